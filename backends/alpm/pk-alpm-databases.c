@@ -39,6 +39,11 @@ pk_alpm_disabled_repos_configure (PkBackend *backend, gboolean only_trusted, GEr
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
 	const alpm_list_t *i;
 
+	/* the sync packages are about to be freed */
+	g_hash_table_remove_all (priv->applications);
+	if (priv->file_indexes != NULL)
+		g_hash_table_remove_all (priv->file_indexes);
+
 	if (alpm_unregister_all_syncdbs (priv->alpm) < 0) {
 		alpm_errno_t errno = alpm_errno (priv->alpm);
 		g_set_error_literal (error, PK_ALPM_ERROR, errno,
@@ -28,22 +28,71 @@
 #include "pk-alpm-error.h"
 #include "pk-alpm-packages.h"
 
-static alpm_pkg_t *
-pk_alpm_list_find_pkgname (const alpm_list_t *pkgs, const gchar *name)
+typedef struct {
+	GQueue		 queue;		/* alpm_pkg_t still to be visited */
+	GHashTable	*visited;	/* name → alpm_pkg_t */
+	GHashTable	*provided;	/* name or provision → alpm_list_t of alpm_pkg_t */
+	GHashTable	*satisfied;	/* set of depstrings already resolved */
+} PkAlpmDependsState;
+
+static void
+pk_alpm_depends_state_init (PkAlpmDependsState *state)
 {
-	g_return_val_if_fail (name != NULL, NULL);
+	g_queue_init (&state->queue);
+	state->visited = g_hash_table_new (g_str_hash, g_str_equal);
+	state->provided = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+						 (GDestroyNotify) alpm_list_free);
+	state->satisfied = g_hash_table_new_full (g_str_hash, g_str_equal,
+						  g_free, NULL);
+}
 
-	for (; pkgs != NULL; pkgs = pkgs->next) {
-		if (g_strcmp0 (name, alpm_pkg_get_name (pkgs->data)) == 0)
-			return pkgs->data;
-	}
+static void
+pk_alpm_depends_state_clear (PkAlpmDependsState *state)
+{
+	g_queue_clear (&state->queue);
+	g_hash_table_unref (state->visited);
+	g_hash_table_unref (state->provided);
+	g_hash_table_unref (state->satisfied);
+}
 
-	return NULL;
+static void
+pk_alpm_depends_state_provide (PkAlpmDependsState *state, const gchar *name,
+			       alpm_pkg_t *pkg)
+{
+	alpm_list_t *pkgs = g_hash_table_lookup (state->provided, name);
+
+	/* appending never changes the head of a non-empty list */
+	if (pkgs == NULL)
+		g_hash_table_insert (state->provided, (gpointer) name,
+				     alpm_list_add (NULL, pkg));
+	else
+		alpm_list_add (pkgs, pkg);
 }
 
-static alpm_list_t *
-pk_alpm_find_provider (PkBackendJob *job, alpm_list_t *pkgs,
-		       const gchar *depend, gboolean recursive,
+/* returns FALSE if the package has already been visited */
+static gboolean
+pk_alpm_depends_state_add (PkAlpmDependsState *state, alpm_pkg_t *pkg)
+{
+	const gchar *name = alpm_pkg_get_name (pkg);
+	const alpm_list_t *i;
+
+	if (g_hash_table_contains (state->visited, name))
+		return FALSE;
+	g_hash_table_insert (state->visited, (gpointer) name, pkg);
+	g_queue_push_tail (&state->queue, pkg);
+
+	/* only these can satisfy a depend, so check them instead of everything */
+	pk_alpm_depends_state_provide (state, name, pkg);
+	for (i = alpm_pkg_get_provides (pkg); i != NULL; i = i->next) {
+		alpm_depend_t *provide = i->data;
+		pk_alpm_depends_state_provide (state, provide->name, pkg);
+	}
+	return TRUE;
+}
+
+static void
+pk_alpm_find_provider (PkBackendJob *job, PkAlpmDependsState *state,
+		       alpm_depend_t *dep, gboolean recursive,
 		       PkBitfield filters, GError **error)
 {
 	PkBackend *backend = pk_backend_job_get_backend (job);
@@ -52,15 +101,22 @@ pk_alpm_find_provider (PkBackendJob *job, alpm_list_t *pkgs,
 
 	alpm_pkg_t *provider;
 	alpm_list_t *pkgcache, *syncdbs;
+	gchar *depend;
+
+	g_return_if_fail (dep != NULL);
 
-	g_return_val_if_fail (depend != NULL, pkgs);
+	/* each depstring only has to be resolved once per job */
+	depend = alpm_dep_compute_string (dep);
+	if (!g_hash_table_add (state->satisfied, depend))
+		return;
 
 	skip_local = pk_bitfield_contain (filters,
 					  PK_FILTER_ENUM_NOT_INSTALLED);
 	skip_remote = pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED);
 
-	if (alpm_find_satisfier (pkgs, depend) != NULL) {
-		return pkgs;
+	if (alpm_find_satisfier (g_hash_table_lookup (state->provided, dep->name),
+				 depend) != NULL) {
+		return;
 	}
 
 	/* look for local dependencies */
@@ -71,12 +127,11 @@ pk_alpm_find_provider (PkBackendJob *job, alpm_list_t *pkgs,
 		if (!skip_local) {
 			pk_alpm_pkg_emit (job, provider, PK_INFO_ENUM_INSTALLED);
 			/* assume later dependencies will also be local */
-			if (recursive) {
-				pkgs = alpm_list_add (pkgs, provider);
-			}
+			if (recursive)
+				pk_alpm_depends_state_add (state, provider);
 		}
 
-		return pkgs;
+		return;
 	}
 
 	/* look for remote dependencies */
@@ -88,28 +143,26 @@ pk_alpm_find_provider (PkBackendJob *job, alpm_list_t *pkgs,
 			pk_alpm_pkg_emit (job, provider, PK_INFO_ENUM_AVAILABLE);
 		/* keep looking for local dependencies */
 		if (recursive)
-			pkgs = alpm_list_add (pkgs, provider);
+			pk_alpm_depends_state_add (state, provider);
 	} else {
 		int code = ALPM_ERR_UNSATISFIED_DEPS;
 		g_set_error (error, PK_ALPM_ERROR, code, "%s: %s", depend,
 			     alpm_strerror (code));
 	}
-
-	return pkgs;
 }
 
-static alpm_list_t *
-pk_backend_find_requirer (PkBackendJob *job, alpm_list_t *pkgs, const gchar *name, gboolean recursive,
-			  GError **error)
+static void
+pk_backend_find_requirer (PkBackendJob *job, PkAlpmDependsState *state,
+			  const gchar *name, gboolean recursive, GError **error)
 {
 	PkBackend *backend = pk_backend_job_get_backend (job);
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
 	alpm_pkg_t *requirer;
 
-	g_return_val_if_fail (name != NULL, pkgs);
+	g_return_if_fail (name != NULL);
 
-	if (pk_alpm_list_find_pkgname (pkgs, name) != NULL)
-		return pkgs;
+	if (g_hash_table_contains (state->visited, name))
+		return;
 
 	/* look for local requirers */
 	requirer = alpm_db_get_pkg (priv->localdb, name);
@@ -117,21 +170,20 @@ pk_backend_find_requirer (PkBackendJob *job, alpm_list_t *pkgs, const gchar *nam
 	if (requirer != NULL) {
 		pk_alpm_pkg_emit (job, requirer, PK_INFO_ENUM_INSTALLED);
 		if (recursive)
-			pkgs = alpm_list_add (pkgs, requirer);
+			pk_alpm_depends_state_add (state, requirer);
 	} else {
 		int code = ALPM_ERR_PKG_NOT_FOUND;
 		g_set_error (error, PK_ALPM_ERROR, code, "%s: %s", name,
 			     alpm_strerror (code));
 	}
-
-	return pkgs;
 }
 
 static void
 pk_backend_depends_on_thread (PkBackendJob* job, GVariant* params, gpointer p)
 {
 	gchar **packages;
-	alpm_list_t *i, *pkgs = NULL;
+	alpm_pkg_t *pkg;
+	PkAlpmDependsState state;
 	g_autoptr(GError) error = NULL;
 	PkBitfield filters;
 	gboolean recursive;
@@ -139,10 +191,10 @@ pk_backend_depends_on_thread (PkBackendJob* job, GVariant* params, gpointer p)
 	g_variant_get (params, "(t^a&sb)",
 		       &filters, &packages, &recursive);
 
+	pk_alpm_depends_state_init (&state);
+
 	/* construct an initial package list */
 	for (; *packages != NULL; ++packages) {
-		alpm_pkg_t *pkg;
-
 		if (pk_backend_job_is_cancelled (job))
 			break;
 
@@ -150,36 +202,35 @@ pk_backend_depends_on_thread (PkBackendJob* job, GVariant* params, gpointer p)
 		if (pkg == NULL)
 			break;
 
-		pkgs = alpm_list_add (pkgs, pkg);
+		pk_alpm_depends_state_add (&state, pkg);
 	}
 
-	/* package list might be modified along the way but that is ok */
-	for (i = pkgs; i != NULL; i = i->next) {
+	/* the queue grows as providers are found when recursive */
+	while ((pkg = g_queue_pop_head (&state.queue)) != NULL) {
 		const alpm_list_t *depends;
 
 		if (pk_backend_job_is_cancelled (job) || error != NULL)
 			break;
 
-		depends = alpm_pkg_get_depends (i->data);
+		depends = alpm_pkg_get_depends (pkg);
 		for (; depends != NULL; depends = depends->next) {
-			g_autofree gchar *depend = NULL;
-
 			if (pk_backend_job_is_cancelled (job) || error != NULL)
 				break;
 
-			depend = alpm_dep_compute_string (depends->data);
-			pkgs = pk_alpm_find_provider (job, pkgs, depend, recursive, filters, &error);
+			pk_alpm_find_provider (job, &state, depends->data,
+					       recursive, filters, &error);
 		}
 	}
 
-	alpm_list_free (pkgs);
+	pk_alpm_depends_state_clear (&state);
 }
 
 static void
 pk_backend_required_by_thread (PkBackendJob* job, GVariant* params, gpointer p)
 {
 	gchar **packages;
-	alpm_list_t *i, *pkgs = NULL;
+	alpm_pkg_t *pkg;
+	PkAlpmDependsState state;
 	g_autoptr(GError) error = NULL;
 	gboolean recursive;
 	PkBitfield filters;
@@ -187,10 +238,10 @@ pk_backend_required_by_thread (PkBackendJob* job, GVariant* params, gpointer p)
 	g_variant_get (params, "(t^a&sb)",
 		       &filters, &packages, &recursive);
 
+	pk_alpm_depends_state_init (&state);
+
 	/* construct an initial package list */
 	for (; *packages != NULL; ++packages) {
-		alpm_pkg_t *pkg;
-
 		if (pk_backend_job_is_cancelled (job))
 			break;
 
@@ -198,29 +249,29 @@ pk_backend_required_by_thread (PkBackendJob* job, GVariant* params, gpointer p)
 		if (pkg == NULL)
 			break;
 
-		pkgs = alpm_list_add (pkgs, pkg);
+		pk_alpm_depends_state_add (&state, pkg);
 	}
 
-	/* package list might be modified along the way but that is ok */
-	for (i = pkgs; i != NULL; i = i->next) {
-		alpm_list_t *requiredby;
+	/* the queue grows as requirers are found when recursive */
+	while ((pkg = g_queue_pop_head (&state.queue)) != NULL) {
+		alpm_list_t *requiredby, *i;
 
 		if (pk_backend_job_is_cancelled (job) || error != NULL)
 			break;
 
-		requiredby = alpm_pkg_compute_requiredby (i->data);
-		for (; requiredby != NULL; requiredby = requiredby->next) {
+		requiredby = alpm_pkg_compute_requiredby (pkg);
+		for (i = requiredby; i != NULL; i = i->next) {
 			if (pk_backend_job_is_cancelled (job) || error != NULL)
 				break;
 
-			pkgs = pk_backend_find_requirer (job, pkgs,
-							 requiredby->data, recursive, &error);
+			pk_backend_find_requirer (job, &state, i->data,
+						  recursive, &error);
 		}
 
 		FREELIST (requiredby);
 	}
 
-	alpm_list_free (pkgs);
+	pk_alpm_depends_state_clear (&state);
 	pk_alpm_finish (job, error);
 }
 
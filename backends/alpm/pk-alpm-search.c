@@ -150,6 +150,132 @@ pk_backend_match_file (alpm_pkg_t *pkg, const gchar *needle)
 	return FALSE;
 }
 
+typedef struct {
+	const gchar	*path;
+	alpm_pkg_t	*pkg;
+} PkAlpmFileOwner;
+
+typedef struct {
+	GArray		*owners;	/* of PkAlpmFileOwner, sorted by path */
+	GHashTable	*basenames;	/* basename → GPtrArray of alpm_pkg_t */
+} PkAlpmFileIndex;
+
+static void
+pk_alpm_file_index_free (PkAlpmFileIndex *file_index)
+{
+	g_array_unref (file_index->owners);
+	g_hash_table_unref (file_index->basenames);
+	g_free (file_index);
+}
+
+static gint
+pk_alpm_file_owner_compare (gconstpointer a, gconstpointer b)
+{
+	const PkAlpmFileOwner *owner_a = a;
+	const PkAlpmFileOwner *owner_b = b;
+	return strcmp (owner_a->path, owner_b->path);
+}
+
+static PkAlpmFileIndex *
+pk_alpm_file_index_new (alpm_db_t *db)
+{
+	PkAlpmFileIndex *file_index;
+	const alpm_list_t *i;
+	gsize j;
+
+	file_index = g_new0 (PkAlpmFileIndex, 1);
+	file_index->owners = g_array_new (FALSE, FALSE, sizeof (PkAlpmFileOwner));
+	file_index->basenames = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+						  (GDestroyNotify) g_ptr_array_unref);
+
+	/* the strings belong to the package cache, so are not copied */
+	for (i = alpm_db_get_pkgcache (db); i != NULL; i = i->next) {
+		alpm_filelist_t *files = alpm_pkg_get_files (i->data);
+
+		for (j = 0; j < files->count; ++j) {
+			PkAlpmFileOwner owner;
+			const gchar *name;
+			GPtrArray *pkgs;
+
+			owner.path = files->files[j].name;
+			owner.pkg = i->data;
+			g_array_append_val (file_index->owners, owner);
+
+			name = strrchr (owner.path, G_DIR_SEPARATOR);
+			if (name == NULL) {
+				name = owner.path;
+			} else {
+				++name;
+			}
+
+			pkgs = g_hash_table_lookup (file_index->basenames, name);
+			if (pkgs == NULL) {
+				pkgs = g_ptr_array_new ();
+				g_hash_table_insert (file_index->basenames,
+						     (gpointer) name, pkgs);
+			}
+			g_ptr_array_add (pkgs, i->data);
+		}
+	}
+
+	g_array_sort (file_index->owners, pk_alpm_file_owner_compare);
+	return file_index;
+}
+
+static PkAlpmFileIndex *
+pk_alpm_file_index_get (PkBackendAlpmPrivate *priv, alpm_db_t *db)
+{
+	PkAlpmFileIndex *file_index;
+
+	if (priv->file_indexes == NULL) {
+		priv->file_indexes = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+							    (GDestroyNotify) pk_alpm_file_index_free);
+	}
+
+	file_index = g_hash_table_lookup (priv->file_indexes, db);
+	if (file_index == NULL) {
+		file_index = pk_alpm_file_index_new (db);
+		g_hash_table_insert (priv->file_indexes, db, file_index);
+	}
+	return file_index;
+}
+
+/* returns the set of packages that own a file matching needle */
+static GHashTable *
+pk_alpm_file_index_lookup (PkAlpmFileIndex *file_index, const gchar *needle)
+{
+	GHashTable *pkgs = g_hash_table_new (g_direct_hash, g_direct_equal);
+	guint lo = 0, hi = file_index->owners->len;
+	guint i;
+
+	if (!G_IS_DIR_SEPARATOR (*needle)) {
+		GPtrArray *owners = g_hash_table_lookup (file_index->basenames, needle);
+		for (i = 0; owners != NULL && i < owners->len; ++i)
+			g_hash_table_add (pkgs, g_ptr_array_index (owners, i));
+		return pkgs;
+	}
+
+	/* match the full path of file, which may have more than one owner */
+	++needle;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+		const PkAlpmFileOwner *owner = &g_array_index (file_index->owners,
+							       PkAlpmFileOwner, mid);
+		if (strcmp (owner->path, needle) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (i = lo; i < file_index->owners->len; ++i) {
+		const PkAlpmFileOwner *owner = &g_array_index (file_index->owners,
+							       PkAlpmFileOwner, i);
+		if (strcmp (owner->path, needle) != 0)
+			break;
+		g_hash_table_add (pkgs, owner->pkg);
+	}
+	return pkgs;
+}
+
 static gboolean
 pk_backend_match_group (alpm_pkg_t *pkg, const gchar *needle)
 {
@@ -264,24 +390,117 @@ pk_alpm_pkg_is_local (PkBackendJob *job, alpm_pkg_t *pkg)
 	return TRUE;
 }
 
+#define PK_ALPM_APPLICATIONS_DIR	"usr/share/applications/"
+
 static gboolean
-pk_alpm_search_is_application (alpm_pkg_t *pkg) {
-	guint i;
+pk_alpm_pkg_has_desktop_file (alpm_pkg_t *pkg)
+{
 	alpm_filelist_t *filelist;
-	g_autoptr(GRegex) regex = NULL;
+	gsize len = strlen (PK_ALPM_APPLICATIONS_DIR);
+	gsize lo = 0, hi;
 
 	filelist = alpm_pkg_get_files (pkg);
-	regex = g_regex_new ("^usr/share/applications/.*\\.desktop$", 0, 0, NULL);
+	hi = filelist->count;
+
+	/* the file list is sorted, so find the first file in the directory */
+	while (lo < hi) {
+		gsize mid = lo + (hi - lo) / 2;
+		if (strcmp (filelist->files[mid].name, PK_ALPM_APPLICATIONS_DIR) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-	for (i = 0; i < filelist->count; i++) {
-		const alpm_file_t *file = filelist->files + i;
-		if (g_regex_match (regex, file->name, 0, NULL)) {
+	for (; lo < filelist->count; lo++) {
+		const gchar *name = filelist->files[lo].name;
+		if (strncmp (name, PK_ALPM_APPLICATIONS_DIR, len) != 0)
+			break;
+		if (g_str_has_suffix (name, ".desktop"))
 			return TRUE;
-		}
 	}
 	return FALSE;
 }
 
+static gboolean
+pk_alpm_search_is_application (PkBackendAlpmPrivate *priv, alpm_pkg_t *pkg)
+{
+	alpm_db_t *db = alpm_pkg_get_db (pkg);
+	gboolean ret;
+	gpointer value;
+	gchar *key;
+
+	/* packages are freed when databases are reloaded, so key on the name */
+	key = g_strdup_printf ("%s/%s-%s",
+			       db != NULL ? alpm_db_get_name (db) : "",
+			       alpm_pkg_get_name (pkg),
+			       alpm_pkg_get_version (pkg));
+	if (g_hash_table_lookup_extended (priv->applications, key, NULL, &value)) {
+		g_free (key);
+		return GPOINTER_TO_INT (value);
+	}
+
+	ret = pk_alpm_pkg_has_desktop_file (pkg);
+	g_hash_table_insert (priv->applications, key, GINT_TO_POINTER (ret));
+	return ret;
+}
+
+static void
+pk_backend_search_emit (PkBackendJob *job, alpm_db_t *db, alpm_pkg_t *pkg,
+			PkBitfield filters)
+{
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	/* want applications */
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION) && !pk_alpm_search_is_application (priv, pkg))
+		return;
+
+	/* don't want applications */
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION) && pk_alpm_search_is_application (priv, pkg))
+		return;
+
+	if (db == priv->localdb) {
+		pk_alpm_pkg_emit (job, pkg, PK_INFO_ENUM_INSTALLED);
+	} else if (!pk_alpm_pkg_is_local (job, pkg)) {
+		pk_alpm_pkg_emit (job, pkg, PK_INFO_ENUM_AVAILABLE);
+	}
+}
+
+static void
+pk_backend_search_db_files (PkBackendJob *job, alpm_db_t *db,
+			    const alpm_list_t *patterns, PkBitfield filters)
+{
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	PkAlpmFileIndex *file_index;
+	const alpm_list_t *i, *j;
+	alpm_list_t *owners = NULL, *k;
+
+	file_index = pk_alpm_file_index_get (priv, db);
+	for (i = patterns; i != NULL; i = i->next)
+		owners = alpm_list_add (owners, pk_alpm_file_index_lookup (file_index, i->data));
+
+	/* emit packages that own a file for every search term */
+	for (i = alpm_db_get_pkgcache (db); i != NULL; i = i->next) {
+		if (pk_backend_job_is_cancelled (job))
+			break;
+
+		for (j = patterns, k = owners; j != NULL; j = j->next, k = k->next) {
+			if (!g_hash_table_contains (k->data, i->data))
+				break;
+		}
+
+		/* not all search terms matched */
+		if (j != NULL)
+			continue;
+
+		pk_backend_search_emit (job, db, i->data, filters);
+	}
+
+	alpm_list_free_inner (owners, (GDestroyNotify) g_hash_table_unref);
+	alpm_list_free (owners);
+}
+
 static void
 pk_backend_search_db (PkBackendJob *job, alpm_db_t *db, MatchFunc match,
 		      const alpm_list_t *patterns, PkBitfield filters)
@@ -293,6 +512,13 @@ pk_backend_search_db (PkBackendJob *job, alpm_db_t *db, MatchFunc match,
 	g_return_if_fail (db != NULL);
 	g_return_if_fail (match != NULL);
 
+	/* the local package cache changes under us after transactions, so
+	 * only the sync databases are worth indexing */
+	if (match == (MatchFunc) pk_backend_match_file && db != priv->localdb) {
+		pk_backend_search_db_files (job, db, patterns, filters);
+		return;
+	}
+
 	/* emit packages that match all search terms */
 	for (i = alpm_db_get_pkgcache (db); i != NULL; i = i->next) {
 		if (pk_backend_job_is_cancelled (job))
@@ -307,19 +533,7 @@ pk_backend_search_db (PkBackendJob *job, alpm_db_t *db, MatchFunc match,
 		if (j != NULL)
 			continue;
 
-		/* want applications */
-		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION) && !pk_alpm_search_is_application (i->data))
-			continue;
-
-		/* don't want applications */
-		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION) && pk_alpm_search_is_application (i->data))
-			continue;
-
-		if (db == priv->localdb) {
-			pk_alpm_pkg_emit (job, i->data, PK_INFO_ENUM_INSTALLED);
-		} else if (!pk_alpm_pkg_is_local (job, i->data)) {
-			pk_alpm_pkg_emit (job, i->data, PK_INFO_ENUM_AVAILABLE);
-		}
+		pk_backend_search_emit (job, db, i->data, filters);
 	}
 }
 
@@ -271,6 +271,10 @@ pk_alpm_update_database (PkBackendJob *job, gint force, alpm_db_t *db, GError **
 	if (pk_alpm_update_is_db_fresh (job, db))
 		return TRUE;
 
+	/* the index points into the package cache we are replacing */
+	if (priv->file_indexes != NULL)
+		g_hash_table_remove (priv->file_indexes, db);
+
 	result = alpm_db_update (force, db);
 	if (result > 0) {
 		dlcb ("", 1, 1);
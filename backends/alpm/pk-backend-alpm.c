@@ -144,6 +144,8 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	g_autoptr(GError) error = NULL;
 
 	priv = g_new0 (PkBackendAlpmPrivate, 1);
+	priv->applications = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free, NULL);
 	pk_backend_set_user_data (backend, priv);
 
 	if (!pk_alpm_initialize (backend, &error))
@@ -175,6 +177,9 @@ pk_backend_destroy (PkBackend *backend)
 
 	FREELIST (priv->syncfirsts);
 	FREELIST (priv->holdpkgs);
+	g_hash_table_unref (priv->applications);
+	if (priv->file_indexes != NULL)
+		g_hash_table_unref (priv->file_indexes);
 	g_free (priv);
 }
 
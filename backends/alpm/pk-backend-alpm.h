@@ -34,6 +34,8 @@ typedef struct {
 	GFileMonitor    *monitor;
 	alpm_list_t     *configured_repos; /* list of configured repos */
 	gboolean	localdb_changed;
+	GHashTable	*applications; /* "db/name-version" → is application */
+	GHashTable	*file_indexes; /* sync alpm_db_t → file owner index */
 } PkBackendAlpmPrivate;
 
 void		 pk_alpm_run		(PkBackendJob *job, PkStatusEnum status,
@@ -53,6 +53,8 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	pk_backend_spawn_set_name (spawn, "entropy");
 	/* allowing sigkill as long as no one complain */
 	pk_backend_spawn_set_allow_sigkill (spawn, TRUE);
+	/* the helper only takes the entropy resource locks for each method */
+	pk_backend_spawn_set_allow_pool (spawn, TRUE);
 }
 
 /**
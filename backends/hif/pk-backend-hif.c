@@ -56,6 +56,8 @@ typedef struct {
 	HySack		 sack;
 	gboolean	 valid;
 	gchar		*key;
+	HifSackAddFlags	 flags;		/* the metadata kinds loaded */
+	GPtrArray	*metadata_only;	/* of source IDs without packages */
 } HifSackCacheItem;
 
 typedef struct {
@@ -63,6 +65,13 @@ typedef struct {
 	HifContext	*context;
 	GHashTable	*sack_cache;	/* of HifSackCacheItem */
 	GMutex		 sack_mutex;
+	GCond		 sack_cond;	/* signalled when a warm-up finishes */
+	gboolean	 sack_warming;
+	gboolean	 sack_warm_pending;
+	guint		 sack_warm_id;
+	guint		 jobs_running;
+	gboolean	 sack_warm_disabled;
+	GCancellable	*sack_warm_cancellable;
 	GTimer		*repos_timer;
 } PkBackendHifPrivate;
 
@@ -103,6 +112,12 @@ pk_backend_supports_parallelization (PkBackend *backend)
 	return FALSE;
 }
 
+static void pk_backend_sack_warm_schedule (PkBackend *backend);
+static void pk_backend_sack_warm_queue (PkBackend *backend);
+static void pk_backend_sack_warm_wait (PkBackendHifPrivate *priv);
+static void pk_backend_sack_warm_cancel (PkBackend *backend);
+static void pk_backend_sack_warm_wait_job (PkBackendJob *job);
+
 /**
  * pk_backend_sack_cache_invalidate:
  **/
@@ -125,6 +140,8 @@ pk_backend_sack_cache_invalidate (PkBackend *backend, const gchar *why)
 		}
 	}
 	g_mutex_unlock (&priv->sack_mutex);
+
+	pk_backend_sack_warm_schedule (backend);
 }
 
 /**
@@ -145,6 +162,7 @@ hif_sack_cache_item_free (HifSackCacheItem *cache_item)
 {
 	hy_sack_free (cache_item->sack);
 	g_free (cache_item->key);
+	g_ptr_array_unref (cache_item->metadata_only);
 	g_slice_free (HifSackCacheItem, cache_item);
 }
 
@@ -236,14 +254,19 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	if (release_ver == NULL)
 		g_error ("Failed to parse os-release: %s", error->message);
 
-	/* a cache of HySacks with the key being which sacks are loaded
+	/* a cache of HySacks with the key being the release version
 	 *
 	 * notes:
 	 * - this deals with deallocating the sack when the backend is unloaded
 	 * - all the cached sacks are dropped on any transaction that can
 	 *   modify state or if the repos or rpmdb are changed
+	 * - there is one sack per key holding every kind of metadata asked
+	 *   for so far, and role and filter differences are applied when it
+	 *   is used rather than by loading another sack
 	 */
 	g_mutex_init (&priv->sack_mutex);
+	g_cond_init (&priv->sack_cond);
+	priv->sack_warm_cancellable = g_cancellable_new ();
 	priv->sack_cache = g_hash_table_new_full (g_str_hash,
 						  g_str_equal,
 						  g_free,
@@ -265,6 +288,9 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 			  G_CALLBACK (pk_backend_hif_repos_changed_cb), backend);
 
 	lr_global_init ();
+
+	/* have a sack ready for the first query */
+	pk_backend_sack_warm_schedule (backend);
 }
 
 /**
@@ -274,12 +300,24 @@ void
 pk_backend_destroy (PkBackend *backend)
 {
 	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+
+	/* stop any background build before the context goes away */
+	g_cancellable_cancel (priv->sack_warm_cancellable);
+	g_mutex_lock (&priv->sack_mutex);
+	priv->sack_warm_disabled = TRUE;
+	pk_backend_sack_warm_wait (priv);
+	if (priv->sack_warm_id != 0)
+		g_source_remove (priv->sack_warm_id);
+	g_mutex_unlock (&priv->sack_mutex);
+	g_object_unref (priv->sack_warm_cancellable);
+
 	if (priv->conf != NULL)
 		g_key_file_unref (priv->conf);
 	if (priv->context != NULL)
 		g_object_unref (priv->context);
 	g_timer_destroy (priv->repos_timer);
 	g_mutex_clear (&priv->sack_mutex);
+	g_cond_clear (&priv->sack_cond);
 	g_hash_table_unref (priv->sack_cache);
 	g_free (priv);
 }
@@ -426,6 +464,11 @@ pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 	job_data->backend = backend;
 	pk_backend_job_set_user_data (job, job_data);
 
+	/* don't start warming the sack while the job runs */
+	g_mutex_lock (&priv->sack_mutex);
+	priv->jobs_running++;
+	g_mutex_unlock (&priv->sack_mutex);
+
 	/* HifState */
 	job_data->state = hif_state_new ();
 	hif_state_set_cancellable (job_data->state,
@@ -460,6 +503,7 @@ pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 void
 pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 {
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
 	PkBackendHifJobData *job_data = pk_backend_job_get_user_data (job);
 
 	if (job_data->state != NULL) {
@@ -476,6 +520,12 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 		hy_goal_free (job_data->goal);
 	g_free (job_data);
 	pk_backend_job_set_user_data (job, NULL);
+
+	/* anything invalidated during the job can be rebuilt now */
+	g_mutex_lock (&priv->sack_mutex);
+	priv->jobs_running--;
+	pk_backend_sack_warm_queue (backend);
+	g_mutex_unlock (&priv->sack_mutex);
 }
 
 /**
@@ -484,10 +534,17 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 static gboolean
 pk_backend_ensure_sources (PkBackendHifJobData *job_data, GError **error)
 {
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (job_data->backend);
+
 	/* already set */
 	if (job_data->sources != NULL)
 		return TRUE;
 
+	/* don't load the repos at the same time as a background build */
+	g_mutex_lock (&priv->sack_mutex);
+	pk_backend_sack_warm_wait (priv);
+	g_mutex_unlock (&priv->sack_mutex);
+
 	/* set the list of repos */
 	job_data->sources = hif_repos_get_sources (hif_context_get_repos (job_data->context), error);
 	if (job_data->sources == NULL)
@@ -499,47 +556,20 @@ pk_backend_ensure_sources (PkBackendHifJobData *job_data, GError **error)
  * hif_utils_add_remote:
  */
 static gboolean
-hif_utils_add_remote (PkBackendJob *job,
-		      HySack sack,
+hif_utils_add_remote (HySack sack,
+		      GPtrArray *sources,
+		      guint cache_age,
 		      HifSackAddFlags flags,
 		      HifState *state,
 		      GError **error)
 {
-	gboolean ret;
-	HifState *state_local;
-	PkBackendHifJobData *job_data = pk_backend_job_get_user_data (job);
-
-	/* set state */
-	ret = hif_state_set_steps (state, error,
-				   2, /* load files */
-				   98, /* add sources */
-				   -1);
-	if (!ret)
-		return FALSE;
-
-	/* set the list of repos */
-	if (!pk_backend_ensure_sources (job_data, error))
-		return FALSE;
-
-	/* done */
-	if (!hif_state_done (state, error))
-		return FALSE;
-
 	/* add each repo */
-	state_local = hif_state_get_child (state);
-	ret = hif_sack_add_sources (sack,
-				    job_data->sources,
-				    pk_backend_job_get_cache_age (job),
-				    flags,
-				    state_local,
-				    error);
-	if (!ret)
-		return FALSE;
-
-	/* done */
-	if (!hif_state_done (state, error))
-		return FALSE;
-	return TRUE;
+	return hif_sack_add_sources (sack,
+				     sources,
+				     cache_age,
+				     flags,
+				     state,
+				     error);
 }
 
 typedef enum {
@@ -552,27 +582,76 @@ typedef enum {
  * hif_utils_create_cache_key:
  */
 static gchar *
-hif_utils_create_cache_key (const gchar *release_ver, HifSackAddFlags flags)
+hif_utils_create_cache_key (const gchar *release_ver)
 {
-	GString *key;
+	return g_strdup_printf ("HySack::release_ver[%s]", release_ver);
+}
 
-	key = g_string_new ("HySack::");
-	g_string_append_printf (key, "release_ver[%s]::", release_ver);
+/**
+ * hif_utils_get_metadata_only_sources:
+ *
+ * Returns the IDs of the sources in @sack that were only loaded for their
+ * metadata, i.e. that have packages which cannot be installed.
+ */
+static GPtrArray *
+hif_utils_get_metadata_only_sources (GPtrArray *sources, HySack sack)
+{
+	GPtrArray *ids;
+	HifSource *src;
+	HyPackageList pkglist;
+	HyQuery query;
+	guint i;
 
-	if (flags == HIF_SACK_ADD_FLAG_NONE) {
-		g_string_append (key, "none");
-	} else {
-		if (flags & HIF_SACK_ADD_FLAG_FILELISTS)
-			g_string_append (key, "filelists|");
-		if (flags & HIF_SACK_ADD_FLAG_UPDATEINFO)
-			g_string_append (key, "updateinfo|");
-		if (flags & HIF_SACK_ADD_FLAG_REMOTE)
-			g_string_append (key, "remote|");
-		if (flags & HIF_SACK_ADD_FLAG_UNAVAILABLE)
-			g_string_append (key, "unavailable|");
-		g_string_truncate (key, key->len - 1);
+	ids = g_ptr_array_new_with_free_func (g_free);
+	if (sources == NULL)
+		return ids;
+	for (i = 0; i < sources->len; i++) {
+		src = g_ptr_array_index (sources, i);
+		if (hif_source_get_enabled (src) != HIF_SOURCE_ENABLED_METADATA)
+			continue;
+
+		/* hawkey cannot disable a repo it never loaded */
+		query = hy_query_create (sack);
+		hy_query_filter (query, HY_PKG_REPONAME, HY_EQ, hif_source_get_id (src));
+		pkglist = hy_query_run (query);
+		if (hy_packagelist_count (pkglist) > 0)
+			g_ptr_array_add (ids, g_strdup (hif_source_get_id (src)));
+		hy_packagelist_free (pkglist);
+		hy_query_free (query);
+	}
+	return ids;
+}
+
+/**
+ * hif_utils_sack_enable_for_role:
+ *
+ * Only queries see packages from sources that are enabled just for their
+ * metadata, so hide them from everything else.
+ */
+static void
+hif_utils_sack_enable_for_role (PkBackendJob *job, HifSackCacheItem *cache_item)
+{
+	gboolean enabled;
+	guint i;
+
+	switch (pk_backend_job_get_role (job)) {
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		enabled = TRUE;
+		break;
+	default:
+		enabled = FALSE;
+		break;
+	}
+	for (i = 0; i < cache_item->metadata_only->len; i++) {
+		hy_sack_repo_enabled (cache_item->sack,
+				      g_ptr_array_index (cache_item->metadata_only, i),
+				      enabled);
 	}
-	return g_string_free (key, FALSE);
 }
 
 /**
@@ -600,87 +679,26 @@ hif_utils_real_path (const gchar *path)
 }
 
 /**
- * hif_utils_create_sack_for_filters:
+ * hif_utils_build_sack:
+ *
+ * Creates a sack that does not depend on any job, so it can also be used to
+ * warm the cache in the background.
  */
 static HySack
-hif_utils_create_sack_for_filters (PkBackendJob *job,
-				   PkBitfield filters,
-				   HifCreateSackFlags create_flags,
-				   HifState *state,
-				   GError **error)
+hif_utils_build_sack (HifContext *context,
+		      GPtrArray *sources,
+		      guint cache_age,
+		      HifSackAddFlags flags,
+		      HifState *state,
+		      GError **error)
 {
 	gboolean ret;
 	gint rc;
-	HifSackAddFlags flags = HIF_SACK_ADD_FLAG_FILELISTS;
-	HifSackCacheItem *cache_item = NULL;
 	HifState *state_local;
 	HySack sack = NULL;
-	PkBackend *backend = pk_backend_job_get_backend (job);
-	PkBackendHifJobData *job_data = pk_backend_job_get_user_data (job);
-	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
-	g_autofree gchar *cache_key = NULL;
 	g_autofree gchar *install_root = NULL;
 	g_autofree gchar *solv_dir = NULL;
 
-	/* don't add if we're going to filter out anyway */
-	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
-		flags |= HIF_SACK_ADD_FLAG_REMOTE;
-
-	/* only load updateinfo when required */
-	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL)
-		flags |= HIF_SACK_ADD_FLAG_UPDATEINFO;
-
-	/* only use unavailble packages for queries */
-	switch (pk_backend_job_get_role (job)) {
-	case PK_ROLE_ENUM_RESOLVE:
-	case PK_ROLE_ENUM_SEARCH_NAME:
-	case PK_ROLE_ENUM_SEARCH_DETAILS:
-	case PK_ROLE_ENUM_SEARCH_FILE:
-	case PK_ROLE_ENUM_GET_DETAILS:
-	case PK_ROLE_ENUM_WHAT_PROVIDES:
-		flags |= HIF_SACK_ADD_FLAG_UNAVAILABLE;
-		break;
-	default:
-		break;
-	}
-
-	/* media repos could disappear at any time */
-	if ((create_flags & HIF_CREATE_SACK_FLAG_USE_CACHE) > 0 &&
-	    hif_repos_has_removable (hif_context_get_repos (job_data->context)) &&
-	    g_timer_elapsed (priv->repos_timer, NULL) > 1.0f) {
-		g_debug ("not reusing sack as media may have disappeared");
-		create_flags &= ~HIF_CREATE_SACK_FLAG_USE_CACHE;
-	}
-	g_timer_reset (priv->repos_timer);
-
-	/* if we've specified a specific cache-age then do not use the cache */
-	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0 &&
-	    pk_backend_job_get_cache_age (job) != G_MAXUINT) {
-		g_debug ("not reusing sack specific cache age requested");
-		create_flags &= ~HIF_CREATE_SACK_FLAG_USE_CACHE;
-	}
-
-	/* do we have anything in the cache */
-	cache_key = hif_utils_create_cache_key (hif_context_get_release_ver (job_data->context), flags);
-	if ((create_flags & HIF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
-		g_mutex_lock (&priv->sack_mutex);
-		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
-		if (cache_item != NULL && cache_item->sack != NULL) {
-			if (cache_item->valid) {
-				ret = TRUE;
-				g_debug ("using cached sack %s", cache_key);
-				sack = cache_item->sack;
-				g_mutex_unlock (&priv->sack_mutex);
-				goto out;
-			} else {
-				/* we have to do this now rather than rely on the
-				 * callback of the hash table */
-				g_hash_table_remove (priv->sack_cache, cache_key);
-			}
-		}
-		g_mutex_unlock (&priv->sack_mutex);
-	}
-
 	/* update status */
 	hif_state_action_start (state, HIF_STATE_ACTION_QUERY, NULL);
 
@@ -697,8 +715,8 @@ hif_utils_create_sack_for_filters (PkBackendJob *job,
 	}
 
 	/* create empty sack */
-	solv_dir = hif_utils_real_path (hif_context_get_solv_dir (job_data->context));
-	install_root = hif_utils_real_path (hif_context_get_install_root (job_data->context));
+	solv_dir = hif_utils_real_path (hif_context_get_solv_dir (context));
+	install_root = hif_utils_real_path (hif_context_get_install_root (context));
 #if HY_VERSION_CHECK(0,5,3)
 	sack = hy_sack_create (solv_dir, NULL, install_root, NULL, HY_MAKE_CACHE_DIR);
 #else
@@ -707,8 +725,8 @@ hif_utils_create_sack_for_filters (PkBackendJob *job,
 	if (sack == NULL) {
 		ret = hif_error_set_from_hawkey (hy_get_errno (), error);
 		g_prefix_error (error, "failed to create sack in %s for %s: ",
-				hif_context_get_solv_dir (job_data->context),
-				hif_context_get_install_root (job_data->context));
+				hif_context_get_solv_dir (context),
+				hif_context_get_install_root (context));
 		goto out;
 	}
 
@@ -728,7 +746,7 @@ hif_utils_create_sack_for_filters (PkBackendJob *job,
 	/* add remote packages */
 	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0) {
 		state_local = hif_state_get_child (state);
-		ret = hif_utils_add_remote (job, sack, flags,
+		ret = hif_utils_add_remote (sack, sources, cache_age, flags,
 					    state_local, error);
 		if (!ret)
 			goto out;
@@ -741,22 +759,353 @@ hif_utils_create_sack_for_filters (PkBackendJob *job,
 
 	/* creates repo for command line rpms */
 	hy_sack_create_cmdline_repo (sack);
+out:
+	if (!ret && sack != NULL) {
+		hy_sack_free (sack);
+		sack = NULL;
+	}
+	return sack;
+}
+
+/**
+ * hif_utils_sack_cache_add:
+ *
+ * Saves @sack in the cache, replacing any smaller or invalid sack. The
+ * sack mutex must be held.
+ */
+static HifSackCacheItem *
+hif_utils_sack_cache_add (PkBackendHifPrivate *priv,
+			  const gchar *cache_key,
+			  HySack sack,
+			  HifSackAddFlags flags,
+			  GPtrArray *sources)
+{
+	HifSackCacheItem *cache_item;
 
-	/* save in cache */
-	g_mutex_lock (&priv->sack_mutex);
 	cache_item = g_slice_new (HifSackCacheItem);
 	cache_item->key = g_strdup (cache_key);
 	cache_item->sack = sack;
 	cache_item->valid = TRUE;
+	cache_item->flags = flags;
+	cache_item->metadata_only = hif_utils_get_metadata_only_sources (sources, sack);
 	g_debug ("created cached sack %s", cache_item->key);
 	g_hash_table_insert (priv->sack_cache, g_strdup (cache_key), cache_item);
+	return cache_item;
+}
+
+/**
+ * hif_utils_create_sack_for_filters:
+ */
+static HySack
+hif_utils_create_sack_for_filters (PkBackendJob *job,
+				   PkBitfield filters,
+				   HifCreateSackFlags create_flags,
+				   HifState *state,
+				   GError **error)
+{
+	HifSackAddFlags flags = HIF_SACK_ADD_FLAG_FILELISTS;
+	HifSackCacheItem *cache_item = NULL;
+	HySack sack = NULL;
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendHifJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+	g_autofree gchar *cache_key = NULL;
+
+	/* don't add if we're going to filter out anyway; unavailable
+	 * packages are always loaded and hidden when not wanted */
+	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
+		flags |= HIF_SACK_ADD_FLAG_REMOTE | HIF_SACK_ADD_FLAG_UNAVAILABLE;
+
+	/* only load updateinfo when required */
+	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL)
+		flags |= HIF_SACK_ADD_FLAG_UPDATEINFO;
+
+	/* media repos could disappear at any time */
+	if ((create_flags & HIF_CREATE_SACK_FLAG_USE_CACHE) > 0 &&
+	    hif_repos_has_removable (hif_context_get_repos (job_data->context)) &&
+	    g_timer_elapsed (priv->repos_timer, NULL) > 1.0f) {
+		g_debug ("not reusing sack as media may have disappeared");
+		create_flags &= ~HIF_CREATE_SACK_FLAG_USE_CACHE;
+	}
+	g_timer_reset (priv->repos_timer);
+
+	/* if we've specified a specific cache-age then do not use the cache */
+	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0 &&
+	    pk_backend_job_get_cache_age (job) != G_MAXUINT) {
+		g_debug ("not reusing sack specific cache age requested");
+		create_flags &= ~HIF_CREATE_SACK_FLAG_USE_CACHE;
+	}
+
+	/* wait for a background build rather than starting a second one */
+	cache_key = hif_utils_create_cache_key (hif_context_get_release_ver (job_data->context));
+	g_mutex_lock (&priv->sack_mutex);
+	pk_backend_sack_warm_wait (priv);
+
+	/* do we have anything in the cache */
+	if ((create_flags & HIF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
+		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
+		if (cache_item != NULL && cache_item->sack != NULL) {
+			if (cache_item->valid &&
+			    (cache_item->flags & flags) == flags) {
+				g_debug ("using cached sack %s", cache_key);
+				hif_utils_sack_enable_for_role (job, cache_item);
+				sack = cache_item->sack;
+				g_mutex_unlock (&priv->sack_mutex);
+				return sack;
+			}
+
+			/* replace it with one that has everything */
+			if (cache_item->valid) {
+				g_debug ("extending cached sack %s", cache_key);
+				flags |= cache_item->flags;
+			}
+
+			/* we have to do this now rather than rely on the
+			 * callback of the hash table */
+			g_hash_table_remove (priv->sack_cache, cache_key);
+		}
+	}
 	g_mutex_unlock (&priv->sack_mutex);
+
+	/* set the list of repos */
+	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0 &&
+	    !pk_backend_ensure_sources (job_data, error))
+		return NULL;
+
+	sack = hif_utils_build_sack (job_data->context,
+				     job_data->sources,
+				     pk_backend_job_get_cache_age (job),
+				     flags, state, error);
+	if (sack == NULL)
+		return NULL;
+
+	/* save in cache */
+	g_mutex_lock (&priv->sack_mutex);
+	cache_item = hif_utils_sack_cache_add (priv, cache_key, sack, flags,
+					       job_data->sources);
+	hif_utils_sack_enable_for_role (job, cache_item);
+	g_mutex_unlock (&priv->sack_mutex);
+	return sack;
+}
+
+/**
+ * pk_backend_sack_warm_sources_cached:
+ *
+ * Warming up must never hit the network, so only do it when every source
+ * already has usable metadata.
+ */
+static gboolean
+pk_backend_sack_warm_sources_cached (GPtrArray *sources, HifState *state)
+{
+	HifSource *src;
+	guint i;
+
+	for (i = 0; i < sources->len; i++) {
+		src = g_ptr_array_index (sources, i);
+		if (hif_source_get_enabled (src) == HIF_SOURCE_ENABLED_NONE)
+			continue;
+		if (hif_source_get_kind (src) == HIF_SOURCE_KIND_MEDIA)
+			continue;
+		hif_state_reset (state);
+		if (!hif_source_check (src, G_MAXUINT, state, NULL)) {
+			g_debug ("not warming sack as %s needs refreshing",
+				 hif_source_get_id (src));
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * pk_backend_sack_warm_thread:
+ */
+static gpointer
+pk_backend_sack_warm_thread (gpointer user_data)
+{
+	PkBackend *backend = PK_BACKEND (user_data);
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+	HifSackAddFlags flags = HIF_SACK_ADD_FLAG_FILELISTS |
+				HIF_SACK_ADD_FLAG_REMOTE |
+				HIF_SACK_ADD_FLAG_UNAVAILABLE;
+	HySack sack = NULL;
+	g_autofree gchar *cache_key = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) sources = NULL;
+	g_autoptr(HifState) state = NULL;
+
+	state = hif_state_new ();
+	hif_state_set_cancellable (state, priv->sack_warm_cancellable);
+
+	sources = hif_repos_get_sources (hif_context_get_repos (priv->context), &error);
+	if (sources == NULL) {
+		g_debug ("not warming sack: %s", error->message);
+		goto out;
+	}
+	if (!pk_backend_sack_warm_sources_cached (sources, state))
+		goto out;
+
+	hif_state_reset (state);
+	sack = hif_utils_build_sack (priv->context, sources, G_MAXUINT,
+				     flags, state, &error);
+	if (sack == NULL) {
+		g_debug ("failed to warm sack: %s", error->message);
+		goto out;
+	}
 out:
-	if (!ret && sack != NULL) {
+	g_mutex_lock (&priv->sack_mutex);
+	cache_key = hif_utils_create_cache_key (hif_context_get_release_ver (priv->context));
+
+	/* only swap it in if nothing changed while we were building */
+	if (sack != NULL && priv->sack_warm_pending) {
+		g_debug ("dropping warmed sack as it is already out of date");
 		hy_sack_free (sack);
-		sack = NULL;
+	} else if (sack != NULL) {
+		hif_utils_sack_cache_add (priv, cache_key, sack, flags, sources);
 	}
-	return sack;
+	priv->sack_warming = FALSE;
+	g_cond_broadcast (&priv->sack_cond);
+
+	/* try again for whatever invalidated it */
+	pk_backend_sack_warm_queue (backend);
+	g_mutex_unlock (&priv->sack_mutex);
+	g_object_unref (backend);
+	return NULL;
+}
+
+/**
+ * pk_backend_sack_warm_idle_cb:
+ */
+static gboolean
+pk_backend_sack_warm_idle_cb (gpointer user_data)
+{
+	PkBackend *backend = PK_BACKEND (user_data);
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+	HifSackCacheItem *cache_item;
+	GThread *thread;
+	g_autofree gchar *cache_key = NULL;
+
+	g_mutex_lock (&priv->sack_mutex);
+	priv->sack_warm_id = 0;
+
+	/* jobs may change the rpmdb under us; try again when they stop */
+	if (!priv->sack_warm_pending || priv->sack_warming ||
+	    priv->jobs_running > 0) {
+		g_mutex_unlock (&priv->sack_mutex);
+		return G_SOURCE_REMOVE;
+	}
+	priv->sack_warm_pending = FALSE;
+
+	/* a job may have built one since we were scheduled */
+	cache_key = hif_utils_create_cache_key (hif_context_get_release_ver (priv->context));
+	cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
+	if (cache_item != NULL && cache_item->valid) {
+		g_mutex_unlock (&priv->sack_mutex);
+		return G_SOURCE_REMOVE;
+	}
+	if (cache_item != NULL)
+		g_hash_table_remove (priv->sack_cache, cache_key);
+
+	/* the last one may have been cancelled by a job */
+	if (g_cancellable_is_cancelled (priv->sack_warm_cancellable)) {
+		g_object_unref (priv->sack_warm_cancellable);
+		priv->sack_warm_cancellable = g_cancellable_new ();
+	}
+	priv->sack_warming = TRUE;
+	g_mutex_unlock (&priv->sack_mutex);
+
+	g_debug ("warming sack %s", cache_key);
+	thread = g_thread_new ("pk-hif-warm", pk_backend_sack_warm_thread,
+			       g_object_ref (backend));
+	g_thread_unref (thread);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_backend_sack_warm_queue:
+ *
+ * Starts a pending warm-up when the daemon is next idle. The sack mutex must
+ * be held.
+ */
+static void
+pk_backend_sack_warm_queue (PkBackend *backend)
+{
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+
+	if (!priv->sack_warm_pending || priv->sack_warm_id != 0 ||
+	    priv->sack_warming || priv->jobs_running > 0 ||
+	    priv->sack_warm_disabled)
+		return;
+	priv->sack_warm_id = g_idle_add_full (G_PRIORITY_LOW,
+					      pk_backend_sack_warm_idle_cb,
+					      backend, NULL);
+}
+
+/**
+ * pk_backend_sack_warm_schedule:
+ *
+ * Rebuilds the sack in the background once the daemon is idle, so the next
+ * query does not have to.
+ */
+static void
+pk_backend_sack_warm_schedule (PkBackend *backend)
+{
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+
+	g_mutex_lock (&priv->sack_mutex);
+	priv->sack_warm_pending = TRUE;
+	pk_backend_sack_warm_queue (backend);
+	g_mutex_unlock (&priv->sack_mutex);
+}
+
+/**
+ * pk_backend_sack_warm_wait:
+ *
+ * Waits for any background build, as it uses the same sources. The sack
+ * mutex must be held.
+ */
+static void
+pk_backend_sack_warm_wait (PkBackendHifPrivate *priv)
+{
+	while (priv->sack_warming)
+		g_cond_wait (&priv->sack_cond, &priv->sack_mutex);
+}
+
+/**
+ * pk_backend_sack_warm_wait_job:
+ *
+ * Waits for any background build from a job thread, for roles that read the
+ * repos without building a sack. Never call this from the main loop.
+ */
+static void
+pk_backend_sack_warm_wait_job (PkBackendJob *job)
+{
+	PkBackendHifJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (job_data->backend);
+
+	g_mutex_lock (&priv->sack_mutex);
+	pk_backend_sack_warm_wait (priv);
+	g_mutex_unlock (&priv->sack_mutex);
+}
+
+/**
+ * pk_backend_sack_warm_cancel:
+ *
+ * Stops a background build for a role that changes the repos or the rpmdb,
+ * without waiting for it; the job thread waits before it touches either.
+ * The warm-up runs again once the jobs have finished.
+ */
+static void
+pk_backend_sack_warm_cancel (PkBackend *backend)
+{
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+
+	g_mutex_lock (&priv->sack_mutex);
+	if (priv->sack_warming) {
+		g_debug ("cancelling sack warm-up for job");
+		g_cancellable_cancel (priv->sack_warm_cancellable);
+		priv->sack_warm_pending = TRUE;
+	}
+	g_mutex_unlock (&priv->sack_mutex);
 }
 
 /**
@@ -1237,6 +1586,9 @@ pk_backend_get_repo_list_thread (PkBackendJob *job,
 
 	g_variant_get (params, "(t)", &filters);
 
+	/* don't scan the repos at the same time as a background build */
+	pk_backend_sack_warm_wait_job (job);
+
 	/* set the list of repos */
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	sources = hif_repos_get_sources (hif_context_get_repos (job_data->context), &error);
@@ -1299,6 +1651,9 @@ pk_backend_repo_set_data_thread (PkBackendJob *job,
 
 	g_variant_get (params, "(&s&s&s)", &repo_id, &parameter, &value);
 
+	/* the background build was cancelled, but may still be reading */
+	pk_backend_sack_warm_wait_job (job);
+
 	/* take lock */
 	ret = hif_state_take_lock (job_data->state,
 				   HIF_LOCK_TYPE_REPO,
@@ -1375,6 +1730,7 @@ pk_backend_repo_set_data (PkBackend *backend,
 			  const gchar *parameter,
 			  const gchar *value)
 {
+	pk_backend_sack_warm_cancel (backend);
 	pk_backend_job_thread_create (job, pk_backend_repo_set_data_thread, NULL, NULL);
 }
 
@@ -1507,6 +1863,251 @@ pk_backend_refresh_source (PkBackendJob *job,
 	return hif_state_done (state, error);
 }
 
+/* the number of sources checked or downloaded at the same time */
+#define PK_BACKEND_HIF_REFRESH_WORKERS		4
+
+typedef struct {
+	PkBackendJob	*job;
+	gboolean	 force;
+	GMutex		 mutex;
+	GCond		 cond;
+	guint		 pending;	/* sources not yet finished */
+	guint		 finished;	/* sources finished */
+	GPtrArray	*workers;	/* of PkBackendHifRefreshWorker */
+	GPtrArray	*refresh_sources;
+	GError		*error;
+} PkBackendHifRefreshHelper;
+
+typedef struct {
+	PkBackendHifRefreshHelper	*helper;
+	HifState			*state;
+	guint				 percentage;
+	guint64				 speed;
+} PkBackendHifRefreshWorker;
+
+/* how often the job progress is updated from the workers, in ms */
+#define PK_BACKEND_HIF_REFRESH_POLL		100
+
+/**
+ * pk_backend_refresh_worker_percentage_changed_cb:
+ **/
+static void
+pk_backend_refresh_worker_percentage_changed_cb (HifState *state,
+						 guint percentage,
+						 PkBackendHifRefreshWorker *worker)
+{
+	g_mutex_lock (&worker->helper->mutex);
+	worker->percentage = percentage;
+	g_mutex_unlock (&worker->helper->mutex);
+}
+
+/**
+ * pk_backend_refresh_worker_speed_changed_cb:
+ **/
+static void
+pk_backend_refresh_worker_speed_changed_cb (HifState *state,
+					    GParamSpec *pspec,
+					    PkBackendHifRefreshWorker *worker)
+{
+	g_mutex_lock (&worker->helper->mutex);
+	worker->speed = hif_state_get_speed (state);
+	g_mutex_unlock (&worker->helper->mutex);
+}
+
+/**
+ * pk_backend_refresh_worker_new:
+ *
+ * HifState is not thread safe, so each worker reports into its own one and
+ * the job thread polls the percentage and speed of all of them.
+ */
+static PkBackendHifRefreshWorker *
+pk_backend_refresh_worker_new (PkBackendHifRefreshHelper *helper)
+{
+	PkBackendHifRefreshWorker *worker = g_new0 (PkBackendHifRefreshWorker, 1);
+	worker->helper = helper;
+	worker->state = hif_state_new ();
+	hif_state_set_cancellable (worker->state,
+				   pk_backend_job_get_cancellable (helper->job));
+	g_signal_connect (worker->state, "percentage-changed",
+			  G_CALLBACK (pk_backend_refresh_worker_percentage_changed_cb),
+			  worker);
+	g_signal_connect (worker->state, "notify::speed",
+			  G_CALLBACK (pk_backend_refresh_worker_speed_changed_cb),
+			  worker);
+	g_mutex_lock (&helper->mutex);
+	g_ptr_array_add (helper->workers, worker);
+	g_mutex_unlock (&helper->mutex);
+	return worker;
+}
+
+/**
+ * pk_backend_refresh_worker_finish:
+ * @worker: the worker, or %NULL if the source was skipped
+ */
+static void
+pk_backend_refresh_worker_finish (PkBackendHifRefreshHelper *helper,
+				  PkBackendHifRefreshWorker *worker,
+				  GError *error)
+{
+	g_mutex_lock (&helper->mutex);
+	if (worker != NULL)
+		g_ptr_array_remove (helper->workers, worker);
+	if (error != NULL && helper->error == NULL)
+		helper->error = g_error_copy (error);
+	helper->pending--;
+	helper->finished++;
+	g_cond_signal (&helper->cond);
+	g_mutex_unlock (&helper->mutex);
+
+	if (worker != NULL) {
+		g_signal_handlers_disconnect_by_data (worker->state, worker);
+		g_object_unref (worker->state);
+		g_free (worker);
+	}
+}
+
+/**
+ * pk_backend_refresh_worker_skip:
+ *
+ * Don't start anything new once the job is cancelled or a source failed.
+ */
+static gboolean
+pk_backend_refresh_worker_skip (PkBackendHifRefreshHelper *helper)
+{
+	gboolean ret;
+
+	if (g_cancellable_is_cancelled (pk_backend_job_get_cancellable (helper->job)))
+		return TRUE;
+	g_mutex_lock (&helper->mutex);
+	ret = helper->error != NULL;
+	g_mutex_unlock (&helper->mutex);
+	return ret;
+}
+
+/**
+ * pk_backend_refresh_check_worker:
+ */
+static void
+pk_backend_refresh_check_worker (gpointer data, gpointer user_data)
+{
+	HifSource *src = HIF_SOURCE (data);
+	PkBackendHifRefreshHelper *helper = user_data;
+	PkBackendHifRefreshWorker *worker = NULL;
+	gboolean src_okay = TRUE;
+
+	/* is the source up to date? */
+	if (!pk_backend_refresh_worker_skip (helper)) {
+		worker = pk_backend_refresh_worker_new (helper);
+		src_okay = hif_source_check (src,
+					     pk_backend_job_get_cache_age (helper->job),
+					     worker->state,
+					     NULL);
+	}
+	g_mutex_lock (&helper->mutex);
+	if (!src_okay || helper->force)
+		g_ptr_array_add (helper->refresh_sources, src);
+	g_mutex_unlock (&helper->mutex);
+
+	pk_backend_refresh_worker_finish (helper, worker, NULL);
+}
+
+/**
+ * pk_backend_refresh_download_worker:
+ */
+static void
+pk_backend_refresh_download_worker (gpointer data, gpointer user_data)
+{
+	HifSource *src = HIF_SOURCE (data);
+	PkBackendHifRefreshHelper *helper = user_data;
+	PkBackendHifRefreshWorker *worker = NULL;
+	g_autoptr(GError) error = NULL;
+
+	if (pk_backend_refresh_worker_skip (helper))
+		goto out;
+
+	/* delete content even if up to date */
+	if (helper->force) {
+		g_debug ("Deleting contents of %s as forced", hif_source_get_id (src));
+		if (!hif_source_clean (src, &error))
+			goto out;
+	}
+
+	/* check and download */
+	worker = pk_backend_refresh_worker_new (helper);
+	pk_backend_refresh_source (helper->job, src, worker->state, &error);
+out:
+	pk_backend_refresh_worker_finish (helper, worker, error);
+}
+
+/**
+ * pk_backend_refresh_sources_parallel:
+ *
+ * Runs @func for each of @sources on a bounded pool of threads, setting the
+ * percentage of @state from the finished sources and the running workers.
+ */
+static gboolean
+pk_backend_refresh_sources_parallel (PkBackendHifRefreshHelper *helper,
+				     GPtrArray *sources,
+				     GFunc func,
+				     HifState *state,
+				     GError **error)
+{
+	GThreadPool *pool;
+	HifState *state_local;
+	PkBackendHifRefreshWorker *worker;
+	gint64 end_time;
+	guint i;
+	guint percentage;
+	guint64 speed;
+
+	hif_state_set_number_steps (state, 1);
+	if (sources->len == 0)
+		return hif_state_done (state, error);
+
+	pool = g_thread_pool_new (func, helper,
+				  MIN (sources->len, PK_BACKEND_HIF_REFRESH_WORKERS),
+				  FALSE, error);
+	if (pool == NULL)
+		return FALSE;
+	helper->pending = sources->len;
+	helper->finished = 0;
+	for (i = 0; i < sources->len; i++)
+		g_thread_pool_push (pool, g_ptr_array_index (sources, i), NULL);
+
+	/* only this thread touches the job state */
+	state_local = hif_state_get_child (state);
+	g_mutex_lock (&helper->mutex);
+	while (helper->pending > 0) {
+		end_time = g_get_monotonic_time () +
+			   PK_BACKEND_HIF_REFRESH_POLL * G_TIME_SPAN_MILLISECOND;
+		g_cond_wait_until (&helper->cond, &helper->mutex, end_time);
+
+		/* each source is an equal share of the step */
+		percentage = helper->finished * 100;
+		speed = 0;
+		for (i = 0; i < helper->workers->len; i++) {
+			worker = g_ptr_array_index (helper->workers, i);
+			percentage += worker->percentage;
+			speed += worker->speed;
+		}
+		g_mutex_unlock (&helper->mutex);
+
+		hif_state_set_percentage (state_local, percentage / sources->len);
+		pk_backend_job_set_speed (helper->job, speed);
+		g_mutex_lock (&helper->mutex);
+	}
+	g_mutex_unlock (&helper->mutex);
+	g_thread_pool_free (pool, FALSE, TRUE);
+	pk_backend_job_set_speed (helper->job, 0);
+
+	if (helper->error != NULL) {
+		g_propagate_error (error, helper->error);
+		helper->error = NULL;
+		return FALSE;
+	}
+	return hif_state_done (state, error);
+}
+
 /**
  * pk_backend_refresh_cache_thread:
  */
@@ -1517,15 +2118,14 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 {
 	HifSource *src;
 	HifState *state_local;
-	HifState *state_loop;
 	HySack sack = NULL;
 	PkBackendHifJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendHifRefreshHelper helper = { 0 };
 	gboolean force;
 	gboolean ret;
-	guint cnt = 0;
 	guint i;
 	g_autoptr(GError) error = NULL;
-	g_autoptr(GPtrArray) refresh_sources = NULL;
+	g_autoptr(GPtrArray) check_sources = NULL;
 
 	/* set state */
 	hif_state_set_steps (job_data->state, NULL,
@@ -1536,6 +2136,9 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 
 	g_variant_get (params, "(b)", &force);
 
+	/* the workers report into their own states, not the job one */
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD_REPOSITORY);
+
 	/* set the list of repos */
 	ret = pk_backend_ensure_sources (job_data, &error);
 	if (!ret) {
@@ -1543,7 +2146,8 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 		return;
 	}
 
-	/* count the enabled sources */
+	/* find the enabled sources */
+	check_sources = g_ptr_array_new ();
 	for (i = 0; i < job_data->sources->len; i++) {
 		src = g_ptr_array_index (job_data->sources, i);
 		if (hif_source_get_enabled (src) == HIF_SOURCE_ENABLED_NONE)
@@ -1552,93 +2156,54 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 			continue;
 		if (hif_source_get_kind (src) == HIF_SOURCE_KIND_LOCAL)
 			continue;
-		cnt++;
+		g_ptr_array_add (check_sources, src);
 	}
 
 	/* figure out which sources need refreshing */
-	refresh_sources = g_ptr_array_new ();
+	helper.job = job;
+	helper.force = force;
+	helper.refresh_sources = g_ptr_array_new ();
+	helper.workers = g_ptr_array_new ();
+	g_mutex_init (&helper.mutex);
+	g_cond_init (&helper.cond);
 	state_local = hif_state_get_child (job_data->state);
-	hif_state_set_number_steps (state_local, cnt);
-	for (i = 0; i < job_data->sources->len; i++) {
-		gboolean src_okay;
-
-		src = g_ptr_array_index (job_data->sources, i);
-		if (hif_source_get_enabled (src) == HIF_SOURCE_ENABLED_NONE)
-			continue;
-		if (hif_source_get_kind (src) == HIF_SOURCE_KIND_MEDIA)
-			continue;
-		if (hif_source_get_kind (src) == HIF_SOURCE_KIND_LOCAL)
-			continue;
-
-		/* is the source up to date? */
-		state_loop = hif_state_get_child (state_local);
-		src_okay = hif_source_check (src,
-					     pk_backend_job_get_cache_age (job),
-					     state_loop,
-					     NULL);
-		if (!src_okay || force)
-			g_ptr_array_add (refresh_sources,
-			                 g_ptr_array_index (job_data->sources, i));
-
-		/* done */
-		ret = hif_state_done (state_local, &error);
-		if (!ret) {
-			pk_backend_job_error_code (job, error->code, "%s", error->message);
-			return;
-		}
+	ret = pk_backend_refresh_sources_parallel (&helper, check_sources,
+						   pk_backend_refresh_check_worker,
+						   state_local, &error);
+	if (!ret) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		goto out;
 	}
 
 	/* done */
 	ret = hif_state_done (job_data->state, &error);
 	if (!ret) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
-		return;
+		goto out;
 	}
 
 	/* is everything up to date? */
-	if (refresh_sources->len == 0) {
+	if (helper.refresh_sources->len == 0) {
 		if (!hif_state_finished (job_data->state, &error))
 			pk_backend_job_error_code (job, error->code, "%s", error->message);
-		return;
+		goto out;
 	}
 
 	/* refresh each repo */
 	state_local = hif_state_get_child (job_data->state);
-	hif_state_set_number_steps (state_local, refresh_sources->len);
-	for (i = 0; i < refresh_sources->len; i++) {
-		src = g_ptr_array_index (refresh_sources, i);
-
-		/* delete content even if up to date */
-		if (force) {
-			g_debug ("Deleting contents of %s as forced", hif_source_get_id (src));
-			ret = hif_source_clean (src, &error);
-			if (!ret) {
-				pk_backend_job_error_code (job, error->code, "%s", error->message);
-				return;
-			}
-		}
-
-		/* check and download */
-		state_loop = hif_state_get_child (state_local);
-		ret = pk_backend_refresh_source (job, src, state_loop, &error);
-		if (!ret) {
-			pk_backend_job_error_code (job, error->code, "%s", error->message);
-			return;
-		}
-
-		/* done */
-		ret = hif_state_done (state_local, &error);
-		if (!ret) {
-			pk_backend_job_error_code (job, error->code, "%s", error->message);
-			return;
-		}
+	ret = pk_backend_refresh_sources_parallel (&helper, helper.refresh_sources,
+						   pk_backend_refresh_download_worker,
+						   state_local, &error);
+	if (!ret) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		goto out;
 	}
 
 	/* done */
 	ret = hif_state_done (job_data->state, &error);
 	if (!ret) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
-		return;
+		goto out;
 	}
 
 	/* regenerate the libsolv metadata */
@@ -1648,14 +2213,21 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 						  state_local, &error);
 	if (sack == NULL) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
-		return;
+		goto out;
 	}
 
 	/* done */
 	ret = hif_state_done (job_data->state, &error);
 	if (!ret) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
-		return;
+		goto out;
+	}
+out:
+	if (helper.refresh_sources != NULL) {
+		g_ptr_array_unref (helper.refresh_sources);
+		g_ptr_array_unref (helper.workers);
+		g_mutex_clear (&helper.mutex);
+		g_cond_clear (&helper.cond);
 	}
 }
 
@@ -1667,6 +2239,7 @@ pk_backend_refresh_cache (PkBackend *backend,
 			  PkBackendJob *job,
 			  gboolean force)
 {
+	pk_backend_sack_warm_cancel (backend);
 	pk_backend_job_thread_create (job, pk_backend_refresh_cache_thread, NULL, NULL);
 }
 
@@ -2477,6 +3050,9 @@ pk_backend_repo_remove_thread (PkBackendJob *job,
 		       &repo_id,
 		       &autoremove);
 
+	/* the background build was cancelled, but may still be reading */
+	pk_backend_sack_warm_wait_job (job);
+
 	/* set state */
 	ret = hif_state_set_steps (job_data->state, NULL,
 				   1, /* get the .repo filename for @repo_id */
@@ -2627,6 +3203,7 @@ pk_backend_repo_remove (PkBackend *backend,
 			const gchar *repo_id,
 			gboolean autoremove)
 {
+	pk_backend_sack_warm_cancel (backend);
 	pk_backend_job_thread_create (job, pk_backend_repo_remove_thread, NULL, NULL);
 }
 
@@ -2804,6 +3381,7 @@ pk_backend_remove_packages (PkBackend *backend, PkBackendJob *job,
 			    gboolean allow_deps,
 			    gboolean autoremove)
 {
+	pk_backend_sack_warm_cancel (backend);
 	pk_backend_job_thread_create (job, pk_backend_remove_packages_thread, NULL, NULL);
 }
 
@@ -2994,6 +3572,7 @@ pk_backend_install_packages (PkBackend *backend, PkBackendJob *job,
 			     PkBitfield transaction_flags,
 			     gchar **package_ids)
 {
+	pk_backend_sack_warm_cancel (backend);
 	pk_backend_job_thread_create (job, pk_backend_install_packages_thread, NULL, NULL);
 }
 
@@ -3103,6 +3682,7 @@ pk_backend_install_files (PkBackend *backend, PkBackendJob *job,
 			  PkBitfield transaction_flags,
 			  gchar **full_paths)
 {
+	pk_backend_sack_warm_cancel (backend);
 	pk_backend_job_thread_create (job, pk_backend_install_files_thread, NULL, NULL);
 }
 
@@ -3214,6 +3794,7 @@ void
 pk_backend_update_packages (PkBackend *backend, PkBackendJob *job,
 			    PkBitfield transaction_flags, gchar **package_ids)
 {
+	pk_backend_sack_warm_cancel (backend);
 	pk_backend_job_thread_create (job, pk_backend_update_packages_thread, NULL, NULL);
 }
 
@@ -3315,6 +3896,7 @@ pk_backend_upgrade_system (PkBackend *backend,
                            const gchar *distro_id,
                            PkUpgradeKindEnum upgrade_kind)
 {
+	pk_backend_sack_warm_cancel (backend);
 	pk_backend_job_thread_create (job, pk_backend_upgrade_system_thread, NULL, NULL);
 }
 
@@ -3679,5 +4261,6 @@ pk_backend_repair_system (PkBackend *backend,
 			  PkBackendJob *job,
 			  PkBitfield transaction_flags)
 {
+	pk_backend_sack_warm_cancel (backend);
 	pk_backend_job_thread_create (job, pk_backend_repair_system_thread, NULL, NULL);
 }
@@ -180,12 +180,9 @@ gboolean katja_binary_real_download(KatjaPkgtools *pkgtools, PkBackendJob *job,
 	CURL *curl = NULL;
 	PkBackendKatjaJobData *job_data = pk_backend_job_get_user_data(job);
 
-	if ((sqlite3_prepare_v2(job_data->db,
-							"SELECT location, (full_name || '.' || ext) FROM pkglist "
-							"WHERE name LIKE @name AND repo_order = @repo_order",
-							-1,
-							&statement,
-							NULL) != SQLITE_OK))
+	if (!(statement = katja_db_prepare(job_data->db, job_data->statements,
+									   "SELECT location, (full_name || '.' || ext) FROM pkglist "
+									   "WHERE name LIKE @name AND repo_order = @repo_order")))
 		return FALSE;
 
 	sqlite3_bind_text(statement, 1, pkg_name, -1, SQLITE_TRANSIENT);
@@ -213,7 +210,7 @@ gboolean katja_binary_real_download(KatjaPkgtools *pkgtools, PkBackendJob *job,
 		g_free(source_url);
 		g_free(dest_filename);
 	}
-	sqlite3_finalize(statement);
+	sqlite3_reset(statement);
 
 	return ret;
 }
@@ -226,12 +223,9 @@ void katja_binary_real_install(KatjaPkgtools *pkgtools, PkBackendJob *job, gchar
 	sqlite3_stmt *statement = NULL;
 	PkBackendKatjaJobData *job_data = pk_backend_job_get_user_data(job);
 
-	if ((sqlite3_prepare_v2(job_data->db,
-							"SELECT (full_name || '.' || ext) FROM pkglist "
-							"WHERE name LIKE @name AND repo_order = @repo_order",
-							-1,
-							&statement,
-							NULL) != SQLITE_OK))
+	if (!(statement = katja_db_prepare(job_data->db, job_data->statements,
+									   "SELECT (full_name || '.' || ext) FROM pkglist "
+									   "WHERE name LIKE @name AND repo_order = @repo_order")))
 		return;
 
 	sqlite3_bind_text(statement, 1, pkg_name, -1, SQLITE_TRANSIENT);
@@ -250,7 +244,7 @@ void katja_binary_real_install(KatjaPkgtools *pkgtools, PkBackendJob *job, gchar
 
 		g_free(pkg_filename);
 	}
-	sqlite3_finalize(statement);
+	sqlite3_reset(statement);
 }
 
 /**
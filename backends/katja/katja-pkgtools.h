@@ -18,6 +18,7 @@ typedef struct _KatjaPkgtools KatjaPkgtools; /* dummy */
 
 typedef struct {
 	sqlite3 *db;
+	GHashTable *statements; /* SQL → sqlite3_stmt, shared by all jobs */
 	CURL *curl;
 } PkBackendKatjaJobData;
 
@@ -143,3 +143,105 @@ PkInfoEnum katja_pkg_is_installed(gchar *pkg_full_name) {
 
 	return ret;
 }
+
+/**
+ * katja_db_update_search_index:
+ *
+ * Marks the packages from the repository with the lowest order as preferred and fills the search tables
+ * with them. Has to be called whenever pkglist or filelist change.
+ **/
+gint katja_db_update_search_index(sqlite3 *db) {
+	gint ret;
+
+	ret = sqlite3_exec(db,
+					   "BEGIN TRANSACTION;"
+					   "UPDATE pkglist SET preferred = (repo_order = "
+					   "(SELECT MIN(p.repo_order) FROM pkglist AS p WHERE p.name = pkglist.name));"
+					   "DELETE FROM pkglist_search;"
+					   "INSERT INTO pkglist_search (name, desc, full_name) "
+					   "SELECT name, desc, full_name FROM pkglist WHERE preferred;"
+					   "DELETE FROM filelist_search;"
+					   "INSERT INTO filelist_search (filename, full_name) SELECT filename, full_name FROM filelist;"
+					   "COMMIT",
+					   NULL,
+					   NULL,
+					   NULL);
+	if (ret != SQLITE_OK)
+		sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+
+	return ret;
+}
+
+/**
+ * katja_db_create_search_index:
+ *
+ * Adds the preferred column and the search tables to a database that doesn't have them yet.
+ **/
+gint katja_db_create_search_index(sqlite3 *db) {
+	gint ret;
+	gboolean rebuild = FALSE;
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(db, "SELECT preferred FROM pkglist LIMIT 0", -1, &stmt, NULL) == SQLITE_OK) {
+		sqlite3_finalize(stmt);
+	} else {
+		ret = sqlite3_exec(db, "ALTER TABLE pkglist ADD COLUMN preferred INTEGER DEFAULT 0", NULL, NULL, NULL);
+		if (ret != SQLITE_OK)
+			return ret;
+		rebuild = TRUE;
+	}
+
+	if (sqlite3_prepare_v2(db,
+						   "SELECT p.full_name, f.full_name FROM pkglist_search AS p, filelist_search AS f LIMIT 0",
+						   -1,
+						   &stmt,
+						   NULL) == SQLITE_OK) {
+		sqlite3_finalize(stmt);
+	} else {
+		/* The trigram tokenizer lets the index answer LIKE '%...%' */
+		ret = sqlite3_exec(db,
+						   "CREATE VIRTUAL TABLE IF NOT EXISTS pkglist_search "
+						   "USING fts5(name, desc, full_name UNINDEXED, tokenize = 'trigram');"
+						   "CREATE VIRTUAL TABLE IF NOT EXISTS filelist_search "
+						   "USING fts5(filename, full_name UNINDEXED, tokenize = 'trigram')",
+						   NULL,
+						   NULL,
+						   NULL);
+		if (ret != SQLITE_OK) {
+			g_warning("Full-text search isn't available, falling back to table scans: %s", sqlite3_errmsg(db));
+			ret = sqlite3_exec(db,
+							   "CREATE TABLE IF NOT EXISTS pkglist_search (name, desc, full_name);"
+							   "CREATE TABLE IF NOT EXISTS filelist_search (filename, full_name)",
+							   NULL,
+							   NULL,
+							   NULL);
+		}
+		if (ret != SQLITE_OK)
+			return ret;
+		rebuild = TRUE;
+	}
+
+	return rebuild ? katja_db_update_search_index(db) : SQLITE_OK;
+}
+
+/**
+ * katja_db_prepare:
+ *
+ * Returns the cached statement for @sql, preparing it the first time it is used. The statement belongs
+ * to the cache, so callers reset it when they are done instead of finalizing it.
+ **/
+sqlite3_stmt *katja_db_prepare(sqlite3 *db, GHashTable *statements, const gchar *sql) {
+	sqlite3_stmt *stmt;
+
+	if ((stmt = g_hash_table_lookup(statements, sql))) {
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+		return stmt;
+	}
+
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+		return NULL;
+	g_hash_table_insert(statements, g_strdup(sql), stmt);
+
+	return stmt;
+}
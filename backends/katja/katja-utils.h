@@ -12,5 +12,8 @@ CURLcode katja_get_file(CURL **curl, gchar *source_url, gchar *dest);
 gchar **katja_cut_pkg(const gchar *pkg_filename);
 gint katja_cmp_repo(gconstpointer a, gconstpointer b);
 PkInfoEnum katja_pkg_is_installed(gchar *pkg_full_name);
+gint katja_db_create_search_index(sqlite3 *db);
+sqlite3_stmt *katja_db_prepare(sqlite3 *db, GHashTable *statements, const gchar *sql);
+gint katja_db_update_search_index(sqlite3 *db);
 
 #endif /* __KATJA_UTILS_H */
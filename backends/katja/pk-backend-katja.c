@@ -9,6 +9,8 @@
 #include "katja-dl.h"
 
 static GSList *repos = NULL;
+static sqlite3 *db = NULL;
+static GHashTable *statements = NULL;
 
 
 void pk_backend_initialize(GKeyFile *conf, PkBackend *backend) {
@@ -21,18 +23,23 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend) {
 	GKeyFile *katja_conf;
 	GError *err = NULL;
 	gpointer repo = NULL;
-	sqlite3 *db;
 	sqlite3_stmt *stmt;
 
 	g_debug("backend: initialize");
 	curl_global_init(CURL_GLOBAL_DEFAULT);
 
-	/* Open the database. We will need it to save the time the configuration file was last modified. */
+	/* Open the database. The connection is kept open and shared by all jobs. */
 	path = g_build_filename(LOCALSTATEDIR, "cache", "PackageKit", "metadata", "metadata.db", NULL);
 	if (sqlite3_open(path, &db) != SQLITE_OK)
 		g_error("%s: %s", path, sqlite3_errmsg(db));
 	g_free(path);
 
+	/* Some SQLite settings */
+	sqlite3_exec(db, "PRAGMA journal_mode = WAL", NULL, NULL, NULL);
+	sqlite3_exec(db, "PRAGMA mmap_size = 268435456", NULL, NULL, NULL);
+	sqlite3_exec(db, "PRAGMA foreign_keys = ON", NULL, NULL, NULL);
+	statements = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) sqlite3_finalize);
+
 	/* Read the configuration file */
 	katja_conf = g_key_file_new();
 	path = g_build_filename(SYSCONFDIR, "PackageKit", "Katja.conf", NULL);
@@ -67,9 +74,12 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend) {
 	else if (!sqlite3_changes(db))
 		g_error("Failed to update database: %s", path);
 
+	/* Databases from older versions don't have the search index yet */
+	if ((ret = katja_db_create_search_index(db)) != SQLITE_OK)
+		g_error("Failed to create the search index: %s", sqlite3_errstr(ret));
+
 	g_object_unref(file_info);
 	g_object_unref(katja_conf_file);
-	sqlite3_close_v2(db);
 	g_free(path);
 
 	/* Initialize an object for each well-formed repository */
@@ -106,6 +116,8 @@ void pk_backend_destroy(PkBackend *backend) {
 	g_debug("backend: destroy");
 
 	g_slist_free_full(repos, g_object_unref);
+	g_hash_table_unref(statements);
+	sqlite3_close(db);
 	curl_global_cleanup();
 }
 
@@ -153,28 +165,17 @@ PkBitfield pk_backend_get_groups(PkBackend *backend) {
 }
 
 void pk_backend_start_job(PkBackend *backend, PkBackendJob *job) {
-	gchar *db_filename = NULL;
 	PkBackendKatjaJobData *job_data = g_new0(PkBackendKatjaJobData, 1);
 
 	pk_backend_job_set_allow_cancel(job, TRUE);
 	pk_backend_job_set_allow_cancel(job, FALSE);
 
-	db_filename = g_build_filename(LOCALSTATEDIR, "cache", "PackageKit", "metadata", "metadata.db", NULL);
-	if (sqlite3_open(db_filename, &job_data->db) == SQLITE_OK) { /* Some SQLite settings */
-		sqlite3_exec(job_data->db, "PRAGMA foreign_keys = ON", NULL, NULL, NULL);
-	} else {
-		pk_backend_job_error_code(job, PK_ERROR_ENUM_NO_CACHE,
-								  "%s: %s",
-								  db_filename,
-								  sqlite3_errmsg(job_data->db));
-		goto out;
-	}
+	/* Jobs aren't run in parallel, so they can share the connection and the cached statements */
+	job_data->db = db;
+	job_data->statements = statements;
 
 	pk_backend_job_set_user_data(job, job_data);
 	pk_backend_job_set_status(job, PK_STATUS_ENUM_RUNNING);
-
-out:
-	g_free(db_filename);
 }
 
 void pk_backend_stop_job(PkBackend *backend, PkBackendJob *job) {
@@ -183,7 +184,6 @@ void pk_backend_stop_job(PkBackend *backend, PkBackendJob *job) {
 	if (job_data->curl)
 		curl_easy_cleanup(job_data->curl);
 
-	sqlite3_close(job_data->db);
 	g_free(job_data);
 	pk_backend_job_set_user_data(job, NULL);
 }
@@ -200,14 +200,16 @@ static void pk_backend_search_thread(PkBackendJob *job, GVariant *params, gpoint
 	g_variant_get(params, "(t^a&s)", NULL, &vals);
 	search = g_strjoinv("%", vals);
 
-	query = sqlite3_mprintf("SELECT (p1.name || ';' || p1.ver || ';' || p1.arch || ';' || r.repo), p1.summary, "
-							"p1.full_name FROM pkglist AS p1 NATURAL JOIN repos AS r "
-							"WHERE p1.%s LIKE '%%%q%%' AND p1.ext NOT LIKE 'obsolete' AND p1.repo_order = "
-							"(SELECT MIN(p2.repo_order) FROM pkglist AS p2 WHERE p2.name = p1.name GROUP BY p2.name)",
-							(gchar *) user_data,
-							search);
+	/* pkglist_search only contains packages from the preferred repository */
+	query = sqlite3_mprintf("SELECT (p.name || ';' || p.ver || ';' || p.arch || ';' || r.repo), p.summary, "
+							"p.full_name FROM pkglist_search AS s JOIN pkglist AS p ON p.full_name = s.full_name "
+							"NATURAL JOIN repos AS r "
+							"WHERE %s LIKE '%%' || @search || '%%' AND p.ext NOT LIKE 'obsolete'",
+							(gchar *) user_data);
+
+	if ((stmt = katja_db_prepare(job_data->db, job_data->statements, query))) {
+		sqlite3_bind_text(stmt, 1, search, -1, SQLITE_TRANSIENT);
 
-	if ((sqlite3_prepare_v2(job_data->db, query, -1, &stmt, NULL) == SQLITE_OK)) {
 		/* Now we're ready to output all packages */
 		while (sqlite3_step(stmt) == SQLITE_ROW) {
 			ret = katja_pkg_is_installed((gchar *) sqlite3_column_text(stmt, 2));
@@ -221,7 +223,7 @@ static void pk_backend_search_thread(PkBackendJob *job, GVariant *params, gpoint
 										(gchar *) sqlite3_column_text(stmt, 1));
 			}
 		}
-		sqlite3_finalize(stmt);
+		sqlite3_reset(stmt);
 	} else {
 		pk_backend_job_error_code(job, PK_ERROR_ENUM_CANNOT_GET_FILELIST, "%s", sqlite3_errmsg(job_data->db));
 	}
@@ -233,20 +235,19 @@ static void pk_backend_search_thread(PkBackendJob *job, GVariant *params, gpoint
 }
 
 void pk_backend_search_names(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values) {
-	pk_backend_job_thread_create(job, pk_backend_search_thread, (gpointer) "name", NULL);
+	pk_backend_job_thread_create(job, pk_backend_search_thread, (gpointer) "s.name", NULL);
 }
 
 void pk_backend_search_details(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values) {
-	pk_backend_job_thread_create(job, pk_backend_search_thread, (gpointer) "desc", NULL);
+	pk_backend_job_thread_create(job, pk_backend_search_thread, (gpointer) "s.desc", NULL);
 }
 
 void pk_backend_search_groups (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values) {
-	pk_backend_job_thread_create(job, pk_backend_search_thread, (gpointer) "cat", NULL);
+	pk_backend_job_thread_create(job, pk_backend_search_thread, (gpointer) "p.cat", NULL);
 }
 
 static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params, gpointer user_data) {
 	gchar **vals, *search;
-	gchar *query;
 	sqlite3_stmt *stmt;
 	PkInfoEnum ret;
 	PkBackendKatjaJobData *job_data = pk_backend_job_get_user_data(job);
@@ -257,11 +258,13 @@ static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params,
 	g_variant_get(params, "(t^a&s)", NULL, &vals);
 	search = g_strjoinv("%", vals);
 
-	query = sqlite3_mprintf("SELECT (p.name || ';' || p.ver || ';' || p.arch || ';' || r.repo), p.summary, "
-							"p.full_name FROM filelist AS f NATURAL JOIN pkglist AS p NATURAL JOIN repos AS r "
-							"WHERE f.filename LIKE '%%%q%%' GROUP BY f.full_name", search);
+	if ((stmt = katja_db_prepare(job_data->db, job_data->statements,
+								 "SELECT (p.name || ';' || p.ver || ';' || p.arch || ';' || r.repo), p.summary, "
+								 "p.full_name FROM filelist_search AS f JOIN pkglist AS p ON p.full_name = f.full_name "
+								 "NATURAL JOIN repos AS r WHERE f.filename LIKE '%' || @search || '%' "
+								 "GROUP BY f.full_name"))) {
+		sqlite3_bind_text(stmt, 1, search, -1, SQLITE_TRANSIENT);
 
-	if ((sqlite3_prepare_v2(job_data->db, query, -1, &stmt, NULL) == SQLITE_OK)) {
 		/* Now we're ready to output all packages */
 		while (sqlite3_step(stmt) == SQLITE_ROW) {
 			ret = katja_pkg_is_installed((gchar *) sqlite3_column_text(stmt, 2));
@@ -275,11 +278,10 @@ static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params,
 										(gchar *) sqlite3_column_text(stmt, 1));
 			}
 		}
-		sqlite3_finalize(stmt);
+		sqlite3_reset(stmt);
 	} else {
 		pk_backend_job_error_code(job, PK_ERROR_ENUM_CANNOT_GET_FILELIST, "%s", sqlite3_errmsg(job_data->db));
 	}
-	sqlite3_free(query);
 	g_free(search);
 
 	pk_backend_job_set_percentage(job, 100);
@@ -303,12 +305,9 @@ static void pk_backend_get_details_thread(PkBackendJob *job, GVariant *params, g
 
 	g_variant_get(params, "(^a&s)", &pkg_ids);
 
-	if ((sqlite3_prepare_v2(job_data->db,
-							"SELECT p.desc, p.cat, p.uncompressed FROM pkglist AS p NATURAL JOIN repos AS r "
-							"WHERE name LIKE @name AND r.repo LIKE @repo AND ext NOT LIKE 'obsolete'",
-							-1,
-							&stmt,
-							NULL) != SQLITE_OK)) {
+	if (!(stmt = katja_db_prepare(job_data->db, job_data->statements,
+								 "SELECT p.desc, p.cat, p.uncompressed FROM pkglist AS p NATURAL JOIN repos AS r "
+								 "WHERE name LIKE @name AND r.repo LIKE @repo AND ext NOT LIKE 'obsolete'"))) {
 		pk_backend_job_error_code(job, PK_ERROR_ENUM_CANNOT_GET_FILELIST, "%s", sqlite3_errmsg(job_data->db));
 		goto out;
 	}
@@ -360,7 +359,7 @@ static void pk_backend_get_details_thread(PkBackendJob *job, GVariant *params, g
 		g_string_free(desc, TRUE);
 
 out:
-	sqlite3_finalize(stmt);
+	sqlite3_reset(stmt);
 }
 
 void pk_backend_get_details(PkBackend *backend, PkBackendJob *job, gchar **package_ids) {
@@ -378,14 +377,10 @@ static void pk_backend_resolve_thread(PkBackendJob *job, GVariant *params, gpoin
 
 	g_variant_get(params, "(t^a&s)", NULL, &vals);
 
-	if ((sqlite3_prepare_v2(job_data->db,
-							"SELECT (p1.name || ';' || p1.ver || ';' || p1.arch || ';' || r.repo), p1.summary, "
-						   	"p1.full_name FROM pkglist AS p1 NATURAL JOIN repos AS r "
-							"WHERE p1.name LIKE @search AND p1.repo_order = "
-							"(SELECT MIN(p2.repo_order) FROM pkglist AS p2 WHERE p2.name = p1.name GROUP BY p2.name)",
-							-1,
-							&stmt,
-							NULL) == SQLITE_OK)) {
+	if ((stmt = katja_db_prepare(job_data->db, job_data->statements,
+								 "SELECT (p1.name || ';' || p1.ver || ';' || p1.arch || ';' || r.repo), p1.summary, "
+								 "p1.full_name FROM pkglist AS p1 NATURAL JOIN repos AS r "
+								 "WHERE p1.name LIKE @search AND p1.preferred"))) {
 		/* Output packages matching each pattern */
 		for (val = vals; *val; val++) {
 			sqlite3_bind_text(stmt, 1, *val, -1, SQLITE_TRANSIENT);
@@ -406,7 +401,7 @@ static void pk_backend_resolve_thread(PkBackendJob *job, GVariant *params, gpoin
 			sqlite3_clear_bindings(stmt);
 			sqlite3_reset(stmt);
 		}
-		sqlite3_finalize(stmt);
+		sqlite3_reset(stmt);
 	} else {
 		pk_backend_job_error_code(job, PK_ERROR_ENUM_CANNOT_GET_FILELIST, "%s", sqlite3_errmsg(job_data->db));
 	}
@@ -428,12 +423,9 @@ static void pk_backend_download_packages_thread(PkBackendJob *job, GVariant *par
 	g_variant_get(params, "(^a&ss)", &pkg_ids, &dir_path);
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
 
-	if ((sqlite3_prepare_v2(job_data->db,
-							"SELECT summary, (full_name || '.' || ext) FROM pkglist NATURAL JOIN repos "
-							"WHERE name LIKE @name AND ver LIKE @ver AND arch LIKE @arch AND repo LIKE @repo",
-							-1,
-							&stmt,
-							NULL) != SQLITE_OK)) {
+	if (!(stmt = katja_db_prepare(job_data->db, job_data->statements,
+								 "SELECT summary, (full_name || '.' || ext) FROM pkglist NATURAL JOIN repos "
+								 "WHERE name LIKE @name AND ver LIKE @ver AND arch LIKE @arch AND repo LIKE @repo"))) {
 		pk_backend_job_error_code(job, PK_ERROR_ENUM_CANNOT_GET_FILELIST, "%s", sqlite3_errmsg(job_data->db));
 		goto out;
 	}
@@ -462,7 +454,7 @@ static void pk_backend_download_packages_thread(PkBackendJob *job, GVariant *par
 	}
 
 out:
-	sqlite3_finalize(stmt);
+	sqlite3_reset(stmt);
 }
 
 void pk_backend_download_packages(PkBackend *backend, PkBackendJob *job, gchar **package_ids, const gchar *directory) {
@@ -482,21 +474,15 @@ static void pk_backend_install_packages_thread(PkBackendJob *job, GVariant *para
 	g_variant_get(params, "(t^a&s)", &transaction_flags, &pkg_ids);
 	pk_backend_job_set_status(job, PK_STATUS_ENUM_DEP_RESOLVE);
 
-	if ((sqlite3_prepare_v2(job_data->db,
-							"SELECT summary, cat FROM pkglist NATURAL JOIN repos "
-							"WHERE name LIKE @name AND ver LIKE @ver AND arch LIKE @arch AND repo LIKE @repo",
-							-1,
-							&pkglist_stmt,
-							NULL) != SQLITE_OK) ||
-		(sqlite3_prepare_v2(job_data->db,
-						   "SELECT (c.collection_pkg || ';' || p.ver || ';' || p.arch || ';' || r.repo), p.summary, "
-						   "p.full_name, p.ext FROM collections AS c "
-						   "JOIN pkglist AS p ON c.collection_pkg = p.name "
-						   "JOIN repos AS r ON p.repo_order = r.repo_order "
-						   "WHERE c.name LIKE @name AND r.repo LIKE @repo",
-						   -1,
-						   &collection_stmt,
-						   NULL) != SQLITE_OK)) {
+	if (!(pkglist_stmt = katja_db_prepare(job_data->db, job_data->statements,
+								 "SELECT summary, cat FROM pkglist NATURAL JOIN repos "
+								 "WHERE name LIKE @name AND ver LIKE @ver AND arch LIKE @arch AND repo LIKE @repo")) ||
+		!(collection_stmt = katja_db_prepare(job_data->db, job_data->statements,
+								 "SELECT (c.collection_pkg || ';' || p.ver || ';' || p.arch || ';' || r.repo), p.summary, "
+								 "p.full_name, p.ext FROM collections AS c "
+								 "JOIN pkglist AS p ON c.collection_pkg = p.name "
+								 "JOIN repos AS r ON p.repo_order = r.repo_order "
+								 "WHERE c.name LIKE @name AND r.repo LIKE @repo"))) {
 		pk_backend_job_error_code(job, PK_ERROR_ENUM_CANNOT_GET_FILELIST, "%s", sqlite3_errmsg(job_data->db));
 		goto out;
 	}
@@ -585,8 +571,8 @@ static void pk_backend_install_packages_thread(PkBackendJob *job, GVariant *para
 	g_slist_free_full(install_list, g_free);
 
 out:
-	sqlite3_finalize(pkglist_stmt);
-	sqlite3_finalize(collection_stmt);
+	sqlite3_reset(pkglist_stmt);
+	sqlite3_reset(collection_stmt);
 
 	pk_backend_job_finished (job);
 }
@@ -657,14 +643,10 @@ static void pk_backend_get_updates_thread(PkBackendJob *job, GVariant *params, g
 
 	pk_backend_job_set_status(job, PK_STATUS_ENUM_QUERY);
 
-	if ((sqlite3_prepare_v2(job_data->db,
-							"SELECT p1.full_name, p1.name, p1.ver, p1.arch, r.repo, p1.summary, p1.ext "
-							"FROM pkglist AS p1 NATURAL JOIN repos AS r "
-							"WHERE p1.name LIKE @name AND p1.repo_order = "
-							"(SELECT MIN(p2.repo_order) FROM pkglist AS p2 WHERE p2.name = p1.name GROUP BY p2.name)",
-							-1,
-							&stmt,
-							NULL) != SQLITE_OK)) {
+	if (!(stmt = katja_db_prepare(job_data->db, job_data->statements,
+								 "SELECT p1.full_name, p1.name, p1.ver, p1.arch, r.repo, p1.summary, p1.ext "
+								 "FROM pkglist AS p1 NATURAL JOIN repos AS r "
+								 "WHERE p1.name LIKE @name AND p1.preferred"))) {
 		pk_backend_job_error_code(job, PK_ERROR_ENUM_CANNOT_GET_FILELIST, "%s", sqlite3_errmsg(job_data->db));
 		goto out;
 	}
@@ -734,7 +716,7 @@ static void pk_backend_get_updates_thread(PkBackendJob *job, GVariant *params, g
 	g_object_unref(pkg_metadata_enumerator);
 
 out:
-	sqlite3_finalize(stmt);
+	sqlite3_reset(stmt);
 }
 
 void pk_backend_get_updates(PkBackend *backend, PkBackendJob *job, PkBitfield filters) {
@@ -869,6 +851,9 @@ static void pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params,
 	for (l = repos; l; l = g_slist_next(l))
 		katja_pkgtools_generate_cache(l->data, job, tmp_dir_name);
 
+	if ((ret = katja_db_update_search_index(job_data->db)) != SQLITE_OK)
+		pk_backend_job_error_code(job, PK_ERROR_ENUM_INTERNAL_ERROR, "%s", sqlite3_errstr(ret));
+
 out:
 	sqlite3_finalize(stmt);
 	if (file_info)
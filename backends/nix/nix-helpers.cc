@@ -19,20 +19,30 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <errno.h>
+#include <string.h>
+
 #include "nix-helpers.hh"
 
+// key used to look up a drv by package id
+static string
+nix_drv_key (const string & attrPath, const string & system)
+{
+	return attrPath + ";" + system;
+}
+
 // find drv based on attrpath and system
 DrvInfo
-nix_find_drv (EvalState & state, DrvInfos drvs, gchar* package_id)
+nix_find_drv (EvalState & state, DrvInfos & drvs, gchar* package_id)
 {
-	gchar** package_id_parts = pk_package_id_split (package_id);
+	g_auto(GStrv) package_id_parts = pk_package_id_split (package_id);
 
 	// string name (package_id_parts[0]);
 	// string version (package_id_parts[1]);
 	string system (package_id_parts[2]);
 	string attrPath (package_id_parts[3]);
 
-	for (auto drv : drvs)
+	for (auto & drv : drvs)
 		if (drv.attrPath == attrPath && drv.system == system)
 			return drv;
 
@@ -54,24 +64,49 @@ nix_drv_package_id (DrvInfo & drv)
 	);
 }
 
-// get all drvs from list of ids
+// get all drvs from list of ids, hashing drvs once rather than once per id
 DrvInfos
-nix_get_drvs_from_ids (EvalState & state, DrvInfos drvs, gchar** package_ids)
+nix_get_drvs_from_ids (EvalState & state, DrvInfos & drvs, gchar** package_ids)
 {
 	DrvInfos _drvs;
+	std::unordered_map<string, DrvInfo*> drvsByKey;
+
+	// the first match wins, as with nix_find_drv
+	drvsByKey.reserve (drvs.size ());
+	for (auto & drv : drvs)
+		drvsByKey.emplace (nix_drv_key (drv.attrPath, drv.system), &drv);
 
 	for (; *package_ids != NULL; package_ids++)
-		_drvs.push_back (
-			nix_find_drv (
-				state,
-				drvs,
-				*package_ids
-			)
-		);
+	{
+		g_auto(GStrv) package_id_parts = pk_package_id_split (*package_ids);
+		if (package_id_parts == NULL)
+		{
+			_drvs.push_back (DrvInfo (state));
+			continue;
+		}
+
+		auto it = drvsByKey.find (nix_drv_key (package_id_parts[3], package_id_parts[2]));
+		if (it != drvsByKey.end ())
+			_drvs.push_back (*it->second);
+		else
+			_drvs.push_back (DrvInfo (state));
+	}
 
 	return _drvs;
 }
 
+// get the names of everything installed in a profile, for O(1) lookups
+NixInstalledNames
+nix_get_installed_names (EvalState & state, const Path & profile)
+{
+	NixInstalledNames names;
+
+	for (auto & drv : queryInstalled (state, profile))
+		names.insert (drv.name);
+
+	return names;
+}
+
 // return false if drvinfo doesn't conflicts with a filter
 bool
 nix_filter_drv (EvalState & state, DrvInfo & drv, const Settings & settings, PkBitfield filters)
@@ -156,6 +191,258 @@ nix_get_all_derivations (EvalState & state, const Path & homedir)
 	return drvs;
 }
 
+// the index format, bump when the fields change
+#define NIX_INDEX_MAGIC "pk-nix-index-1"
+
+// flags stored for each index entry, so filters need no evaluation
+#define NIX_INDEX_FLAG_FAILED		'f'
+#define NIX_INDEX_FLAG_PLATFORMS	'p'
+#define NIX_INDEX_FLAG_SUPPORTED	's'
+
+// identify the channel generation by where each ~/.nix-defexpr entry points
+string
+nix_index_generation (const Path & homedir)
+{
+	Path defexpr = homedir + "/.nix-defexpr";
+	string generation;
+
+	if (!pathExists (defexpr))
+		return generation;
+
+	StringSet namesSorted;
+	for (auto & i : readDirectory (defexpr))
+		namesSorted.insert (i.name);
+
+	for (auto & i : namesSorted)
+	{
+		try
+		{
+			generation += i + "=" + canonPath (defexpr + "/" + i, true) + ";";
+		}
+		catch (Error & e)
+		{
+			// ignore dangling symlinks, like getAllExprs does
+		}
+	}
+
+	return generation;
+}
+
+static void
+nix_index_append (string & data, const string & field)
+{
+	data.append (field);
+	data.push_back ('\0');
+}
+
+// serialise the fields needed by the query roles, NUL-terminated so the
+// mapped file can be used without copying
+gboolean
+nix_index_write (EvalState & state, DrvInfos & drvs, const Settings & settings, const gchar* filename, const string & generation, GError** error)
+{
+	string data;
+	guint count = 0;
+	string records;
+
+	for (auto & drv : drvs)
+	{
+		try
+		{
+			DrvName name (drv.name);
+			string flags;
+
+			if (drv.hasFailed ())
+				flags.push_back (NIX_INDEX_FLAG_FAILED);
+
+			auto platforms = drv.queryMeta ("platforms");
+			if (platforms != NULL && platforms->isList ())
+			{
+				flags.push_back (NIX_INDEX_FLAG_PLATFORMS);
+				for (auto i = platforms->listElems (); i != platforms->listElems () + platforms->listSize (); i++)
+					if (*i != NULL && (*i)->type == tString && (*i)->string.s == settings.thisSystem)
+					{
+						flags.push_back (NIX_INDEX_FLAG_SUPPORTED);
+						break;
+					}
+			}
+
+			string description = drv.queryMetaString ("description");
+
+			nix_index_append (records, drv.attrPath);
+			nix_index_append (records, drv.name);
+			nix_index_append (records, name.name);
+			nix_index_append (records, name.version);
+			nix_index_append (records, drv.system);
+			nix_index_append (records, description);
+			nix_index_append (records, flags);
+			count++;
+		}
+		catch (Error & e)
+		{
+			// skip derivations that fail to evaluate
+			g_debug ("not indexing %s: %s", drv.attrPath.c_str (), e.what ());
+		}
+	}
+
+	nix_index_append (data, NIX_INDEX_MAGIC);
+	nix_index_append (data, generation);
+	nix_index_append (data, std::to_string (count));
+	data.append (records);
+
+	g_autofree gchar* dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0755) != 0)
+	{
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			     "failed to create %s", dirname);
+		return FALSE;
+	}
+
+	return g_file_set_contents (filename, data.data (), data.size (), error);
+}
+
+// map the index, returning NULL if it is missing, corrupt or from another generation
+NixIndex*
+nix_index_load (const gchar* filename, const string & generation)
+{
+	g_autoptr (GError) error = NULL;
+
+	GMappedFile* file = g_mapped_file_new (filename, FALSE, &error);
+	if (file == NULL)
+	{
+		g_debug ("no index: %s", error->message);
+		return NULL;
+	}
+
+	const gchar* p = g_mapped_file_get_contents (file);
+	const gchar* end = p + g_mapped_file_get_length (file);
+
+	auto next = [&] () -> const gchar*
+	{
+		if (p == NULL || p >= end)
+			return NULL;
+		auto nul = (const gchar*) memchr (p, '\0', end - p);
+		if (nul == NULL)
+			return NULL;
+		auto field = p;
+		p = nul + 1;
+		return field;
+	};
+
+	const gchar* magic = next ();
+	const gchar* _generation = next ();
+	const gchar* count = next ();
+	if (g_strcmp0 (magic, NIX_INDEX_MAGIC) != 0 ||
+	    g_strcmp0 (_generation, generation.c_str ()) != 0 ||
+	    count == NULL)
+	{
+		g_debug ("index %s is out of date", filename);
+		g_mapped_file_unref (file);
+		return NULL;
+	}
+
+	auto index = new NixIndex;
+	index->ref = 1;
+	index->file = file;
+	index->generation = generation;
+
+	guint64 n = g_ascii_strtoull (count, NULL, 10);
+	index->entries.reserve (n);
+	for (guint64 i = 0; i < n; i++)
+	{
+		NixIndexEntry entry;
+		entry.attr_path = next ();
+		entry.drv_name = next ();
+		entry.name = next ();
+		entry.version = next ();
+		entry.system = next ();
+		entry.description = next ();
+		entry.flags = next ();
+		if (entry.flags == NULL)
+		{
+			g_warning ("index %s is truncated", filename);
+			nix_index_unref (index);
+			return NULL;
+		}
+		index->entries.push_back (entry);
+	}
+
+	return index;
+}
+
+NixIndex*
+nix_index_ref (NixIndex* index)
+{
+	g_atomic_int_inc (&index->ref);
+	return index;
+}
+
+void
+nix_index_unref (NixIndex* index)
+{
+	if (!g_atomic_int_dec_and_test (&index->ref))
+		return;
+	g_mapped_file_unref (index->file);
+	delete index;
+}
+
+// generate package id from an index entry
+gchar*
+nix_index_entry_package_id (const NixIndexEntry & entry)
+{
+	return pk_package_id_build (
+		entry.name,
+		entry.version,
+		entry.system,
+		entry.attr_path
+	);
+}
+
+// same as nix_filter_drv, using the flags computed when indexing
+bool
+nix_filter_index_entry (const NixIndexEntry & entry, const Settings & settings, PkBitfield filters)
+{
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_VISIBLE) || pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_VISIBLE))
+		if (strchr (entry.flags, NIX_INDEX_FLAG_FAILED) == NULL)
+		{
+			if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_VISIBLE))
+				return FALSE;
+		}
+		else
+		{
+			if (pk_bitfield_contain (filters, PK_FILTER_ENUM_VISIBLE))
+				return FALSE;
+		}
+
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_ARCH) || pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_ARCH))
+		if (entry.system == settings.thisSystem)
+		{
+			if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_ARCH))
+				return FALSE;
+		}
+		else
+		{
+			if (pk_bitfield_contain (filters, PK_FILTER_ENUM_ARCH))
+				return FALSE;
+		}
+
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_SUPPORTED) || pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_SUPPORTED))
+		if (strchr (entry.flags, NIX_INDEX_FLAG_PLATFORMS) != NULL)
+		{
+			if (strchr (entry.flags, NIX_INDEX_FLAG_SUPPORTED) != NULL)
+			{
+				if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_SUPPORTED))
+					return FALSE;
+			}
+			else
+			{
+				if (pk_bitfield_contain (filters, PK_FILTER_ENUM_SUPPORTED))
+					return FALSE;
+			}
+		}
+
+	return TRUE;
+}
+
 // get current nix profile frmo job's uid
 Path
 nix_get_profile (PkBackendJob* job)
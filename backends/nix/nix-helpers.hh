@@ -23,6 +23,9 @@
 #define NIX_HELPERS_HH
 
 #include <pwd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <glib.h>
 
 #include <pk-backend.h>
@@ -40,7 +43,12 @@ gboolean
 pk_nix_finish (PkBackendJob* job, GError* error);
 
 DrvInfos
-nix_get_drvs_from_ids (EvalState & state, DrvInfos drvs, gchar** package_ids);
+nix_get_drvs_from_ids (EvalState & state, DrvInfos & drvs, gchar** package_ids);
+
+typedef std::unordered_set<string> NixInstalledNames;
+
+NixInstalledNames
+nix_get_installed_names (EvalState & state, const Path & profile);
 
 EvalState*
 nix_get_state ();
@@ -52,7 +60,7 @@ gchar*
 nix_drv_package_id (DrvInfo & drv);
 
 DrvInfo
-nix_find_drv (EvalState & state, DrvInfos drvs, gchar* package_id);
+nix_find_drv (EvalState & state, DrvInfos & drvs, gchar* package_id);
 
 bool
 nix_filter_drv (EvalState & state, DrvInfo & drv, const Settings & settings, PkBitfield filters);
@@ -60,4 +68,43 @@ nix_filter_drv (EvalState & state, DrvInfo & drv, const Settings & settings, PkB
 Path
 nix_get_profile (PkBackendJob* job);
 
+// one derivation in the on-disk index, all pointing into the mapped file
+typedef struct {
+	const gchar* attr_path;
+	const gchar* drv_name;
+	const gchar* name;
+	const gchar* version;
+	const gchar* system;
+	const gchar* description;
+	const gchar* flags;
+} NixIndexEntry;
+
+typedef struct {
+	gint ref;
+	GMappedFile* file;
+	string generation;
+	std::vector<NixIndexEntry> entries;
+} NixIndex;
+
+string
+nix_index_generation (const Path & homedir);
+
+gboolean
+nix_index_write (EvalState & state, DrvInfos & drvs, const Settings & settings, const gchar* filename, const string & generation, GError** error);
+
+NixIndex*
+nix_index_load (const gchar* filename, const string & generation);
+
+NixIndex*
+nix_index_ref (NixIndex* index);
+
+void
+nix_index_unref (NixIndex* index);
+
+gchar*
+nix_index_entry_package_id (const NixIndexEntry & entry);
+
+bool
+nix_filter_index_entry (const NixIndexEntry & entry, const Settings & settings, PkBitfield filters);
+
 #endif
@@ -28,11 +28,120 @@
 
 typedef struct {
 	Path roothome;
+	gchar* indexfile;
 } PkBackendNixPrivate;
 
 static PkBackendNixPrivate* priv;
 static EvalState* state;
 static DrvInfos drvs;
+static NixIndex* nixIndex;
+static GMutex nixIndexLock;
+
+// write a new index from drvs and start using it
+static void
+pk_backend_nix_rebuild_index (const string & generation)
+{
+	g_autoptr (GError) error = NULL;
+
+	if (!nix_index_write (*state, drvs, settings, priv->indexfile, generation, &error))
+		throw Error (format ("failed to write %1%: %2%") % priv->indexfile % error->message);
+
+	NixIndex* _index = nix_index_load (priv->indexfile, generation);
+	if (_index == NULL)
+		throw Error (format ("failed to load %1%") % priv->indexfile);
+
+	if (nixIndex != NULL)
+		nix_index_unref (nixIndex);
+	nixIndex = _index;
+}
+
+// get the index for the current channels, only evaluating nixpkgs if the
+// index on disk is missing or from an older channel generation
+static NixIndex*
+pk_backend_nix_get_index ()
+{
+	string generation = nix_index_generation (priv->roothome);
+	NixIndex* _index;
+
+	g_mutex_lock (&nixIndexLock);
+	try
+	{
+		if (nixIndex == NULL || nixIndex->generation != generation)
+		{
+			_index = nix_index_load (priv->indexfile, generation);
+			if (_index != NULL)
+			{
+				if (nixIndex != NULL)
+					nix_index_unref (nixIndex);
+				nixIndex = _index;
+			}
+			else
+			{
+				// possibly slow call
+				drvs = nix_get_all_derivations (*state, priv->roothome);
+				pk_backend_nix_rebuild_index (generation);
+			}
+		}
+		_index = nix_index_ref (nixIndex);
+	}
+	catch (...)
+	{
+		g_mutex_unlock (&nixIndexLock);
+		throw;
+	}
+	g_mutex_unlock (&nixIndexLock);
+
+	return _index;
+}
+
+// get the derivations for package_ids, only evaluating nixpkgs the first
+// time; drvs is shared with refresh, so it is only touched under the lock
+static DrvInfos
+pk_backend_nix_get_drvs_from_ids (gchar** package_ids)
+{
+	DrvInfos _drvs;
+
+	g_mutex_lock (&nixIndexLock);
+	try
+	{
+		// possibly slow call
+		if (drvs.empty ())
+			drvs = nix_get_all_derivations (*state, priv->roothome);
+		_drvs = nix_get_drvs_from_ids (*state, drvs, package_ids);
+	}
+	catch (...)
+	{
+		g_mutex_unlock (&nixIndexLock);
+		throw;
+	}
+	g_mutex_unlock (&nixIndexLock);
+
+	return _drvs;
+}
+
+// get a snapshot of all derivations, for when a job has to scan them
+static DrvInfos
+pk_backend_nix_get_drvs ()
+{
+	DrvInfos _drvs;
+
+	g_mutex_lock (&nixIndexLock);
+	try
+	{
+		// possibly slow call
+		if (drvs.empty ())
+			drvs = nix_get_all_derivations (*state, priv->roothome);
+		_drvs = drvs;
+	}
+	catch (...)
+	{
+		g_mutex_unlock (&nixIndexLock);
+		throw;
+	}
+	g_mutex_unlock (&nixIndexLock);
+
+	return _drvs;
+}
 
 void
 pk_backend_initialize (GKeyFile* conf, PkBackend* backend)
@@ -45,6 +154,7 @@ pk_backend_initialize (GKeyFile* conf, PkBackend* backend)
 	if ((uid_ent = getpwuid (getuid ())) == NULL)
 		g_error ("Failed to get HOME");
 	priv->roothome = uid_ent->pw_dir;
+	priv->indexfile = g_build_filename (LOCALSTATEDIR, "cache", "PackageKit", "nix-index", NULL);
 
 	verbosity = (Verbosity) -1;
 
@@ -63,8 +173,11 @@ pk_backend_initialize (GKeyFile* conf, PkBackend* backend)
 void
 pk_backend_destroy (PkBackend* backend)
 {
-	drvs.empty ();
+	drvs.clear ();
+	if (nixIndex != NULL)
+		nix_index_unref (nixIndex);
 	g_free (state);
+	g_free (priv->indexfile);
 	g_free (priv);
 }
 
@@ -201,13 +314,9 @@ pk_backend_get_details_thread (PkBackendJob* job, GVariant* params, gpointer p)
 
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
-
-		DrvInfos _drvs = nix_get_drvs_from_ids (*state, drvs, (gchar**) p);
+		DrvInfos _drvs = pk_backend_nix_get_drvs_from_ids ((gchar**) p);
 
-		for (auto drv : _drvs)
+		for (auto & drv : _drvs)
 		{
 			if (pk_backend_job_is_cancelled (job))
 				break;
@@ -263,36 +372,33 @@ pk_backend_get_packages_thread (PkBackendJob* job, GVariant* params, gpointer p)
 	PkBitfield filters;
 	g_variant_get (params, "(t)", &filters);
 
+	NixIndex* _index = NULL;
+
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
+		_index = pk_backend_nix_get_index ();
 
 		auto profile = nix_get_profile (job);
-		DrvInfos installedDrvs = queryInstalled (*state, profile);
+		NixInstalledNames installedNames = nix_get_installed_names (*state, profile);
 
 		int n = 0;
-		double percentFactor = 100 / drvs.size ();
+		double percentFactor = 0;
+		if (_index->entries.size () > 0)
+			percentFactor = 100.0 / _index->entries.size ();
 
-		for (auto drv : drvs)
+		for (auto & entry : _index->entries)
 		{
 			if (pk_backend_job_is_cancelled (job))
 				break;
 
 			pk_backend_job_set_percentage (job, (n++) * percentFactor);
 
-			if (!nix_filter_drv (*state, drv, settings, filters))
+			if (!nix_filter_index_entry (entry, settings, filters))
 				continue;
 
 			auto info = PK_INFO_ENUM_AVAILABLE;
-
-			for (auto _drv : installedDrvs)
-				if (_drv.name == drv.name)
-				{
-					info = PK_INFO_ENUM_INSTALLED;
-					break;
-				}
+			if (installedNames.count (entry.drv_name) > 0)
+				info = PK_INFO_ENUM_INSTALLED;
 
 			if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && info != PK_INFO_ENUM_INSTALLED)
 				continue;
@@ -303,8 +409,8 @@ pk_backend_get_packages_thread (PkBackendJob* job, GVariant* params, gpointer p)
 			pk_backend_job_package (
 				job,
 				info,
-				nix_drv_package_id (drv),
-				drv.queryMetaString ("description").c_str ()
+				nix_index_entry_package_id (entry),
+				entry.description
 			);
 		}
 	}
@@ -312,6 +418,9 @@ pk_backend_get_packages_thread (PkBackendJob* job, GVariant* params, gpointer p)
 	{
 	}
 
+	if (_index != NULL)
+		nix_index_unref (_index);
+
 	pk_nix_finish (job, error);
 }
 
@@ -330,14 +439,14 @@ pk_backend_resolve_thread (PkBackendJob* job, GVariant* params, gpointer p)
 	PkBitfield filters;
 	g_variant_get (params, "(t^a&s)", &filters, &search);
 
+	NixIndex* _index = NULL;
+
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
+		_index = pk_backend_nix_get_index ();
 
 		auto profile = nix_get_profile (job);
-		DrvInfos installedDrvs = queryInstalled (*state, profile);
+		NixInstalledNames installedNames = nix_get_installed_names (*state, profile);
 
 		for (; *search != NULL; ++search)
 		{
@@ -346,22 +455,17 @@ pk_backend_resolve_thread (PkBackendJob* job, GVariant* params, gpointer p)
 
 			DrvName searchName (*search);
 
-			for (auto drv : drvs)
+			for (auto & entry : _index->entries)
 			{
-				DrvName drvName (drv.name);
+				DrvName drvName (entry.drv_name);
 				if (searchName.matches (drvName))
 				{
-					if (!nix_filter_drv (*state, drv, settings, filters))
+					if (!nix_filter_index_entry (entry, settings, filters))
 						continue;
 
 					auto info = PK_INFO_ENUM_AVAILABLE;
-
-					for (auto _drv : installedDrvs)
-						if (_drv.name == drv.name)
-						{
-							info = PK_INFO_ENUM_INSTALLED;
-							break;
-						}
+					if (installedNames.count (entry.drv_name) > 0)
+						info = PK_INFO_ENUM_INSTALLED;
 
 					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && info != PK_INFO_ENUM_INSTALLED)
 						continue;
@@ -372,8 +476,8 @@ pk_backend_resolve_thread (PkBackendJob* job, GVariant* params, gpointer p)
 					pk_backend_job_package (
 						job,
 						info,
-						nix_drv_package_id (drv),
-						drv.queryMetaString ("description").c_str ()
+						nix_index_entry_package_id (entry),
+						entry.description
 					);
 				}
 			}
@@ -383,6 +487,9 @@ pk_backend_resolve_thread (PkBackendJob* job, GVariant* params, gpointer p)
 	{
 	}
 
+	if (_index != NULL)
+		nix_index_unref (_index);
+
 	pk_nix_finish (job, error);
 }
 
@@ -401,34 +508,29 @@ pk_backend_search_names_thread (PkBackendJob* job, GVariant* params, gpointer p)
 	PkBitfield filters;
 	g_variant_get (params, "(t^a&s)", &filters, &search);
 
+	NixIndex* _index = NULL;
+
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
+		_index = pk_backend_nix_get_index ();
 
 		auto profile = nix_get_profile (job);
-		DrvInfos installedDrvs = queryInstalled (*state, profile);
+		NixInstalledNames installedNames = nix_get_installed_names (*state, profile);
 
 		for (; *search != NULL; ++search)
 		{
 			if (pk_backend_job_is_cancelled (job))
 				break;
 
-			for (auto drv : drvs)
-				if (drv.name.find(*search) != -1)
+			for (auto & entry : _index->entries)
+				if (strstr (entry.drv_name, *search) != NULL)
 				{
-					if (!nix_filter_drv (*state, drv, settings, filters))
+					if (!nix_filter_index_entry (entry, settings, filters))
 						continue;
 
 					auto info = PK_INFO_ENUM_AVAILABLE;
-
-					for (auto _drv : installedDrvs)
-						if (_drv.name == drv.name)
-						{
-							info = PK_INFO_ENUM_INSTALLED;
-							break;
-						}
+					if (installedNames.count (entry.drv_name) > 0)
+						info = PK_INFO_ENUM_INSTALLED;
 
 					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && info != PK_INFO_ENUM_INSTALLED)
 						continue;
@@ -439,8 +541,8 @@ pk_backend_search_names_thread (PkBackendJob* job, GVariant* params, gpointer p)
 					pk_backend_job_package (
 						job,
 						info,
-						nix_drv_package_id (drv),
-						drv.queryMetaString ("description").c_str ()
+						nix_index_entry_package_id (entry),
+						entry.description
 					);
 				}
 		}
@@ -449,6 +551,9 @@ pk_backend_search_names_thread (PkBackendJob* job, GVariant* params, gpointer p)
 	{
 	}
 
+	if (_index != NULL)
+		nix_index_unref (_index);
+
 	pk_nix_finish (job, error);
 }
 
@@ -467,34 +572,29 @@ pk_backend_search_details_thread (PkBackendJob* job, GVariant* params, gpointer
 	PkBitfield filters;
 	g_variant_get (params, "(t^a&s)", &filters, &value);
 
+	NixIndex* _index = NULL;
+
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
+		_index = pk_backend_nix_get_index ();
 
 		auto profile = nix_get_profile (job);
-		DrvInfos installedDrvs = queryInstalled (*state, profile);
+		NixInstalledNames installedNames = nix_get_installed_names (*state, profile);
 
 		for (; *value != NULL; ++value)
 		{
 			if (pk_backend_job_is_cancelled (job))
 				break;
 
-			for (auto drv : drvs)
-				if (drv.queryMetaString ("description").find (*value) != -1)
+			for (auto & entry : _index->entries)
+				if (strstr (entry.description, *value) != NULL)
 				{
-					if (!nix_filter_drv (*state, drv, settings, filters))
+					if (!nix_filter_index_entry (entry, settings, filters))
 						continue;
 
 					auto info = PK_INFO_ENUM_AVAILABLE;
-
-					for (auto _drv : installedDrvs)
-						if (_drv.name == drv.name)
-						{
-							info = PK_INFO_ENUM_INSTALLED;
-							break;
-						}
+					if (installedNames.count (entry.drv_name) > 0)
+						info = PK_INFO_ENUM_INSTALLED;
 
 					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && info != PK_INFO_ENUM_INSTALLED)
 						continue;
@@ -505,8 +605,8 @@ pk_backend_search_details_thread (PkBackendJob* job, GVariant* params, gpointer
 					pk_backend_job_package (
 						job,
 						info,
-						nix_drv_package_id (drv),
-						drv.queryMetaString ("description").c_str ()
+						nix_index_entry_package_id (entry),
+						entry.description
 					);
 				}
 		}
@@ -515,6 +615,9 @@ pk_backend_search_details_thread (PkBackendJob* job, GVariant* params, gpointer
 	{
 	}
 
+	if (_index != NULL)
+		nix_index_unref (_index);
+
 	pk_nix_finish (job, error);
 }
 
@@ -531,8 +634,24 @@ pk_backend_refresh_cache_thread (PkBackendJob* job, GVariant* params, gpointer p
 
 	try
 	{
+		string generation = nix_index_generation (priv->roothome);
+
 		state = nix_get_state ();
-		drvs = nix_get_all_derivations (*state, priv->roothome);
+		DrvInfos _drvs = nix_get_all_derivations (*state, priv->roothome);
+
+		// searches and package lists only read the index from now on
+		g_mutex_lock (&nixIndexLock);
+		try
+		{
+			drvs.swap (_drvs);
+			pk_backend_nix_rebuild_index (generation);
+		}
+		catch (...)
+		{
+			g_mutex_unlock (&nixIndexLock);
+			throw;
+		}
+		g_mutex_unlock (&nixIndexLock);
 	}
 	catch (std::exception & e)
 	{
@@ -559,13 +678,9 @@ pk_backend_install_packages_thread (PkBackendJob* job, GVariant* params, gpointe
 
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
-
-		DrvInfos newElems = nix_get_drvs_from_ids (*state, drvs, package_ids);
+		DrvInfos newElems = pk_backend_nix_get_drvs_from_ids (package_ids);
 
-		for (auto drv : newElems)
+		for (auto & drv : newElems)
 		{
 			pk_backend_job_package (
 				job,
@@ -597,7 +712,7 @@ pk_backend_install_packages_thread (PkBackendJob* job, GVariant* params, gpointe
 				break;
 		}
 
-		for (auto drv : newElems)
+		for (auto & drv : newElems)
 		{
 			pk_backend_job_package (
 				job,
@@ -632,13 +747,9 @@ pk_backend_remove_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations(*state, priv->roothome);
-
-		DrvInfos _drvs = nix_get_drvs_from_ids (*state, drvs, package_ids);
+		DrvInfos _drvs = pk_backend_nix_get_drvs_from_ids (package_ids);
 
-		for (auto drv : _drvs)
+		for (auto & drv : _drvs)
 		{
 			pk_backend_job_package (
 				job,
@@ -679,7 +790,7 @@ pk_backend_remove_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 				break;
 		}
 
-		for (auto drv : _drvs)
+		for (auto & drv : _drvs)
 		{
 			pk_backend_job_package (
 				job,
@@ -709,9 +820,7 @@ pk_backend_update_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
+		DrvInfos allElems = pk_backend_nix_get_drvs ();
 
 		auto profile = nix_get_profile (job);
 
@@ -745,10 +854,10 @@ pk_backend_update_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 					   priority.  If there are still multiple matches,
 					   take the one with the highest version.
 					   Do not upgrade if it would decrease the priority. */
-					DrvInfos::iterator bestElem = drvs.end ();
+					DrvInfos::iterator bestElem = allElems.end ();
 					string bestVersion;
 
-					for (auto j = drvs.begin (); j != drvs.end (); ++j)
+					for (auto j = allElems.begin (); j != allElems.end (); ++j)
 					{
 						if (comparePriorities (*state, i, *j) > 0)
 							continue;
@@ -760,7 +869,7 @@ pk_backend_update_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 							if (d < 0)
 							{
 								int d2 = -1;
-								if (bestElem != drvs.end ())
+								if (bestElem != allElems.end ())
 								{
 									d2 = comparePriorities (*state, *bestElem, *j);
 									if (d2 == 0)
@@ -775,7 +884,7 @@ pk_backend_update_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 						}
 					}
 
-					if (bestElem != drvs.end () && i.queryOutPath () != bestElem->queryOutPath ())
+					if (bestElem != allElems.end () && i.queryOutPath () != bestElem->queryOutPath ())
 					{
 						const char * action;
 						auto _drv = *bestElem;
@@ -814,7 +923,7 @@ pk_backend_update_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 
 			if (createUserEnv (*state, newElems, profile, false, lockToken))
 			{
-				for (auto drv : newElems)
+				for (auto & drv : newElems)
 				{
 					pk_backend_job_package (
 						job,
@@ -852,14 +961,10 @@ pk_backend_download_packages_thread (PkBackendJob* job, GVariant* params, gpoint
 
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
-
-		DrvInfos _drvs = nix_get_drvs_from_ids (*state, drvs, package_ids);
+		DrvInfos _drvs = pk_backend_nix_get_drvs_from_ids (package_ids);
 
 		PathSet paths;
-		for (auto drv : _drvs)
+		for (auto & drv : _drvs)
 		{
 			if (pk_backend_job_is_cancelled (job))
 				break;
@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# Licensed under the GNU General Public License Version 2
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# Stays running between jobs like the python dispatchers. The package
+# version is the PID of the helper, and the data says whether the command
+# came on the command line or on stdin.
+
+job () {
+	printf 'package\tinstalled\tdispatcher;%s;noarch;%s\tThe test dispatcher\n' "$$" "$1"
+	printf 'finished\n'
+}
+
+if [ $# -gt 0 ]; then
+	job argv
+fi
+while read command; do
+	if [ "$command" = "exit" ]; then
+		exit 0
+	fi
+	job stdin
+done
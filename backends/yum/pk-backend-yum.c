@@ -76,15 +76,6 @@ pk_backend_stderr_cb (PkBackendJob *job, const gchar *output)
 	return TRUE;
 }
 
-/**
- * pk_backend_stdout_cb:
- */
-static gboolean
-pk_backend_stdout_cb (PkBackendJob *job, const gchar *output)
-{
-	return TRUE;
-}
-
 /**
  * pk_backend_yum_repos_changed_cb:
  **/
@@ -214,7 +205,6 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	g_debug ("backend: initialize");
 	priv->spawn = pk_backend_spawn_new (conf);
 	pk_backend_spawn_set_filter_stderr (priv->spawn, pk_backend_stderr_cb);
-	pk_backend_spawn_set_filter_stdout (priv->spawn, pk_backend_stdout_cb);
 	pk_backend_spawn_set_name (priv->spawn, "yum");
 	pk_backend_spawn_set_allow_sigkill (priv->spawn, FALSE);
 
@@ -228,6 +228,9 @@ def _get_cmdline_for_pid(pid):
 
 class PackageKitYumBackend(PackageKitBaseBackend, PackagekitPackage):
 
+    # send frames rather than text lines when the daemon supports them
+    framed_output = True
+
     def __init__(self, args, lock=True):
         signal.signal(signal.SIGQUIT, sigquit)
         PackageKitBaseBackend.__init__(self, args)
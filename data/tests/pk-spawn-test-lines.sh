@@ -0,0 +1,10 @@
+#!/bin/sh
+# Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+# Licensed under the GNU General Public License Version 2
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# write more than one poll worth of output as fast as possible
+seq 1 20000 | sed 's/.*/package\tinstalled\tpolkit;0.0.&;i386;data\tPolicyKit daemon/'
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+# Licensed under the GNU General Public License Version 2
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# the last line has no newline and the helper exits straight away,
+# optionally waiting for a command before writing it
+printf 'first\nsecond\n'
+if [ "$1" = "wait" ]; then
+	read command
+fi
+printf 'last'
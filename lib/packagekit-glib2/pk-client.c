@@ -66,6 +66,7 @@ struct _PkClientPrivate
 	gboolean		 interactive;
 	gboolean		 idle;
 	guint			 cache_age;
+	gboolean		 no_start_transaction;
 };
 
 enum {
@@ -120,6 +121,9 @@ typedef struct {
 	PkUpgradeKindEnum		 upgrade_kind;
 	guint				 refcount;
 	PkClientHelper			*client_helper;
+	guint				 signal_id;
+	gchar				*match_rule;
+	GPtrArray			*signals;
 } PkClientState;
 
 static void
@@ -559,13 +563,18 @@ pk_client_cancel_cb (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
 	PkClientState *state = (PkClientState *) user_data;
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (G_IS_DBUS_PROXY (source_object)) {
+		value = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object),
+						  res, &error);
+	} else {
+		value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object),
+						       res, &error);
+	}
 	if (value == NULL) {
 		/* there's not really a lot we can do here */
 		g_warning ("failed to cancel: %s", error->message);
@@ -582,6 +591,27 @@ pk_client_cancel_cb (GObject *source_object,
 static void
 pk_client_cancellable_cancel_cb (GCancellable *cancellable, PkClientState *state)
 {
+	/* started with a single call, so there's no proxy */
+	if (state->proxy == NULL && state->signal_id != 0) {
+		if (state->tid == NULL) {
+			g_debug ("Cancelled, will cancel when started");
+			return;
+		}
+		g_debug ("cancelling %s", state->tid);
+		g_dbus_connection_call (state->client->priv->connection,
+					PK_DBUS_SERVICE,
+					state->tid,
+					PK_DBUS_INTERFACE_TRANSACTION,
+					"Cancel",
+					NULL,
+					NULL,
+					G_DBUS_CALL_FLAGS_NONE,
+					PK_CLIENT_DBUS_METHOD_TIMEOUT,
+					NULL,
+					pk_client_cancel_cb, state);
+		return;
+	}
+
 	/* dbus method has not yet fired */
 	if (state->proxy == NULL) {
 		g_debug ("Cancelled, but no proxy, not sure what to do here");
@@ -633,6 +663,63 @@ pk_client_state_add (PkClient *client, PkClientState *state)
 	}
 }
 
+/**
+ * pk_client_state_set_match_rule:
+ *
+ * Replaces the bus match rule for the transaction signals. The new rule is
+ * added before the old one is removed, and the bus handles both in order,
+ * so no signal is lost in between.
+ **/
+static void
+pk_client_state_set_match_rule (PkClientState *state, const gchar *match_rule)
+{
+	GDBusConnection *connection = state->client->priv->connection;
+
+	if (match_rule != NULL) {
+		g_dbus_connection_call (connection,
+					"org.freedesktop.DBus",
+					"/org/freedesktop/DBus",
+					"org.freedesktop.DBus",
+					"AddMatch",
+					g_variant_new ("(s)", match_rule),
+					NULL,
+					G_DBUS_CALL_FLAGS_NO_AUTO_START,
+					-1, NULL, NULL, NULL);
+	}
+	if (state->match_rule != NULL) {
+		g_dbus_connection_call (connection,
+					"org.freedesktop.DBus",
+					"/org/freedesktop/DBus",
+					"org.freedesktop.DBus",
+					"RemoveMatch",
+					g_variant_new ("(s)", state->match_rule),
+					NULL,
+					G_DBUS_CALL_FLAGS_NO_AUTO_START,
+					-1, NULL, NULL, NULL);
+	}
+	g_free (state->match_rule);
+	state->match_rule = g_strdup (match_rule);
+}
+
+/**
+ * pk_client_state_unsubscribe:
+ **/
+static void
+pk_client_state_unsubscribe (PkClientState *state)
+{
+	if (state->signal_id != 0) {
+		g_dbus_connection_signal_unsubscribe (state->client->priv->connection,
+						      state->signal_id);
+		state->signal_id = 0;
+	}
+	if (state->match_rule != NULL)
+		pk_client_state_set_match_rule (state, NULL);
+	if (state->signals != NULL) {
+		g_ptr_array_unref (state->signals);
+		state->signals = NULL;
+	}
+}
+
 /**
  * pk_client_state_finish:
  **/
@@ -669,6 +756,7 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 
 	if (state->proxy_props != NULL)
 		g_object_unref (G_OBJECT (state->proxy_props));
+	pk_client_state_unsubscribe (state);
 
 	if (state->ret) {
 		g_simple_async_result_set_op_res_gpointer (state->res,
@@ -751,22 +839,10 @@ pk_client_signal_package (PkClientState *state,
 	g_autoptr(GError) error = NULL;
 	g_autoptr(PkPackage) package = NULL;
 
-	/* create virtual package */
-	package = pk_package_new ();
-	if (!pk_package_set_id (package, package_id, &error)) {
-		g_warning ("failed to set package id for %s", package_id);
-		return;
-	}
-	g_object_set (package,
-		      "info", info_enum,
-		      "summary", summary,
-		      "role", state->role,
-		      "transaction-id", state->transaction_id,
-		      NULL);
-
-	/* add to results */
+	/* add to results, the object is created when it's asked for */
 	if (state->results != NULL && info_enum != PK_INFO_ENUM_FINISHED)
-		pk_results_add_package (state->results, package);
+		pk_results_add_package_data (state->results, info_enum,
+					     package_id, summary);
 
 	/* only emit progress for verb packages */
 	switch (info_enum) {
@@ -781,6 +857,17 @@ pk_client_signal_package (PkClientState *state,
 	case PK_INFO_ENUM_PREPARING:
 	case PK_INFO_ENUM_DECOMPRESSING:
 	case PK_INFO_ENUM_FINISHED:
+		package = pk_package_new ();
+		if (!pk_package_set_id (package, package_id, &error)) {
+			g_warning ("failed to set package id for %s", package_id);
+			return;
+		}
+		pk_package_set_info (package, info_enum);
+		pk_package_set_summary (package, summary);
+		g_object_set (package,
+			      "role", state->role,
+			      "transaction-id", state->transaction_id,
+			      NULL);
 		ret = pk_progress_set_package_id (state->progress, package_id);
 		if (state->progress_callback != NULL && ret) {
 			state->progress_callback (state->progress,
@@ -1459,26 +1546,15 @@ pk_client_set_role (PkClientState *state, PkRoleEnum role)
 }
 
 /**
- * pk_client_set_hints_cb:
+ * pk_client_get_method:
+ *
+ * Creates the results for the role and returns the name of the
+ * Transaction method that starts it, with the arguments in @parameters.
  **/
-static void
-pk_client_set_hints_cb (GObject *source_object,
-			GAsyncResult *res,
-			gpointer user_data)
+static const gchar *
+pk_client_get_method (PkClientState *state, GVariant **parameters)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
-	PkClientState *state = (PkClientState *) user_data;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(GVariant) value = NULL;
-
-	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
-	if (value == NULL) {
-		/* fix up the D-Bus error */
-		pk_client_fixup_dbus_error (error);
-		pk_client_state_finish (state, error);
-		return;
-	}
+	const gchar *method = NULL;
 
 	/* we'll have results from now on */
 	state->results = pk_results_new ();
@@ -1488,362 +1564,237 @@ pk_client_set_hints_cb (GObject *source_object,
 		      "transaction-flags", state->transaction_flags,
 		      NULL);
 
-	/* do this async, although this should be pretty fast anyway */
 	if (state->role == PK_ROLE_ENUM_RESOLVE) {
-		g_dbus_proxy_call (state->proxy, "Resolve",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "Resolve";
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->package_ids);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_NAME) {
-		g_dbus_proxy_call (state->proxy, "SearchNames",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "SearchNames";
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "SearchDetails",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "SearchDetails";
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_GROUP) {
-		g_dbus_proxy_call (state->proxy, "SearchGroups",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "SearchGroups";
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_FILE) {
-		g_dbus_proxy_call (state->proxy, "SearchFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "SearchFiles";
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
 	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "GetDetails",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetDetails";
+		*parameters = g_variant_new ("(^a&s)",
+					     state->package_ids);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetDetailsLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetDetailsLocal";
+		*parameters = g_variant_new ("(^a&s)",
+					     state->files);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_FILES_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetFilesLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetFilesLocal";
+		*parameters = g_variant_new ("(^a&s)",
+					     state->files);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_UPDATE_DETAIL) {
-		g_dbus_proxy_call (state->proxy, "GetUpdateDetail",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetUpdateDetail";
+		*parameters = g_variant_new ("(^a&s)",
+					     state->package_ids);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_OLD_TRANSACTIONS) {
-		g_dbus_proxy_call (state->proxy, "GetOldTransactions",
-				   g_variant_new ("(u)",
-						  state->number),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetOldTransactions";
+		*parameters = g_variant_new ("(u)",
+					     state->number);
 	} else if (state->role == PK_ROLE_ENUM_DOWNLOAD_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "DownloadPackages",
-				   g_variant_new ("(b^a&s)",
-						  (state->directory == NULL),
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "DownloadPackages";
+		*parameters = g_variant_new ("(b^a&s)",
+					     (state->directory == NULL),
+					     state->package_ids);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_UPDATES) {
-		g_dbus_proxy_call (state->proxy, "GetUpdates",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetUpdates";
+		*parameters = g_variant_new ("(t)",
+					     state->filters);
 	} else if (state->role == PK_ROLE_ENUM_DEPENDS_ON) {
-		g_dbus_proxy_call (state->proxy, "DependsOn",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "DependsOn";
+		*parameters = g_variant_new ("(t^a&sb)",
+					     state->filters,
+					     state->package_ids,
+					     state->recursive);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 
 	} else if (state->role == PK_ROLE_ENUM_REQUIRED_BY) {
-		g_dbus_proxy_call (state->proxy, "RequiredBy",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "RequiredBy";
+		*parameters = g_variant_new ("(t^a&sb)",
+					     state->filters,
+					     state->package_ids,
+					     state->recursive);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "GetPackages",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetPackages";
+		*parameters = g_variant_new ("(t)",
+					     state->filters);
 	} else if (state->role == PK_ROLE_ENUM_WHAT_PROVIDES) {
-		g_dbus_proxy_call (state->proxy, "WhatProvides",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "WhatProvides";
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
 	} else if (state->role == PK_ROLE_ENUM_GET_DISTRO_UPGRADES) {
-		g_dbus_proxy_call (state->proxy, "GetDistroUpgrades",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetDistroUpgrades";
+		*parameters = g_variant_new ("()");
 	} else if (state->role == PK_ROLE_ENUM_GET_FILES) {
-		g_dbus_proxy_call (state->proxy, "GetFiles",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetFiles";
+		*parameters = g_variant_new ("(^a&s)",
+					     state->package_ids);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_CATEGORIES) {
-		g_dbus_proxy_call (state->proxy, "GetCategories",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetCategories";
+		*parameters = g_variant_new ("()");
 	} else if (state->role == PK_ROLE_ENUM_REMOVE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "RemovePackages",
-				   g_variant_new ("(t^a&sbb)",
-						  state->transaction_flags,
-						  state->package_ids,
-						  state->allow_deps,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "RemovePackages";
+		*parameters = g_variant_new ("(t^a&sbb)",
+					     state->transaction_flags,
+					     state->package_ids,
+					     state->allow_deps,
+					     state->autoremove);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_REFRESH_CACHE) {
-		g_dbus_proxy_call (state->proxy, "RefreshCache",
-				   g_variant_new ("(b)",
-						  state->force),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "RefreshCache";
+		*parameters = g_variant_new ("(b)",
+					     state->force);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "InstallPackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "InstallPackages";
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->transaction_flags,
+					     state->package_ids);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_SIGNATURE) {
-		g_dbus_proxy_call (state->proxy, "InstallSignature",
-				   g_variant_new ("(uss)",
-						  state->type,
-						  state->key_id,
-						  state->package_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "InstallSignature";
+		*parameters = g_variant_new ("(uss)",
+					     state->type,
+					     state->key_id,
+					     state->package_id);
 	} else if (state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "UpdatePackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "UpdatePackages";
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->transaction_flags,
+					     state->package_ids);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_FILES) {
-		g_dbus_proxy_call (state->proxy, "InstallFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "InstallFiles";
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->transaction_flags,
+					     state->files);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_ACCEPT_EULA) {
-		g_dbus_proxy_call (state->proxy, "AcceptEula",
-				   g_variant_new ("(s)",
-						  state->eula_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "AcceptEula";
+		*parameters = g_variant_new ("(s)",
+					     state->eula_id);
 	} else if (state->role == PK_ROLE_ENUM_GET_REPO_LIST) {
-		g_dbus_proxy_call (state->proxy, "GetRepoList",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "GetRepoList";
+		*parameters = g_variant_new ("(t)",
+					     state->filters);
 	} else if (state->role == PK_ROLE_ENUM_REPO_ENABLE) {
-		g_dbus_proxy_call (state->proxy, "RepoEnable",
-				   g_variant_new ("(sb)",
-						  state->repo_id,
-						  state->enabled),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "RepoEnable";
+		*parameters = g_variant_new ("(sb)",
+					     state->repo_id,
+					     state->enabled);
 	} else if (state->role == PK_ROLE_ENUM_REPO_SET_DATA) {
-		g_dbus_proxy_call (state->proxy, "RepoSetData",
-				   g_variant_new ("(sss)",
-						  state->repo_id,
-						  state->parameter ? state->parameter : "",
-						  state->value ? state->value : ""),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "RepoSetData";
+		*parameters = g_variant_new ("(sss)",
+					     state->repo_id,
+					     state->parameter ? state->parameter : "",
+					     state->value ? state->value : "");
 	} else if (state->role == PK_ROLE_ENUM_REPO_REMOVE) {
-		g_dbus_proxy_call (state->proxy, "RepoRemove",
-				   g_variant_new ("(tsb)",
-						  state->transaction_flags,
-						  state->repo_id,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "RepoRemove";
+		*parameters = g_variant_new ("(tsb)",
+					     state->transaction_flags,
+					     state->repo_id,
+					     state->autoremove);
 	} else if (state->role == PK_ROLE_ENUM_UPGRADE_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "UpgradeSystem",
-				   g_variant_new ("(tsu)",
-						  state->transaction_flags,
-						  state->distro_id,
-						  state->upgrade_kind),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "UpgradeSystem";
+		*parameters = g_variant_new ("(tsu)",
+					     state->transaction_flags,
+					     state->distro_id,
+					     state->upgrade_kind);
 	} else if (state->role == PK_ROLE_ENUM_REPAIR_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "RepairSystem",
-				   g_variant_new ("(t)",
-						  state->transaction_flags),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		method = "RepairSystem";
+		*parameters = g_variant_new ("(t)",
+					     state->transaction_flags);
 	} else {
 		g_assert_not_reached ();
 	}
+	return method;
+}
+
+/**
+ * pk_client_set_hints_cb:
+ **/
+static void
+pk_client_set_hints_cb (GObject *source_object,
+			GAsyncResult *res,
+			gpointer user_data)
+{
+	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	PkClientState *state = (PkClientState *) user_data;
+	const gchar *method;
+	GVariant *parameters = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* get the result */
+	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (value == NULL) {
+		/* fix up the D-Bus error */
+		pk_client_fixup_dbus_error (error);
+		pk_client_state_finish (state, error);
+		return;
+	}
+
+	/* do this async, although this should be pretty fast anyway */
+	method = pk_client_get_method (state, &parameters);
+	g_dbus_proxy_call (state->proxy, method,
+			   parameters,
+			   G_DBUS_CALL_FLAGS_NONE,
+			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
+			   state->cancellable,
+			   pk_client_method_cb,
+			   state);
 }
 
 /**
@@ -1940,6 +1891,18 @@ pk_client_create_helper_argv_envp (PkClientState *state,
 	return TRUE;
 }
 
+/**
+ * pk_client_role_needs_helper:
+ **/
+static gboolean
+pk_client_role_needs_helper (PkRoleEnum role)
+{
+	return role == PK_ROLE_ENUM_INSTALL_FILES ||
+	       role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	       role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
+	       role == PK_ROLE_ENUM_UPDATE_PACKAGES;
+}
+
 /**
  * pk_client_create_helper_socket:
  **/
@@ -1990,26 +1953,14 @@ pk_client_create_helper_socket (PkClientState *state)
 }
 
 /**
- * pk_client_get_proxy_cb:
+ * pk_client_get_hints:
  **/
-static void
-pk_client_get_proxy_cb (GObject *object,
-			GAsyncResult *res,
-			gpointer user_data)
+static GPtrArray *
+pk_client_get_hints (PkClientState *state)
 {
 	gchar *hint;
-	PkClientState *state = (PkClientState *) user_data;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(GPtrArray) array = NULL;
-
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL)
-		g_error ("Cannot connect to PackageKit on %s", state->tid);
-
-	/* connect */
-	pk_client_proxy_connect (state);
+	GPtrArray *array;
 
-	/* get hints */
 	array = g_ptr_array_new_with_free_func (g_free);
 
 	/* locale */
@@ -2036,17 +1987,37 @@ pk_client_get_proxy_cb (GObject *object,
 	}
 
 	/* create socket for roles that need interaction */
-	if (state->role == PK_ROLE_ENUM_INSTALL_FILES ||
-	    state->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
-	    state->role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
-	    state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
+	if (pk_client_role_needs_helper (state->role)) {
 		hint = pk_client_create_helper_socket (state);
 		if (hint != NULL)
 			g_ptr_array_add (array, hint);
 	}
 
-	/* set hints */
 	g_ptr_array_add (array, NULL);
+	return array;
+}
+
+/**
+ * pk_client_get_proxy_cb:
+ **/
+static void
+pk_client_get_proxy_cb (GObject *object,
+			GAsyncResult *res,
+			gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL)
+		g_error ("Cannot connect to PackageKit on %s", state->tid);
+
+	/* connect */
+	pk_client_proxy_connect (state);
+
+	/* set hints */
+	array = pk_client_get_hints (state);
 	g_dbus_proxy_call (state->proxy, "SetHints",
 			   g_variant_new ("(^a&s)",
 					  array->pdata),
@@ -2089,6 +2060,246 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 				  state);
 }
 
+/**
+ * pk_client_transaction_signal:
+ **/
+static void
+pk_client_transaction_signal (PkClientState *state,
+			      const gchar *interface_name,
+			      const gchar *signal_name,
+			      GVariant *parameters)
+{
+	/* property changes are not cached on a proxy, so apply them now */
+	if (g_strcmp0 (interface_name, "org.freedesktop.DBus.Properties") == 0) {
+		const gchar *interface_changed;
+		g_autoptr(GVariant) changed = NULL;
+		if (g_strcmp0 (signal_name, "PropertiesChanged") != 0)
+			return;
+		g_variant_get (parameters, "(&s@a{sv}@as)",
+			       &interface_changed, &changed, NULL);
+		if (g_strcmp0 (interface_changed, PK_DBUS_INTERFACE_TRANSACTION) != 0)
+			return;
+		pk_client_properties_changed_cb (NULL, changed, NULL, state);
+		return;
+	}
+	if (g_strcmp0 (interface_name, PK_DBUS_INTERFACE_TRANSACTION) == 0)
+		pk_client_signal_cb (NULL, NULL, signal_name, parameters, state);
+}
+
+/**
+ * pk_client_transaction_signal_cb:
+ **/
+static void
+pk_client_transaction_signal_cb (GDBusConnection *connection,
+				 const gchar *sender_name,
+				 const gchar *object_path,
+				 const gchar *interface_name,
+				 const gchar *signal_name,
+				 GVariant *parameters,
+				 gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+
+	/* the daemon can emit before StartTransaction() has returned */
+	if (state->tid == NULL) {
+		g_ptr_array_add (state->signals,
+				 g_variant_ref_sink (g_variant_new ("(sss@*)",
+								    object_path,
+								    interface_name,
+								    signal_name,
+								    parameters)));
+		return;
+	}
+	if (g_strcmp0 (object_path, state->tid) != 0)
+		return;
+	pk_client_transaction_signal (state, interface_name, signal_name, parameters);
+}
+
+/**
+ * pk_client_start_transaction_cb:
+ **/
+static void
+pk_client_start_transaction_cb (GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	PkClientState *state = (PkClientState *) user_data;
+	guint i;
+	g_autofree gchar *rule = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) signals = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* get the result */
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		/* an older daemon, so do it the long way */
+		if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD)) {
+			g_debug ("no StartTransaction(), falling back: %s", error->message);
+			state->client->priv->no_start_transaction = TRUE;
+			pk_client_state_unsubscribe (state);
+			pk_client_state_remove (state->client, state);
+			g_clear_object (&state->results);
+			pk_control_get_tid_async (state->client->priv->control,
+						  state->cancellable_client,
+						  (GAsyncReadyCallback) pk_client_get_tid_cb,
+						  state);
+			return;
+		}
+
+		/* fix up the D-Bus error */
+		pk_client_fixup_dbus_error (error);
+		pk_client_state_finish (state, error);
+		return;
+	}
+	g_variant_get (value, "(o)", &state->tid);
+	pk_progress_set_transaction_id (state->progress, state->tid);
+
+	/* only this transaction is interesting from now on */
+	rule = g_strdup_printf ("type='signal',sender='%s',path='%s'",
+				PK_DBUS_SERVICE, state->tid);
+	pk_client_state_set_match_rule (state, rule);
+
+	/* replay anything that arrived before we knew our path */
+	signals = state->signals;
+	state->signals = NULL;
+	for (i = 0; i < signals->len; i++) {
+		const gchar *object_path;
+		const gchar *interface_name;
+		const gchar *signal_name;
+		g_autoptr(GVariant) parameters = NULL;
+
+		g_variant_get (g_ptr_array_index (signals, i), "(&s&s&s@*)",
+			       &object_path, &interface_name,
+			       &signal_name, &parameters);
+		if (g_strcmp0 (object_path, state->tid) != 0)
+			continue;
+		pk_client_transaction_signal (state, interface_name,
+					      signal_name, parameters);
+
+		/* state may be gone */
+		if (g_strcmp0 (interface_name, PK_DBUS_INTERFACE_TRANSACTION) == 0 &&
+		    g_strcmp0 (signal_name, "Finished") == 0)
+			return;
+	}
+
+	/* the client cancelled before we had something to cancel */
+	if (state->cancellable_client != NULL &&
+	    g_cancellable_is_cancelled (state->cancellable_client))
+		pk_client_cancellable_cancel_cb (state->cancellable_client, state);
+}
+
+/**
+ * pk_client_start_transaction:
+ **/
+static void
+pk_client_start_transaction (PkClientState *state)
+{
+	const gchar *method;
+	GDBusConnection *connection = state->client->priv->connection;
+	GVariant *parameters = NULL;
+	g_autoptr(GPtrArray) hints = NULL;
+
+	/* subscribe first, as the transaction starts as soon as it exists;
+	 * the path is not known yet, so the bus match rule is narrowed to
+	 * it in pk_client_start_transaction_cb() */
+	state->signals = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+	state->signal_id = g_dbus_connection_signal_subscribe (connection,
+							       PK_DBUS_SERVICE,
+							       NULL,
+							       NULL,
+							       NULL,
+							       NULL,
+							       G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE,
+							       pk_client_transaction_signal_cb,
+							       state,
+							       NULL);
+	pk_client_state_set_match_rule (state, "type='signal',sender='" PK_DBUS_SERVICE "'");
+
+	/* create, set hints and start the role in one call */
+	hints = pk_client_get_hints (state);
+	method = pk_client_get_method (state, &parameters);
+	g_dbus_connection_call (connection,
+				PK_DBUS_SERVICE,
+				PK_DBUS_PATH,
+				PK_DBUS_INTERFACE,
+				"StartTransaction",
+				g_variant_new ("(^a&ssv)",
+					       hints->pdata,
+					       method,
+					       parameters),
+				G_VARIANT_TYPE ("(o)"),
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				state->cancellable,
+				pk_client_start_transaction_cb,
+				state);
+
+	/* track state */
+	pk_client_state_add (state->client, state);
+}
+
+/**
+ * pk_client_bus_get_cb:
+ **/
+static void
+pk_client_bus_get_cb (GObject *source_object,
+		      GAsyncResult *res,
+		      gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+	PkClientPrivate *priv = state->client->priv;
+	GDBusConnection *connection;
+	g_autoptr(GError) error = NULL;
+
+	connection = g_bus_get_finish (res, &error);
+	if (connection == NULL) {
+		pk_client_state_finish (state, error);
+		return;
+	}
+
+	/* another call may have got there first */
+	if (priv->connection == NULL)
+		priv->connection = connection;
+	else
+		g_object_unref (connection);
+	pk_client_start_transaction (state);
+}
+
+/**
+ * pk_client_create_transaction:
+ *
+ * Creates the transaction for the state and starts the role, using a
+ * single StartTransaction() round-trip where the daemon supports it.
+ **/
+static void
+pk_client_create_transaction (PkClientState *state)
+{
+	PkClientPrivate *priv = state->client->priv;
+
+	/* the helper socket is named after the transaction ID, so
+	 * interactive roles have to get it before setting the hints */
+	if (priv->no_start_transaction ||
+	    pk_client_role_needs_helper (state->role)) {
+		pk_control_get_tid_async (priv->control,
+					  state->cancellable_client,
+					  (GAsyncReadyCallback) pk_client_get_tid_cb,
+					  state);
+		return;
+	}
+
+	/* signals are matched on the connection rather than on a proxy */
+	if (priv->connection == NULL) {
+		g_bus_get (G_BUS_TYPE_SYSTEM,
+			   state->cancellable,
+			   pk_client_bus_get_cb,
+			   state);
+		return;
+	}
+	pk_client_start_transaction (state);
+}
+
 /**
  * pk_client_generic_finish:
  * @client: a valid #PkClient instance
@@ -2178,11 +2389,8 @@ pk_client_resolve_async (PkClient *client, PkBitfield filters, gchar **packages,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2245,11 +2453,8 @@ pk_client_search_names_async (PkClient *client, PkBitfield filters, gchar **valu
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2313,11 +2518,8 @@ pk_client_search_details_async (PkClient *client, PkBitfield filters, gchar **va
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2379,11 +2581,8 @@ pk_client_search_groups_async (PkClient *client, PkBitfield filters, gchar **val
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2445,11 +2644,8 @@ pk_client_search_files_async (PkClient *client, PkBitfield filters, gchar **valu
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2511,11 +2707,8 @@ pk_client_get_details_async (PkClient *client, gchar **package_ids, GCancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2581,11 +2774,8 @@ pk_client_get_details_local_async (PkClient *client, gchar **files, GCancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2651,11 +2841,8 @@ pk_client_get_files_local_async (PkClient *client, gchar **files, GCancellable *
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2717,11 +2904,8 @@ pk_client_get_update_detail_async (PkClient *client, gchar **package_ids, GCance
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2784,11 +2968,8 @@ pk_client_download_packages_async (PkClient *client, gchar **package_ids, const
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2848,11 +3029,8 @@ pk_client_get_updates_async (PkClient *client, PkBitfield filters, GCancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2912,11 +3090,8 @@ pk_client_get_old_transactions_async (PkClient *client, guint number, GCancellab
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -2981,11 +3156,8 @@ pk_client_depends_on_async (PkClient *client, PkBitfield filters, gchar **packag
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3045,11 +3217,8 @@ pk_client_get_packages_async (PkClient *client, PkBitfield filters, GCancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3114,11 +3283,8 @@ pk_client_required_by_async (PkClient *client, PkBitfield filters, gchar **packa
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3185,11 +3351,8 @@ pk_client_what_provides_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3248,11 +3411,8 @@ pk_client_get_distro_upgrades_async (PkClient *client, GCancellable *cancellable
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3313,11 +3473,8 @@ pk_client_get_files_async (PkClient *client, gchar **package_ids, GCancellable *
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3375,11 +3532,8 @@ pk_client_get_categories_async (PkClient *client, GCancellable *cancellable,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3455,11 +3609,8 @@ pk_client_remove_packages_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3522,11 +3673,8 @@ pk_client_refresh_cache_async (PkClient *client, gboolean force, GCancellable *c
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3589,11 +3737,8 @@ pk_client_install_packages_async (PkClient *client, PkBitfield transaction_flags
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3657,11 +3802,8 @@ pk_client_install_signature_async (PkClient *client, PkSigTypeEnum type, const g
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3729,11 +3871,8 @@ pk_client_update_packages_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -3964,11 +4103,8 @@ pk_client_accept_eula_async (PkClient *client, const gchar *eula_id, GCancellabl
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -4028,11 +4164,8 @@ pk_client_get_repo_list_async (PkClient *client, PkBitfield filters, GCancellabl
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -4094,11 +4227,8 @@ pk_client_repo_enable_async (PkClient *client, const gchar *repo_id, gboolean en
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -4163,11 +4293,8 @@ pk_client_repo_set_data_async (PkClient *client, const gchar *repo_id, const gch
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -4237,11 +4364,8 @@ pk_client_repo_remove_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -4312,11 +4436,8 @@ pk_client_upgrade_system_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**
@@ -4380,8 +4501,8 @@ pk_client_repair_system_async (PkClient *client,
 	/* identify */
 	pk_client_set_role (state, state->role);
 
-	/* get tid */
-	pk_control_get_tid_async (client->priv->control, cancellable, (GAsyncReadyCallback) pk_client_get_tid_cb, state);
+	/* create the transaction */
+	pk_client_create_transaction (state);
 }
 
 /**********************************************************************/
@@ -4942,6 +5063,8 @@ pk_client_finalize (GObject *object)
 	g_free (client->priv->locale);
 	g_object_unref (priv->control);
 	g_ptr_array_unref (priv->calls);
+	if (priv->connection != NULL)
+		g_object_unref (priv->connection);
 
 	G_OBJECT_CLASS (pk_client_parent_class)->finalize (object);
 }
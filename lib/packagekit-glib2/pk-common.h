@@ -67,6 +67,15 @@ G_BEGIN_DECLS
  */
 #define	PK_DBUS_INTERFACE_OFFLINE	"org.freedesktop.PackageKit.Offline"
 
+/**
+ * PK_DBUS_INTERFACE_DEBUG:
+ *
+ * The DBUS interface for daemon instrumentation
+ *
+ * Since: 1.1.5
+ */
+#define	PK_DBUS_INTERFACE_DEBUG		"org.freedesktop.PackageKit.Debug"
+
 /**
  * PK_PACKAGE_LIST_FILENAME:
  *
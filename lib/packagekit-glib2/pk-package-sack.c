@@ -52,8 +52,10 @@ static void     pk_package_sack_finalize	(GObject     *object);
 struct _PkPackageSackPrivate
 {
 	GHashTable		*table;
+	GHashTable		*name_arch_table;	/* "name;arch" : GPtrArray */
 	GPtrArray		*array;
 	PkClient		*client;
+	guint			 chunks;
 };
 
 enum {
@@ -61,8 +63,74 @@ enum {
 	SIGNAL_LAST
 };
 
+static guint signals [SIGNAL_LAST] = { 0 };
+
 G_DEFINE_TYPE (PkPackageSack, pk_package_sack, G_TYPE_OBJECT)
 
+/**
+ * pk_package_sack_name_arch_key:
+ **/
+static gchar *
+pk_package_sack_name_arch_key (const gchar *name, const gchar *arch)
+{
+	return g_strconcat (name, ";", arch, NULL);
+}
+
+/**
+ * pk_package_sack_index_add:
+ **/
+static void
+pk_package_sack_index_add (PkPackageSack *sack, PkPackage *package)
+{
+	GPtrArray *packages;
+	gchar *key;
+
+	key = pk_package_sack_name_arch_key (pk_package_get_name (package),
+					     pk_package_get_arch (package));
+	packages = g_hash_table_lookup (sack->priv->name_arch_table, key);
+	if (packages == NULL) {
+		packages = g_ptr_array_new ();
+		g_hash_table_insert (sack->priv->name_arch_table, key, packages);
+	} else {
+		g_free (key);
+	}
+	g_ptr_array_add (packages, package);
+}
+
+/**
+ * pk_package_sack_index_remove:
+ **/
+static void
+pk_package_sack_index_remove (PkPackageSack *sack, PkPackage *package)
+{
+	GPtrArray *packages;
+	g_autofree gchar *key = NULL;
+
+	key = pk_package_sack_name_arch_key (pk_package_get_name (package),
+					     pk_package_get_arch (package));
+	packages = g_hash_table_lookup (sack->priv->name_arch_table, key);
+	if (packages == NULL)
+		return;
+	g_ptr_array_remove (packages, package);
+	if (packages->len == 0)
+		g_hash_table_remove (sack->priv->name_arch_table, key);
+}
+
+/**
+ * pk_package_sack_index_rebuild:
+ *
+ * The index keeps packages in array order, so this is needed after sorting.
+ **/
+static void
+pk_package_sack_index_rebuild (PkPackageSack *sack)
+{
+	guint i;
+
+	g_hash_table_remove_all (sack->priv->name_arch_table);
+	for (i = 0; i < sack->priv->array->len; i++)
+		pk_package_sack_index_add (sack, g_ptr_array_index (sack->priv->array, i));
+}
+
 /**
  * pk_package_sack_clear:
  * @sack: a valid #PkPackageSack instance
@@ -78,6 +146,7 @@ pk_package_sack_clear (PkPackageSack *sack)
 
 	g_ptr_array_set_size (sack->priv->array, 0);
 	g_hash_table_remove_all (sack->priv->table);
+	g_hash_table_remove_all (sack->priv->name_arch_table);
 }
 
 /**
@@ -240,6 +309,7 @@ pk_package_sack_add_package (PkPackageSack *sack, PkPackage *package)
 	g_hash_table_insert (sack->priv->table,
 			     (gpointer) pk_package_get_id (package),
 			     (gpointer) package);
+	pk_package_sack_index_add (sack, package);
 
 	return TRUE;
 }
@@ -416,6 +486,7 @@ pk_package_sack_remove_package (PkPackageSack *sack, PkPackage *package)
 
 	/* remove from array */
 	g_hash_table_remove (sack->priv->table, pk_package_get_id (package));
+	pk_package_sack_index_remove (sack, package);
 	return g_ptr_array_remove (sack->priv->array, package);
 }
 
@@ -520,6 +591,27 @@ pk_package_sack_find_by_id (PkPackageSack *sack, const gchar *package_id)
 	return package;
 }
 
+/**
+ * pk_package_sack_lookup_name_arch:
+ **/
+static PkPackage *
+pk_package_sack_lookup_name_arch (PkPackageSack *sack, const gchar *package_id)
+{
+	GPtrArray *packages;
+	g_autofree gchar *key = NULL;
+	g_auto(GStrv) split = NULL;
+
+	split = pk_package_id_split (package_id);
+	if (split == NULL)
+		return NULL;
+	key = pk_package_sack_name_arch_key (split[PK_PACKAGE_ID_NAME],
+					     split[PK_PACKAGE_ID_ARCH]);
+	packages = g_hash_table_lookup (sack->priv->name_arch_table, key);
+	if (packages == NULL)
+		return NULL;
+	return g_ptr_array_index (packages, 0);
+}
+
 /**
  * pk_package_sack_find_by_id_name_arch:
  * @sack: a valid #PkPackageSack instance
@@ -535,29 +627,127 @@ pk_package_sack_find_by_id (PkPackageSack *sack, const gchar *package_id)
 PkPackage *
 pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_id)
 {
-	PkPackage *pkg_tmp;
-	guint i;
-	g_auto(GStrv) split = NULL;
+	PkPackage *package;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 	g_return_val_if_fail (package_id != NULL, NULL);
 
 	/* does the package name feature in the array */
+	package = pk_package_sack_lookup_name_arch (sack, package_id);
+	if (package == NULL)
+		return NULL;
+	return g_object_ref (package);
+}
+
+/**
+ * pk_package_sack_lookup_for_merge:
+ *
+ * The daemon may return a different package-id to the one asked for, for
+ * instance with the data part set to "installed", so fall back to the
+ * name, version and architecture. No reference is taken.
+ **/
+static PkPackage *
+pk_package_sack_lookup_for_merge (PkPackageSack *sack, const gchar *package_id)
+{
+	GPtrArray *packages;
+	PkPackage *package;
+	guint i;
+	g_autofree gchar *key = NULL;
+	g_auto(GStrv) split = NULL;
+
+	package = g_hash_table_lookup (sack->priv->table, package_id);
+	if (package != NULL)
+		return package;
+
+	/* only the data part may differ */
 	split = pk_package_id_split (package_id);
 	if (split == NULL)
 		return NULL;
-	for (i = 0; i < sack->priv->array->len; i++) {
-		pkg_tmp = g_ptr_array_index (sack->priv->array, i);
-		if (g_strcmp0 (pk_package_get_name (pkg_tmp),
-			       split[PK_PACKAGE_ID_NAME]) == 0 &&
-		    g_strcmp0 (pk_package_get_arch (pkg_tmp),
-			       split[PK_PACKAGE_ID_ARCH]) == 0) {
-			return g_object_ref (pkg_tmp);
-		}
+	key = pk_package_sack_name_arch_key (split[PK_PACKAGE_ID_NAME],
+					     split[PK_PACKAGE_ID_ARCH]);
+	packages = g_hash_table_lookup (sack->priv->name_arch_table, key);
+	if (packages == NULL)
+		return NULL;
+	for (i = 0; i < packages->len; i++) {
+		package = g_ptr_array_index (packages, i);
+		if (g_strcmp0 (pk_package_get_version (package),
+			       split[PK_PACKAGE_ID_VERSION]) == 0)
+			return package;
 	}
 	return NULL;
 }
 
+/**
+ * pk_package_sack_merge_results:
+ * @sack: a valid #PkPackageSack instance
+ * @results: a #PkResults, e.g. from Resolve() or GetDetails()
+ *
+ * Merges the packages, details and update details in @results into the
+ * matching packages in the sack. The data is copied directly rather than
+ * as properties, and ::changed is emitted once at the end.
+ *
+ * Return value: the number of items that matched a package in the sack
+ *
+ * Since: 1.1.5
+ **/
+guint
+pk_package_sack_merge_results (PkPackageSack *sack, PkResults *results)
+{
+	guint i;
+	guint merged = 0;
+	PkPackage *package;
+	g_autoptr(GPtrArray) details = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GPtrArray) update_details = NULL;
+
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), 0);
+	g_return_val_if_fail (PK_IS_RESULTS (results), 0);
+
+	/* Resolve() */
+	packages = pk_results_get_package_array (results);
+	for (i = 0; i < packages->len; i++) {
+		PkPackage *item = g_ptr_array_index (packages, i);
+		package = pk_package_sack_lookup_for_merge (sack, pk_package_get_id (item));
+		if (package == NULL) {
+			g_warning ("failed to find %s", pk_package_get_id (item));
+			continue;
+		}
+		pk_package_set_info (package, pk_package_get_info (item));
+		pk_package_set_summary (package, pk_package_get_summary (item));
+		merged++;
+	}
+
+	/* GetDetails() */
+	details = pk_results_get_details_array (results);
+	for (i = 0; i < details->len; i++) {
+		PkDetails *item = g_ptr_array_index (details, i);
+		package = pk_package_sack_lookup_for_merge (sack, pk_details_get_package_id (item));
+		if (package == NULL) {
+			g_warning ("failed to find %s", pk_details_get_package_id (item));
+			continue;
+		}
+		pk_package_set_details (package, item);
+		merged++;
+	}
+
+	/* GetUpdateDetail() */
+	update_details = pk_results_get_update_detail_array (results);
+	for (i = 0; i < update_details->len; i++) {
+		PkUpdateDetail *item = g_ptr_array_index (update_details, i);
+		package = pk_package_sack_lookup_for_merge (sack, pk_update_detail_get_package_id (item));
+		if (package == NULL) {
+			g_warning ("failed to find %s", pk_update_detail_get_package_id (item));
+			continue;
+		}
+		pk_package_set_update_detail (package, item);
+		merged++;
+	}
+
+	if (merged > 0)
+		g_signal_emit (sack, signals [SIGNAL_CHANGED], 0);
+	return merged;
+}
+
 /**
  * pk_package_sack_sort_compare_name_func:
  **/
@@ -640,6 +830,7 @@ pk_package_sack_sort (PkPackageSack *sack, PkPackageSackSortType type)
 		g_ptr_array_sort (sack->priv->array, (GCompareFunc) pk_package_sack_sort_compare_summary_func);
 	else if (type == PK_PACKAGE_SACK_SORT_TYPE_INFO)
 		g_ptr_array_sort (sack->priv->array, (GCompareFunc) pk_package_sack_sort_compare_info_func);
+	pk_package_sack_index_rebuild (sack);
 }
 
 /**
@@ -699,11 +890,88 @@ pk_package_sack_get_package_ids (PkPackageSack *sack)
 	return package_ids;
 }
 
+/**
+ * pk_package_sack_get_package_id_chunks:
+ *
+ * Splits the package IDs in the sack into at most sack->priv->chunks
+ * evenly sized arrays, never returning an empty chunk unless the sack
+ * itself is empty.
+ **/
+static GPtrArray *
+pk_package_sack_get_package_id_chunks (PkPackageSack *sack)
+{
+	GPtrArray *chunks;
+	const GPtrArray *array = sack->priv->array;
+	PkPackage *package;
+	gchar **package_ids;
+	guint n_chunks;
+	guint start;
+	guint end;
+	guint i, j;
+
+	n_chunks = MIN (sack->priv->chunks, array->len);
+	if (n_chunks == 0)
+		n_chunks = 1;
+
+	chunks = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
+	for (i = 0; i < n_chunks; i++) {
+		start = i * array->len / n_chunks;
+		end = (i + 1) * array->len / n_chunks;
+		package_ids = g_new0 (gchar *, end - start + 1);
+		for (j = start; j < end; j++) {
+			package = g_ptr_array_index (array, j);
+			package_ids[j - start] = g_strdup (pk_package_get_id (package));
+		}
+		g_ptr_array_add (chunks, package_ids);
+	}
+	return chunks;
+}
+
+/**
+ * pk_package_sack_set_chunks:
+ * @sack: a valid #PkPackageSack instance
+ * @chunks: the maximum number of transactions to use, or 0 for the default
+ *
+ * Sets how many transactions pk_package_sack_get_details_async() and
+ * pk_package_sack_get_update_detail_async() split the sack into.
+ * The transactions are all queued at once, so backends that support
+ * parallelization run them concurrently and the results of each one
+ * are merged into the sack as soon as it finishes.
+ *
+ * Since: 1.1.5
+ **/
+void
+pk_package_sack_set_chunks (PkPackageSack *sack, guint chunks)
+{
+	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	sack->priv->chunks = MAX (chunks, 1);
+}
+
+/**
+ * pk_package_sack_get_chunks:
+ * @sack: a valid #PkPackageSack instance
+ *
+ * Gets the number of transactions the sack is split into when merging.
+ *
+ * Return value: the maximum number of transactions, normally 1
+ *
+ * Since: 1.1.5
+ **/
+guint
+pk_package_sack_get_chunks (PkPackageSack *sack)
+{
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), 0);
+	return sack->priv->chunks;
+}
+
 typedef struct {
 	PkPackageSack		*sack;
 	GCancellable		*cancellable;
 	gboolean		 ret;
 	GSimpleAsyncResult	*res;
+	guint			 pending;
+	guint			 found;
+	GError			*error;
 } PkPackageSackState;
 
 /***************************************************************************************************/
@@ -727,11 +995,57 @@ pk_package_sack_merge_bool_state_finish (PkPackageSackState *state, const GError
 	/* deallocate */
 	if (state->cancellable != NULL)
 		g_object_unref (state->cancellable);
+	if (state->error != NULL)
+		g_error_free (state->error);
 	g_object_unref (state->res);
 	g_object_unref (state->sack);
 	g_slice_free (PkPackageSackState, state);
 }
 
+/**
+ * pk_package_sack_merge_chunk_finish:
+ *
+ * Called once for every chunk transaction; the async result is only
+ * completed when the last outstanding chunk has returned.
+ **/
+static void
+pk_package_sack_merge_chunk_finish (PkPackageSackState *state,
+				    PkResults *results,
+				    guint found,
+				    const GError *error,
+				    const gchar *empty_message)
+{
+	g_autoptr(GError) error_local = NULL;
+
+	/* merge as soon as each chunk arrives */
+	if (results != NULL && found > 0) {
+		pk_package_sack_merge_results (state->sack, results);
+		state->found += found;
+	}
+
+	/* save the first failure */
+	if (error != NULL && state->error == NULL)
+		state->error = g_error_copy (error);
+
+	/* still waiting for other chunks */
+	if (--state->pending > 0)
+		return;
+
+	if (state->error != NULL) {
+		pk_package_sack_merge_bool_state_finish (state, state->error);
+		return;
+	}
+	if (state->found == 0) {
+		error_local = g_error_new (1, 0, "%s", empty_message);
+		pk_package_sack_merge_bool_state_finish (state, error_local);
+		return;
+	}
+
+	/* all okay */
+	state->ret = TRUE;
+	pk_package_sack_merge_bool_state_finish (state, NULL);
+}
+
 /**
  * pk_package_sack_resolve_cb:
  **/
@@ -739,10 +1053,6 @@ static void
 pk_package_sack_resolve_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
 {
 	PkClient *client = PK_CLIENT (source_object);
-	PkPackage *item;
-	guint i;
-	PkPackage *package;
-	const gchar *package_id;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(PkResults) results = NULL;
 	g_autoptr(GPtrArray) packages = NULL;
@@ -765,22 +1075,7 @@ pk_package_sack_resolve_cb (GObject *source_object, GAsyncResult *res, PkPackage
 	}
 
 	/* set data on each item */
-	for (i = 0; i < packages->len; i++) {
-		item = g_ptr_array_index (packages, i);
-		package_id = pk_package_get_id (item);
-		package = pk_package_sack_find_by_id (state->sack, package_id);
-		if (package == NULL) {
-			g_warning ("failed to find %s", package_id);
-			continue;
-		}
-
-		/* set data */
-		g_object_set (package,
-			      "info", pk_package_get_info (item),
-			      "summary", pk_package_get_summary (item),
-			      NULL);
-		g_object_unref (package);
-	}
+	pk_package_sack_merge_results (state->sack, results);
 
 	/* all okay */
 	state->ret = TRUE;
@@ -870,9 +1165,6 @@ static void
 pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
 {
 	PkClient *client = PK_CLIENT (source_object);
-	PkDetails *item;
-	guint i;
-	PkPackage *package;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(PkResults) results = NULL;
 	g_autoptr(GPtrArray) details = NULL;
@@ -881,49 +1173,15 @@ pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPac
 	results = pk_client_generic_finish (client, res, &error);
 	if (results == NULL) {
 		g_warning ("failed to details: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
-	/* get the details */
-	details = pk_results_get_details_array (results);
-	if (details->len == 0) {
-		error = g_error_new (1, 0, "no details found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
+		pk_package_sack_merge_chunk_finish (state, NULL, 0, error,
+						    "no details found!");
 		return;
 	}
 
 	/* set data on each item */
-	for (i = 0; i < details->len; i++) {
-		g_autofree gchar *package_id = NULL;
-		item = g_ptr_array_index (details, i);
-		g_object_get (item,
-			      "package-id", &package_id,
-			      NULL);
-
-		/* get package, and set data */
-		package = pk_package_sack_find_by_id (state->sack, package_id);
-		if (package == NULL) {
-			g_warning ("failed to find %s", package_id);
-			continue;
-		}
-
-		/* set data */
-		g_object_set (package,
-			      "license", pk_details_get_license (item),
-			      "group", pk_details_get_group (item),
-			      "description", pk_details_get_description (item),
-			      "url", pk_details_get_url (item),
-			      "size", pk_details_get_size (item),
-			      NULL);
-		g_object_unref (package);
-	}
-
-	/* all okay */
-	state->ret = TRUE;
-
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+	details = pk_results_get_details_array (results);
+	pk_package_sack_merge_chunk_finish (state, results, details->len, NULL,
+					    "no details found!");
 }
 
 /**
@@ -944,7 +1202,9 @@ pk_package_sack_get_details_async (PkPackageSack *sack, GCancellable *cancellabl
 {
 	PkPackageSackState *state;
 	g_autoptr(GSimpleAsyncResult) res = NULL;
-	g_auto(GStrv) package_ids = NULL;
+	gchar **package_ids;
+	guint i;
+	g_autoptr(GPtrArray) chunks = NULL;
 
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 	g_return_if_fail (callback != NULL);
@@ -959,11 +1219,15 @@ pk_package_sack_get_details_async (PkPackageSack *sack, GCancellable *cancellabl
 		state->cancellable = g_object_ref (cancellable);
 	state->ret = FALSE;
 
-	/* start details async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_get_details_async (sack->priv->client, package_ids,
-				     cancellable, progress_callback, progress_user_data,
-				     (GAsyncReadyCallback) pk_package_sack_get_details_cb, state);
+	/* start one details transaction per chunk */
+	chunks = pk_package_sack_get_package_id_chunks (sack);
+	state->pending = chunks->len;
+	for (i = 0; i < chunks->len; i++) {
+		package_ids = g_ptr_array_index (chunks, i);
+		pk_client_get_details_async (sack->priv->client, package_ids,
+					     cancellable, progress_callback, progress_user_data,
+					     (GAsyncReadyCallback) pk_package_sack_get_details_cb, state);
+	}
 }
 
 /***************************************************************************************************/
@@ -975,9 +1239,6 @@ static void
 pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res, PkPackageSackState *state)
 {
 	PkClient *client = PK_CLIENT (source_object);
-	PkUpdateDetail *item;
-	guint i;
-	PkPackage *package;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(PkResults) results = NULL;
 	g_autoptr(GPtrArray) update_details = NULL;
@@ -986,78 +1247,15 @@ pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res,
 	results = pk_client_generic_finish (client, res, &error);
 	if (results == NULL) {
 		g_warning ("failed to update_detail: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
-
-	/* get the update_details */
-	update_details = pk_results_get_update_detail_array (results);
-	if (update_details->len == 0) {
-		error = g_error_new (1, 0, "no update details found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
+		pk_package_sack_merge_chunk_finish (state, NULL, 0, error,
+						    "no update details found!");
 		return;
 	}
 
 	/* set data on each item */
-	for (i = 0; i < update_details->len; i++) {
-		PkRestartEnum restart;
-		PkUpdateStateEnum state_enum;
-		g_autofree gchar *changelog = NULL;
-		g_autofree gchar *issued = NULL;
-		g_autofree gchar *obsoletes = NULL;
-		g_autofree gchar *package_id = NULL;
-		g_autofree gchar *updated = NULL;
-		g_autofree gchar *updates = NULL;
-		g_autofree gchar *update_text = NULL;
-		g_auto(GStrv) bugzilla_urls = NULL;
-		g_auto(GStrv) cve_urls = NULL;
-		g_auto(GStrv) vendor_urls = NULL;
-
-		item = g_ptr_array_index (update_details, i);
-		g_object_get (item,
-			      "package-id", &package_id,
-			      "updates", &updates,
-			      "obsoletes", &obsoletes,
-			      "vendor-urls", &vendor_urls,
-			      "bugzilla-urls", &bugzilla_urls,
-			      "cve-urls", &cve_urls,
-			      "restart", &restart,
-			      "update-text", &update_text,
-			      "changelog", &changelog,
-			      "state", &state_enum,
-			      "issued", &issued,
-			      "updated", &updated,
-			      NULL);
-
-		/* get package, and set data */
-		package = pk_package_sack_find_by_id (state->sack, package_id);
-		if (package == NULL) {
-			g_warning ("failed to find %s", package_id);
-			continue;
-		}
-
-		/* set data */
-		g_object_set (package,
-			      "update-updates", updates,
-			      "update-obsoletes", obsoletes,
-			      "update-vendor-urls", vendor_urls,
-			      "update-bugzilla-urls", bugzilla_urls,
-			      "update-cve-urls", cve_urls,
-			      "update-restart", restart,
-			      "update-text", update_text,
-			      "update-changelog", changelog,
-			      "update-state", state_enum,
-			      "update-issued", issued,
-			      "update-updated", updated,
-			      NULL);
-		g_object_unref (package);
-	}
-
-	/* all okay */
-	state->ret = TRUE;
-
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+	update_details = pk_results_get_update_detail_array (results);
+	pk_package_sack_merge_chunk_finish (state, results, update_details->len, NULL,
+					    "no update details found!");
 }
 
 /**
@@ -1080,7 +1278,9 @@ pk_package_sack_get_update_detail_async (PkPackageSack *sack, GCancellable *canc
 {
 	PkPackageSackState *state;
 	g_autoptr(GSimpleAsyncResult) res = NULL;
-	g_auto(GStrv) package_ids = NULL;
+	gchar **package_ids;
+	guint i;
+	g_autoptr(GPtrArray) chunks = NULL;
 
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 	g_return_if_fail (callback != NULL);
@@ -1095,11 +1295,15 @@ pk_package_sack_get_update_detail_async (PkPackageSack *sack, GCancellable *canc
 		state->cancellable = g_object_ref (cancellable);
 	state->ret = FALSE;
 
-	/* start update_detail async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_get_update_detail_async (sack->priv->client, package_ids,
-					   cancellable, progress_callback, progress_user_data,
-					   (GAsyncReadyCallback) pk_package_sack_get_update_detail_cb, state);
+	/* start one update_detail transaction per chunk */
+	chunks = pk_package_sack_get_package_id_chunks (sack);
+	state->pending = chunks->len;
+	for (i = 0; i < chunks->len; i++) {
+		package_ids = g_ptr_array_index (chunks, i);
+		pk_client_get_update_detail_async (sack->priv->client, package_ids,
+						   cancellable, progress_callback, progress_user_data,
+						   (GAsyncReadyCallback) pk_package_sack_get_update_detail_cb, state);
+	}
 }
 
 /***************************************************************************************************/
@@ -1113,7 +1317,6 @@ pk_package_sack_class_init (PkPackageSackClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	object_class->finalize = pk_package_sack_finalize;
 
-#if 0
 	/**
 	 * PkPackageSack::changed:
 	 * @sack: the #PkPackageSack instance that emitted the signal
@@ -1123,10 +1326,9 @@ pk_package_sack_class_init (PkPackageSackClass *klass)
 	signals [SIGNAL_CHANGED] =
 		g_signal_new ("changed",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
-			      G_STRUCT_OFFSACK (PkPackageSackClass, changed),
+			      G_STRUCT_OFFSET (PkPackageSackClass, changed),
 			      NULL, NULL, g_cclosure_marshal_VOID__VOID,
 			      G_TYPE_NONE, 0);
-#endif
 
 	g_type_class_add_private (klass, sizeof (PkPackageSackPrivate));
 }
@@ -1142,8 +1344,11 @@ pk_package_sack_init (PkPackageSack *sack)
 	priv = sack->priv;
 
 	priv->table = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->name_arch_table = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, (GDestroyNotify) g_ptr_array_unref);
 	priv->array = g_ptr_array_new_with_free_func (g_object_unref);
 	priv->client = pk_client_new ();
+	priv->chunks = 1;
 }
 
 /**
@@ -1157,6 +1362,7 @@ pk_package_sack_finalize (GObject *object)
 
 	g_ptr_array_unref (priv->array);
 	g_hash_table_unref (priv->table);
+	g_hash_table_unref (priv->name_arch_table);
 	g_object_unref (priv->client);
 
 	G_OBJECT_CLASS (pk_package_sack_parent_class)->finalize (object);
@@ -46,6 +46,11 @@ typedef struct _PkPackageSack		PkPackageSack;
 typedef struct _PkPackageSackClass	PkPackageSackClass;
 typedef struct _PkPackageSackResults	PkPackageSackResults;
 
+/* pk-results.h includes this file, so only after PkPackageSack is declared */
+G_END_DECLS
+#include <packagekit-glib2/pk-results.h>
+G_BEGIN_DECLS
+
 #ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkPackageSack, g_object_unref)
 #endif
@@ -120,10 +125,15 @@ PkPackageSack	*pk_package_sack_filter			(PkPackageSack		*sack,
 							 PkPackageSackFilterFunc filter_cb,
 							 gpointer		 user_data);
 guint64		 pk_package_sack_get_total_bytes	(PkPackageSack		*sack);
+void		 pk_package_sack_set_chunks		(PkPackageSack		*sack,
+							 guint			 chunks);
+guint		 pk_package_sack_get_chunks		(PkPackageSack		*sack);
 
 gboolean	 pk_package_sack_merge_generic_finish	(PkPackageSack		*sack,
 							 GAsyncResult		*res,
 							 GError			**error);
+guint		 pk_package_sack_merge_results		(PkPackageSack		*sack,
+							 PkResults		*results);
 
 /* merging in data to the array using Resolve() */
 void		 pk_package_sack_resolve_async		(PkPackageSack		*sack,
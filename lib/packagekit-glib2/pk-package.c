@@ -37,6 +37,7 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-enum-types.h>
 #include <packagekit-glib2/pk-package-id.h>
+#include <packagekit-glib2/pk-package-ids.h>
 
 static void     pk_package_finalize	(GObject     *object);
 
@@ -287,6 +288,76 @@ pk_package_set_summary (PkPackage *package, const gchar *summary)
 	package->priv->summary = g_strdup (summary);
 }
 
+/**
+ * pk_package_set_details:
+ * @package: a valid #PkPackage instance
+ * @details: a #PkDetails for the same package
+ *
+ * Copies the license, group, description, URL and size from @details.
+ * No property notifications are emitted.
+ *
+ * Since: 1.1.5
+ **/
+void
+pk_package_set_details (PkPackage *package, PkDetails *details)
+{
+	PkPackagePrivate *priv;
+
+	g_return_if_fail (PK_IS_PACKAGE (package));
+	g_return_if_fail (PK_IS_DETAILS (details));
+
+	priv = package->priv;
+	g_free (priv->license);
+	priv->license = g_strdup (pk_details_get_license (details));
+	priv->group = pk_details_get_group (details);
+	g_free (priv->description);
+	priv->description = g_strdup (pk_details_get_description (details));
+	g_free (priv->url);
+	priv->url = g_strdup (pk_details_get_url (details));
+	priv->size = pk_details_get_size (details);
+}
+
+/**
+ * pk_package_set_update_detail:
+ * @package: a valid #PkPackage instance
+ * @update_detail: a #PkUpdateDetail for the same package
+ *
+ * Copies the update-* data from @update_detail.
+ * No property notifications are emitted.
+ *
+ * Since: 1.1.5
+ **/
+void
+pk_package_set_update_detail (PkPackage *package, PkUpdateDetail *update_detail)
+{
+	PkPackagePrivate *priv;
+
+	g_return_if_fail (PK_IS_PACKAGE (package));
+	g_return_if_fail (PK_IS_UPDATE_DETAIL (update_detail));
+
+	priv = package->priv;
+	g_free (priv->update_updates);
+	priv->update_updates = pk_package_ids_to_string (pk_update_detail_get_updates (update_detail));
+	g_free (priv->update_obsoletes);
+	priv->update_obsoletes = pk_package_ids_to_string (pk_update_detail_get_obsoletes (update_detail));
+	g_strfreev (priv->update_vendor_urls);
+	priv->update_vendor_urls = g_strdupv (pk_update_detail_get_vendor_urls (update_detail));
+	g_strfreev (priv->update_bugzilla_urls);
+	priv->update_bugzilla_urls = g_strdupv (pk_update_detail_get_bugzilla_urls (update_detail));
+	g_strfreev (priv->update_cve_urls);
+	priv->update_cve_urls = g_strdupv (pk_update_detail_get_cve_urls (update_detail));
+	priv->update_restart = pk_update_detail_get_restart (update_detail);
+	g_free (priv->update_text);
+	priv->update_text = g_strdup (pk_update_detail_get_update_text (update_detail));
+	g_free (priv->update_changelog);
+	priv->update_changelog = g_strdup (pk_update_detail_get_changelog (update_detail));
+	priv->update_state = pk_update_detail_get_state (update_detail);
+	g_free (priv->update_issued);
+	priv->update_issued = g_strdup (pk_update_detail_get_issued (update_detail));
+	g_free (priv->update_updated);
+	priv->update_updated = g_strdup (pk_update_detail_get_updated (update_detail));
+}
+
 /**
  * pk_package_get_id:
  * @package: a valid #PkPackage instance
@@ -28,8 +28,10 @@
 
 #include <glib-object.h>
 
+#include <packagekit-glib2/pk-details.h>
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-source.h>
+#include <packagekit-glib2/pk-update-detail.h>
 
 G_BEGIN_DECLS
 
@@ -93,6 +95,10 @@ void		 pk_package_set_info			(PkPackage	*package,
 const gchar	*pk_package_get_summary			(PkPackage	*package);
 void		 pk_package_set_summary			(PkPackage	*package,
 							 const gchar	*summary);
+void		 pk_package_set_details			(PkPackage	*package,
+							 PkDetails	*details);
+void		 pk_package_set_update_detail		(PkPackage	*package,
+							 PkUpdateDetail	*update_detail);
 const gchar	*pk_package_get_name			(PkPackage	*package);
 const gchar	*pk_package_get_version			(PkPackage	*package);
 const gchar	*pk_package_get_arch			(PkPackage	*package);
@@ -66,8 +66,18 @@ struct _PkResultsPrivate
 	GPtrArray		*media_change_required_array;
 	GPtrArray		*repo_detail_array;
 	PkPackageSack		*package_sack;
+	GArray			*package_pending;
+	GStringChunk		*package_strings;
 };
 
+/* a Package() not yet turned into a PkPackage; the strings are owned by
+ * package_strings so that repeated IDs and summaries are only stored once */
+typedef struct {
+	PkInfoEnum		 info;
+	const gchar		*package_id;
+	const gchar		*summary;
+} PkResultsPackage;
+
 enum {
 	PROP_0,
 	PROP_ROLE,
@@ -159,6 +169,43 @@ pk_results_set_exit_code (PkResults *results, PkExitEnum exit_enum)
 	return TRUE;
 }
 
+/**
+ * pk_results_ensure_packages:
+ *
+ * Creates the #PkPackage objects for anything added with
+ * pk_results_add_package_data().
+ **/
+static void
+pk_results_ensure_packages (PkResults *results)
+{
+	PkResultsPrivate *priv = results->priv;
+	guint i;
+
+	if (priv->package_pending->len == 0)
+		return;
+	for (i = 0; i < priv->package_pending->len; i++) {
+		PkResultsPackage *tmp;
+		g_autoptr(GError) error = NULL;
+		g_autoptr(PkPackage) package = NULL;
+
+		tmp = &g_array_index (priv->package_pending, PkResultsPackage, i);
+		package = pk_package_new ();
+		if (!pk_package_set_id (package, tmp->package_id, &error)) {
+			g_warning ("failed to set package id for %s", tmp->package_id);
+			continue;
+		}
+		pk_package_set_info (package, tmp->info);
+		pk_package_set_summary (package, tmp->summary);
+		if (priv->role != PK_ROLE_ENUM_UNKNOWN)
+			g_object_set (package, "role", priv->role, NULL);
+		pk_package_sack_add_package (priv->package_sack, package);
+	}
+
+	/* the objects have their own copies */
+	g_array_set_size (priv->package_pending, 0);
+	g_string_chunk_clear (priv->package_strings);
+}
+
 /**
  * pk_results_add_package:
  * @results: a valid #PkResults instance
@@ -181,10 +228,58 @@ pk_results_add_package (PkResults *results, PkPackage *item)
 		g_warning ("Finished packages cannot be added to PkResults");
 		return FALSE;
 	}
+
+	/* keep the order the packages were added in */
+	pk_results_ensure_packages (results);
 	pk_package_sack_add_package (results->priv->package_sack, item);
 	return TRUE;
 }
 
+/**
+ * pk_results_add_package_data:
+ * @results: a valid #PkResults instance
+ * @info: the #PkInfoEnum of the package
+ * @package_id: a valid package-id
+ * @summary: the package summary, or %NULL
+ *
+ * Adds a package to the results set without creating a #PkPackage for
+ * it. The object is only created when the packages are requested, which
+ * is much cheaper when adding thousands of packages from a transaction.
+ *
+ * Return value: %TRUE if the value was set
+ *
+ * Since: 1.1.5
+ **/
+gboolean
+pk_results_add_package_data (PkResults *results,
+			     PkInfoEnum info,
+			     const gchar *package_id,
+			     const gchar *summary)
+{
+	PkResultsPackage tmp;
+	PkResultsPrivate *priv;
+
+	g_return_val_if_fail (PK_IS_RESULTS (results), FALSE);
+	g_return_val_if_fail (package_id != NULL, FALSE);
+
+	/* do not allow finished types */
+	if (info == PK_INFO_ENUM_FINISHED) {
+		g_warning ("Finished packages cannot be added to PkResults");
+		return FALSE;
+	}
+
+	priv = results->priv;
+	tmp.info = info;
+	tmp.package_id = g_string_chunk_insert_const (priv->package_strings,
+						      package_id);
+	tmp.summary = NULL;
+	if (summary != NULL)
+		tmp.summary = g_string_chunk_insert_const (priv->package_strings,
+							   summary);
+	g_array_append_val (priv->package_pending, tmp);
+	return TRUE;
+}
+
 /**
  * pk_results_add_details:
  * @results: a valid #PkResults instance
@@ -557,6 +652,7 @@ GPtrArray *
 pk_results_get_package_array (PkResults *results)
 {
 	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+	pk_results_ensure_packages (results);
 	return pk_package_sack_get_array (results->priv->package_sack);
 }
 
@@ -574,6 +670,7 @@ PkPackageSack *
 pk_results_get_package_sack (PkResults *results)
 {
 	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+	pk_results_ensure_packages (results);
 	return g_object_ref (results->priv->package_sack);
 }
 
@@ -873,6 +970,8 @@ pk_results_init (PkResults *results)
 	results->priv->progress = NULL;
 	results->priv->error_code = NULL;
 	results->priv->package_sack = pk_package_sack_new ();
+	results->priv->package_pending = g_array_new (FALSE, FALSE, sizeof (PkResultsPackage));
+	results->priv->package_strings = g_string_chunk_new (4096);
 	results->priv->details_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	results->priv->update_detail_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	results->priv->category_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
@@ -907,6 +1006,8 @@ pk_results_finalize (GObject *object)
 	g_ptr_array_unref (priv->media_change_required_array);
 	g_ptr_array_unref (priv->repo_detail_array);
 	g_object_unref (priv->package_sack);
+	g_array_unref (priv->package_pending);
+	g_string_chunk_free (priv->package_strings);
 	if (results->priv->progress != NULL)
 		g_object_unref (results->priv->progress);
 	if (results->priv->error_code != NULL)
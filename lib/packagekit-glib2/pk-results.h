@@ -36,7 +36,6 @@
 #include <packagekit-glib2/pk-eula-required.h>
 #include <packagekit-glib2/pk-files.h>
 #include <packagekit-glib2/pk-media-change-required.h>
-#include <packagekit-glib2/pk-package-sack.h>
 #include <packagekit-glib2/pk-repo-detail.h>
 #include <packagekit-glib2/pk-repo-signature-required.h>
 #include <packagekit-glib2/pk-require-restart.h>
@@ -57,6 +56,11 @@ typedef struct _PkResultsPrivate	PkResultsPrivate;
 typedef struct _PkResults		PkResults;
 typedef struct _PkResultsClass		PkResultsClass;
 
+/* pk-package-sack.h includes this file, so only after PkResults is declared */
+G_END_DECLS
+#include <packagekit-glib2/pk-package-sack.h>
+G_BEGIN_DECLS
+
 #ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkResults, g_object_unref)
 #endif
@@ -91,6 +95,10 @@ gboolean	 pk_results_set_error_code 		(PkResults		*results,
 /* add */
 gboolean	 pk_results_add_package			(PkResults		*results,
 							 PkPackage		*item);
+gboolean	 pk_results_add_package_data		(PkResults		*results,
+							 PkInfoEnum		 info,
+							 const gchar		*package_id,
+							 const gchar		*summary);
 gboolean	 pk_results_add_details			(PkResults		*results,
 							 PkDetails		*item);
 gboolean	 pk_results_add_update_detail		(PkResults		*results,
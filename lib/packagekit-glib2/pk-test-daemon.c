@@ -723,6 +723,117 @@ pk_test_client_func (void)
 #endif
 }
 
+static gint _start_transaction_calls = 0;
+static gint _create_transaction_calls = 0;
+static gint _set_hints_calls = 0;
+static gint _start_transaction_hidden = FALSE;
+
+/**
+ * pk_test_client_start_transaction_filter_cb:
+ *
+ * Runs in the GDBus worker thread for every message on the system bus.
+ **/
+static GDBusMessage *
+pk_test_client_start_transaction_filter_cb (GDBusConnection *connection,
+					    GDBusMessage *message,
+					    gboolean incoming,
+					    gpointer user_data)
+{
+	const gchar *member;
+	GDBusMessage *copy;
+
+	if (incoming ||
+	    g_dbus_message_get_message_type (message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL)
+		return message;
+	member = g_dbus_message_get_member (message);
+	if (g_strcmp0 (member, "CreateTransaction") == 0)
+		g_atomic_int_inc (&_create_transaction_calls);
+	else if (g_strcmp0 (member, "SetHints") == 0)
+		g_atomic_int_inc (&_set_hints_calls);
+	if (g_strcmp0 (member, "StartTransaction") != 0)
+		return message;
+	g_atomic_int_inc (&_start_transaction_calls);
+
+	/* pretend to be an older daemon */
+	if (!g_atomic_int_get (&_start_transaction_hidden))
+		return message;
+	copy = g_dbus_message_copy (message, NULL);
+	g_dbus_message_set_member (copy, "StartTransactionDave");
+	g_object_unref (message);
+	return copy;
+}
+
+static void
+pk_test_client_start_transaction_resolve_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	PkClient *client = PK_CLIENT (object);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	results = pk_client_generic_finish (client, res, &error);
+	g_assert_no_error (error);
+	g_assert (results != NULL);
+	g_assert_cmpint (pk_results_get_exit_code (results), ==, PK_EXIT_ENUM_SUCCESS);
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_client_start_transaction_resolve (PkClient *client)
+{
+	g_auto(GStrv) package_ids = NULL;
+
+	package_ids = pk_package_ids_from_id ("glib2;2.14.0;i386;fedora");
+	pk_client_resolve_async (client,
+				 pk_bitfield_value (PK_FILTER_ENUM_INSTALLED),
+				 package_ids,
+				 NULL,
+				 NULL,
+				 NULL,
+				 (GAsyncReadyCallback) pk_test_client_start_transaction_resolve_cb,
+				 NULL);
+	_g_test_loop_run_with_timeout (15000);
+}
+
+static void
+pk_test_client_start_transaction_func (void)
+{
+	guint filter_id;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkClient) client = NULL;
+
+	/* this is the connection the client uses too */
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	g_assert_no_error (error);
+	filter_id = g_dbus_connection_add_filter (connection,
+						  pk_test_client_start_transaction_filter_cb,
+						  NULL, NULL);
+
+	/* a non-interactive role takes a single round-trip */
+	client = pk_client_new ();
+	pk_test_client_start_transaction_resolve (client);
+	g_assert_cmpint (g_atomic_int_get (&_start_transaction_calls), ==, 1);
+	g_assert_cmpint (g_atomic_int_get (&_create_transaction_calls), ==, 0);
+	g_assert_cmpint (g_atomic_int_get (&_set_hints_calls), ==, 0);
+	g_object_unref (client);
+
+	/* without StartTransaction() it falls back to the long way */
+	g_atomic_int_set (&_start_transaction_hidden, TRUE);
+	client = pk_client_new ();
+	pk_test_client_start_transaction_resolve (client);
+	g_assert_cmpint (g_atomic_int_get (&_start_transaction_calls), ==, 2);
+	g_assert_cmpint (g_atomic_int_get (&_create_transaction_calls), ==, 1);
+	g_assert_cmpint (g_atomic_int_get (&_set_hints_calls), ==, 1);
+
+	/* and does not try again */
+	pk_test_client_start_transaction_resolve (client);
+	g_assert_cmpint (g_atomic_int_get (&_start_transaction_calls), ==, 2);
+	g_assert_cmpint (g_atomic_int_get (&_create_transaction_calls), ==, 2);
+	g_assert_cmpint (g_atomic_int_get (&_set_hints_calls), ==, 2);
+
+	g_dbus_connection_remove_filter (connection, filter_id);
+}
+
 static void
 pk_test_console_func (void)
 {
@@ -1011,6 +1122,19 @@ pk_test_package_sack_filter_cb (PkPackage *package, gpointer user_data)
 	return TRUE;
 }
 
+/**
+ * pk_test_package_sack_progress_cb:
+ **/
+static void
+pk_test_package_sack_progress_cb (PkProgress *progress, PkProgressType type, gpointer user_data)
+{
+	GHashTable *tids = (GHashTable *) user_data;
+	const gchar *tid = pk_progress_get_transaction_id (progress);
+
+	if (tid != NULL)
+		g_hash_table_add (tids, g_strdup (tid));
+}
+
 static void
 pk_test_package_sack_func (void)
 {
@@ -1021,7 +1145,14 @@ pk_test_package_sack_func (void)
 	gchar **strv;
 	guint size;
 	PkInfoEnum info = PK_INFO_ENUM_UNKNOWN;
+	PkRestartEnum restart = PK_RESTART_ENUM_UNKNOWN;
 	guint64 bytes;
+	guint merged;
+	GError *error = NULL;
+	g_autoptr(GHashTable) tids = NULL;
+	g_autoptr(PkClient) client = NULL;
+	g_autoptr(PkPackageSack) sack_update = NULL;
+	g_autoptr(PkResults) results = NULL;
 
 	sack = pk_package_sack_new ();
 	g_assert (sack != NULL);
@@ -1046,6 +1177,14 @@ pk_test_package_sack_func (void)
 	size = pk_package_sack_get_size (sack);
 	g_assert (size == 1);
 
+	/* find package by name and arch */
+	package = pk_package_sack_find_by_id_name_arch (sack, "powertop;1.9-1.fc8;i386;installed");
+	g_assert (package != NULL);
+	g_assert_cmpstr (pk_package_get_id (package), ==, "powertop;1.8-1.fc8;i386;fedora");
+	g_object_unref (package);
+	package = pk_package_sack_find_by_id_name_arch (sack, "powertop;1.8-1.fc8;x86_64;fedora");
+	g_assert (package == NULL);
+
 	/* merge resolve results */
 	pk_package_sack_resolve_async (sack, NULL, NULL, NULL, (GAsyncReadyCallback) pk_test_package_sack_resolve_cb, NULL);
 	_g_test_loop_run_with_timeout (5000);
@@ -1068,7 +1207,10 @@ pk_test_package_sack_func (void)
 	g_free (text);
 	g_object_unref (package);
 
-	/* merge details results */
+	/* merge details results, asking for more chunks than packages */
+	g_assert_cmpint (pk_package_sack_get_chunks (sack), ==, 1);
+	pk_package_sack_set_chunks (sack, 4);
+	g_assert_cmpint (pk_package_sack_get_chunks (sack), ==, 4);
 	pk_package_sack_get_details_async (sack, NULL, NULL, NULL, (GAsyncReadyCallback) pk_test_package_sack_details_cb, NULL);
 	_g_test_loop_run_with_timeout (5000);
 	g_debug ("got details in %f", g_test_timer_elapsed ());
@@ -1129,6 +1271,87 @@ pk_test_package_sack_func (void)
 	/* check all removed */
 	size = pk_package_sack_get_size (sack);
 	g_assert_cmpint (size, ==, 0);
+	package = pk_package_sack_find_by_id_name_arch (sack, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (package == NULL);
+
+	/* several packages are split over the chunks */
+	pk_package_sack_add_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora", NULL);
+	pk_package_sack_add_package_by_id (sack, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed", NULL);
+	pk_package_sack_add_package_by_id (sack, "gtkhtml2;2.19.1-4.fc8;i386;fedora", NULL);
+	pk_package_sack_resolve_async (sack, NULL, NULL, NULL, (GAsyncReadyCallback) pk_test_package_sack_resolve_cb, NULL);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (pk_package_sack_get_size (sack), ==, 3);
+
+	/* merge details results from two transactions */
+	tids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	pk_package_sack_set_chunks (sack, 2);
+	pk_package_sack_get_details_async (sack, NULL,
+					   pk_test_package_sack_progress_cb, tids,
+					   (GAsyncReadyCallback) pk_test_package_sack_details_cb, NULL);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (g_hash_table_size (tids), ==, 2);
+
+	/* merge update detail results from three transactions */
+	g_hash_table_remove_all (tids);
+	pk_package_sack_set_chunks (sack, 3);
+	pk_package_sack_get_update_detail_async (sack, NULL,
+						 pk_test_package_sack_progress_cb, tids,
+						 (GAsyncReadyCallback) pk_test_package_sack_update_detail_cb, NULL);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (g_hash_table_size (tids), ==, 3);
+
+	/* each package got its own data, in the original order */
+	strv = pk_package_sack_get_ids (sack);
+	g_assert_cmpint (g_strv_length (strv), ==, 3);
+	g_assert_cmpstr (strv[0], ==, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert_cmpstr (strv[1], ==, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed");
+	g_assert_cmpstr (strv[2], ==, "gtkhtml2;2.19.1-4.fc8;i386;fedora");
+	g_strfreev (strv);
+	package = pk_package_sack_find_by_id (sack, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed");
+	g_assert (package != NULL);
+	g_object_get (package,
+		      "info", &info,
+		      "url", &text,
+		      NULL);
+	g_assert_cmpint (info, ==, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpstr (text, ==, "http://www.kernel.org");
+	g_free (text);
+	g_object_unref (package);
+	package = pk_package_sack_find_by_id (sack, "gtkhtml2;2.19.1-4.fc8;i386;fedora");
+	g_assert (package != NULL);
+	g_object_get (package,
+		      "summary", &text,
+		      "update-restart", &restart,
+		      NULL);
+	g_assert_cmpstr (text, ==, "An HTML widget for GTK+ 2.0");
+	g_assert_cmpint (restart, ==, PK_RESTART_ENUM_SESSION);
+	g_free (text);
+	g_object_unref (package);
+	bytes = pk_package_sack_get_total_bytes (sack);
+	g_assert_cmpint (bytes, ==, (101 + 33 * 1024 + 133) * 1024);
+
+	/* the installed version is not merged into a different version */
+	sack_update = pk_package_sack_new ();
+	ret = pk_package_sack_add_package_by_id (sack_update, "powertop;1.9-1.fc8;i386;updates", NULL);
+	g_assert (ret);
+	client = pk_client_new ();
+	strv = g_strsplit ("powertop", " ", -1);
+	results = pk_client_resolve (client,
+				     pk_bitfield_value (PK_FILTER_ENUM_INSTALLED),
+				     strv, NULL, NULL, NULL, &error);
+	g_strfreev (strv);
+	g_assert_no_error (error);
+	g_assert (results != NULL);
+	g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+			       "failed to find powertop;1.8-1.fc8;i386;fedora");
+	merged = pk_package_sack_merge_results (sack_update, results);
+	g_test_assert_expected_messages ();
+	g_assert_cmpint (merged, ==, 0);
+	package = pk_package_sack_find_by_id (sack_update, "powertop;1.9-1.fc8;i386;updates");
+	g_assert (package != NULL);
+	g_assert_cmpint (pk_package_get_info (package), ==, PK_INFO_ENUM_UNKNOWN);
+	g_assert_cmpstr (pk_package_get_summary (package), ==, NULL);
+	g_object_unref (package);
 
 	g_object_unref (sack);
 }
@@ -1438,6 +1661,7 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/transaction-list", pk_test_transaction_list_func);
 	g_test_add_func ("/packagekit-glib2/client-helper", pk_test_client_helper_func);
 	g_test_add_func ("/packagekit-glib2/client", pk_test_client_func);
+	g_test_add_func ("/packagekit-glib2/client-start-transaction", pk_test_client_start_transaction_func);
 	g_test_add_func ("/packagekit-glib2/package-sack", pk_test_package_sack_func);
 	g_test_add_func ("/packagekit-glib2/task", pk_test_task_func);
 	g_test_add_func ("/packagekit-glib2/task-wrapper", pk_test_task_wrapper_func);
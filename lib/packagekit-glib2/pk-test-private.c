@@ -532,9 +532,62 @@ pk_test_results_func (void)
 	g_free (package_id);
 	g_free (summary);
 
+	/* add package without an object, and check the order is kept */
+	ret = pk_results_add_package_data (results,
+					   PK_INFO_ENUM_INSTALLED,
+					   "hal;0.0.1;i386;installed",
+					   "Hardware abstraction layer");
+	g_assert (ret);
+	packages = pk_results_get_package_array (results);
+	g_assert_cmpint (packages->len, ==, 2);
+	item = g_ptr_array_index (packages, 1);
+	g_assert_cmpint (pk_package_get_info (item), ==, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpstr (pk_package_get_id (item), ==, "hal;0.0.1;i386;installed");
+	g_assert_cmpstr (pk_package_get_summary (item), ==, "Hardware abstraction layer");
+	g_ptr_array_unref (packages);
+
 	g_object_unref (results);
 }
 
+static void
+pk_test_package_sack_merge_func (void)
+{
+	gboolean ret;
+	guint merged;
+	g_autofree gchar *url = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkDetails) details = NULL;
+	g_autoptr(PkPackage) package = NULL;
+	g_autoptr(PkPackageSack) sack = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	sack = pk_package_sack_new ();
+	ret = pk_package_sack_add_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* the installed package-id differs only in the data */
+	results = pk_results_new ();
+	pk_results_add_package_data (results, PK_INFO_ENUM_INSTALLED,
+				     "powertop;1.8-1.fc8;i386;installed",
+				     "Power consumption monitor");
+	details = pk_details_new ();
+	g_object_set (details,
+		      "package-id", "powertop;1.8-1.fc8;i386;fedora",
+		      "url", "http://live.gnome.org/powertop",
+		      NULL);
+	pk_results_add_details (results, details);
+	merged = pk_package_sack_merge_results (sack, results);
+	g_assert_cmpint (merged, ==, 2);
+
+	package = pk_package_sack_find_by_id (sack, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (package != NULL);
+	g_assert_cmpint (pk_package_get_info (package), ==, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpstr (pk_package_get_summary (package), ==, "Power consumption monitor");
+	g_object_get (package, "url", &url, NULL);
+	g_assert_cmpstr (url, ==, "http://live.gnome.org/powertop");
+}
+
 static void
 pk_test_package_func (void)
 {
@@ -929,6 +982,7 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/progress", pk_test_progress_func);
 	g_test_add_func ("/packagekit-glib2/results", pk_test_results_func);
 	g_test_add_func ("/packagekit-glib2/package", pk_test_package_func);
+	g_test_add_func ("/packagekit-glib2/package-sack-merge", pk_test_package_sack_merge_func);
 	g_test_add_func ("/packagekit-glib2/progress-bar", pk_test_progress_bar);
 	g_test_add_func ("/packagekit-glib2/offline", pk_test_offline_func);
 	g_test_add_func ("/packagekit-glib2/offline-upgrade", pk_test_offline_upgrade_func);
@@ -27,12 +27,27 @@ from __future__ import print_function
 import sys
 import traceback
 import os.path
+import struct
 
 from .enums import *
 
 PACKAGE_IDS_DELIM = '&'
 FILENAME_DELIM = '|'
 
+# command ids for the framed output protocol, see pk-backend-spawn.c
+FRAME_TEXT = 0
+FRAME_FINISHED = 1
+FRAME_PACKAGE = 2
+FRAME_DETAILS = 3
+FRAME_FILES = 4
+FRAME_UPDATE_DETAIL = 5
+FRAME_PERCENTAGE = 6
+FRAME_ITEM_PROGRESS = 7
+FRAME_STATUS = 8
+FRAME_ALLOW_CANCEL = 9
+FRAME_SPEED = 10
+FRAME_DOWNLOAD_SIZE_REMAINING = 11
+
 def _to_unicode(txt, encoding='utf-8'):
     if isinstance(txt, str):
         if not isinstance(txt, str):
@@ -46,6 +61,31 @@ def _to_utf8(txt, errors='replace'):
         return txt.encode('utf-8', errors=errors)
     return str(txt)
 
+def _to_bytes(txt):
+    if isinstance(txt, bytes):
+        return txt
+    if not hasattr(txt, 'encode'):
+        txt = str(txt)
+    return txt.encode('utf-8', 'replace')
+
+def _frame_string(txt):
+    data = _to_bytes(txt)
+    return struct.pack('>I', len(data)) + data + b'\0'
+
+def _frame_field(typ, value):
+    if typ == 's':
+        return b's' + _frame_string(value)
+    if typ == 'u':
+        return b'u' + struct.pack('>I', value)
+    if typ == 't':
+        return b't' + struct.pack('>Q', value)
+    if typ == 'b':
+        return b'b' + struct.pack('B', bool(value))
+    if typ == 'a':
+        items = [item for item in value if item]
+        return b'a' + struct.pack('>I', len(items)) + b''.join(_frame_string(item) for item in items)
+    raise ValueError("unknown frame field type %s" % typ)
+
 class PkError(Exception):
     def __init__(self, code, details):
         self.code = code
@@ -55,6 +95,10 @@ class PkError(Exception):
 
 class PackageKitBaseBackend:
 
+    # set in a subclass to use the framed output protocol when the daemon
+    # offers it; anything else printed is then sent to stderr
+    framed_output = False
+
     def __init__(self, cmds):
         # Setup a custom exception handler
         installExceptionHandler(self)
@@ -67,6 +111,8 @@ class PackageKitBaseBackend:
         self.interactive = False
         self.cache_age = 0
         self.percentage_old = 0
+        self._framed = False
+        self._frame_out = None
 
         # try to get LANG
         try:
@@ -107,6 +153,31 @@ class PackageKitBaseBackend:
         except KeyError as e:
             pass
 
+        # switch to framed output if the daemon supports it
+        protocols = os.environ.get('HELPER_PROTOCOL', '').split(',')
+        if self.framed_output and 'framed1' in protocols:
+            self._write_text("protocol\tframed1\n")
+            self._framed = True
+
+            # keep stray prints from yum and other libraries out of the frames
+            self._frame_out = getattr(sys.stdout, 'buffer', sys.stdout)
+            sys.stdout = sys.stderr
+
+    def _write_text(self, text):
+        ''' Write one line of the text protocol '''
+        if self._framed:
+            self._write_frame(FRAME_TEXT, 's', text.rstrip('\n'))
+            return
+        sys.stdout.write(_to_utf8(text))
+        sys.stdout.flush()
+
+    def _write_frame(self, command, signature, *values):
+        ''' Write one frame of the framed protocol '''
+        payload = struct.pack('B', command)
+        payload += b''.join(_frame_field(typ, value) for typ, value in zip(signature, values))
+        self._frame_out.write(struct.pack('>I', len(payload)) + payload)
+        self._frame_out.flush()
+
     def doLock(self):
         ''' Generic locking, overide and extend in child class'''
         self._locked = True
@@ -124,19 +195,26 @@ class PackageKitBaseBackend:
         @param percent: Progress percentage (int preferred)
         '''
         if percent == None:
-            sys.stdout.write(_to_utf8("no-percentage-updates\n"))
+            if self._framed:
+                self._write_frame(FRAME_PERCENTAGE, 'u', 101)
+            else:
+                self._write_text("no-percentage-updates\n")
         elif percent == 0 or percent > self.percentage_old:
-            sys.stdout.write(_to_utf8("percentage\t%i\n" % percent))
+            if self._framed:
+                self._write_frame(FRAME_PERCENTAGE, 'u', int(percent))
+            else:
+                self._write_text("percentage\t%i\n" % percent)
             self.percentage_old = percent
-        sys.stdout.flush()
 
     def speed(self, bps=0):
         '''
         Write progress speed
         @param bps: Progress speed (int, bytes per second)
         '''
-        sys.stdout.write(_to_utf8("speed\t%i\n" % bps))
-        sys.stdout.flush()
+        if self._framed:
+            self._write_frame(FRAME_SPEED, 't', int(bps))
+            return
+        self._write_text("speed\t%i\n" % bps)
 
     def item_progress(self, package_id, status, percent=None):
         '''
@@ -144,8 +222,10 @@ class PackageKitBaseBackend:
         @param package_id: The package ID name, e.g. openoffice-clipart;2.6.22;ppc64;fedora
         @param percent: percentage of the current item (int preferred)
         '''
-        sys.stdout.write(_to_utf8("item-progress\t%s\t%s\t%i\n" % (package_id, status, percent)))
-        sys.stdout.flush()
+        if self._framed:
+            self._write_frame(FRAME_ITEM_PROGRESS, 'ssu', package_id, status, int(percent))
+            return
+        self._write_text("item-progress\t%s\t%s\t%i\n" % (package_id, status, percent))
 
     def error(self, err, description, exit=True):
         '''
@@ -159,8 +239,7 @@ class PackageKitBaseBackend:
             self.unLock()
 
         # this should be fast now
-        sys.stdout.write(_to_utf8("error\t%s\t%s\n" % (err, description)))
-        sys.stdout.flush()
+        self._write_text("error\t%s\t%s\n" % (err, description))
         if exit:
             # Paradoxically, we don't want to print "finished" to stdout here.
             # Python takes an _enormous_ amount of time to exit, and leaves a
@@ -174,8 +253,7 @@ class PackageKitBaseBackend:
         send 'message' signal
         @param typ: MESSAGE_BROKEN_MIRROR
         '''
-        sys.stdout.write(_to_utf8("message\t%s\t%s\n" % (typ, msg)))
-        sys.stdout.flush()
+        self._write_text("message\t%s\t%s\n" % (typ, msg))
 
     def package(self, package_id, status, summary):
         '''
@@ -184,8 +262,10 @@ class PackageKitBaseBackend:
         @param package_id: The package ID name, e.g. openoffice-clipart;2.6.22;ppc64;fedora
         @param summary: The package Summary
         '''
-        sys.stdout.write(_to_utf8("package\t%s\t%s\t%s\n" % (status, package_id, summary)))
-        sys.stdout.flush()
+        if self._framed:
+            self._write_frame(FRAME_PACKAGE, 'sss', status, package_id, summary)
+            return
+        self._write_text("package\t%s\t%s\t%s\n" % (status, package_id, summary))
 
     def media_change_required(self, mtype, id, text):
         '''
@@ -194,8 +274,7 @@ class PackageKitBaseBackend:
         @param id: the localised label of the media
         @param text: the localised text describing the media
         '''
-        sys.stdout.write(_to_utf8("media-change-required\t%s\t%s\t%s\n" % (mtype, id, text)))
-        sys.stdout.flush()
+        self._write_text("media-change-required\t%s\t%s\t%s\n" % (mtype, id, text))
 
     def distro_upgrade(self, dtype, name, summary):
         '''
@@ -204,16 +283,17 @@ class PackageKitBaseBackend:
         @param name: The distro name, e.g. "fedora-9"
         @param summary: The localised distribution name and description
         '''
-        sys.stdout.write(_to_utf8("distro-upgrade\t%s\t%s\t%s\n" % (dtype, name, summary)))
-        sys.stdout.flush()
+        self._write_text("distro-upgrade\t%s\t%s\t%s\n" % (dtype, name, summary))
 
     def status(self, state):
         '''
         send 'status' signal
         @param state: STATUS_DOWNLOAD, STATUS_INSTALL, STATUS_UPDATE, STATUS_REMOVE, STATUS_WAIT
         '''
-        sys.stdout.write(_to_utf8("status\t%s\n" % state))
-        sys.stdout.flush()
+        if self._framed:
+            self._write_frame(FRAME_STATUS, 's', state)
+            return
+        self._write_text("status\t%s\n" % state)
 
     def repo_detail(self, repoid, name, state):
         '''
@@ -221,16 +301,14 @@ class PackageKitBaseBackend:
         @param repoid: The repo id tag
         @param state: false is repo is disabled else true.
         '''
-        sys.stdout.write(_to_utf8("repo-detail\t%s\t%s\t%s\n" % (repoid, name, _bool_to_string(state))))
-        sys.stdout.flush()
+        self._write_text("repo-detail\t%s\t%s\t%s\n" % (repoid, name, _bool_to_string(state)))
 
     def data(self, data):
         '''
         send 'data' signal:
         @param data:  The current worked on package
         '''
-        sys.stdout.write(_to_utf8("data\t%s\n" % data))
-        sys.stdout.flush()
+        self._write_text("data\t%s\n" % data)
 
     def details(self, package_id, summary, package_license, group, desc, url, bytes):
         '''
@@ -243,16 +321,22 @@ class PackageKitBaseBackend:
         @param url: The upstream project homepage
         @param bytes: The size of the package, in bytes
         '''
-        sys.stdout.write(_to_utf8("details\t%s\t%s\t%s\t%s\t%s\t%s\t%ld\n" % (package_id, summary, package_license, group, desc, url, bytes)))
-        sys.stdout.flush()
+        if self._framed:
+            self._write_frame(FRAME_DETAILS, 'sssssst', package_id, summary,
+                              package_license, group, (desc or '').replace(';', '\n'),
+                              url, int(bytes))
+            return
+        self._write_text("details\t%s\t%s\t%s\t%s\t%s\t%s\t%ld\n" % (package_id, summary, package_license, group, desc, url, bytes))
 
     def files(self, package_id, file_list):
         '''
         Send 'files' signal
         @param file_list: List of the files in the package, separated by ';'
         '''
-        sys.stdout.write(_to_utf8("files\t%s\t%s\n" % (package_id, file_list)))
-        sys.stdout.flush()
+        if self._framed:
+            self._write_frame(FRAME_FILES, 'sa', package_id, file_list.split(';'))
+            return
+        self._write_text("files\t%s\t%s\n" % (package_id, file_list))
 
     def category(self, parent_id, cat_id, name, summary, icon):
         '''
@@ -263,15 +347,16 @@ class PackageKitBaseBackend:
         summery   : a summary of the category in current locale.
         icon      : an icon name to represent the category
         '''
-        sys.stdout.write(_to_utf8("category\t%s\t%s\t%s\t%s\t%s\n" % (parent_id, cat_id, name, summary, icon)))
-        sys.stdout.flush()
+        self._write_text("category\t%s\t%s\t%s\t%s\t%s\n" % (parent_id, cat_id, name, summary, icon))
 
     def finished(self):
         '''
         Send 'finished' signal
         '''
-        sys.stdout.write(_to_utf8("finished\n"))
-        sys.stdout.flush()
+        if self._framed:
+            self._write_frame(FRAME_FINISHED, '')
+            return
+        self._write_text("finished\n")
 
     def update_detail(self, package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated):
         '''
@@ -289,8 +374,17 @@ class PackageKitBaseBackend:
         @param issued:
         @param updated:
         '''
-        sys.stdout.write(_to_utf8("updatedetail\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated)))
-        sys.stdout.flush()
+        if self._framed:
+            self._write_frame(FRAME_UPDATE_DETAIL, 'saaaaassssss', package_id,
+                              updates.split(PACKAGE_IDS_DELIM),
+                              obsoletes.split(PACKAGE_IDS_DELIM),
+                              vendor_url.split(';'), bugzilla_url.split(';'),
+                              cve_url.split(';'), restart,
+                              (update_text or '').replace(';', '\n'),
+                              (changelog or '').replace(';', '\n'),
+                              state, issued, updated)
+            return
+        self._write_text("updatedetail\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated))
 
     def require_restart(self, restart_type, details):
         '''
@@ -298,20 +392,21 @@ class PackageKitBaseBackend:
         @param restart_type: RESTART_SYSTEM, RESTART_APPLICATION, RESTART_SESSION
         @param details: Optional details about the restart
         '''
-        sys.stdout.write(_to_utf8("requirerestart\t%s\t%s\n" % (restart_type, details)))
-        sys.stdout.flush()
+        self._write_text("requirerestart\t%s\t%s\n" % (restart_type, details))
 
     def allow_cancel(self, allow):
         '''
         send 'allow-cancel' signal:
         @param allow:  Allow the current process to be aborted.
         '''
+        if self._framed:
+            self._write_frame(FRAME_ALLOW_CANCEL, 'b', allow)
+            return
         if allow:
             data = 'true'
         else:
             data = 'false'
-        sys.stdout.write(_to_utf8("allow-cancel\t%s\n" % data))
-        sys.stdout.flush()
+        self._write_text("allow-cancel\t%s\n" % data)
 
     def repo_signature_required(self, package_id, repo_name, key_url, key_userid, key_id, key_fingerprint, key_timestamp, sig_type):
         '''
@@ -325,10 +420,9 @@ class PackageKitBaseBackend:
         @param key_timestamp:   Key timestamp
         @param sig_type:        Key type (GPG)
         '''
-        sys.stdout.write(_to_utf8("repo-signature-required\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (
+        self._write_text("repo-signature-required\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (
             package_id, repo_name, key_url, key_userid, key_id, key_fingerprint, key_timestamp, sig_type
-            )))
-        sys.stdout.flush()
+            ))
 
     def eula_required(self, eula_id, package_id, vendor_name, license_agreement):
         '''
@@ -338,10 +432,9 @@ class PackageKitBaseBackend:
         @param vendor_name:     Name of the vendor that wrote the EULA
         @param license_agreement: The license text
         '''
-        sys.stdout.write(_to_utf8("eula-required\t%s\t%s\t%s\t%s\n" % (
+        self._write_text("eula-required\t%s\t%s\t%s\t%s\n" % (
             eula_id, package_id, vendor_name, license_agreement
-            )))
-        sys.stdout.flush()
+            ))
 
 #
 # Backend Action Methods
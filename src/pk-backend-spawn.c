@@ -54,9 +54,62 @@
 
 #define	PK_UNSAFE_DELIMITERS	"\\\f\r\t"
 
+/* offered to helpers in the HELPER_PROTOCOL environment variable; a helper
+ * that wants framed output prints "protocol\tframed1" as a text line and
+ * from then on writes only frames, see pk_backend_spawn_inject_frame() */
+#define PK_BACKEND_SPAWN_PROTOCOLS		"text,framed1"
+#define PK_BACKEND_SPAWN_FRAME_FIELDS_MAX	16
+
+typedef enum {
+	PK_BACKEND_SPAWN_FRAME_TEXT,
+	PK_BACKEND_SPAWN_FRAME_FINISHED,
+	PK_BACKEND_SPAWN_FRAME_PACKAGE,
+	PK_BACKEND_SPAWN_FRAME_DETAILS,
+	PK_BACKEND_SPAWN_FRAME_FILES,
+	PK_BACKEND_SPAWN_FRAME_UPDATE_DETAIL,
+	PK_BACKEND_SPAWN_FRAME_PERCENTAGE,
+	PK_BACKEND_SPAWN_FRAME_ITEM_PROGRESS,
+	PK_BACKEND_SPAWN_FRAME_STATUS,
+	PK_BACKEND_SPAWN_FRAME_ALLOW_CANCEL,
+	PK_BACKEND_SPAWN_FRAME_SPEED,
+	PK_BACKEND_SPAWN_FRAME_DOWNLOAD_SIZE_REMAINING,
+	PK_BACKEND_SPAWN_FRAME_LAST
+} PkBackendSpawnFrameCommand;
+
+/* the field types each command takes, using GVariant type characters:
+ * s=string, u=uint32, t=uint64, b=boolean, a=array of strings */
+static const gchar *pk_backend_spawn_frame_signatures[] = {
+	"s",			/* text */
+	"",			/* finished */
+	"sss",			/* package */
+	"sssssst",		/* details */
+	"sa",			/* files */
+	"saaaaassssss",		/* update-detail */
+	"u",			/* percentage */
+	"ssu",			/* item-progress */
+	"s",			/* status */
+	"b",			/* allow-cancel */
+	"t",			/* speed */
+	"t",			/* download-size-remaining */
+	NULL
+};
+
+typedef union {
+	const gchar		*str;
+	gchar			**strv;
+	guint64			 num;
+} PkBackendSpawnFrameField;
+
 struct PkBackendSpawnPrivate
 {
-	PkSpawn			*spawn;
+	PkSpawn			*spawn;		/* the helper of the current job */
+	GPtrArray		*pool;		/* of PkSpawn, most recently used first */
+	GPtrArray		*recycling;	/* of PkSpawn, exiting to be restarted */
+	gboolean		 allow_pool;
+	guint			 pool_max_jobs;
+	guint			 prewarm_id;
+	gchar			*last_argv0;
+	gchar			**last_envp;
 	PkBackend		*backend;
 	PkBackendJob		*job;
 	gchar			*name;
@@ -73,6 +126,10 @@ G_DEFINE_TYPE (PkBackendSpawn, pk_backend_spawn, G_TYPE_OBJECT)
 
 /**
  * pk_backend_spawn_set_filter_stdout:
+ *
+ * Sets a function that can drop lines from the helper before they are
+ * processed. Frames from helpers using the framed protocol are turned back
+ * into lines for it, so backends should not set one just to forward output.
  **/
 gboolean
 pk_backend_spawn_set_filter_stdout (PkBackendSpawn *backend_spawn, PkBackendSpawnFilterFunc func)
@@ -99,12 +156,18 @@ pk_backend_spawn_set_filter_stderr (PkBackendSpawn *backend_spawn, PkBackendSpaw
 static gboolean
 pk_backend_spawn_exit_timeout_cb (PkBackendSpawn *backend_spawn)
 {
+	guint i;
+	PkSpawn *spawn;
+
 	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
 
 	/* only try to close if running */
-	if (pk_spawn_is_running (backend_spawn->priv->spawn)) {
-		g_debug ("closing dispatcher as running and is idle");
-		pk_spawn_exit (backend_spawn->priv->spawn);
+	for (i = 0; i < backend_spawn->priv->pool->len; i++) {
+		spawn = g_ptr_array_index (backend_spawn->priv->pool, i);
+		if (pk_spawn_is_running (spawn)) {
+			g_debug ("closing dispatcher as running and is idle");
+			pk_spawn_exit (spawn);
+		}
 	}
 	backend_spawn->priv->kill_id = 0;
 	return FALSE;
@@ -138,6 +201,133 @@ pk_backend_spawn_start_kill_timer (PkBackendSpawn *backend_spawn)
 	g_source_set_name_by_id (priv->kill_id, "[PkBackendSpawn] exit");
 }
 
+/**
+ * pk_backend_spawn_pool_is_used_up:
+ **/
+static gboolean
+pk_backend_spawn_pool_is_used_up (PkBackendSpawn *backend_spawn, PkSpawn *spawn)
+{
+	if (backend_spawn->priv->pool_max_jobs == 0)
+		return FALSE;
+	return pk_spawn_get_job_count (spawn) >= backend_spawn->priv->pool_max_jobs;
+}
+
+/**
+ * pk_backend_spawn_pool_select:
+ *
+ * Prefer a helper that is already running with the same settings, then
+ * an empty slot, and only then restart the least recently used helper.
+ **/
+static PkSpawn *
+pk_backend_spawn_pool_select (PkBackendSpawn *backend_spawn, gchar **argv, gchar **envp)
+{
+	guint i;
+	guint pool_size;
+	PkSpawn *spawn = NULL;
+	PkSpawn *tmp;
+	GPtrArray *pool = backend_spawn->priv->pool;
+
+	/* only helpers that do not hold the lock between jobs can run side by side */
+	pool_size = backend_spawn->priv->allow_pool ? pool->len : 1;
+	for (i = 0; i < pool_size && spawn == NULL; i++) {
+		tmp = g_ptr_array_index (pool, i);
+		if (pk_spawn_can_reuse (tmp, argv, envp) &&
+		    !pk_backend_spawn_pool_is_used_up (backend_spawn, tmp))
+			spawn = tmp;
+	}
+	for (i = 0; i < pool_size && spawn == NULL; i++) {
+		tmp = g_ptr_array_index (pool, i);
+		if (!pk_spawn_is_running (tmp))
+			spawn = tmp;
+	}
+	if (spawn == NULL)
+		spawn = g_ptr_array_index (pool, pool_size - 1);
+
+	/* move to the front, keeping the pool in most recently used order */
+	g_ptr_array_remove (pool, g_object_ref (spawn));
+	g_ptr_array_insert (pool, 0, spawn);
+	return spawn;
+}
+
+/**
+ * pk_backend_spawn_prewarm_cb:
+ *
+ * Asks a helper that has run too many jobs to exit while the daemon is
+ * idle. The replacement is started from pk_backend_spawn_exit_cb() once it
+ * has gone, so the two never hold the package lock at the same time.
+ **/
+static gboolean
+pk_backend_spawn_prewarm_cb (gpointer user_data)
+{
+	PkBackendSpawn *backend_spawn = PK_BACKEND_SPAWN (user_data);
+	PkBackendSpawnPrivate *priv = backend_spawn->priv;
+	PkSpawn *spawn;
+	guint i;
+
+	priv->prewarm_id = 0;
+
+	/* a new job got there first */
+	if (priv->is_busy)
+		return FALSE;
+
+	for (i = 0; i < priv->pool->len; i++) {
+		spawn = g_ptr_array_index (priv->pool, i);
+		if (!pk_spawn_is_running (spawn))
+			continue;
+		if (!pk_backend_spawn_pool_is_used_up (backend_spawn, spawn))
+			continue;
+		g_debug ("recycling helper after %u jobs",
+			 pk_spawn_get_job_count (spawn));
+		if (pk_spawn_exit_async (spawn))
+			g_ptr_array_add (priv->recycling, spawn);
+	}
+	return FALSE;
+}
+
+/**
+ * pk_backend_spawn_prewarm:
+ **/
+static void
+pk_backend_spawn_prewarm (PkBackendSpawn *backend_spawn, PkSpawn *spawn)
+{
+	PkBackendSpawnPrivate *priv = backend_spawn->priv;
+	gchar *argv[] = { priv->last_argv0, NULL };
+	g_autoptr(GError) error = NULL;
+
+	/* a job has started and will pick its own helper */
+	if (priv->is_busy)
+		return;
+
+	/* with no arguments the helper just waits for a command */
+	if (!pk_spawn_argv (spawn, argv, priv->last_envp,
+			    PK_SPAWN_ARGV_FLAGS_NONE, &error))
+		g_warning ("failed to prewarm helper: %s", error->message);
+}
+
+/**
+ * pk_backend_spawn_finished:
+ **/
+static void
+pk_backend_spawn_finished (PkBackendSpawn *backend_spawn, PkBackendJob *job)
+{
+	PkBackendSpawnPrivate *priv = backend_spawn->priv;
+
+	pk_backend_job_finished (job);
+	priv->is_busy = FALSE;
+
+	/* from this point on, we can start the kill timer */
+	pk_backend_spawn_start_kill_timer (backend_spawn);
+
+	/* replace the helper when idle if it has done enough work */
+	if (priv->prewarm_id == 0 &&
+	    pk_backend_spawn_pool_is_used_up (backend_spawn, priv->spawn)) {
+		priv->prewarm_id = g_idle_add_full (G_PRIORITY_LOW,
+						    pk_backend_spawn_prewarm_cb,
+						    backend_spawn, NULL);
+		g_source_set_name_by_id (priv->prewarm_id, "[PkBackendSpawn] prewarm");
+	}
+}
+
 /**
  * pk_backend_spawn_parse_stdout:
  **/
@@ -236,12 +426,7 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
 			return FALSE;
 		}
-		pk_backend_job_finished (job);
-		priv->is_busy = FALSE;
-
-		/* from this point on, we can start the kill timer */
-		pk_backend_spawn_start_kill_timer (backend_spawn);
-
+		pk_backend_spawn_finished (backend_spawn, job);
 	} else if (g_strcmp0 (command, "files") == 0) {
 		g_auto(GStrv) tmp = NULL;
 		if (size != 3) {
@@ -561,6 +746,17 @@ pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
 			return FALSE;
 		}
 		pk_backend_job_category (job, sections[1], sections[2], sections[3], sections[4], sections[5]);
+	} else if (g_strcmp0 (command, "protocol") == 0) {
+		if (size != 2) {
+			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
+			return FALSE;
+		}
+		if (g_strcmp0 (sections[1], "framed1") != 0) {
+			g_set_error (error, 1, 0, "protocol '%s' not supported", sections[1]);
+			return FALSE;
+		}
+		g_debug ("helper switched to framed output");
+		pk_spawn_set_framed (priv->spawn, TRUE);
 	} else {
 		g_set_error (error, 1, 0, "invalid command '%s'", command);
 		return FALSE;
@@ -577,6 +773,18 @@ pk_backend_spawn_exit_cb (PkSpawn *spawn, PkSpawnExitType exit_enum, PkBackendSp
 	gboolean ret;
 	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
 
+	/* a used up helper has gone, so start its replacement */
+	if (g_ptr_array_remove (backend_spawn->priv->recycling, spawn)) {
+		pk_backend_spawn_prewarm (backend_spawn, spawn);
+		return;
+	}
+
+	/* an idle helper in the pool, not running any job */
+	if (spawn != backend_spawn->priv->spawn) {
+		g_debug ("idle helper exited");
+		return;
+	}
+
 	/* reset the busy flag */
 	backend_spawn->priv->is_busy = FALSE;
 
@@ -627,14 +835,420 @@ pk_backend_spawn_inject_data (PkBackendSpawn *backend_spawn,
 	return pk_backend_spawn_parse_stdout (backend_spawn, job, line, error);
 }
 
+/**
+ * pk_backend_spawn_frame_read_uint32:
+ **/
+static gboolean
+pk_backend_spawn_frame_read_uint32 (const guint8 *data, gsize len, gsize *offset, guint32 *value)
+{
+	if (len - *offset < sizeof (guint32))
+		return FALSE;
+	memcpy (value, data + *offset, sizeof (guint32));
+	*value = GUINT32_FROM_BE (*value);
+	*offset += sizeof (guint32);
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_frame_read_string:
+ *
+ * Strings are a 32 bit length followed by the UTF-8 text and a NUL byte,
+ * so they can be used in place without copying.
+ **/
+static gboolean
+pk_backend_spawn_frame_read_string (const guint8 *data, gsize len, gsize *offset, const gchar **value)
+{
+	guint32 str_len;
+	if (!pk_backend_spawn_frame_read_uint32 (data, len, offset, &str_len))
+		return FALSE;
+	if (len - *offset < (gsize) str_len + 1)
+		return FALSE;
+	if (data[*offset + str_len] != '\0')
+		return FALSE;
+	*value = (const gchar *) data + *offset;
+	*offset += str_len + 1;
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_frame_check_utf8:
+ **/
+static gboolean
+pk_backend_spawn_frame_check_utf8 (const gchar *text, GError **error)
+{
+	if (!g_utf8_validate (text, -1, NULL)) {
+		g_set_error (error, 1, 0, "text '%s' was not valid UTF8!", text);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_frame_parse:
+ *
+ * Checks each field against the signature of the command, and points the
+ * string fields into the frame data. Every string is checked to be valid
+ * UTF-8 here, as they all end up in GVariants sent over D-Bus.
+ **/
+static gboolean
+pk_backend_spawn_frame_parse (const guint8 *data,
+			      gsize len,
+			      PkBackendSpawnFrameCommand *command,
+			      PkBackendSpawnFrameField *fields,
+			      GError **error)
+{
+	const gchar *signature;
+	gsize offset = 1;
+	guint32 count;
+	guint32 tmp;
+	guint64 tmp64;
+	guint i;
+	guint j;
+
+	if (len == 0) {
+		g_set_error_literal (error, 1, 0, "empty frame");
+		return FALSE;
+	}
+	*command = data[0];
+	if (*command >= PK_BACKEND_SPAWN_FRAME_LAST) {
+		g_set_error (error, 1, 0, "invalid frame command %u", *command);
+		return FALSE;
+	}
+
+	signature = pk_backend_spawn_frame_signatures[*command];
+	for (i = 0; signature[i] != '\0'; i++) {
+		if (offset >= len || data[offset] != (guint8) signature[i]) {
+			g_set_error (error, 1, 0,
+				     "frame command %u field %u is not of type '%c'",
+				     *command, i, signature[i]);
+			return FALSE;
+		}
+		offset++;
+		switch (signature[i]) {
+		case 's':
+			if (!pk_backend_spawn_frame_read_string (data, len, &offset, &fields[i].str))
+				goto truncated;
+			if (!pk_backend_spawn_frame_check_utf8 (fields[i].str, error))
+				return FALSE;
+			break;
+		case 'u':
+			if (!pk_backend_spawn_frame_read_uint32 (data, len, &offset, &tmp))
+				goto truncated;
+			fields[i].num = tmp;
+			break;
+		case 't':
+			if (len - offset < sizeof (guint64))
+				goto truncated;
+			memcpy (&tmp64, data + offset, sizeof (guint64));
+			fields[i].num = GUINT64_FROM_BE (tmp64);
+			offset += sizeof (guint64);
+			break;
+		case 'b':
+			if (len - offset < 1)
+				goto truncated;
+			fields[i].num = data[offset++] != 0;
+			break;
+		case 'a':
+			if (!pk_backend_spawn_frame_read_uint32 (data, len, &offset, &count))
+				goto truncated;
+			if (count > len - offset)
+				goto truncated;
+			fields[i].strv = g_new (gchar *, count + 1);
+			for (j = 0; j < count; j++) {
+				if (!pk_backend_spawn_frame_read_string (data, len, &offset,
+									 (const gchar **) &fields[i].strv[j])) {
+					fields[i].strv[j] = NULL;
+					goto truncated;
+				}
+				if (!pk_backend_spawn_frame_check_utf8 (fields[i].strv[j], error)) {
+					fields[i].strv[j + 1] = NULL;
+					return FALSE;
+				}
+			}
+			fields[i].strv[count] = NULL;
+			break;
+		default:
+			g_assert_not_reached ();
+		}
+	}
+	if (offset != len) {
+		g_set_error (error, 1, 0, "frame command %u has trailing data", *command);
+		return FALSE;
+	}
+	return TRUE;
+truncated:
+	g_set_error (error, 1, 0, "frame command %u is truncated", *command);
+	return FALSE;
+}
+
+/**
+ * pk_backend_spawn_frame_fields_free:
+ **/
+static void
+pk_backend_spawn_frame_fields_free (PkBackendSpawnFrameCommand command,
+				    PkBackendSpawnFrameField *fields)
+{
+	const gchar *signature;
+	guint i;
+
+	if (command >= PK_BACKEND_SPAWN_FRAME_LAST)
+		return;
+
+	/* the strings themselves are owned by the frame */
+	signature = pk_backend_spawn_frame_signatures[command];
+	for (i = 0; signature[i] != '\0'; i++) {
+		if (signature[i] == 'a')
+			g_free (fields[i].strv);
+	}
+}
+
+/**
+ * pk_backend_spawn_frame_dispatch:
+ *
+ * Unlike the text protocol the fields are already split, lists arrive as
+ * arrays and newlines need no escaping, so only the values are checked.
+ **/
+static gboolean
+pk_backend_spawn_frame_dispatch (PkBackendSpawn *backend_spawn,
+				 PkBackendJob *job,
+				 PkBackendSpawnFrameCommand command,
+				 PkBackendSpawnFrameField *f,
+				 GError **error)
+{
+	PkInfoEnum info;
+	PkGroupEnum group;
+	PkRestartEnum restart;
+	PkStatusEnum status_enum;
+	PkUpdateStateEnum update_state_enum;
+
+	switch (command) {
+	case PK_BACKEND_SPAWN_FRAME_TEXT:
+		return pk_backend_spawn_inject_data (backend_spawn, job, f[0].str, error);
+	case PK_BACKEND_SPAWN_FRAME_FINISHED:
+		pk_backend_spawn_finished (backend_spawn, job);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_PACKAGE:
+		info = pk_info_enum_from_string (f[0].str);
+		if (info == PK_INFO_ENUM_UNKNOWN) {
+			g_set_error (error, 1, 0, "Info enum not recognised, and hence ignored: '%s'", f[0].str);
+			return FALSE;
+		}
+		if (!pk_package_id_check (f[1].str)) {
+			g_set_error_literal (error, 1, 0, "invalid package_id");
+			return FALSE;
+		}
+		pk_backend_job_package (job, info, f[1].str, f[2].str);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_DETAILS:
+		if (f[6].num > 1073741824) {
+			g_set_error_literal (error, 1, 0,
+					     "package size cannot be that large");
+			return FALSE;
+		}
+		group = pk_group_enum_from_string (f[3].str);
+		pk_backend_job_details (job, f[0].str, f[1].str, f[2].str,
+					group, f[4].str, f[5].str, f[6].num);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_FILES:
+		pk_backend_job_files (job, f[0].str, f[1].strv);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_UPDATE_DETAIL:
+		restart = pk_restart_enum_from_string (f[6].str);
+		if (restart == PK_RESTART_ENUM_UNKNOWN) {
+			g_set_error (error, 1, 0, "Restart enum not recognised, and hence ignored: '%s'", f[6].str);
+			return FALSE;
+		}
+		update_state_enum = pk_update_state_enum_from_string (f[9].str);
+		pk_backend_job_update_detail (job, f[0].str,
+					      f[1].strv, f[2].strv,
+					      f[3].strv, f[4].strv, f[5].strv,
+					      restart, f[7].str, f[8].str,
+					      update_state_enum,
+					      f[10].str, f[11].str);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_PERCENTAGE:
+		if (f[0].num > 100 && f[0].num != PK_BACKEND_PERCENTAGE_INVALID) {
+			g_set_error (error, 1, 0, "invalid percentage value %" G_GUINT64_FORMAT, f[0].num);
+			return FALSE;
+		}
+		pk_backend_job_set_percentage (job, f[0].num);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_ITEM_PROGRESS:
+		if (!pk_package_id_check (f[0].str)) {
+			g_set_error_literal (error, 1, 0, "invalid package_id");
+			return FALSE;
+		}
+		status_enum = pk_status_enum_from_string (f[1].str);
+		if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
+			g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", f[1].str);
+			return FALSE;
+		}
+		if (f[2].num > 100) {
+			g_set_error (error, 1, 0, "invalid item-progress value %" G_GUINT64_FORMAT, f[2].num);
+			return FALSE;
+		}
+		pk_backend_job_set_item_progress (job, f[0].str, status_enum, f[2].num);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_STATUS:
+		status_enum = pk_status_enum_from_string (f[0].str);
+		if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
+			g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", f[0].str);
+			return FALSE;
+		}
+		pk_backend_job_set_status (job, status_enum);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_ALLOW_CANCEL:
+		pk_backend_job_set_allow_cancel (job, f[0].num);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_SPEED:
+		pk_backend_job_set_speed (job, f[0].num);
+		break;
+	case PK_BACKEND_SPAWN_FRAME_DOWNLOAD_SIZE_REMAINING:
+		pk_backend_job_set_download_size_remaining (job, f[0].num);
+		break;
+	default:
+		g_set_error (error, 1, 0, "invalid frame command %u", command);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_frame_to_line:
+ *
+ * Builds the text protocol line equivalent to a frame, so that the stdout
+ * filter of the backend sees the same data whichever protocol the helper
+ * uses.
+ **/
+static gchar *
+pk_backend_spawn_frame_to_line (PkBackendSpawnFrameCommand command,
+				PkBackendSpawnFrameField *f)
+{
+	g_autofree gchar *tmp1 = NULL;
+	g_autofree gchar *tmp2 = NULL;
+	g_autofree gchar *tmp3 = NULL;
+	g_autofree gchar *tmp4 = NULL;
+	g_autofree gchar *tmp5 = NULL;
+
+	switch (command) {
+	case PK_BACKEND_SPAWN_FRAME_TEXT:
+		return g_strdup (f[0].str);
+	case PK_BACKEND_SPAWN_FRAME_FINISHED:
+		return g_strdup ("finished");
+	case PK_BACKEND_SPAWN_FRAME_PACKAGE:
+		return g_strdup_printf ("package\t%s\t%s\t%s",
+					f[0].str, f[1].str, f[2].str);
+	case PK_BACKEND_SPAWN_FRAME_DETAILS:
+		return g_strdup_printf ("details\t%s\t%s\t%s\t%s\t%s\t%s\t%" G_GUINT64_FORMAT,
+					f[0].str, f[1].str, f[2].str, f[3].str,
+					f[4].str, f[5].str, f[6].num);
+	case PK_BACKEND_SPAWN_FRAME_FILES:
+		tmp1 = g_strjoinv (";", f[1].strv);
+		return g_strdup_printf ("files\t%s\t%s", f[0].str, tmp1);
+	case PK_BACKEND_SPAWN_FRAME_UPDATE_DETAIL:
+		tmp1 = g_strjoinv ("&", f[1].strv);
+		tmp2 = g_strjoinv ("&", f[2].strv);
+		tmp3 = g_strjoinv (";", f[3].strv);
+		tmp4 = g_strjoinv (";", f[4].strv);
+		tmp5 = g_strjoinv (";", f[5].strv);
+		return g_strdup_printf ("updatedetail\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s",
+					f[0].str, tmp1, tmp2, tmp3, tmp4, tmp5,
+					f[6].str, f[7].str, f[8].str, f[9].str,
+					f[10].str, f[11].str);
+	case PK_BACKEND_SPAWN_FRAME_PERCENTAGE:
+		return g_strdup_printf ("percentage\t%" G_GUINT64_FORMAT, f[0].num);
+	case PK_BACKEND_SPAWN_FRAME_ITEM_PROGRESS:
+		return g_strdup_printf ("item-progress\t%s\t%s\t%" G_GUINT64_FORMAT,
+					f[0].str, f[1].str, f[2].num);
+	case PK_BACKEND_SPAWN_FRAME_STATUS:
+		return g_strdup_printf ("status\t%s", f[0].str);
+	case PK_BACKEND_SPAWN_FRAME_ALLOW_CANCEL:
+		return g_strdup_printf ("allow-cancel\t%s", f[0].num ? "true" : "false");
+	case PK_BACKEND_SPAWN_FRAME_SPEED:
+		return g_strdup_printf ("speed\t%" G_GUINT64_FORMAT, f[0].num);
+	case PK_BACKEND_SPAWN_FRAME_DOWNLOAD_SIZE_REMAINING:
+		return g_strdup_printf ("download-size-remaining\t%" G_GUINT64_FORMAT, f[0].num);
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * pk_backend_spawn_inject_frame:
+ *
+ * Parses one frame from a helper using the framed protocol. The payload is a
+ * command byte followed by the fields in pk_backend_spawn_frame_signatures,
+ * each prefixed by its type character. Integers are big endian.
+ **/
+gboolean
+pk_backend_spawn_inject_frame (PkBackendSpawn *backend_spawn,
+			       PkBackendJob *job,
+			       const guint8 *data,
+			       gsize len,
+			       GError **error)
+{
+	gboolean ret;
+	PkBackendSpawnFrameCommand command = PK_BACKEND_SPAWN_FRAME_LAST;
+	PkBackendSpawnFrameField fields[PK_BACKEND_SPAWN_FRAME_FIELDS_MAX] = { { NULL } };
+
+	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+
+	ret = pk_backend_spawn_frame_parse (data, len, &command, fields, error);
+	if (!ret)
+		goto out;
+
+	/* text frames go through the filter in pk_backend_spawn_inject_data() */
+	if (backend_spawn->priv->stdout_func != NULL &&
+	    command != PK_BACKEND_SPAWN_FRAME_TEXT) {
+		g_autofree gchar *line = NULL;
+		line = pk_backend_spawn_frame_to_line (command, fields);
+		if (!backend_spawn->priv->stdout_func (job, line))
+			goto out;
+	}
+	ret = pk_backend_spawn_frame_dispatch (backend_spawn, job, command, fields, error);
+out:
+	pk_backend_spawn_frame_fields_free (command, fields);
+	return ret;
+}
+
+/**
+ * pk_backend_spawn_frame_cb:
+ **/
+static void
+pk_backend_spawn_frame_cb (PkSpawn *spawn, const guint8 *data, guint len, PkBackendSpawn *backend_spawn)
+{
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+
+	if (spawn != backend_spawn->priv->spawn) {
+		g_debug ("ignoring frame from idle helper");
+		return;
+	}
+	ret = pk_backend_spawn_inject_frame (backend_spawn,
+					     backend_spawn->priv->job,
+					     data, len,
+					     &error);
+	if (!ret)
+		g_warning ("failed to parse frame: %s", error->message);
+}
+
 /**
  * pk_backend_spawn_stdout_cb:
  **/
 static void
-pk_backend_spawn_stdout_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendSpawn *backend_spawn)
+pk_backend_spawn_stdout_cb (PkSpawn *spawn, const gchar *line, PkBackendSpawn *backend_spawn)
 {
 	gboolean ret;
 	g_autoptr(GError) error = NULL;
+
+	/* an idle helper in the pool can only negotiate the protocol */
+	if (spawn != backend_spawn->priv->spawn) {
+		if (g_strcmp0 (line, "protocol\tframed1") == 0)
+			pk_spawn_set_framed (spawn, TRUE);
+		else
+			g_debug ("ignoring output from idle helper: %s", line);
+		return;
+	}
 	ret = pk_backend_spawn_inject_data (backend_spawn,
 					    backend_spawn->priv->job,
 					    line,
@@ -647,7 +1261,7 @@ pk_backend_spawn_stdout_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendS
  * pk_backend_spawn_stderr_cb:
  **/
 static void
-pk_backend_spawn_stderr_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendSpawn *backend_spawn)
+pk_backend_spawn_stderr_cb (PkSpawn *spawn, const gchar *line, PkBackendSpawn *backend_spawn)
 {
 	gboolean ret;
 	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
@@ -799,6 +1413,11 @@ pk_backend_spawn_get_envp (PkBackendSpawn *backend_spawn)
 				      g_strdup_printf ("%u", cache_age));
 	}
 
+	/* HELPER_PROTOCOL */
+	g_hash_table_replace (env_table,
+			      g_strdup ("HELPER_PROTOCOL"),
+			      g_strdup (PK_BACKEND_SPAWN_PROTOCOLS));
+
 	/* copy hashed environment key/value pairs to envp */
 	envp = g_new0 (gchar *, g_hash_table_size (env_table) + 1);
 	g_hash_table_iter_init (&env_iter, env_table);
@@ -928,6 +1547,18 @@ pk_backend_spawn_helper_va_list (PkBackendSpawn *backend_spawn,
 	g_free (argv[PK_BACKEND_SPAWN_ARGV0]);
 	argv[PK_BACKEND_SPAWN_ARGV0] = g_strdup (filename);
 
+	/* use a helper from the pool, replacing it if it has done enough work */
+	envp = pk_backend_spawn_get_envp (backend_spawn);
+	priv->spawn = pk_backend_spawn_pool_select (backend_spawn, argv, envp);
+	if (pk_backend_spawn_pool_is_used_up (backend_spawn, priv->spawn))
+		flags |= PK_SPAWN_ARGV_FLAGS_NEVER_REUSE;
+
+	/* save these so a replacement helper can be started when idle */
+	g_free (priv->last_argv0);
+	priv->last_argv0 = g_strdup (argv[0]);
+	g_strfreev (priv->last_envp);
+	priv->last_envp = g_strdupv (envp);
+
 	/* copy idle setting from backend to PkSpawn instance */
 	background = pk_backend_job_get_background (job);
 	g_object_set (priv->spawn,
@@ -940,7 +1571,6 @@ pk_backend_spawn_helper_va_list (PkBackendSpawn *backend_spawn,
 #endif
 
 	priv->finished = FALSE;
-	envp = pk_backend_spawn_get_envp (backend_spawn);
 	if (!pk_spawn_argv (priv->spawn, argv, envp, flags, &error)) {
 		pk_backend_job_error_code (priv->job,
 					   PK_ERROR_ENUM_INTERNAL_ERROR,
@@ -1013,8 +1643,15 @@ pk_backend_spawn_is_busy (PkBackendSpawn *backend_spawn)
 gboolean
 pk_backend_spawn_exit (PkBackendSpawn *backend_spawn)
 {
+	guint i;
+	PkSpawn *spawn;
+
 	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
-	pk_spawn_exit (backend_spawn->priv->spawn);
+	for (i = 0; i < backend_spawn->priv->pool->len; i++) {
+		spawn = g_ptr_array_index (backend_spawn->priv->pool, i);
+		if (pk_spawn_is_running (spawn))
+			pk_spawn_exit (spawn);
+	}
 	return TRUE;
 }
 
@@ -1058,10 +1695,31 @@ pk_backend_spawn_helper (PkBackendSpawn *backend_spawn,
 void
 pk_backend_spawn_set_allow_sigkill (PkBackendSpawn *backend_spawn, gboolean allow_sigkill)
 {
+	guint i;
+
 	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
-	g_object_set (backend_spawn->priv->spawn,
-		      "allow-sigkill", allow_sigkill,
-		      NULL);
+	for (i = 0; i < backend_spawn->priv->pool->len; i++) {
+		g_object_set (g_ptr_array_index (backend_spawn->priv->pool, i),
+			      "allow-sigkill", allow_sigkill,
+			      NULL);
+	}
+}
+
+/**
+ * pk_backend_spawn_set_allow_pool:
+ *
+ * Allows more than one helper to be kept running, as set by
+ * BackendSpawnPoolSize. Only backends whose helpers take the package lock
+ * for each command and release it before reporting finished may set this,
+ * as pooled helpers are idle side by side and any of them can be given the
+ * next job. Helpers that lock when they start, like yum, must not be
+ * pooled.
+ **/
+void
+pk_backend_spawn_set_allow_pool (PkBackendSpawn *backend_spawn, gboolean allow_pool)
+{
+	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
+	backend_spawn->priv->allow_pool = allow_pool;
 }
 
 /**
@@ -1078,10 +1736,15 @@ pk_backend_spawn_finalize (GObject *object)
 
 	if (backend_spawn->priv->kill_id > 0)
 		g_source_remove (backend_spawn->priv->kill_id);
+	if (backend_spawn->priv->prewarm_id > 0)
+		g_source_remove (backend_spawn->priv->prewarm_id);
 
 	g_free (backend_spawn->priv->name);
+	g_free (backend_spawn->priv->last_argv0);
+	g_strfreev (backend_spawn->priv->last_envp);
 	g_key_file_unref (backend_spawn->priv->conf);
-	g_object_unref (backend_spawn->priv->spawn);
+	g_ptr_array_unref (backend_spawn->priv->recycling);
+	g_ptr_array_unref (backend_spawn->priv->pool);
 	if (backend_spawn->priv->backend != NULL)
 		g_object_unref (backend_spawn->priv->backend);
 
@@ -1115,15 +1778,36 @@ PkBackendSpawn *
 pk_backend_spawn_new (GKeyFile *conf)
 {
 	PkBackendSpawn *backend_spawn;
+	PkSpawn *spawn;
+	gint pool_size;
+	gint i;
+
 	backend_spawn = g_object_new (PK_TYPE_BACKEND_SPAWN, NULL);
 	backend_spawn->priv->conf = g_key_file_ref (conf);
-	backend_spawn->priv->spawn = pk_spawn_new (backend_spawn->priv->conf);
-	g_signal_connect (backend_spawn->priv->spawn, "exit",
-			  G_CALLBACK (pk_backend_spawn_exit_cb), backend_spawn);
-	g_signal_connect (backend_spawn->priv->spawn, "stdout",
-			  G_CALLBACK (pk_backend_spawn_stdout_cb), backend_spawn);
-	g_signal_connect (backend_spawn->priv->spawn, "stderr",
-			  G_CALLBACK (pk_backend_spawn_stderr_cb), backend_spawn);
+
+	/* get policy for the helper pool */
+	pool_size = g_key_file_get_integer (conf, "Daemon", "BackendSpawnPoolSize", NULL);
+	if (pool_size < 1)
+		pool_size = 1;
+	backend_spawn->priv->pool_max_jobs = MAX (g_key_file_get_integer (conf, "Daemon",
+									  "BackendSpawnMaxJobs",
+									  NULL), 0);
+
+	backend_spawn->priv->pool = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	backend_spawn->priv->recycling = g_ptr_array_new ();
+	for (i = 0; i < pool_size; i++) {
+		spawn = pk_spawn_new (backend_spawn->priv->conf);
+		g_signal_connect (spawn, "exit",
+				  G_CALLBACK (pk_backend_spawn_exit_cb), backend_spawn);
+		g_signal_connect (spawn, "stdout",
+				  G_CALLBACK (pk_backend_spawn_stdout_cb), backend_spawn);
+		g_signal_connect (spawn, "frame",
+				  G_CALLBACK (pk_backend_spawn_frame_cb), backend_spawn);
+		g_signal_connect (spawn, "stderr",
+				  G_CALLBACK (pk_backend_spawn_stderr_cb), backend_spawn);
+		g_ptr_array_add (backend_spawn->priv->pool, spawn);
+	}
+	backend_spawn->priv->spawn = g_ptr_array_index (backend_spawn->priv->pool, 0);
 	return PK_BACKEND_SPAWN (backend_spawn);
 }
 
@@ -64,10 +64,17 @@ gboolean	 pk_backend_spawn_set_name		(PkBackendSpawn	*backend_spawn,
 							 const gchar	*name);
 void		 pk_backend_spawn_set_allow_sigkill	(PkBackendSpawn	*backend_spawn,
 							 gboolean	 allow_sigkill);
+void		 pk_backend_spawn_set_allow_pool	(PkBackendSpawn	*backend_spawn,
+							 gboolean	 allow_pool);
 gboolean	 pk_backend_spawn_inject_data		(PkBackendSpawn *backend_spawn,
 							 PkBackendJob	*job,
 							 const gchar	*line,
 							 GError		**error);
+gboolean	 pk_backend_spawn_inject_frame		(PkBackendSpawn *backend_spawn,
+							 PkBackendJob	*job,
+							 const guint8	*data,
+							 gsize		 len,
+							 GError		**error);
 
 /* filtering */
 typedef gboolean (*PkBackendSpawnFilterFunc)		(PkBackendJob	*job,
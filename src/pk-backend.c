@@ -207,6 +207,7 @@ struct PkBackendPrivate
 	guint			 repo_list_changed_id;
 	guint			 installed_db_changed_id;
 	guint			 updates_changed_id;
+	gint			 generation;	/* atomic */
 };
 
 G_DEFINE_TYPE (PkBackend, pk_backend, G_TYPE_OBJECT)
@@ -643,6 +644,7 @@ pk_backend_repo_list_changed_cb (gpointer user_data)
 	PkBackend *backend = PK_BACKEND (user_data);
 
 	g_debug ("emitting repo-list-changed");
+	g_atomic_int_inc (&backend->priv->generation);
 	g_signal_emit (backend, signals [SIGNAL_REPO_LIST_CHANGED], 0);
 	backend->priv->repo_list_changed_id = 0;
 	return FALSE;
@@ -678,6 +680,7 @@ pk_backend_updates_changed (PkBackend *backend)
 	g_return_val_if_fail (pk_is_thread_default (), FALSE);
 
 	g_debug ("emitting updates-changed");
+	g_atomic_int_inc (&backend->priv->generation);
 	g_signal_emit (backend, signals [SIGNAL_UPDATES_CHANGED], 0);
 	return TRUE;
 }
@@ -697,6 +700,9 @@ pk_backend_finished_updates_changed_cb (gpointer data)
 /**
  * pk_backend_updates_changed_delay:
  *
+ * The generation is bumped straight away, so queries started before the
+ * UpdatesChanged signal is emitted do not get results from the cache.
+ *
  * This function can be called on any thread.
  **/
 gboolean
@@ -704,6 +710,9 @@ pk_backend_updates_changed_delay (PkBackend *backend, guint timeout)
 {
 	g_return_val_if_fail (PK_IS_BACKEND (backend), FALSE);
 
+	/* cached results are stale now, not just once the signal is sent */
+	g_atomic_int_inc (&backend->priv->generation);
+
 	/* check if we did this more than once */
 	if (backend->priv->updates_changed_id != 0)
 		return FALSE;
@@ -718,6 +727,22 @@ pk_backend_updates_changed_delay (PkBackend *backend, guint timeout)
 	return TRUE;
 }
 
+/**
+ * pk_backend_get_generation:
+ *
+ * The generation is incremented each time the package database, the list
+ * of updates or the repo list may have changed, so query results obtained
+ * with the same generation can be shared.
+ *
+ * Return value: the current backend state generation
+ **/
+guint
+pk_backend_get_generation (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), 0);
+	return (guint) g_atomic_int_get (&backend->priv->generation);
+}
+
 /**
  * pk_backend_installed_db_changed_cb:
  **/
@@ -727,6 +752,7 @@ pk_backend_installed_db_changed_cb (gpointer user_data)
 	PkBackend *backend = PK_BACKEND (user_data);
 	g_autoptr(GError) error = NULL;
 
+	g_atomic_int_inc (&backend->priv->generation);
 	if (!backend->priv->transaction_in_progress) {
 		g_debug ("invalidating offline updates");
 		if (!pk_offline_auth_invalidate (&error))
@@ -90,6 +90,7 @@ void		 pk_backend_installed_db_changed	(PkBackend      *backend);
 gboolean	 pk_backend_updates_changed		(PkBackend	*backend);
 gboolean	 pk_backend_updates_changed_delay	(PkBackend	*backend,
 							 guint		 timeout);
+guint		 pk_backend_get_generation		(PkBackend	*backend);
 
 void		 pk_backend_transaction_inhibit_start	(PkBackend      *backend);
 void		 pk_backend_transaction_inhibit_end	(PkBackend      *backend);
@@ -67,6 +67,10 @@ pk_dbus_get_uid (PkDbus *dbus, const gchar *sender)
 	g_return_val_if_fail (sender != NULL, G_MAXUINT);
 
 	/* set in the test suite */
+	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit.Other") == 0) {
+		g_debug ("using self-check shortcut for another user");
+		return 501;
+	}
 	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
 		g_debug ("using self-check shortcut");
 		return 500;
@@ -108,7 +112,7 @@ pk_dbus_get_pid (PkDbus *dbus, const gchar *sender)
 	g_return_val_if_fail (sender != NULL, G_MAXUINT);
 
 	/* set in the test suite */
-	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
+	if (g_str_has_prefix (sender, ":org.freedesktop.PackageKit")) {
 		g_debug ("using self-check shortcut");
 		return G_MAXUINT - 1;
 	}
@@ -157,7 +161,7 @@ pk_dbus_get_cmdline (PkDbus *dbus, const gchar *sender)
 	g_return_val_if_fail (sender != NULL, NULL);
 
 	/* set in the test suite */
-	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
+	if (g_str_has_prefix (sender, ":org.freedesktop.PackageKit")) {
 		g_debug ("using self-check shortcut");
 		return g_strdup ("/usr/sbin/packagekit");
 	}
@@ -230,7 +234,7 @@ pk_dbus_get_session (PkDbus *dbus, const gchar *sender)
 	g_return_val_if_fail (sender != NULL, NULL);
 
 	/* set in the test suite */
-	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
+	if (g_str_has_prefix (sender, ":org.freedesktop.PackageKit")) {
 		g_debug ("using self-check shortcut");
 		session = g_strdup ("xxx");
 		goto out;
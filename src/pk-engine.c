@@ -58,6 +58,7 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC(PolkitSubject, g_object_unref)
 
 static void     pk_engine_finalize	(GObject       *object);
 static void	pk_engine_set_locked (PkEngine *engine, gboolean is_locked);
+static void	pk_engine_set_queue_depth (PkEngine *engine, guint queue_depth);
 
 #define PK_ENGINE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_ENGINE, PkEnginePrivate))
 
@@ -94,6 +95,7 @@ struct PkEnginePrivate
 	guint			 timeout_normal_id;
 	PolkitAuthority		*authority;
 	gboolean		 locked;
+	guint			 queue_depth;
 	PkNetworkEnum		 network_state;
 	guint			 owner_id;
 	GDBusNodeInfo		*introspection;
@@ -187,6 +189,7 @@ pk_engine_scheduler_changed_cb (PkScheduler *scheduler, PkEngine *engine)
 	/* automatically locked if the transaction cannot be cancelled */
 	pk_engine_set_locked (engine, pk_scheduler_get_locked (scheduler));
 	pk_engine_set_inhibited (engine, pk_scheduler_get_inhibited (scheduler));
+	pk_engine_set_queue_depth (engine, pk_scheduler_get_queue_depth (scheduler));
 
 	transaction_list = pk_scheduler_get_array (scheduler);
 	g_dbus_connection_emit_signal (engine->priv->connection,
@@ -352,6 +355,25 @@ pk_engine_set_locked (PkEngine *engine, gboolean is_locked)
 					 g_variant_new_boolean (is_locked));
 }
 
+/**
+ * pk_engine_set_queue_depth:
+ **/
+static void
+pk_engine_set_queue_depth (PkEngine *engine, guint queue_depth)
+{
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	/* already set */
+	if (engine->priv->queue_depth == queue_depth)
+		return;
+	engine->priv->queue_depth = queue_depth;
+
+	/* emit */
+	pk_engine_emit_property_changed (engine,
+					 "QueueDepth",
+					 g_variant_new_uint32 (queue_depth));
+}
+
 /**
  * pk_engine_backend_repo_list_changed_cb:
  **/
@@ -1161,6 +1183,16 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 		return g_variant_new_uint32 (engine->priv->network_state);
 	if (g_strcmp0 (property_name, "DistroId") == 0)
 		return _g_variant_new_maybe_string (engine->priv->distro_id);
+	if (g_strcmp0 (property_name, "QueueDepth") == 0)
+		return g_variant_new_uint32 (pk_scheduler_get_queue_depth (engine->priv->scheduler));
+	if (g_strcmp0 (property_name, "QueueWaitTimeAverage") == 0)
+		return g_variant_new_uint32 (pk_scheduler_get_wait_time_average (engine->priv->scheduler));
+	if (g_strcmp0 (property_name, "QueueWaitTimeMax") == 0)
+		return g_variant_new_uint32 (pk_scheduler_get_wait_time_max (engine->priv->scheduler));
+	if (g_strcmp0 (property_name, "ResultsCacheHits") == 0)
+		return g_variant_new_uint32 (pk_scheduler_get_results_cache_hits (engine->priv->scheduler));
+	if (g_strcmp0 (property_name, "ResultsCacheMisses") == 0)
+		return g_variant_new_uint32 (pk_scheduler_get_results_cache_misses (engine->priv->scheduler));
 
 	/* return an error */
 	g_set_error (error,
@@ -1172,61 +1204,36 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 }
 
 /**
- * pk_engine_package_name_in_strv:
- **/
-static gboolean
-pk_engine_package_name_in_strv (gchar **strv, PkPackage *pkg)
-{
-	guint i;
-	for (i = 0; strv[i] != NULL; i++) {
-		if (g_strcmp0 (strv[i], pk_package_get_name (pkg)) == 0)
-			return TRUE;
-	}
-	return FALSE;
-}
-
-/**
- * pk_engine_get_package_history_pkg:
+ * pk_engine_get_package_history_cb:
  *
- * Create a 'a{sv}' GVariant instance from all the PkTransactionPast data
+ * Create a 'a{sv}' GVariant instance from a package history entry
  **/
-static GVariant *
-pk_engine_get_package_history_pkg (PkTransactionPast *item, PkPackage *pkg)
+static void
+pk_engine_get_package_history_cb (const gchar *package_id,
+				  PkInfoEnum info,
+				  gint64 timestamp,
+				  guint uid,
+				  gpointer user_data)
 {
+	GPtrArray *array = (GPtrArray *) user_data;
 	GVariantBuilder builder;
+	g_auto(GStrv) split = NULL;
+
+	split = pk_package_id_split (package_id);
+	if (split == NULL)
+		return;
 	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
 	g_variant_builder_add (&builder, "{sv}", "info",
-			       g_variant_new_uint32 (pk_package_get_info (pkg)));
+			       g_variant_new_uint32 (info));
 	g_variant_builder_add (&builder, "{sv}", "source",
-			       g_variant_new_string (pk_package_get_data (pkg)));
+			       g_variant_new_string (split[PK_PACKAGE_ID_DATA]));
 	g_variant_builder_add (&builder, "{sv}", "version",
-			       g_variant_new_string (pk_package_get_version (pkg)));
+			       g_variant_new_string (split[PK_PACKAGE_ID_VERSION]));
 	g_variant_builder_add (&builder, "{sv}", "timestamp",
-			       g_variant_new_uint64 (pk_transaction_past_get_timestamp (item)));
+			       g_variant_new_uint64 (timestamp));
 	g_variant_builder_add (&builder, "{sv}", "user-id",
-			       g_variant_new_uint32 (pk_transaction_past_get_uid (item)));
-	return g_variant_builder_end (&builder);
-}
-
-/**
- * pk_engine_is_package_history_interesing:
- **/
-static gboolean
-pk_engine_is_package_history_interesing (PkPackage *package)
-{
-	gboolean ret;
-
-	switch (pk_package_get_info (package)) {
-	case PK_INFO_ENUM_INSTALLING:
-	case PK_INFO_ENUM_REMOVING:
-	case PK_INFO_ENUM_UPDATING:
-		ret = TRUE;
-		break;
-	default:
-		ret = FALSE;
-		break;
-	}
-	return ret;
+			       g_variant_new_uint32 (uid));
+	g_ptr_array_add (array, g_variant_builder_end (&builder));
 }
 
 /**
@@ -1238,120 +1245,45 @@ pk_engine_get_package_history (PkEngine *engine,
 			       guint max_size,
 			       GError **error)
 {
-	const gchar *data;
-	const gchar *pkgname;
-	gboolean ret;
-	gchar *key;
-	gint64 timestamp;
-	GList *l;
-	GList *list;
-	GPtrArray *array = NULL;
 	guint i;
 	GVariantBuilder builder;
-	GVariant *value = NULL;
-	PkTransactionPast *item;
-	g_autoptr(GHashTable) deduplicate_hash = NULL;
 	g_autoptr(GHashTable) pkgname_hash = NULL;
-	g_autoptr(GList) keys = NULL;
-	g_autoptr(PkPackage) package_tmp = NULL;
-
-	list = pk_transaction_db_get_list (engine->priv->transaction_db, max_size);
 
-	/* simplify the loop */
-	if (max_size == 0)
-		max_size = G_MAXUINT;
+	/* the history is indexed by package name, so there is no need to
+	 * look at the transactions that did not touch these packages */
+	pkgname_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{saa{sv}}"));
+	for (i = 0; package_names[i] != NULL; i++) {
+		GVariant *value;
+		g_autoptr(GPtrArray) array = NULL;
 
-	pkgname_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
-	deduplicate_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-	package_tmp = pk_package_new ();
-	for (l = list; l != NULL; l = l->next) {
-		g_auto(GStrv) package_lines = NULL;
-		item = PK_TRANSACTION_PAST (l->data);
-
-		/* ignore anything that failed */
-		if (!pk_transaction_past_get_succeeded (item))
+		if (g_hash_table_contains (pkgname_hash, package_names[i]))
 			continue;
-
-		/* split up data */
-		data = pk_transaction_past_get_data (item);
-		if (data == NULL)
-			continue;
-		package_lines = g_strsplit (data, "\n", -1);
-		for (i = 0; package_lines[i] != NULL; i++) {
-			g_autoptr(GError) error_local = NULL;
-			ret = pk_package_parse (package_tmp,
-						package_lines[i],
-						&error_local);
-			if (!ret) {
-				g_warning ("Failed to parse package: '%s': %s",
-					   package_lines[i], error_local->message);
-				continue;
-			}
-
-			/* not the package we care about */
-			if (!pk_engine_package_name_in_strv (package_names, package_tmp))
-				continue;
-
-			/* not a state we care about */
-			if (!pk_engine_is_package_history_interesing (package_tmp))
-				continue;
-
-			/* transactions without a timestamp are not interesting */
-			timestamp = pk_transaction_past_get_timestamp (item);
-			if (timestamp == 0)
-				continue;
-
-			/* de-duplicate the entry, in the case of multiarch */
-			key = g_strdup_printf ("%s-%" G_GINT64_FORMAT,
-					       pk_package_get_name (package_tmp),
-					       timestamp);
-			if (g_hash_table_lookup (deduplicate_hash, key) != NULL) {
-				g_free (key);
-				continue;
-			}
-			g_hash_table_insert (deduplicate_hash, key, package_lines[i]);
-
-			/* get the blob for this data item */
-			value = pk_engine_get_package_history_pkg (item, package_tmp);
-			if (value == NULL)
-				continue;
-
-			/* find the array */
-			pkgname = pk_package_get_name (package_tmp);
-			array = g_hash_table_lookup (pkgname_hash, pkgname);
-			if (array == NULL) {
-				array = g_ptr_array_new ();
-				g_hash_table_insert (pkgname_hash,
-						     g_strdup (pkgname),
-						     array);
-			}
-			g_ptr_array_add (array, value);
+		g_hash_table_add (pkgname_hash, package_names[i]);
+
+		array = g_ptr_array_new ();
+		if (!pk_transaction_db_get_package_history (engine->priv->transaction_db,
+							    package_names[i],
+							    max_size,
+							    pk_engine_get_package_history_cb,
+							    array,
+							    error)) {
+			g_ptr_array_foreach (array, (GFunc) g_variant_unref, NULL);
+			g_variant_builder_clear (&builder);
+			return NULL;
 		}
-	}
 
-	/* no history returns an empty array */
-	if (g_hash_table_size (pkgname_hash) == 0) {
-		value = g_variant_new_array (G_VARIANT_TYPE ("{saa{sv}}"), NULL, 0);
-		goto out;
-	}
+		/* no history for this package */
+		if (array->len == 0)
+			continue;
 
-	/* we have a hash of pkgname:GPtrArray where the GPtrArray is an array
-	 * of GVariants of type a{sv} */
-	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	keys = g_hash_table_get_keys (pkgname_hash);
-	for (l = keys; l != NULL; l = l->next) {
-		pkgname = l->data;
-		array = g_hash_table_lookup (pkgname_hash, pkgname);
 		/* create aa{sv} */
-		value = g_variant_new_array (NULL,
+		value = g_variant_new_array (G_VARIANT_TYPE ("a{sv}"),
 					     (GVariant * const *) array->pdata,
-					     MIN (array->len, max_size));
-		g_variant_builder_add (&builder, "{s@aa{sv}}", pkgname, value);
+					     array->len);
+		g_variant_builder_add (&builder, "{s@aa{sv}}", package_names[i], value);
 	}
-	value = g_variant_builder_end (&builder);
-out:
-	g_list_free_full (list, (GDestroyNotify) g_object_unref);
-	return value;
+	return g_variant_builder_end (&builder);
 }
 
 /**
@@ -1375,8 +1307,11 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 	gchar **package_names;
 	guint size;
 	gboolean is_priority = TRUE;
+	PkTransaction *transaction;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *data = NULL;
+	g_autofree gchar **hints = NULL;
+	g_autoptr(GVariant) params = NULL;
 	g_auto(GStrv) array = NULL;
 
 	g_return_if_fail (PK_IS_ENGINE (engine));
@@ -1448,6 +1383,39 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 		return;
 	}
 
+	if (g_strcmp0 (method_name, "StartTransaction") == 0) {
+		g_variant_get (parameters, "(^a&s&sv)", &hints, &tmp, &params);
+		g_debug ("StartTransaction method called for %s", tmp);
+		data = pk_transaction_db_generate_id (engine->priv->transaction_db);
+		g_assert (data != NULL);
+		ret = pk_scheduler_create (engine->priv->scheduler,
+					   data, sender, &error);
+		if (!ret) {
+			g_dbus_method_invocation_return_error (invocation,
+							       PK_ENGINE_ERROR,
+							       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
+							       "could not create transaction %s: %s",
+							       data,
+							       error->message);
+			return;
+		}
+
+		/* same as SetHints() and then the method on the new object */
+		transaction = pk_scheduler_get_transaction (engine->priv->scheduler, data);
+		if (!pk_transaction_start (transaction, hints, tmp, params, &error)) {
+			/* a failed method will already have removed it */
+			if (pk_scheduler_get_transaction (engine->priv->scheduler, data) != NULL)
+				pk_scheduler_remove (engine->priv->scheduler, data);
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
+
+		g_debug ("sending object path: '%s'", data);
+		value = g_variant_new ("(o)", data);
+		g_dbus_method_invocation_return_value (invocation, value);
+		return;
+	}
+
 	if (g_strcmp0 (method_name, "GetTransactionList") == 0) {
 		transaction_list = pk_scheduler_get_array (engine->priv->scheduler);
 		value = g_variant_new ("(^a&o)", transaction_list);
@@ -1811,6 +1779,43 @@ pk_engine_offline_method_call (GDBusConnection *connection_, const gchar *sender
 	}
 }
 
+/**
+ * pk_engine_debug_method_call:
+ **/
+static void
+pk_engine_debug_method_call (GDBusConnection *connection_, const gchar *sender,
+			     const gchar *object_path, const gchar *interface_name,
+			     const gchar *method_name, GVariant *parameters,
+			     GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkTrace *trace;
+
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	/* reset the timer */
+	pk_engine_reset_timer (engine);
+
+	trace = pk_scheduler_get_trace (engine->priv->scheduler);
+	if (g_strcmp0 (method_name, "GetLatencyHistogram") == 0) {
+		g_dbus_method_invocation_return_value (invocation,
+						       pk_trace_get_histogram (trace));
+		return;
+	}
+	if (g_strcmp0 (method_name, "ResetLatencyHistogram") == 0) {
+		if (pk_dbus_get_uid (engine->priv->dbus, sender) != 0) {
+			g_dbus_method_invocation_return_error (invocation,
+							       PK_ENGINE_ERROR,
+							       PK_ENGINE_ERROR_DENIED,
+							       "only root can reset the histogram");
+			return;
+		}
+		pk_trace_reset (trace);
+		g_dbus_method_invocation_return_value (invocation, NULL);
+		return;
+	}
+}
+
 #ifdef HAVE_SYSTEMD
 /**
  * pk_engine_proxy_logind_cb:
@@ -1849,6 +1854,11 @@ pk_engine_on_bus_acquired_cb (GDBusConnection *connection,
 		pk_engine_offline_get_property,
 		NULL
 	};
+	static const GDBusInterfaceVTable iface_debug_vtable = {
+		pk_engine_debug_method_call,
+		NULL,
+		NULL
+	};
 
 	/* save copy for emitting signals */
 	engine->priv->connection = g_object_ref (connection);
@@ -1883,6 +1893,14 @@ pk_engine_on_bus_acquired_cb (GDBusConnection *connection,
 							     NULL,  /* user_data_free_func */
 							     NULL); /* GError** */
 	g_assert (registration_id > 0);
+	registration_id = g_dbus_connection_register_object (connection,
+							     PK_DBUS_PATH,
+							     engine->priv->introspection->interfaces[2],
+							     &iface_debug_vtable,
+							     engine,  /* user_data */
+							     NULL,  /* user_data_free_func */
+							     NULL); /* GError** */
+	g_assert (registration_id > 0);
 }
 
 
@@ -42,6 +42,26 @@
  * 		ELSE
  * 			Do nothing
  * 		Transaction.Destroy()
+ *
+ * Queue Ordering:
+ *
+ * Committed transactions wait in one of two binary heaps, one for exclusive
+ * transactions and one for those that can run in parallel. Each is ordered
+ * by a due time, which is the commit time plus a delay derived from:
+ *
+ *  - whether the transaction was started in the background
+ *  - the cost class of the role, so that cheap queries overtake updates
+ *  - how many transactions the same uid already has waiting
+ *
+ * Ties are broken by commit order. As a transaction is never overtaken by one
+ * committed after its own due time, nothing waits forever.
+ *
+ * Read-only transactions that are identical to one already waiting or running
+ * are not queued at all. They follow the earlier transaction and are finished
+ * with a copy of its results, unless it is cancelled in which case they are
+ * queued again. The successful results of some cheap but common queries are
+ * also kept until the backend state generation changes, so that polling
+ * clients are answered without running anything on the backend.
 **/
 
 #include "config.h"
@@ -68,6 +88,7 @@
 #include "pk-scheduler.h"
 
 static void     pk_scheduler_finalize	(GObject	*object);
+static void     pk_scheduler_dispatch	(PkScheduler	*scheduler);
 
 #define PK_SCHEDULER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_SCHEDULER, PkSchedulerPrivate))
 
@@ -86,16 +107,41 @@ static void     pk_scheduler_finalize	(GObject	*object);
 /* maximum number of requests a given user is able to request and queue */
 #define PK_SCHEDULER_SIMULTANEOUS_TRANSACTIONS_FOR_UID	500
 
+/* how long a queued transaction can be overtaken by newer ones */
+#define PK_SCHEDULER_DELAY_BACKGROUND			60000 /* ms */
+#define PK_SCHEDULER_DELAY_DOWNLOAD			2000 /* ms */
+#define PK_SCHEDULER_DELAY_MODIFY			5000 /* ms */
+#define PK_SCHEDULER_DELAY_PER_QUEUED_FOR_UID		1000 /* ms */
+
+/* how long cached results can be used if nothing else invalidates them */
+#define PK_SCHEDULER_RESULTS_CACHE_TIMEOUT		3600 /* s */
+
 struct PkSchedulerPrivate
 {
 	GPtrArray		*array;
+	GPtrArray		*running;
+	GPtrArray		*queue_exclusive;
+	GPtrArray		*queue_parallel;
+	GHashTable		*queued_for_uid;
+	GHashTable		*coalesce;
+	GHashTable		*results_cache;
+	guint			 results_cache_generation;
+	guint			 results_cache_hits;
+	guint			 results_cache_misses;
+	guint64			 queue_seq;
+	guint64			 dispatched;
+	gint64			 wait_total;
+	gint64			 wait_max;
+	gint64			 delay_background;
 	guint			 unwedge_id;
 	GKeyFile		*conf;
 	PkBackend		*backend;
 	GDBusNodeInfo		*introspection;
+	PkTrace			*trace;
+	gboolean		 trace_enabled;
 };
 
-typedef struct {
+typedef struct PkSchedulerItem {
 	PkTransaction		*transaction;
 	PkScheduler		*scheduler;
 	gchar			*tid;
@@ -107,8 +153,24 @@ typedef struct {
 	gulong			 allow_cancel_changed_id;
 	guint			 uid;
 	guint			 tries;
+	GPtrArray		*queue;
+	guint			 queue_idx;
+	guint64			 queue_seq;
+	gint64			 queued;
+	gint64			 due;
+	gchar			*coalesce_key;
+	guint			 generation;
+	struct PkSchedulerItem	*leader;
+	GPtrArray		*subscribers;
+	PkResults		*replay;
+	gboolean		 shared;
 } PkSchedulerItem;
 
+typedef struct {
+	PkResults		*results;
+	gint64			 created;
+} PkSchedulerCacheItem;
+
 enum {
 	PK_SCHEDULER_CHANGED,
 	PK_SCHEDULER_LAST_SIGNAL
@@ -213,11 +275,440 @@ pk_scheduler_item_free (PkSchedulerItem *item)
 		g_source_remove (item->idle_id);
 	if (item->remove_id != 0)
 		g_source_remove (item->remove_id);
+	if (item->replay != NULL)
+		g_object_unref (item->replay);
+	if (item->subscribers != NULL)
+		g_ptr_array_unref (item->subscribers);
 	g_object_unref (item->scheduler);
+	g_free (item->coalesce_key);
 	g_free (item->tid);
 	g_free (item);
 }
 
+/**
+ * pk_scheduler_item_before:
+ *
+ * Return value: %TRUE if @a should be run before @b
+ **/
+static gboolean
+pk_scheduler_item_before (PkSchedulerItem *a, PkSchedulerItem *b)
+{
+	if (a->due != b->due)
+		return a->due < b->due;
+	return a->queue_seq < b->queue_seq;
+}
+
+/**
+ * pk_scheduler_queue_swap:
+ **/
+static void
+pk_scheduler_queue_swap (GPtrArray *queue, guint i, guint j)
+{
+	PkSchedulerItem *item_i = g_ptr_array_index (queue, i);
+	PkSchedulerItem *item_j = g_ptr_array_index (queue, j);
+
+	g_ptr_array_index (queue, i) = item_j;
+	g_ptr_array_index (queue, j) = item_i;
+	item_j->queue_idx = i;
+	item_i->queue_idx = j;
+}
+
+/**
+ * pk_scheduler_queue_sift_up:
+ **/
+static void
+pk_scheduler_queue_sift_up (GPtrArray *queue, guint idx)
+{
+	guint parent;
+
+	while (idx > 0) {
+		parent = (idx - 1) / 2;
+		if (!pk_scheduler_item_before (g_ptr_array_index (queue, idx),
+					       g_ptr_array_index (queue, parent)))
+			break;
+		pk_scheduler_queue_swap (queue, idx, parent);
+		idx = parent;
+	}
+}
+
+/**
+ * pk_scheduler_queue_sift_down:
+ **/
+static void
+pk_scheduler_queue_sift_down (GPtrArray *queue, guint idx)
+{
+	guint child;
+	guint best;
+
+	for (;;) {
+		best = idx;
+		child = 2 * idx + 1;
+		if (child < queue->len &&
+		    pk_scheduler_item_before (g_ptr_array_index (queue, child),
+					      g_ptr_array_index (queue, best)))
+			best = child;
+		child++;
+		if (child < queue->len &&
+		    pk_scheduler_item_before (g_ptr_array_index (queue, child),
+					      g_ptr_array_index (queue, best)))
+			best = child;
+		if (best == idx)
+			break;
+		pk_scheduler_queue_swap (queue, idx, best);
+		idx = best;
+	}
+}
+
+/**
+ * pk_scheduler_queue_insert:
+ *
+ * Adds the item to a heap without changing when it is due.
+ **/
+static void
+pk_scheduler_queue_insert (GPtrArray *queue, PkSchedulerItem *item)
+{
+	item->queue = queue;
+	item->queue_idx = queue->len;
+	g_ptr_array_add (queue, item);
+	pk_scheduler_queue_sift_up (queue, item->queue_idx);
+}
+
+/**
+ * pk_scheduler_queue_unlink:
+ **/
+static void
+pk_scheduler_queue_unlink (PkSchedulerItem *item)
+{
+	GPtrArray *queue = item->queue;
+	PkSchedulerItem *moved;
+	guint idx = item->queue_idx;
+	guint last;
+
+	/* move the last entry into the hole and restore the heap order */
+	last = queue->len - 1;
+	if (idx != last)
+		pk_scheduler_queue_swap (queue, idx, last);
+	g_ptr_array_remove_index (queue, last);
+	if (idx < queue->len) {
+		moved = g_ptr_array_index (queue, idx);
+		pk_scheduler_queue_sift_up (queue, idx);
+		pk_scheduler_queue_sift_down (queue, moved->queue_idx);
+	}
+	item->queue = NULL;
+}
+
+/**
+ * pk_scheduler_queue_remove:
+ **/
+static void
+pk_scheduler_queue_remove (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	guint queued;
+
+	/* not waiting */
+	if (item->queue == NULL)
+		return;
+	pk_scheduler_queue_unlink (item);
+
+	queued = GPOINTER_TO_UINT (g_hash_table_lookup (scheduler->priv->queued_for_uid,
+							 GUINT_TO_POINTER (item->uid)));
+	if (queued > 1) {
+		g_hash_table_insert (scheduler->priv->queued_for_uid,
+				     GUINT_TO_POINTER (item->uid),
+				     GUINT_TO_POINTER (queued - 1));
+	} else {
+		g_hash_table_remove (scheduler->priv->queued_for_uid,
+				     GUINT_TO_POINTER (item->uid));
+	}
+}
+
+/**
+ * pk_scheduler_role_get_delay:
+ *
+ * Return value: how long a transaction of this role may be overtaken, in ms
+ **/
+static gint64
+pk_scheduler_role_get_delay (PkRoleEnum role)
+{
+	switch (role) {
+	case PK_ROLE_ENUM_REFRESH_CACHE:
+	case PK_ROLE_ENUM_DOWNLOAD_PACKAGES:
+		return PK_SCHEDULER_DELAY_DOWNLOAD;
+	case PK_ROLE_ENUM_INSTALL_PACKAGES:
+	case PK_ROLE_ENUM_INSTALL_FILES:
+	case PK_ROLE_ENUM_INSTALL_SIGNATURE:
+	case PK_ROLE_ENUM_REMOVE_PACKAGES:
+	case PK_ROLE_ENUM_UPDATE_PACKAGES:
+	case PK_ROLE_ENUM_UPGRADE_SYSTEM:
+	case PK_ROLE_ENUM_REPAIR_SYSTEM:
+	case PK_ROLE_ENUM_ACCEPT_EULA:
+	case PK_ROLE_ENUM_REPO_ENABLE:
+	case PK_ROLE_ENUM_REPO_SET_DATA:
+	case PK_ROLE_ENUM_REPO_REMOVE:
+		return PK_SCHEDULER_DELAY_MODIFY;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * pk_scheduler_queue_push:
+ *
+ * Works out when the committed item is due and adds it to the right queue.
+ **/
+static void
+pk_scheduler_queue_push (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkSchedulerPrivate *priv = scheduler->priv;
+	gint64 delay;
+	guint queued;
+
+	/* already waiting, e.g. committed twice */
+	if (item->queue != NULL)
+		return;
+
+	queued = GPOINTER_TO_UINT (g_hash_table_lookup (priv->queued_for_uid,
+							 GUINT_TO_POINTER (item->uid)));
+	delay = pk_scheduler_role_get_delay (pk_transaction_get_role (item->transaction));
+	if (pk_transaction_get_background (item->transaction))
+		delay += priv->delay_background;
+	delay += (gint64) queued * PK_SCHEDULER_DELAY_PER_QUEUED_FOR_UID;
+
+	item->queued = g_get_monotonic_time ();
+	item->due = item->queued + delay * 1000;
+	item->queue_seq = priv->queue_seq++;
+	g_hash_table_insert (priv->queued_for_uid,
+			     GUINT_TO_POINTER (item->uid),
+			     GUINT_TO_POINTER (queued + 1));
+
+	if (pk_transaction_is_exclusive (item->transaction))
+		pk_scheduler_queue_insert (priv->queue_exclusive, item);
+	else
+		pk_scheduler_queue_insert (priv->queue_parallel, item);
+}
+
+/**
+ * pk_scheduler_replay_idle_cb:
+ **/
+static gboolean
+pk_scheduler_replay_idle_cb (PkSchedulerItem *item)
+{
+	g_autoptr(PkResults) results = item->replay;
+
+	item->replay = NULL;
+	item->idle_id = 0;
+	pk_transaction_replay_results (item->transaction, results);
+	return FALSE;
+}
+
+/**
+ * pk_scheduler_replay:
+ *
+ * Finishes the committed item with a copy of @results.
+ **/
+static void
+pk_scheduler_replay (PkSchedulerItem *item, PkResults *results)
+{
+	/* add this idle, so that we don't have a deep out-of-order callchain */
+	item->shared = TRUE;
+	item->replay = g_object_ref (results);
+	item->idle_id = g_idle_add ((GSourceFunc) pk_scheduler_replay_idle_cb, item);
+	g_source_set_name_by_id (item->idle_id, "[PkScheduler] replay");
+}
+
+/**
+ * pk_scheduler_cache_item_free:
+ **/
+static void
+pk_scheduler_cache_item_free (PkSchedulerCacheItem *cache_item)
+{
+	g_object_unref (cache_item->results);
+	g_free (cache_item);
+}
+
+/**
+ * pk_scheduler_role_is_cacheable:
+ **/
+static gboolean
+pk_scheduler_role_is_cacheable (PkRoleEnum role)
+{
+	return role == PK_ROLE_ENUM_GET_UPDATES ||
+	       role == PK_ROLE_ENUM_GET_PACKAGES ||
+	       role == PK_ROLE_ENUM_GET_REPO_LIST;
+}
+
+/**
+ * pk_scheduler_results_cache_check_generation:
+ *
+ * Drops all the cached results if the backend state has changed.
+ **/
+static void
+pk_scheduler_results_cache_check_generation (PkScheduler *scheduler)
+{
+	PkSchedulerPrivate *priv = scheduler->priv;
+	guint generation = pk_backend_get_generation (priv->backend);
+
+	if (priv->results_cache_generation == generation)
+		return;
+	g_debug ("backend state changed, invalidating %u cached results",
+		 g_hash_table_size (priv->results_cache));
+	g_hash_table_remove_all (priv->results_cache);
+	priv->results_cache_generation = generation;
+}
+
+/**
+ * pk_scheduler_results_cache_lookup:
+ *
+ * Return value: cached results for the item, or %NULL. Do not unref.
+ **/
+static PkResults *
+pk_scheduler_results_cache_lookup (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkSchedulerCacheItem *cache_item;
+	PkSchedulerPrivate *priv = scheduler->priv;
+	gint64 age;
+	guint cache_age;
+
+	if (!pk_scheduler_role_is_cacheable (pk_transaction_get_role (item->transaction)))
+		return NULL;
+
+	pk_scheduler_results_cache_check_generation (scheduler);
+	cache_item = g_hash_table_lookup (priv->results_cache, item->coalesce_key);
+	if (cache_item != NULL) {
+		/* the client may want fresher results than this */
+		age = (g_get_monotonic_time () - cache_item->created) / G_USEC_PER_SEC;
+		cache_age = pk_backend_job_get_cache_age (pk_transaction_get_backend_job (item->transaction));
+		if (age < PK_SCHEDULER_RESULTS_CACHE_TIMEOUT && age < cache_age) {
+			priv->results_cache_hits++;
+			return cache_item->results;
+		}
+		g_hash_table_remove (priv->results_cache, item->coalesce_key);
+	}
+	priv->results_cache_misses++;
+	return NULL;
+}
+
+/**
+ * pk_scheduler_results_cache_add:
+ **/
+static void
+pk_scheduler_results_cache_add (PkScheduler *scheduler,
+				PkSchedulerItem *item,
+				PkResults *results)
+{
+	PkSchedulerCacheItem *cache_item;
+	PkSchedulerPrivate *priv = scheduler->priv;
+
+	if (item->coalesce_key == NULL)
+		return;
+	if (!pk_scheduler_role_is_cacheable (pk_transaction_get_role (item->transaction)))
+		return;
+	if (pk_results_get_exit_code (results) != PK_EXIT_ENUM_SUCCESS)
+		return;
+
+	/* the backend state changed while this was running */
+	pk_scheduler_results_cache_check_generation (scheduler);
+	if (item->generation != priv->results_cache_generation)
+		return;
+
+	cache_item = g_new0 (PkSchedulerCacheItem, 1);
+	cache_item->results = g_object_ref (results);
+	cache_item->created = g_get_monotonic_time ();
+	g_hash_table_insert (priv->results_cache,
+			     g_strdup (item->coalesce_key),
+			     cache_item);
+}
+
+/**
+ * pk_scheduler_enqueue:
+ *
+ * Queues the committed item, or makes it follow an identical transaction
+ * that is already waiting or running.
+ **/
+static void
+pk_scheduler_enqueue (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkResults *results;
+	PkSchedulerItem *leader;
+	PkSchedulerPrivate *priv = scheduler->priv;
+
+	/* being retried, so keep any followers */
+	if (item->coalesce_key != NULL &&
+	    g_hash_table_lookup (priv->coalesce, item->coalesce_key) == item) {
+		pk_scheduler_queue_push (scheduler, item);
+		return;
+	}
+
+	g_free (item->coalesce_key);
+	item->coalesce_key = pk_transaction_get_coalesce_key (item->transaction);
+	item->generation = pk_backend_get_generation (priv->backend);
+	if (item->coalesce_key != NULL) {
+		results = pk_scheduler_results_cache_lookup (scheduler, item);
+		if (results != NULL) {
+			g_debug ("%s is using cached results", item->tid);
+			pk_scheduler_replay (item, results);
+			return;
+		}
+		leader = g_hash_table_lookup (priv->coalesce, item->coalesce_key);
+		if (leader != NULL) {
+			g_debug ("%s will share the results of %s",
+				 item->tid, leader->tid);
+			if (leader->subscribers == NULL)
+				leader->subscribers = g_ptr_array_new ();
+			g_ptr_array_add (leader->subscribers, item);
+			item->leader = leader;
+			return;
+		}
+		g_hash_table_insert (priv->coalesce, item->coalesce_key, item);
+	}
+	pk_scheduler_queue_push (scheduler, item);
+}
+
+/**
+ * pk_scheduler_coalesce_release:
+ * @results: the results to give to the followers, or %NULL to queue them
+ *
+ * Stops the item following or being followed by other transactions.
+ **/
+static void
+pk_scheduler_coalesce_release (PkScheduler *scheduler,
+			       PkSchedulerItem *item,
+			       PkResults *results)
+{
+	PkSchedulerItem *subscriber;
+	PkSchedulerPrivate *priv = scheduler->priv;
+	guint i;
+	g_autoptr(GPtrArray) subscribers = NULL;
+
+	/* stop following */
+	if (item->leader != NULL) {
+		g_ptr_array_remove (item->leader->subscribers, item);
+		item->leader = NULL;
+	}
+	if (item->replay != NULL) {
+		g_source_remove (item->idle_id);
+		item->idle_id = 0;
+		g_clear_object (&item->replay);
+	}
+
+	/* stop leading */
+	if (item->coalesce_key != NULL &&
+	    g_hash_table_lookup (priv->coalesce, item->coalesce_key) == item)
+		g_hash_table_remove (priv->coalesce, item->coalesce_key);
+	subscribers = item->subscribers;
+	item->subscribers = NULL;
+	if (subscribers == NULL)
+		return;
+	for (i = 0; i < subscribers->len; i++) {
+		subscriber = g_ptr_array_index (subscribers, i);
+		subscriber->leader = NULL;
+		if (results == NULL)
+			pk_scheduler_enqueue (scheduler, subscriber);
+		else
+			pk_scheduler_replay (subscriber, results);
+	}
+}
+
 /**
  * pk_scheduler_remove_internal:
  **/
@@ -235,7 +726,11 @@ pk_scheduler_remove_internal (PkScheduler *scheduler, PkSchedulerItem *item)
 		g_warning ("could not remove %p as not present in list", item);
 		return FALSE;
 	}
+	pk_scheduler_queue_remove (scheduler, item);
+	g_ptr_array_remove (scheduler->priv->running, item);
+	pk_scheduler_coalesce_release (scheduler, item, NULL);
 	pk_scheduler_item_free (item);
+	pk_scheduler_dispatch (scheduler);
 
 	return TRUE;
 }
@@ -320,7 +815,20 @@ pk_scheduler_run_idle_cb (PkSchedulerItem *item)
 static void
 pk_scheduler_run_item (PkScheduler *scheduler, PkSchedulerItem *item)
 {
+	PkSchedulerPrivate *priv = scheduler->priv;
+	gint64 wait;
+
+	/* record how long it was queued for */
+	if (item->queue != NULL) {
+		pk_scheduler_queue_remove (scheduler, item);
+		wait = g_get_monotonic_time () - item->queued;
+		priv->wait_total += wait;
+		priv->wait_max = MAX (priv->wait_max, wait);
+		priv->dispatched++;
+	}
+
 	/* we set this here so that we don't try starting more than one */
+	g_ptr_array_add (priv->running, item);
 	pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_RUNNING);
 
 	/* add this idle, so that we don't have a deep out-of-order callchain */
@@ -335,25 +843,8 @@ pk_scheduler_run_item (PkScheduler *scheduler, PkSchedulerItem *item)
 static GPtrArray *
 pk_scheduler_get_active_transactions (PkScheduler *scheduler)
 {
-	guint i;
-	GPtrArray *array;
-	GPtrArray *res;
-	PkSchedulerItem *item;
-
 	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), NULL);
-
-	/* create array to store the results */
-	res = g_ptr_array_new ();
-
-	/* find the runner with the transaction ID */
-	array = scheduler->priv->array;
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		if (pk_transaction_get_state (item->transaction) == PK_TRANSACTION_STATE_RUNNING)
-			g_ptr_array_add (res, item);
-	}
-
-	return res;
+	return g_ptr_array_ref (scheduler->priv->running);
 }
 
 /**
@@ -420,57 +911,49 @@ pk_scheduler_get_background_running (PkScheduler *scheduler)
 
 /**
  * pk_scheduler_get_next_item:
+ *
+ * Return value: the most urgent queued item that can be run now, or %NULL
  **/
 static PkSchedulerItem *
 pk_scheduler_get_next_item (PkScheduler *scheduler)
 {
+	PkSchedulerPrivate *priv = scheduler->priv;
 	PkSchedulerItem *item = NULL;
-	GPtrArray *array;
-	guint i;
-	PkTransactionState state;
-	gboolean exclusive_running;
-
-	array = scheduler->priv->array;
+	PkSchedulerItem *item_exclusive;
+
+	/* transactions can be made exclusive while they wait */
+	while (priv->queue_parallel->len > 0) {
+		item = g_ptr_array_index (priv->queue_parallel, 0);
+		if (!pk_transaction_is_exclusive (item->transaction))
+			break;
+		pk_scheduler_queue_unlink (item);
+		pk_scheduler_queue_insert (priv->queue_exclusive, item);
+		item = NULL;
+	}
 
-	/* check for running exclusive transaction */
-	exclusive_running = pk_scheduler_get_exclusive_running (scheduler) > 0;
+	/* an exclusive transaction has to wait for the lock to be released */
+	if (priv->queue_exclusive->len == 0 ||
+	    pk_scheduler_get_exclusive_running (scheduler) > 0)
+		return item;
 
-	/* first try the waiting non-background transactions */
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		state = pk_transaction_get_state (item->transaction);
-
-		if ((state == PK_TRANSACTION_STATE_READY) && (!pk_transaction_get_background (item->transaction))) {
-			/* check if we can run the transaction now or if we need to wait for lock release */
-			if (pk_transaction_is_exclusive (item->transaction)) {
-				if (!exclusive_running)
-					goto out;
-			} else {
-				goto out;
-			}
-		}
-	}
+	item_exclusive = g_ptr_array_index (priv->queue_exclusive, 0);
+	if (item == NULL || pk_scheduler_item_before (item_exclusive, item))
+		return item_exclusive;
+	return item;
+}
 
-	/* then try the other waiting transactions (background tasks) */
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		state = pk_transaction_get_state (item->transaction);
+/**
+ * pk_scheduler_dispatch:
+ **/
+static void
+pk_scheduler_dispatch (PkScheduler *scheduler)
+{
+	PkSchedulerItem *item;
 
-		if (state == PK_TRANSACTION_STATE_READY) {
-			/* check if we can run the transaction now or if we need to wait for lock release */
-			if (pk_transaction_is_exclusive (item->transaction)) {
-				if (!exclusive_running)
-					goto out;
-			} else {
-				goto out;
-			}
-		}
+	while ((item = pk_scheduler_get_next_item (scheduler)) != NULL) {
+		g_debug ("running %s", item->tid);
+		pk_scheduler_run_item (scheduler, item);
 	}
-
-	/* nothing to run */
-	item = NULL;
-out:
-	return item;
 }
 
 /**
@@ -500,9 +983,6 @@ pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 		item->commit_id = 0;
 	}
 
-	/* we will changed what is running */
-	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
-
 	/* is one of the current running transactions background, and this new
 	 * transaction foreground? */
 	if (!pk_transaction_get_background (item->transaction) &&
@@ -512,10 +992,12 @@ pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 		pk_scheduler_cancel_background (scheduler);
 	}
 
-	/* do the transaction now, if possible */
-	if (pk_transaction_is_exclusive (item->transaction) == FALSE ||
-	    pk_scheduler_get_exclusive_running (scheduler) == 0)
-		pk_scheduler_run_item (scheduler, item);
+	/* queue the transaction and run whatever is most urgent now */
+	pk_scheduler_enqueue (scheduler, item);
+	pk_scheduler_dispatch (scheduler);
+
+	/* we have changed what is running */
+	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
 }
 
 /**
@@ -559,6 +1041,8 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 	PkSchedulerItem *item;
 	PkTransactionState state;
 	PkBackendJob *job;
+	PkExitEnum exit_enum;
+	PkResults *results;
 	const gchar *tid;
 
 	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
@@ -575,6 +1059,10 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 		return;
 	}
 
+	/* not running or waiting any more, until committed again */
+	g_ptr_array_remove (scheduler->priv->running, item);
+	pk_scheduler_queue_remove (scheduler, item);
+
 	if (pk_transaction_is_finished_with_lock_required (item->transaction)) {
 		pk_transaction_reset_after_lock_error (item->transaction);
 
@@ -603,6 +1091,16 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 		}
 		pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_FINISHED);
 
+		/* anything following this gets the same results, unless cancelled */
+		results = pk_transaction_get_results (item->transaction);
+		exit_enum = pk_results_get_exit_code (results);
+		if (exit_enum == PK_EXIT_ENUM_CANCELLED ||
+		    exit_enum == PK_EXIT_ENUM_CANCELLED_PRIORITY)
+			results = NULL;
+		else if (!item->shared)
+			pk_scheduler_results_cache_add (scheduler, item, results);
+		pk_scheduler_coalesce_release (scheduler, item, results);
+
 		/* give the client a few seconds to still query the runner */
 		item->remove_id = g_timeout_add_seconds (PK_TRANSACTION_KEEP_FINISHED_TIMOUT,
 							 pk_scheduler_remove_item_cb,
@@ -610,12 +1108,8 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 		g_source_set_name_by_id (item->remove_id, "[PkScheduler] remove");
 	}
 
-	/* try to run the next transaction, if possible */
-	item = pk_scheduler_get_next_item (scheduler);
-	if (item != NULL) {
-		g_debug ("running %s as previous one finished", item->tid);
-		pk_scheduler_run_item (scheduler, item);
-	}
+	/* try to run the next transactions, if possible */
+	pk_scheduler_dispatch (scheduler);
 
 	/* we have changed what is running */
 	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
@@ -701,6 +1195,10 @@ pk_scheduler_create (PkScheduler *scheduler,
 					G_CALLBACK (pk_scheduler_transaction_allow_cancel_changed_cb),
 					scheduler);
 
+	/* report stage timings when finished */
+	if (scheduler->priv->trace_enabled)
+		pk_transaction_set_trace (item->transaction, scheduler->priv->trace);
+
 	/* set transaction state */
 	pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_NEW);
 
@@ -913,6 +1411,69 @@ pk_scheduler_get_size (PkScheduler *scheduler)
 	return scheduler->priv->array->len;
 }
 
+/**
+ * pk_scheduler_get_queue_depth:
+ *
+ * Return value: the number of committed transactions waiting to be run
+ **/
+guint
+pk_scheduler_get_queue_depth (PkScheduler *scheduler)
+{
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), 0);
+	return scheduler->priv->queue_exclusive->len +
+	       scheduler->priv->queue_parallel->len;
+}
+
+/**
+ * pk_scheduler_get_wait_time_average:
+ *
+ * Return value: the mean time transactions were queued before being run, in ms
+ **/
+guint
+pk_scheduler_get_wait_time_average (PkScheduler *scheduler)
+{
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), 0);
+	if (scheduler->priv->dispatched == 0)
+		return 0;
+	return scheduler->priv->wait_total / scheduler->priv->dispatched / 1000;
+}
+
+/**
+ * pk_scheduler_get_wait_time_max:
+ *
+ * Return value: the longest time a transaction was queued before being run, in ms
+ **/
+guint
+pk_scheduler_get_wait_time_max (PkScheduler *scheduler)
+{
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), 0);
+	return scheduler->priv->wait_max / 1000;
+}
+
+/**
+ * pk_scheduler_get_results_cache_hits:
+ *
+ * Return value: the number of transactions answered from cached results
+ **/
+guint
+pk_scheduler_get_results_cache_hits (PkScheduler *scheduler)
+{
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), 0);
+	return scheduler->priv->results_cache_hits;
+}
+
+/**
+ * pk_scheduler_get_results_cache_misses:
+ *
+ * Return value: the number of cacheable transactions that had to be run
+ **/
+guint
+pk_scheduler_get_results_cache_misses (PkScheduler *scheduler)
+{
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), 0);
+	return scheduler->priv->results_cache_misses;
+}
+
 /**
  * pk_scheduler_get_state:
  **/
@@ -1079,6 +1640,19 @@ pk_scheduler_set_backend (PkScheduler *scheduler,
 	scheduler->priv->backend = g_object_ref (backend);
 }
 
+/**
+ * pk_scheduler_get_trace:
+ *
+ * Return value: (transfer none): the transaction latency histogram, which is
+ * only filled in if TransactionTracing is set in the config file
+ **/
+PkTrace *
+pk_scheduler_get_trace (PkScheduler *scheduler)
+{
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), NULL);
+	return scheduler->priv->trace;
+}
+
 /**
  * pk_scheduler_class_init:
  * @klass: The PkSchedulerClass
@@ -1108,8 +1682,16 @@ pk_scheduler_init (PkScheduler *scheduler)
 {
 	scheduler->priv = PK_SCHEDULER_GET_PRIVATE (scheduler);
 	scheduler->priv->array = g_ptr_array_new ();
+	scheduler->priv->running = g_ptr_array_new ();
+	scheduler->priv->queue_exclusive = g_ptr_array_new ();
+	scheduler->priv->queue_parallel = g_ptr_array_new ();
+	scheduler->priv->queued_for_uid = g_hash_table_new (g_direct_hash, g_direct_equal);
+	scheduler->priv->coalesce = g_hash_table_new (g_str_hash, g_str_equal);
+	scheduler->priv->results_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+								(GDestroyNotify) pk_scheduler_cache_item_free);
 	scheduler->priv->introspection = pk_load_introspection (PK_DBUS_INTERFACE_TRANSACTION ".xml",
 							    NULL);
+	scheduler->priv->trace = pk_trace_new ();
 	scheduler->priv->unwedge_id = g_timeout_add_seconds (PK_TRANSACTION_WEDGE_CHECK,
 							  (GSourceFunc) pk_scheduler_wedge_check, scheduler);
 	g_source_set_name_by_id (scheduler->priv->unwedge_id, "[PkScheduler] wedge-check (main)");
@@ -1135,7 +1717,14 @@ pk_scheduler_finalize (GObject *object)
 
 	g_ptr_array_foreach (scheduler->priv->array, (GFunc) pk_scheduler_item_free, NULL);
 	g_ptr_array_free (scheduler->priv->array, TRUE);
+	g_ptr_array_unref (scheduler->priv->running);
+	g_ptr_array_unref (scheduler->priv->queue_exclusive);
+	g_ptr_array_unref (scheduler->priv->queue_parallel);
+	g_hash_table_unref (scheduler->priv->queued_for_uid);
+	g_hash_table_unref (scheduler->priv->coalesce);
+	g_hash_table_unref (scheduler->priv->results_cache);
 	g_dbus_node_info_unref (scheduler->priv->introspection);
+	g_object_unref (scheduler->priv->trace);
 	g_key_file_unref (scheduler->priv->conf);
 	if (scheduler->priv->backend != NULL)
 		g_object_unref (scheduler->priv->backend);
@@ -1152,7 +1741,28 @@ PkScheduler *
 pk_scheduler_new (GKeyFile *conf)
 {
 	PkScheduler *scheduler = PK_SCHEDULER (g_object_new (PK_TYPE_SCHEDULER, NULL));
+	gint delay;
+	g_autofree gchar *trace_file = NULL;
+	g_autoptr(GError) error = NULL;
+
 	scheduler->priv->conf = g_key_file_ref (conf);
+
+	/* how long background transactions can be overtaken, in seconds */
+	delay = g_key_file_get_integer (conf, "Daemon", "BackgroundQueueDelay", NULL);
+	if (delay > 0)
+		scheduler->priv->delay_background = (gint64) delay * 1000;
+	else
+		scheduler->priv->delay_background = PK_SCHEDULER_DELAY_BACKGROUND;
+
+	/* optionally time each stage of every transaction */
+	scheduler->priv->trace_enabled = g_key_file_get_boolean (conf, "Daemon",
+								 "TransactionTracing",
+								 NULL);
+	trace_file = g_key_file_get_string (conf, "Daemon", "TransactionTraceFile", NULL);
+	if (scheduler->priv->trace_enabled && trace_file != NULL && trace_file[0] != '\0') {
+		if (!pk_trace_set_filename (scheduler->priv->trace, trace_file, &error))
+			g_warning ("failed to open %s: %s", trace_file, error->message);
+	}
 	return scheduler;
 }
 
@@ -25,6 +25,7 @@
 #include <glib-object.h>
 #include <packagekit-glib2/pk-enum.h>
 
+#include "pk-trace.h"
 #include "pk-transaction.h"
 
 G_BEGIN_DECLS
@@ -71,6 +72,11 @@ gchar		**pk_scheduler_get_array	(PkScheduler	*scheduler)
 gchar		*pk_scheduler_get_state		(PkScheduler	*scheduler)
 						 G_GNUC_WARN_UNUSED_RESULT;
 guint		 pk_scheduler_get_size		(PkScheduler	*scheduler);
+guint		 pk_scheduler_get_queue_depth	(PkScheduler	*scheduler);
+guint		 pk_scheduler_get_wait_time_average	(PkScheduler	*scheduler);
+guint		 pk_scheduler_get_wait_time_max	(PkScheduler	*scheduler);
+guint		 pk_scheduler_get_results_cache_hits	(PkScheduler	*scheduler);
+guint		 pk_scheduler_get_results_cache_misses	(PkScheduler	*scheduler);
 gboolean	 pk_scheduler_get_locked	(PkScheduler	*scheduler);
 gboolean	 pk_scheduler_get_inhibited	(PkScheduler	*scheduler);
 PkTransaction	*pk_scheduler_get_transaction	(PkScheduler	*scheduler,
@@ -79,6 +85,7 @@ void		 pk_scheduler_cancel_background	(PkScheduler	*scheduler);
 void		 pk_scheduler_cancel_queued	(PkScheduler	*scheduler);
 void		 pk_scheduler_set_backend	(PkScheduler	*scheduler,
 						 PkBackend	*backend);
+PkTrace		*pk_scheduler_get_trace		(PkScheduler	*scheduler);
 
 G_END_DECLS
 
@@ -24,12 +24,14 @@
 #include <glib.h>
 #include <glib-object.h>
 #include <glib/gstdio.h>
+#include <string.h>
 
 #include "pk-backend.h"
 #include "pk-backend-spawn.h"
 #include "pk-dbus.h"
 #include "pk-engine.h"
 #include "pk-spawn.h"
+#include "pk-trace.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
 #include "pk-transaction-private.h"
@@ -324,6 +326,32 @@ pk_test_backend_spawn_package_cb (PkBackend *backend, PkInfoEnum info,
 	_backend_spawn_number_packages++;
 }
 
+static gchar *_backend_spawn_filtered_line = NULL;
+
+/**
+ * pk_test_backend_spawn_filter_cb:
+ **/
+static gboolean
+pk_test_backend_spawn_filter_cb (PkBackendJob *job, const gchar *line)
+{
+	g_free (_backend_spawn_filtered_line);
+	_backend_spawn_filtered_line = g_strdup (line);
+	return !g_str_has_prefix (line, "package\t");
+}
+
+/**
+ * pk_test_frame_add_string:
+ **/
+static void
+pk_test_frame_add_string (GByteArray *frame, const gchar *str)
+{
+	guint8 type = 's';
+	guint32 len = GUINT32_TO_BE (strlen (str));
+	g_byte_array_append (frame, &type, 1);
+	g_byte_array_append (frame, (const guint8 *) &len, sizeof (len));
+	g_byte_array_append (frame, (const guint8 *) str, strlen (str) + 1);
+}
+
 static void
 pk_test_backend_spawn_func (void)
 {
@@ -331,6 +359,8 @@ pk_test_backend_spawn_func (void)
 	const gchar *text;
 	gboolean ret;
 	gchar *uri;
+	guint8 frame_command = 2; /* package */
+	GByteArray *frame;
 	GError *error = NULL;
 	g_autoptr(GKeyFile) conf = NULL;
 	g_autoptr(PkBackend) backend = NULL;
@@ -436,6 +466,57 @@ pk_test_backend_spawn_func (void)
 		"package\tinstalled\tgnome-power-manager;0.0.1;i386;data\tMore useless software", NULL);
 	g_assert (ret);
 
+	/* test pk_backend_spawn_inject_frame Package */
+	frame = g_byte_array_new ();
+	g_byte_array_append (frame, &frame_command, 1);
+	pk_test_frame_add_string (frame, "installed");
+	pk_test_frame_add_string (frame, "gnome-power-manager;0.0.1;i386;data");
+	pk_test_frame_add_string (frame, "More useless software");
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, frame->data, frame->len, NULL);
+	g_assert (ret);
+
+	/* test pk_backend_spawn_inject_frame truncated */
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, frame->data, frame->len - 1, NULL);
+	g_assert (!ret);
+
+	/* test pk_backend_spawn_inject_frame wrong field type */
+	frame->data[1] = 'u';
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, frame->data, frame->len, NULL);
+	g_assert (!ret);
+
+	/* test pk_backend_spawn_inject_frame invalid command */
+	frame->data[0] = 0xff;
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, frame->data, frame->len, NULL);
+	g_assert (!ret);
+	g_byte_array_unref (frame);
+
+	/* test pk_backend_spawn_inject_frame invalid UTF-8 */
+	frame = g_byte_array_new ();
+	g_byte_array_append (frame, &frame_command, 1);
+	pk_test_frame_add_string (frame, "installed");
+	pk_test_frame_add_string (frame, "gnome-power-manager;0.0.1;i386;data");
+	pk_test_frame_add_string (frame, "More \xff software");
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, frame->data, frame->len, NULL);
+	g_assert (!ret);
+	g_byte_array_unref (frame);
+
+	/* test pk_backend_spawn_inject_frame goes through the stdout filter */
+	ret = pk_backend_spawn_set_filter_stdout (backend_spawn, pk_test_backend_spawn_filter_cb);
+	g_assert (ret);
+	frame = g_byte_array_new ();
+	g_byte_array_append (frame, &frame_command, 1);
+	pk_test_frame_add_string (frame, "installed");
+	pk_test_frame_add_string (frame, "gnome-power-manager;0.0.1;i386;data");
+	pk_test_frame_add_string (frame, "More useless software");
+	ret = pk_backend_spawn_inject_frame (backend_spawn, job, frame->data, frame->len, NULL);
+	g_assert (ret);
+	g_assert_cmpstr (_backend_spawn_filtered_line, ==,
+			 "package\tinstalled\tgnome-power-manager;0.0.1;i386;data\tMore useless software");
+	g_byte_array_unref (frame);
+	pk_backend_spawn_set_filter_stdout (backend_spawn, NULL);
+	g_free (_backend_spawn_filtered_line);
+	_backend_spawn_filtered_line = NULL;
+
 	/* manually unlock as we have no engine */
 	ret = pk_backend_unload (backend);
 	g_assert (ret);
@@ -484,6 +565,122 @@ pk_test_backend_spawn_func (void)
 	g_object_unref (backend_spawn);
 }
 
+static PkPackage *_backend_spawn_pool_package = NULL;
+
+/**
+ * pk_test_backend_spawn_pool_package_cb:
+ **/
+static void
+pk_test_backend_spawn_pool_package_cb (PkBackendJob *job,
+				       PkPackage *item,
+				       gpointer user_data)
+{
+	g_set_object (&_backend_spawn_pool_package, item);
+}
+
+/**
+ * pk_test_backend_spawn_pool_run:
+ *
+ * Runs one job on the test dispatcher and returns the package it sent,
+ * which says which helper process ran it and how it got the command.
+ **/
+static PkPackage *
+pk_test_backend_spawn_pool_run (PkBackendSpawn *backend_spawn,
+				PkBackend *backend,
+				GKeyFile *conf,
+				const gchar *locale)
+{
+	gboolean ret;
+	g_autoptr(PkBackendJob) job = NULL;
+
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_backend (job, backend);
+	pk_backend_job_set_locale (job, locale);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_FINISHED,
+				  (PkBackendJobVFunc) pk_test_backend_spawn_finished_cb,
+				  backend_spawn);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGE,
+				  (PkBackendJobVFunc) pk_test_backend_spawn_pool_package_cb,
+				  NULL);
+
+	g_clear_object (&_backend_spawn_pool_package);
+	ret = pk_backend_spawn_helper (backend_spawn, job, "dispatcher.sh",
+				       "search-name", "none", "foo", NULL);
+	g_assert (ret);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert (_backend_spawn_pool_package != NULL);
+	return g_steal_pointer (&_backend_spawn_pool_package);
+}
+
+static void
+pk_test_backend_spawn_pool_func (void)
+{
+	gboolean ret;
+	PkBackendSpawn *backend_spawn;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkPackage) pkg1 = NULL;
+	g_autoptr(PkPackage) pkg2 = NULL;
+	g_autoptr(PkPackage) pkg3 = NULL;
+	g_autoptr(PkPackage) pkg4 = NULL;
+	g_autoptr(PkPackage) pkg5 = NULL;
+	g_autoptr(PkPackage) pkg6 = NULL;
+	g_autoptr(PkPackage) pkg7 = NULL;
+
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "test_spawn");
+	g_key_file_set_integer (conf, "Daemon", "BackendSpawnPoolSize", 2);
+	g_key_file_set_integer (conf, "Daemon", "BackendSpawnMaxJobs", 3);
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+
+	backend_spawn = pk_backend_spawn_new (conf);
+	ret = pk_backend_spawn_set_name (backend_spawn, "test_spawn");
+	g_assert (ret);
+	pk_backend_spawn_set_allow_pool (backend_spawn, TRUE);
+
+	/* the first job starts a helper, the second reuses it */
+	pkg1 = pk_test_backend_spawn_pool_run (backend_spawn, backend, conf, "C");
+	g_assert_cmpstr (pk_package_get_data (pkg1), ==, "argv");
+	pkg2 = pk_test_backend_spawn_pool_run (backend_spawn, backend, conf, "C");
+	g_assert_cmpstr (pk_package_get_version (pkg2), ==, pk_package_get_version (pkg1));
+	g_assert_cmpstr (pk_package_get_data (pkg2), ==, "stdin");
+
+	/* a different locale uses the empty slot, and keeps the first helper */
+	pkg3 = pk_test_backend_spawn_pool_run (backend_spawn, backend, conf, "en_GB.UTF-8");
+	g_assert_cmpstr (pk_package_get_version (pkg3), !=, pk_package_get_version (pkg1));
+	pkg4 = pk_test_backend_spawn_pool_run (backend_spawn, backend, conf, "C");
+	g_assert_cmpstr (pk_package_get_version (pkg4), ==, pk_package_get_version (pkg1));
+
+	/* that was the third job, so the helper is replaced while idle and
+	 * the next job is sent to the replacement on stdin */
+	_g_test_loop_wait (1000);
+	pkg5 = pk_test_backend_spawn_pool_run (backend_spawn, backend, conf, "C");
+	g_assert_cmpstr (pk_package_get_version (pkg5), !=, pk_package_get_version (pkg1));
+	g_assert_cmpstr (pk_package_get_data (pkg5), ==, "stdin");
+	g_object_unref (backend_spawn);
+
+	/* without opting in there is only ever one helper */
+	backend_spawn = pk_backend_spawn_new (conf);
+	ret = pk_backend_spawn_set_name (backend_spawn, "test_spawn");
+	g_assert (ret);
+	pkg6 = pk_test_backend_spawn_pool_run (backend_spawn, backend, conf, "C");
+	pkg7 = pk_test_backend_spawn_pool_run (backend_spawn, backend, conf, "en_GB.UTF-8");
+	g_assert_cmpstr (pk_package_get_version (pkg7), !=, pk_package_get_version (pkg6));
+	g_assert_cmpstr (pk_package_get_data (pkg7), ==, "argv");
+	g_clear_object (&pkg6);
+	pkg6 = pk_test_backend_spawn_pool_run (backend_spawn, backend, conf, "C");
+	g_assert_cmpstr (pk_package_get_version (pkg6), !=, pk_package_get_version (pkg7));
+	g_assert_cmpstr (pk_package_get_data (pkg6), ==, "argv");
+	g_object_unref (backend_spawn);
+
+	ret = pk_backend_unload (backend);
+	g_assert (ret);
+}
+
 static void
 pk_test_dbus_func (void)
 {
@@ -677,6 +874,22 @@ pk_test_spawn_func (void)
 	/* get new object */
 	new_spawn_object (&spawn);
 
+	/* make sure no lines are lost when the helper writes faster than we poll */
+	mexit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
+	argv = g_strsplit (TESTDATADIR "/pk-spawn-test-lines.sh", " ", 0);
+	ret = pk_spawn_argv (spawn, argv, NULL, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_strfreev (argv);
+
+	/* wait for finished */
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (mexit, ==, PK_SPAWN_EXIT_TYPE_SUCCESS);
+	g_assert_cmpint (stdout_count, ==, 20000);
+
+	/* get new object */
+	new_spawn_object (&spawn);
+
 	/* run the dispatcher */
 	mexit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
 	argv = g_strsplit (TESTDATADIR "/pk-spawn-dispatcher.py\tsearch-name\tnone\tpower manager", "\t", 0);
@@ -705,6 +918,10 @@ pk_test_spawn_func (void)
 	/* we got another package (and finished) */
 	g_assert_cmpint (stdout_count, ==, 4);
 
+	/* the same helper was reused for both commands */
+	g_assert_cmpint (pk_spawn_get_job_count (spawn), ==, 2);
+	g_assert (pk_spawn_can_reuse (spawn, argv, envp));
+
 	/* see if pk_spawn_exit blocks (required) */
 	g_idle_add (idle_cb, NULL);
 
@@ -730,6 +947,79 @@ pk_test_spawn_func (void)
 	g_assert (!ret);
 }
 
+static gboolean tail_reenter = FALSE;
+static guint tail_lines_at_exit = 0;
+
+/**
+ * pk_test_spawn_tail_exit_cb:
+ **/
+static void
+pk_test_spawn_tail_exit_cb (PkSpawn *spawn, PkSpawnExitType exit, GPtrArray *lines)
+{
+	mexit = exit;
+	tail_lines_at_exit = lines->len;
+	_g_test_loop_quit ();
+}
+
+/**
+ * pk_test_spawn_tail_stdout_cb:
+ **/
+static void
+pk_test_spawn_tail_stdout_cb (PkSpawn *spawn, const gchar *line, GPtrArray *lines)
+{
+	gboolean ret;
+
+	g_ptr_array_add (lines, g_strdup (line));
+
+	/* wait for the child to exit from inside the handler, so the
+	 * rest of the output arrives while this line is being emitted */
+	if (tail_reenter && lines->len == 1) {
+		ret = pk_spawn_exit (spawn);
+		g_assert (ret);
+	}
+}
+
+static void
+pk_test_spawn_tail_func (void)
+{
+	gboolean ret;
+	guint i;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GKeyFile) conf = g_key_file_new ();
+
+	for (i = 0; i < 2; i++) {
+		g_auto(GStrv) argv = NULL;
+		g_autoptr(PkSpawn) spawn = NULL;
+		g_autoptr(GPtrArray) lines = g_ptr_array_new_with_free_func (g_free);
+
+		/* the second time the child exits during a nested emission */
+		tail_reenter = (i == 1);
+		if (tail_reenter)
+			argv = g_strsplit (TESTDATADIR "/pk-spawn-test-tail.sh wait", " ", 0);
+		else
+			argv = g_strsplit (TESTDATADIR "/pk-spawn-test-tail.sh", " ", 0);
+		spawn = pk_spawn_new (conf);
+		g_signal_connect (spawn, "exit",
+				  G_CALLBACK (pk_test_spawn_tail_exit_cb), lines);
+		g_signal_connect (spawn, "stdout",
+				  G_CALLBACK (pk_test_spawn_tail_stdout_cb), lines);
+		mexit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
+		ret = pk_spawn_argv (spawn, argv, NULL, PK_SPAWN_ARGV_FLAGS_NONE, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		_g_test_loop_run_with_timeout (5000);
+
+		/* the unterminated line is emitted, in order, before ::exit */
+		g_assert_cmpint (mexit, ==, tail_reenter ? PK_SPAWN_EXIT_TYPE_DISPATCHER_EXIT :
+							   PK_SPAWN_EXIT_TYPE_SUCCESS);
+		g_assert_cmpint (lines->len, ==, 3);
+		g_assert_cmpint (tail_lines_at_exit, ==, 3);
+		g_assert_cmpstr (g_ptr_array_index (lines, 0), ==, "first");
+		g_assert_cmpstr (g_ptr_array_index (lines, 1), ==, "second");
+		g_assert_cmpstr (g_ptr_array_index (lines, 2), ==, "last");
+	}
+}
+
 static void
 pk_test_transaction_func (void)
 {
@@ -762,14 +1052,121 @@ pk_test_transaction_func (void)
 	g_dbus_node_info_unref (introspection);
 }
 
+static void
+pk_test_trace_func (void)
+{
+	gboolean ret;
+	gint64 stages[PK_TRACE_STAGE_LAST] = { 0 };
+	guint count = 0;
+	guint total;
+	const gchar *role;
+	const gchar *stage;
+	GVariantIter *iter_bounds = NULL;
+	GVariantIter *iter = NULL;
+	GVariantIter *iter_buckets = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) histogram = NULL;
+	g_autoptr(PkTrace) trace = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *data = NULL;
+
+	trace = pk_trace_new ();
+	filename = g_build_filename (g_get_tmp_dir (), "pk-self-test-trace.json", NULL);
+	ret = pk_trace_set_filename (trace, filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* 3ms between each stage, with no packages emitted */
+	stages[PK_TRACE_STAGE_CREATED] = 1000000;
+	stages[PK_TRACE_STAGE_RECEIVED] = 1003000;
+	stages[PK_TRACE_STAGE_AUTHORIZED] = 1006000;
+	stages[PK_TRACE_STAGE_SCHEDULED] = 1009000;
+	stages[PK_TRACE_STAGE_BACKEND_STARTED] = 1012000;
+	stages[PK_TRACE_STAGE_FINISHED] = 1015000;
+	stages[PK_TRACE_STAGE_FLUSHED] = 1018000;
+	pk_trace_add (trace, PK_ROLE_ENUM_RESOLVE, "/1_test", stages);
+	g_assert_cmpint (pk_trace_get_count (trace, PK_ROLE_ENUM_RESOLVE), ==, 1);
+	g_assert_cmpint (pk_trace_get_count (trace, PK_ROLE_ENUM_GET_UPDATES), ==, 0);
+
+	/* six intervals and the total, all in the right buckets */
+	histogram = g_variant_ref_sink (pk_trace_get_histogram (trace));
+	g_variant_get (histogram, "(aua(ssuau))", &iter_bounds, &iter);
+	g_assert_cmpint (g_variant_iter_n_children (iter_bounds), ==, PK_TRACE_HISTOGRAM_BUCKETS);
+	while (g_variant_iter_next (iter, "(&s&suau)", &role, &stage, &total, &iter_buckets)) {
+		guint bucket = 0;
+		guint i = 0;
+		guint value;
+		g_assert_cmpstr (role, ==, "resolve");
+		g_assert_cmpint (total, ==, 1);
+		g_assert_cmpstr (stage, !=, "first-package");
+		while (g_variant_iter_next (iter_buckets, "u", &value)) {
+			if (value > 0)
+				bucket = i;
+			i++;
+		}
+		if (g_strcmp0 (stage, "total") == 0)
+			g_assert_cmpint (bucket, ==, 5); /* 18ms */
+		else
+			g_assert_cmpint (bucket, ==, 2); /* 3ms */
+		g_variant_iter_free (iter_buckets);
+		count++;
+	}
+	g_assert_cmpint (count, ==, 7);
+	g_variant_iter_free (iter_bounds);
+	g_variant_iter_free (iter);
+
+	/* the trace file has one complete event per interval */
+	g_clear_object (&trace);
+	ret = g_file_get_contents (filename, &data, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (g_str_has_prefix (data, "[\n{\"name\":\"received\",\"cat\":\"resolve\",\"ph\":\"X\""));
+	g_assert (g_strstr_len (data, -1, "\"ts\":1015000,\"dur\":3000") != NULL);
+	g_assert (g_str_has_suffix (data, "}\n]\n"));
+	g_unlink (filename);
+}
+
+static void
+pk_test_transaction_db_history_cb (const gchar *package_id,
+				   PkInfoEnum info,
+				   gint64 timestamp,
+				   guint uid,
+				   gpointer user_data)
+{
+	GPtrArray *history = (GPtrArray *) user_data;
+	g_assert_cmpint (info, ==, PK_INFO_ENUM_INSTALLING);
+	g_assert_cmpint (timestamp, >, 0);
+	g_assert_cmpint (uid, ==, 500);
+	g_ptr_array_add (history, g_strdup (package_id));
+}
+
+static void
+pk_test_transaction_db_foreach_cb (const gchar *tid,
+				   const gchar *timespec,
+				   gboolean succeeded,
+				   guint duration,
+				   PkRoleEnum role,
+				   const gchar *data,
+				   guint uid,
+				   const gchar *cmdline,
+				   gpointer user_data)
+{
+	GPtrArray *page = (GPtrArray *) user_data;
+	g_ptr_array_add (page, g_strdup (tid));
+}
+
 static void
 pk_test_transaction_db_func (void)
 {
+	guint i;
 	guint value;
 	gchar *tid;
 	gboolean ret;
 	gdouble ms;
+	gint64 since;
 	GError *error = NULL;
+	g_autoptr(GPtrArray) history = NULL;
+	g_autoptr(GPtrArray) page = NULL;
 	g_autoptr(PkTransactionDb) db = NULL;
 	g_autofree gchar *proxy_http = NULL;
 	g_autofree gchar *proxy_ftp = NULL;
@@ -833,6 +1230,136 @@ pk_test_transaction_db_func (void)
 	g_assert_cmpint (value, >, 1);
 	g_assert_cmpint (value, <=, 4);
 
+	/* save a transaction, with quotes that must not be parsed as SQL */
+	tid = pk_transaction_db_generate_id (db);
+	g_assert (pk_transaction_db_add (db, tid));
+	g_assert (pk_transaction_db_set_role (db, tid, PK_ROLE_ENUM_INSTALL_PACKAGES));
+	g_assert (pk_transaction_db_set_uid (db, tid, 500));
+	g_assert (pk_transaction_db_set_cmdline (db, tid, "pkcon install 'hal'"));
+	g_assert (pk_transaction_db_set_data (db, tid, "installing\thal;0.1;i386;\"fedora\""));
+	g_assert (pk_transaction_db_set_finished (db, tid, TRUE, 1000));
+
+	/* is it readable before and after the deferred commit */
+	for (i = 0; i < 2; i++) {
+		GList *list;
+		GList *l;
+		PkTransactionPast *past = NULL;
+
+		list = pk_transaction_db_get_list (db, 0);
+		for (l = list; l != NULL; l = l->next) {
+			if (g_strcmp0 (pk_transaction_past_get_id (l->data), tid) == 0)
+				past = l->data;
+		}
+		g_assert (past != NULL);
+		g_assert_cmpint (pk_transaction_past_get_role (past), ==, PK_ROLE_ENUM_INSTALL_PACKAGES);
+		g_assert_cmpint (pk_transaction_past_get_uid (past), ==, 500);
+		g_assert_cmpint (pk_transaction_past_get_duration (past), ==, 1000);
+		g_assert (pk_transaction_past_get_succeeded (past));
+		g_assert_cmpstr (pk_transaction_past_get_cmdline (past), ==, "pkcon install 'hal'");
+		g_assert_cmpstr (pk_transaction_past_get_data (past), ==, "installing\thal;0.1;i386;\"fedora\"");
+		g_list_free_full (list, g_object_unref);
+		_g_test_loop_wait (100);
+	}
+	g_free (tid);
+
+	/* is the package history indexed */
+	history = g_ptr_array_new_with_free_func (g_free);
+	ret = pk_transaction_db_get_package_history (db, "hal", 0,
+						     pk_test_transaction_db_history_cb,
+						     history, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (history->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (history, 0), ==, "hal;0.1;i386;\"fedora\"");
+
+	/* a later version a second after that */
+	_g_test_loop_wait (1100);
+	tid = pk_transaction_db_generate_id (db);
+	g_assert (pk_transaction_db_add (db, tid));
+	g_assert (pk_transaction_db_set_uid (db, tid, 500));
+	g_assert (pk_transaction_db_set_data (db, tid, "installing\thal;0.2;i386;\"fedora\""));
+	g_assert (pk_transaction_db_set_finished (db, tid, TRUE, 1000));
+	g_free (tid);
+
+	/* the history is oldest first */
+	g_ptr_array_set_size (history, 0);
+	ret = pk_transaction_db_get_package_history (db, "hal", 0,
+						     pk_test_transaction_db_history_cb,
+						     history, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (history->len, ==, 2);
+	g_assert_cmpstr (g_ptr_array_index (history, 0), ==, "hal;0.1;i386;\"fedora\"");
+	g_assert_cmpstr (g_ptr_array_index (history, 1), ==, "hal;0.2;i386;\"fedora\"");
+
+	/* and the limit keeps the newest */
+	g_ptr_array_set_size (history, 0);
+	ret = pk_transaction_db_get_package_history (db, "hal", 1,
+						     pk_test_transaction_db_history_cb,
+						     history, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (history->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (history, 0), ==, "hal;0.2;i386;\"fedora\"");
+
+	/* page back through the transactions one at a time */
+	tid = pk_transaction_db_generate_id (db);
+	g_assert (pk_transaction_db_add (db, tid));
+	page = g_ptr_array_new_with_free_func (g_free);
+	ret = pk_transaction_db_foreach (db, NULL, 0, 1,
+					 pk_test_transaction_db_foreach_cb,
+					 page, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (page->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (page, 0), ==, tid);
+	ret = pk_transaction_db_foreach (db, tid, 0, 1,
+					 pk_test_transaction_db_foreach_cb,
+					 page, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (page->len, ==, 2);
+	g_assert_cmpstr (g_ptr_array_index (page, 1), !=, tid);
+
+	/* nothing has happened in the future */
+	ret = pk_transaction_db_foreach (db, NULL, g_get_real_time () / G_USEC_PER_SEC + 3600, 0,
+					 pk_test_transaction_db_foreach_cb,
+					 page, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (page->len, ==, 2);
+
+	/* nor after anything GDateTime can represent */
+	ret = pk_transaction_db_foreach (db, NULL, G_MAXINT64, 0,
+					 pk_test_transaction_db_foreach_cb,
+					 page, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (page->len, ==, 2);
+
+	/* a transaction started in the same second as since is included */
+	g_free (tid);
+	tid = pk_transaction_db_generate_id (db);
+	since = g_get_real_time () / G_USEC_PER_SEC;
+	g_assert (pk_transaction_db_add (db, tid));
+	g_ptr_array_set_size (page, 0);
+	ret = pk_transaction_db_foreach (db, NULL, since, 0,
+					 pk_test_transaction_db_foreach_cb,
+					 page, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (page->len, >=, 1);
+	g_assert_cmpstr (g_ptr_array_index (page, page->len - 1), ==, tid);
+
+	/* an unknown cursor is an error */
+	ret = pk_transaction_db_foreach (db, "/0_dave", 0, 0,
+					 pk_test_transaction_db_foreach_cb,
+					 page, &error);
+	g_assert (error != NULL);
+	g_assert (!ret);
+	g_clear_error (&error);
+	g_free (tid);
+
 	/* can we set the proxies */
 	ret = pk_transaction_db_set_proxy (db, 500, "session1",
 					   "127.0.0.1:80",
@@ -922,6 +1449,46 @@ pk_test_scheduler_create_transaction (PkScheduler *tlist)
 	return tid;
 }
 
+/**
+ * pk_test_scheduler_start_exclusive:
+ **/
+static gchar *
+pk_test_scheduler_start_exclusive (PkScheduler *tlist,
+				   const gchar *sender,
+				   const gchar *hints,
+				   const gchar *method,
+				   PkBitfield bitfield,
+				   const gchar *value)
+{
+	gchar *tid;
+	gboolean ret;
+	PkTransaction *transaction;
+	GError *error = NULL;
+	g_auto(GStrv) hints_array = NULL;
+	g_auto(GStrv) values = NULL;
+
+	tid = pk_transaction_db_generate_id (db);
+	ret = pk_scheduler_create (tlist, tid, sender, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* exclusive, so that anything committed while it runs is queued */
+	transaction = pk_scheduler_get_transaction (tlist, tid);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	pk_transaction_skip_auth_checks (transaction, TRUE);
+	pk_transaction_make_exclusive (transaction);
+	hints_array = g_strsplit (hints, " ", -1);
+	values = g_strsplit (value, " ", -1);
+	ret = pk_transaction_start (transaction, hints_array, method,
+				    g_variant_new ("(t^as)", bitfield, values),
+				    &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	return tid;
+}
+
 static void
 pk_test_scheduler_func (void)
 {
@@ -934,7 +1501,15 @@ pk_test_scheduler_func (void)
 	g_autofree gchar *tid_item1 = NULL;
 	g_autofree gchar *tid_item2 = NULL;
 	g_autofree gchar *tid_item3 = NULL;
+	g_autofree gchar *tid_item4 = NULL;
+	g_autofree gchar *tid_item5 = NULL;
+	g_autofree gchar *tid_item6 = NULL;
+	g_autofree gchar *tid_item7 = NULL;
+	g_autofree gchar *tid_item8 = NULL;
+	PkResults *results;
 	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GPtrArray) packages_leader = NULL;
 	g_autoptr(PkBackend) backend = NULL;
 	g_autoptr(PkScheduler) tlist = NULL;
 
@@ -1138,6 +1713,9 @@ pk_test_scheduler_func (void)
 	g_assert_cmpint (size, ==, 3);
 	g_strfreev (array);
 
+	/* the other two are waiting for the first */
+	g_assert_cmpint (pk_scheduler_get_queue_depth (tlist), ==, 2);
+
 	/* wait for first action */
 	_g_test_loop_run_with_timeout (10000);
 
@@ -1150,6 +1728,7 @@ pk_test_scheduler_func (void)
 	size = g_strv_length (array);
 	g_assert_cmpint (size, ==, 2);
 	g_strfreev (array);
+	g_assert_cmpint (pk_scheduler_get_queue_depth (tlist), ==, 1);
 
 	/* make sure transaction1 has correct flags */
 	transaction = pk_scheduler_get_transaction (tlist, tid_item1);
@@ -1226,6 +1805,95 @@ pk_test_scheduler_func (void)
 	g_assert_cmpint (size, ==, 0);
 	g_strfreev (array);
 
+	/* two identical queries only run once */
+	tid_item4 = pk_test_scheduler_create_transaction (tlist);
+	tid_item5 = pk_test_scheduler_create_transaction (tlist);
+	array = g_strsplit ("evince", " ", -1);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item4);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	pk_transaction_search_names (transaction,
+				     g_variant_new ("(t^as)",
+						    pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						    array),
+				     NULL);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item5);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	pk_transaction_search_names (transaction,
+				     g_variant_new ("(t^as)",
+						    pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						    array),
+				     NULL);
+	g_strfreev (array);
+
+	/* the second is not queued, but follows the first */
+	transaction = pk_scheduler_get_transaction (tlist, tid_item4);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_RUNNING);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item5);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_READY);
+	g_assert_cmpint (pk_scheduler_get_queue_depth (tlist), ==, 0);
+
+	/* wait for both to finish */
+	_g_test_loop_run_with_timeout (10000);
+	_g_test_loop_run_with_timeout (10000);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item5);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_FINISHED);
+	results = pk_transaction_get_results (transaction);
+	g_assert_cmpint (pk_results_get_exit_code (results), ==, PK_EXIT_ENUM_SUCCESS);
+	packages = pk_results_get_package_array (results);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item4);
+	results = pk_transaction_get_results (transaction);
+	packages_leader = pk_results_get_package_array (results);
+	g_assert_cmpint (packages->len, ==, packages_leader->len);
+	g_assert_cmpint (packages->len, >, 0);
+
+	/* the updates from the first transaction were cached */
+	tid_item6 = pk_test_scheduler_create_transaction (tlist);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item6);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	pk_transaction_get_updates (transaction,
+				    g_variant_new ("(t)",
+						   pk_bitfield_value (PK_FILTER_ENUM_NONE)),
+				    NULL);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_READY);
+	g_assert_cmpint (pk_scheduler_get_results_cache_hits (tlist), ==, 1);
+	_g_test_loop_run_with_timeout (2000);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_FINISHED);
+	results = pk_transaction_get_results (transaction);
+	g_assert_cmpint (pk_results_get_exit_code (results), ==, PK_EXIT_ENUM_SUCCESS);
+
+	/* installing something drops the cache as soon as it has finished */
+	tid_item7 = pk_test_scheduler_create_transaction (tlist);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item7);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	array = g_strsplit ("foobar;1.1.0;i386;debian", " ", -1);
+	pk_transaction_skip_auth_checks (transaction, TRUE);
+	pk_transaction_install_packages (transaction,
+					 g_variant_new ("(t^as)",
+							pk_bitfield_value (PK_FILTER_ENUM_NONE),
+							array),
+					 NULL);
+	g_strfreev (array);
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_FINISHED);
+
+	/* so querying straight away runs the backend again */
+	tid_item8 = pk_test_scheduler_create_transaction (tlist);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item8);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	pk_transaction_get_updates (transaction,
+				    g_variant_new ("(t)",
+						   pk_bitfield_value (PK_FILTER_ENUM_NONE)),
+				    NULL);
+	g_assert_cmpint (pk_scheduler_get_results_cache_hits (tlist), ==, 1);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_RUNNING);
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_FINISHED);
+
 	g_object_unref (db);
 }
 
@@ -1437,6 +2105,241 @@ pk_test_scheduler_parallel_func (void)
 	g_object_unref (db);
 }
 
+static void
+pk_test_scheduler_start_func (void)
+{
+	gboolean ret;
+	gchar **array;
+	gchar **hints;
+	PkTransaction *transaction;
+	GError *error = NULL;
+	g_autofree gchar *tid_item1 = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "MaximumPackagesToProcess", "1000");
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+
+	tid_item1 = pk_test_scheduler_create_transaction (tlist);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item1);
+	g_signal_connect (transaction, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	array = g_strsplit ("power", " ", -1);
+	hints = g_strsplit ("locale=C", " ", -1);
+
+	/* methods that do not set a role are refused */
+	ret = pk_transaction_start (transaction, hints, "SetHints",
+				    g_variant_new ("(^as)", hints), &error);
+	g_assert (error != NULL);
+	g_assert (error->domain == PK_TRANSACTION_ERROR);
+	g_assert (!ret);
+	g_clear_error (&error);
+	ret = pk_transaction_start (transaction, hints, "Cancel",
+				    g_variant_new ("()"), &error);
+	g_assert (error != NULL);
+	g_assert (!ret);
+	g_clear_error (&error);
+	ret = pk_transaction_start (transaction, hints, "Dave",
+				    g_variant_new ("()"), &error);
+	g_assert (error != NULL);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* the arguments have to match the method */
+	ret = pk_transaction_start (transaction, hints, "SearchNames",
+				    g_variant_new ("(t)",
+						   pk_bitfield_value (PK_FILTER_ENUM_NONE)),
+				    &error);
+	g_assert (error != NULL);
+	g_assert (error->domain == PK_TRANSACTION_ERROR);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* so do the hints */
+	g_strfreev (hints);
+	hints = g_strsplit ("background=maybe", " ", -1);
+	ret = pk_transaction_start (transaction, hints, "SearchNames",
+				    g_variant_new ("(t^as)",
+						   pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						   array),
+				    &error);
+	g_assert (error != NULL);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* nothing was started by any of those */
+	g_assert_cmpint (pk_transaction_get_role (transaction), ==, PK_ROLE_ENUM_UNKNOWN);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_NEW);
+
+	/* a valid call dispatches the method */
+	g_strfreev (hints);
+	hints = g_strsplit ("locale=C background=true", " ", -1);
+	ret = pk_transaction_start (transaction, hints, "SearchNames",
+				    g_variant_new ("(t^as)",
+						   pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						   array),
+				    &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (pk_transaction_get_role (transaction), ==, PK_ROLE_ENUM_SEARCH_NAME);
+	g_strfreev (array);
+	g_strfreev (hints);
+
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_FINISHED);
+	g_assert_cmpint (pk_results_get_exit_code (pk_transaction_get_results (transaction)), ==, PK_EXIT_ENUM_SUCCESS);
+
+	g_object_unref (db);
+}
+
+static void
+pk_test_scheduler_order_func (void)
+{
+	gboolean ret;
+	guint wait_average;
+	guint wait_max;
+	PkTransaction *transaction;
+	GError *error = NULL;
+	g_autofree gchar *tid_item1 = NULL;
+	g_autofree gchar *tid_item2 = NULL;
+	g_autofree gchar *tid_item3 = NULL;
+	g_autofree gchar *tid_item4 = NULL;
+	g_autofree gchar *tid_item5 = NULL;
+	g_autofree gchar *tid_item6 = NULL;
+	g_autofree gchar *tid_item7 = NULL;
+	g_autofree gchar *tid_item8 = NULL;
+	g_autofree gchar *tid_item9 = NULL;
+	g_autofree gchar *tid_item10 = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "MaximumPackagesToProcess", "1000");
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	g_key_file_set_integer (conf, "Daemon", "BackgroundQueueDelay", 1);
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+
+	/* nothing has been queued yet */
+	g_assert_cmpint (pk_scheduler_get_wait_time_average (tlist), ==, 0);
+	g_assert_cmpint (pk_scheduler_get_wait_time_max (tlist), ==, 0);
+
+	/* a query committed after an update overtakes it */
+	tid_item1 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit",
+						       "locale=C", "SearchNames",
+						       pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						       "power");
+	tid_item2 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit",
+						       "locale=C", "UpdatePackages", 0,
+						       "powertop;1.8-1.fc8;i386;fedora");
+	tid_item3 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit",
+						       "locale=C", "SearchDetails",
+						       pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						       "dave");
+	g_assert_cmpint (pk_scheduler_get_queue_depth (tlist), ==, 2);
+	_g_test_loop_run_with_timeout (10000);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item3);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_RUNNING);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item2);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_READY);
+	g_assert_cmpint (pk_scheduler_get_queue_depth (tlist), ==, 1);
+
+	/* the update is never run */
+	pk_scheduler_cancel_queued (tlist);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_FINISHED);
+	g_assert_cmpint (pk_scheduler_get_queue_depth (tlist), ==, 0);
+	_g_test_loop_run_with_timeout (10000);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item3);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_FINISHED);
+
+	/* the first search ran straight away, the second waited for it */
+	wait_average = pk_scheduler_get_wait_time_average (tlist);
+	wait_max = pk_scheduler_get_wait_time_max (tlist);
+	g_assert_cmpint (wait_max, >=, 1000);
+	g_assert_cmpint (wait_max, <, 10000);
+	g_assert_cmpint (wait_average, >, 0);
+	g_assert_cmpint (wait_average, <, wait_max);
+
+	/* the second transaction of one uid waits for the first of another */
+	tid_item4 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit",
+						       "locale=C", "SearchNames",
+						       pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						       "evince");
+	tid_item5 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit",
+						       "locale=C", "SearchDetails",
+						       pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						       "first");
+	tid_item6 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit",
+						       "locale=C", "SearchDetails",
+						       pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						       "second");
+	tid_item7 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit.Other",
+						       "locale=C", "SearchDetails",
+						       pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						       "other");
+	g_assert_cmpint (pk_scheduler_get_queue_depth (tlist), ==, 3);
+	_g_test_loop_run_with_timeout (10000);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item5);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_RUNNING);
+	_g_test_loop_run_with_timeout (10000);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item7);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_RUNNING);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item6);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_READY);
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_RUNNING);
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_FINISHED);
+
+	/* a background transaction is only overtaken for BackgroundQueueDelay */
+	tid_item8 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit",
+						       "locale=C", "SearchNames",
+						       pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						       "gtk");
+	tid_item9 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit.Other",
+						       "locale=C background=true", "SearchDetails",
+						       pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						       "background");
+	_g_test_loop_wait (1200);
+	tid_item10 = pk_test_scheduler_start_exclusive (tlist, ":org.freedesktop.PackageKit",
+							"locale=C", "SearchDetails",
+							pk_bitfield_value (PK_FILTER_ENUM_NONE),
+							"interactive");
+	g_assert_cmpint (pk_scheduler_get_queue_depth (tlist), ==, 2);
+	_g_test_loop_run_with_timeout (10000);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item9);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_RUNNING);
+	transaction = pk_scheduler_get_transaction (tlist, tid_item10);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_READY);
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_RUNNING);
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (pk_transaction_get_state (transaction), ==, PK_TRANSACTION_STATE_FINISHED);
+
+	g_object_unref (db);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1455,13 +2358,18 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit/transaction", pk_test_transaction_func);
 	g_test_add_func ("/packagekit/dbus", pk_test_dbus_func);
 	g_test_add_func ("/packagekit/spawn", pk_test_spawn_func);
+	g_test_add_func ("/packagekit/spawn-tail", pk_test_spawn_tail_func);
 	g_test_add_func ("/packagekit/scheduler", pk_test_scheduler_func);
 	g_test_add_func ("/packagekit/scheduler-parallel", pk_test_scheduler_parallel_func);
+	g_test_add_func ("/packagekit/scheduler-start", pk_test_scheduler_start_func);
+	g_test_add_func ("/packagekit/scheduler-order", pk_test_scheduler_order_func);
 	g_test_add_func ("/packagekit/transaction-db", pk_test_transaction_db_func);
+	g_test_add_func ("/packagekit/trace", pk_test_trace_func);
 
 	/* backend stuff */
 	g_test_add_func ("/packagekit/backend", pk_test_backend_func);
 	g_test_add_func ("/packagekit/backend_spawn", pk_test_backend_spawn_func);
+	g_test_add_func ("/packagekit/backend_spawn-pool", pk_test_backend_spawn_pool_func);
 
 	return g_test_run ();
 }
@@ -48,6 +48,20 @@ static void     pk_spawn_finalize	(GObject       *object);
 #define PK_SPAWN_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_SPAWN, PkSpawnPrivate))
 #define PK_SPAWN_POLL_DELAY	50 /* ms */
 #define PK_SPAWN_SIGKILL_DELAY	2500 /* ms */
+#define PK_SPAWN_STDOUT_BUF_SIZE	(64 * 1024) /* bytes */
+#define PK_SPAWN_STDOUT_LINE_MAX	(4 * 1024 * 1024) /* bytes */
+#define PK_SPAWN_STDOUT_POLL_MAX	(1024 * 1024) /* bytes */
+
+/* stdout is read straight into this buffer and lines are emitted in place:
+ * [head, scan) has been searched without finding a newline, and
+ * [scan, tail) has not been searched yet */
+typedef struct {
+	gchar			*data;
+	gsize			 size;
+	gsize			 head;
+	gsize			 scan;
+	gsize			 tail;
+} PkSpawnLineBuffer;
 
 struct PkSpawnPrivate
 {
@@ -60,13 +74,18 @@ struct PkSpawnPrivate
 	gboolean		 finished;
 	gboolean		 background;
 	gboolean		 is_sending_exit;
+	gboolean		 is_exiting_async;
 	gboolean		 is_changing_dispatcher;
 	gboolean		 allow_sigkill;
 	PkSpawnExitType		 exit;
-	GString			*stdout_buf;
+	PkSpawnLineBuffer	 stdout_buf;
+	guint			 stdout_emit_depth;
+	gboolean		 stdout_drain_pending;
+	gboolean		 framed;
 	GString			*stderr_buf;
 	gchar			*last_argv0;
 	gchar			**last_envp;
+	guint			 job_count;
 	GKeyFile		*conf;
 };
 
@@ -74,6 +93,7 @@ enum {
 	SIGNAL_EXIT,
 	SIGNAL_STDOUT,
 	SIGNAL_STDERR,
+	SIGNAL_FRAME,
 	SIGNAL_LAST
 };
 
@@ -106,40 +126,211 @@ pk_spawn_read_fd_into_buffer (gint fd, GString *string)
 	return TRUE;
 }
 
+/**
+ * pk_spawn_line_buffer_reserve:
+ *
+ * Makes space at the end of the buffer by moving the incomplete line to the
+ * front, growing the buffer only if that line is bigger than the buffer.
+ *
+ * Return value: the number of bytes that can be read into the buffer
+ **/
+static gsize
+pk_spawn_line_buffer_reserve (PkSpawnLineBuffer *buf, gboolean can_move)
+{
+	gsize len;
+
+	/* the data may be in use by a signal handler further up the stack */
+	if (!can_move)
+		return buf->size - buf->tail;
+
+	/* move the incomplete line to the start */
+	if (buf->head > 0 && buf->tail == buf->size) {
+		len = buf->tail - buf->head;
+		memmove (buf->data, buf->data + buf->head, len);
+		buf->scan -= buf->head;
+		buf->tail = len;
+		buf->head = 0;
+	}
+
+	/* one line fills the entire buffer */
+	if (buf->head == 0 && buf->tail == buf->size &&
+	    buf->size < PK_SPAWN_STDOUT_LINE_MAX) {
+		buf->size = MIN (buf->size * 2, PK_SPAWN_STDOUT_LINE_MAX);
+		buf->data = g_realloc (buf->data, buf->size + 1);
+	}
+	return buf->size - buf->tail;
+}
+
+static void pk_spawn_drain_stdout (PkSpawn *spawn);
+
+/**
+ * pk_spawn_emit_stdout:
+ **/
+static void
+pk_spawn_emit_stdout (PkSpawn *spawn, const gchar *line)
+{
+	spawn->priv->stdout_emit_depth++;
+	g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, line);
+	spawn->priv->stdout_emit_depth--;
+
+	/* the child exited while a handler was using the buffer */
+	if (spawn->priv->stdout_emit_depth == 0 && spawn->priv->stdout_drain_pending)
+		pk_spawn_drain_stdout (spawn);
+}
+
+/**
+ * pk_spawn_emit_frame:
+ **/
+static void
+pk_spawn_emit_frame (PkSpawn *spawn, const gchar *frame, guint32 len)
+{
+	spawn->priv->stdout_emit_depth++;
+	g_signal_emit (spawn, signals [SIGNAL_FRAME], 0, frame, len);
+	spawn->priv->stdout_emit_depth--;
+
+	if (spawn->priv->stdout_emit_depth == 0 && spawn->priv->stdout_drain_pending)
+		pk_spawn_drain_stdout (spawn);
+}
+
 /**
  * pk_spawn_emit_whole_lines:
+ *
+ * Emits each complete line without copying it, and leaves any incomplete
+ * line in the buffer for the next read.
  **/
 static gboolean
-pk_spawn_emit_whole_lines (PkSpawn *spawn, GString *string)
+pk_spawn_emit_whole_lines (PkSpawn *spawn)
 {
-	guint i;
-	guint size;
-	guint bytes_processed;
-	g_auto(GStrv) lines = NULL;
+	gboolean ret = FALSE;
+	gchar *eol;
+	gchar *line;
+	PkSpawnLineBuffer *buf = &spawn->priv->stdout_buf;
+
+	while (buf->scan < buf->tail) {
+		eol = memchr (buf->data + buf->scan, '\n', buf->tail - buf->scan);
+		if (eol == NULL) {
+			buf->scan = buf->tail;
+			break;
+		}
 
-	/* if nothing then don't emit */
-	if (pk_strzero (string->str))
-		return FALSE;
+		/* advance before emitting in case the handler re-enters */
+		*eol = '\0';
+		line = buf->data + buf->head;
+		buf->head = (eol - buf->data) + 1;
+		buf->scan = buf->head;
 
-	/* split into lines - the last line may be incomplete */
-	lines = g_strsplit (string->str, "\n", 0);
-	if (lines == NULL)
-		return FALSE;
+		pk_spawn_emit_stdout (spawn, line);
+		ret = TRUE;
+
+		/* the helper switched protocol, so the rest is not text */
+		if (spawn->priv->framed)
+			break;
+	}
+	return ret;
+}
 
-	/* find size */
-	size = g_strv_length (lines);
+/**
+ * pk_spawn_emit_whole_frames:
+ *
+ * Emits each complete frame without copying it. A frame is a 32 bit big
+ * endian length followed by that many bytes of payload.
+ **/
+static gboolean
+pk_spawn_emit_whole_frames (PkSpawn *spawn)
+{
+	gboolean ret = FALSE;
+	guint32 len;
+	gchar *frame;
+	PkSpawnLineBuffer *buf = &spawn->priv->stdout_buf;
+
+	while (buf->tail - buf->head >= sizeof (guint32)) {
+		memcpy (&len, buf->data + buf->head, sizeof (guint32));
+		len = GUINT32_FROM_BE (len);
+		if (len > PK_SPAWN_STDOUT_LINE_MAX - sizeof (guint32)) {
+			g_warning ("frame of %u bytes is too large, dropping output", len);
+			buf->head = buf->tail;
+			buf->scan = buf->tail;
+			break;
+		}
+		if (buf->tail - buf->head - sizeof (guint32) < len)
+			break;
+
+		/* advance before emitting in case the handler re-enters */
+		frame = buf->data + buf->head + sizeof (guint32);
+		buf->head += sizeof (guint32) + len;
+		buf->scan = buf->head;
+
+		pk_spawn_emit_frame (spawn, frame, len);
+		ret = TRUE;
+	}
+	return ret;
+}
 
-	bytes_processed = 0;
-	/* we only emit n-1 strings */
-	for (i = 0; i < (size-1); i++) {
-		g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, lines[i]);
-		/* ITS4: ignore, g_strsplit always NULL terminates */
-		bytes_processed += strlen (lines[i]) + 1;
+/**
+ * pk_spawn_emit_buffered:
+ **/
+static void
+pk_spawn_emit_buffered (PkSpawn *spawn)
+{
+	PkSpawnLineBuffer *buf = &spawn->priv->stdout_buf;
+
+	if (!spawn->priv->framed)
+		pk_spawn_emit_whole_lines (spawn);
+	if (spawn->priv->framed)
+		pk_spawn_emit_whole_frames (spawn);
+
+	/* everything was processed, so start from the front again */
+	if (buf->head == buf->tail && spawn->priv->stdout_emit_depth == 0) {
+		buf->head = 0;
+		buf->scan = 0;
+		buf->tail = 0;
 	}
+}
 
-	/* remove the text we've processed */
-	g_string_erase (string, 0, bytes_processed);
-	return TRUE;
+/**
+ * pk_spawn_read_stdout:
+ *
+ * Reads at most @max_bytes from the helper, emitting lines as they complete.
+ * Anything left over stays in the pipe, so a chatty helper blocks on write
+ * rather than the daemon buffering an unbounded amount of output.
+ **/
+static void
+pk_spawn_read_stdout (PkSpawn *spawn, gsize max_bytes)
+{
+	gsize avail;
+	gsize total = 0;
+	gssize bytes_read;
+	PkSpawnLineBuffer *buf = &spawn->priv->stdout_buf;
+
+	while (total < max_bytes) {
+		avail = pk_spawn_line_buffer_reserve (buf, spawn->priv->stdout_emit_depth == 0);
+		if (avail == 0) {
+			if (spawn->priv->stdout_emit_depth > 0 || spawn->priv->framed)
+				break;
+
+			/* ITS4: ignore, the buffer is always allocated one byte larger */
+			g_warning ("line longer than %i bytes, splitting",
+				   PK_SPAWN_STDOUT_LINE_MAX);
+			buf->data[buf->tail] = '\0';
+			buf->head = buf->tail;
+			buf->scan = buf->tail;
+			pk_spawn_emit_stdout (spawn, buf->data);
+			if (spawn->priv->stdout_fd == -1)
+				break;
+			buf->head = 0;
+			buf->scan = 0;
+			buf->tail = 0;
+			continue;
+		}
+		bytes_read = read (spawn->priv->stdout_fd,
+				   buf->data + buf->tail,
+				   MIN (avail, max_bytes - total));
+		if (bytes_read <= 0)
+			break;
+		buf->tail += bytes_read;
+		total += bytes_read;
+		pk_spawn_emit_buffered (spawn);
+	}
 }
 
 /**
@@ -163,6 +354,52 @@ pk_spawn_exit_type_enum_to_string (PkSpawnExitType type)
 	return "unknown";
 }
 
+/**
+ * pk_spawn_drain_stdout:
+ *
+ * Emits everything the exited helper wrote, including a last line with no
+ * newline, then closes stdout and emits ::exit. If a handler further up the
+ * stack is still using the buffer, this waits until that handler returns.
+ * If a handler starts a new helper meanwhile, the old one is forgotten.
+ **/
+static void
+pk_spawn_drain_stdout (PkSpawn *spawn)
+{
+	gchar *line;
+	PkSpawnLineBuffer *buf = &spawn->priv->stdout_buf;
+
+	if (spawn->priv->stdout_emit_depth > 0) {
+		spawn->priv->stdout_drain_pending = TRUE;
+		return;
+	}
+	spawn->priv->stdout_drain_pending = FALSE;
+
+	/* get anything left in the pipe before closing it */
+	pk_spawn_read_stdout (spawn, G_MAXSIZE);
+	if (!spawn->priv->finished)
+		return;
+	if (!spawn->priv->framed && buf->head < buf->tail) {
+		/* ITS4: ignore, the buffer is always allocated one byte larger */
+		buf->data[buf->tail] = '\0';
+		line = buf->data + buf->head;
+		buf->head = buf->tail;
+		buf->scan = buf->tail;
+		pk_spawn_emit_stdout (spawn, line);
+		if (!spawn->priv->finished)
+			return;
+	} else if (buf->head < buf->tail) {
+		g_warning ("helper exited in the middle of a frame");
+	}
+	buf->head = 0;
+	buf->scan = 0;
+	buf->tail = 0;
+	close (spawn->priv->stdout_fd);
+	spawn->priv->stdout_fd = -1;
+
+	g_debug ("emitting exit %s", pk_spawn_exit_type_enum_to_string (spawn->priv->exit));
+	g_signal_emit (spawn, signals [SIGNAL_EXIT], 0, spawn->priv->exit);
+}
+
 /**
  * pk_spawn_check_child:
  **/
@@ -181,7 +418,6 @@ pk_spawn_check_child (PkSpawn *spawn)
 		return FALSE;
 	}
 
-	pk_spawn_read_fd_into_buffer (spawn->priv->stdout_fd, spawn->priv->stdout_buf);
 	pk_spawn_read_fd_into_buffer (spawn->priv->stderr_fd, spawn->priv->stderr_buf);
 
 	/* emit all lines on standard out in one callback, as it's all probably
@@ -192,7 +428,11 @@ pk_spawn_check_child (PkSpawn *spawn)
 	}
 
 	/* all usual output goes on standard out, only bad libraries bitch to stderr */
-	pk_spawn_emit_whole_lines (spawn, spawn->priv->stdout_buf);
+	pk_spawn_read_stdout (spawn, PK_SPAWN_STDOUT_POLL_MAX);
+
+	/* a ::stdout handler may have waited for the child to exit */
+	if (spawn->priv->finished)
+		return FALSE;
 
 	/* Only print one in twenty times to avoid filling the screen */
 	if (limit_printing++ % 20 == 0)
@@ -220,12 +460,10 @@ pk_spawn_check_child (PkSpawn *spawn)
 		spawn->priv->poll_id = 0;
 	}
 
-	/* child exited, close resources */
+	/* child exited, close resources; stdout is closed once drained */
 	close (spawn->priv->stdin_fd);
-	close (spawn->priv->stdout_fd);
 	close (spawn->priv->stderr_fd);
 	spawn->priv->stdin_fd = -1;
-	spawn->priv->stdout_fd = -1;
 	spawn->priv->stderr_fd = -1;
 	spawn->priv->child_pid = -1;
 
@@ -280,11 +518,15 @@ pk_spawn_check_child (PkSpawn *spawn)
 	else if (spawn->priv->is_sending_exit)
 		spawn->priv->exit = PK_SPAWN_EXIT_TYPE_DISPATCHER_EXIT;
 
-	/* don't emit if we just closed an invalid dispatcher */
-	g_debug ("emitting exit %s", pk_spawn_exit_type_enum_to_string (spawn->priv->exit));
-	g_signal_emit (spawn, signals [SIGNAL_EXIT], 0, spawn->priv->exit);
+	/* nobody is waiting in pk_spawn_exit() to clear this */
+	if (spawn->priv->is_exiting_async) {
+		spawn->priv->is_exiting_async = FALSE;
+		spawn->priv->is_sending_exit = FALSE;
+	}
 
+	/* emit the rest of the output, then ::exit */
 	spawn->priv->poll_id = 0;
+	pk_spawn_drain_stdout (spawn);
 	return FALSE;
 }
 
@@ -332,6 +574,21 @@ pk_spawn_is_running (PkSpawn *spawn)
 	return (spawn->priv->child_pid != -1);
 }
 
+/**
+ * pk_spawn_set_framed:
+ *
+ * Switches the running helper from newline separated text to length
+ * prefixed frames, which are emitted using the ::frame signal.
+ * This is normally called from a ::stdout handler once the helper has
+ * announced it, and lasts until a new helper process is started.
+ **/
+void
+pk_spawn_set_framed (PkSpawn *spawn, gboolean framed)
+{
+	g_return_if_fail (PK_IS_SPAWN (spawn));
+	spawn->priv->framed = framed;
+}
+
 /**
  * pk_spawn_kill:
  *
@@ -425,6 +682,34 @@ pk_spawn_send_stdin (PkSpawn *spawn, const gchar *command)
 	return TRUE;
 }
 
+/**
+ * pk_spawn_wait_for_exit:
+ **/
+static gboolean
+pk_spawn_wait_for_exit (PkSpawn *spawn)
+{
+	gboolean ret;
+	guint count = 0;
+
+	/* block until the previous script exited */
+	do {
+		g_debug ("waiting for exit");
+		/* Usleep rather than g_main_loop_run -- we have to block.
+		 * If we run the loop, other idle events can be processed,
+		 * and this includes sending data to a new instance,
+		 * which of course will fail as the 'old' script is exiting */
+		g_usleep (10*1000); /* 10 ms */
+		ret = pk_spawn_check_child (spawn);
+	} while (ret && count++ < 500);
+
+	/* the script exited okay */
+	if (count < 500)
+		ret = TRUE;
+	else
+		g_warning ("failed to exit script");
+	return ret;
+}
+
 /**
  * pk_spawn_exit:
  *
@@ -435,7 +720,6 @@ gboolean
 pk_spawn_exit (PkSpawn *spawn)
 {
 	gboolean ret;
-	guint count = 0;
 
 	g_return_val_if_fail (PK_IS_SPAWN (spawn), FALSE);
 
@@ -452,28 +736,38 @@ pk_spawn_exit (PkSpawn *spawn)
 		g_debug ("failed to send exit");
 		goto out;
 	}
-
-	/* block until the previous script exited */
-	do {
-		g_debug ("waiting for exit");
-		/* Usleep rather than g_main_loop_run -- we have to block.
-		 * If we run the loop, other idle events can be processed,
-		 * and this includes sending data to a new instance,
-		 * which of course will fail as the 'old' script is exiting */
-		g_usleep (10*1000); /* 10 ms */
-		ret = pk_spawn_check_child (spawn);
-	} while (ret && count++ < 500);
-
-	/* the script exited okay */
-	if (count < 500)
-		ret = TRUE;
-	else
-		g_warning ("failed to exit script");
+	ret = pk_spawn_wait_for_exit (spawn);
 out:
 	spawn->priv->is_sending_exit = FALSE;
 	return ret;
 }
 
+/**
+ * pk_spawn_exit_async:
+ *
+ * Like pk_spawn_exit(), but returns as soon as "exit" has been written.
+ * ::exit is emitted from the poll once the script has closed, and a
+ * pk_spawn_argv() in the meantime waits for that to happen first.
+ **/
+gboolean
+pk_spawn_exit_async (PkSpawn *spawn)
+{
+	g_return_val_if_fail (PK_IS_SPAWN (spawn), FALSE);
+
+	/* check if already sending exit */
+	if (spawn->priv->is_sending_exit) {
+		g_warning ("already sending exit, ignoring");
+		return FALSE;
+	}
+	if (!pk_spawn_send_stdin (spawn, "exit")) {
+		g_debug ("failed to send exit");
+		return FALSE;
+	}
+	spawn->priv->is_sending_exit = TRUE;
+	spawn->priv->is_exiting_async = TRUE;
+	return TRUE;
+}
+
 /**
  * pk_strvequal:
  **/
@@ -507,6 +801,39 @@ pk_strvequal (gchar **id1, gchar **id2)
 	return TRUE;
 }
 
+/**
+ * pk_spawn_can_reuse:
+ *
+ * We can reuse the dispatcher if:
+ *  - it's still running
+ *  - argv[0] (executable name is the same)
+ *  - all of envp are the same (proxy and locale settings)
+ **/
+gboolean
+pk_spawn_can_reuse (PkSpawn *spawn, gchar **argv, gchar **envp)
+{
+	g_return_val_if_fail (PK_IS_SPAWN (spawn), FALSE);
+	g_return_val_if_fail (argv != NULL, FALSE);
+
+	if (spawn->priv->stdin_fd == -1 || spawn->priv->is_sending_exit)
+		return FALSE;
+	if (g_strcmp0 (spawn->priv->last_argv0, argv[0]) != 0)
+		return FALSE;
+	return pk_strvequal (spawn->priv->last_envp, envp);
+}
+
+/**
+ * pk_spawn_get_job_count:
+ *
+ * Return value: the number of commands the running helper has been given
+ **/
+guint
+pk_spawn_get_job_count (PkSpawn *spawn)
+{
+	g_return_val_if_fail (PK_IS_SPAWN (spawn), 0);
+	return spawn->priv->job_count;
+}
+
 /**
  * pk_spawn_argv:
  * @argv: Can be generated using g_strsplit (command, " ", 0)
@@ -537,6 +864,12 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 			g_debug ("envp[%i] '%s'", i, envp[i]);
 	}
 
+	/* let a script we asked to exit in the background finish first */
+	if (spawn->priv->is_exiting_async) {
+		g_debug ("waiting for previous instance to exit");
+		pk_spawn_wait_for_exit (spawn);
+	}
+
 	/* check we are not using a closing instance */
 	if (spawn->priv->is_sending_exit) {
 		ret = FALSE;
@@ -544,15 +877,10 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 		goto out;
 	}
 
-	/* we can reuse the dispatcher if:
-	 *  - it's still running
-	 *  - argv[0] (executable name is the same)
-	 *  - all of envp are the same (proxy and locale settings) */
+	/* reuse the dispatcher if it is still running with the same settings */
 	if (spawn->priv->stdin_fd != -1) {
-		if (g_strcmp0 (spawn->priv->last_argv0, argv[0]) != 0) {
-			g_debug ("argv did not match, not reusing");
-		} else if (!pk_strvequal (spawn->priv->last_envp, envp)) {
-			g_debug ("envp did not match, not reusing");
+		if (!pk_spawn_can_reuse (spawn, argv, envp)) {
+			g_debug ("argv or envp did not match, not reusing");
 		} else if ((flags & PK_SPAWN_ARGV_FLAGS_NEVER_REUSE) > 0) {
 			g_debug ("not re-using instance due to policy");
 		} else {
@@ -562,8 +890,10 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 			/* reuse instance */
 			g_debug ("reusing instance");
 			ret = pk_spawn_send_stdin (spawn, command);
-			if (ret)
+			if (ret) {
+				spawn->priv->job_count++;
 				goto out;
+			}
 
 			/* so fall on through to kill and respawn */
 			g_warning ("failed to write, so trying to kill and respawn");
@@ -584,8 +914,23 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 		spawn->priv->is_changing_dispatcher = FALSE;
 	}
 
+	/* a handler is starting a new helper before the old one was drained */
+	if (spawn->priv->stdout_fd != -1) {
+		g_warning ("dropping unread output of the previous helper");
+		close (spawn->priv->stdout_fd);
+		spawn->priv->stdout_fd = -1;
+		spawn->priv->stdout_drain_pending = FALSE;
+	}
+
+	/* a new process always starts with text output */
+	spawn->priv->framed = FALSE;
+	spawn->priv->stdout_buf.head = 0;
+	spawn->priv->stdout_buf.scan = 0;
+	spawn->priv->stdout_buf.tail = 0;
+
 	/* create spawned object for tracking */
 	spawn->priv->finished = FALSE;
+	spawn->priv->job_count = 0;
 	g_debug ("creating new instance of %s", argv[0]);
 	ret = g_spawn_async_with_pipes (NULL, argv, envp,
 				 G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH,
@@ -618,6 +963,10 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 		pk_ioprio_set_idle (spawn->priv->child_pid);
 	}
 
+	/* a helper started with no arguments just waits for a command */
+	if (argv[1] != NULL)
+		spawn->priv->job_count = 1;
+
 	/* save this so we can check the dispatcher name */
 	g_free (spawn->priv->last_argv0);
 	spawn->priv->last_argv0 = g_strdup (argv[0]);
@@ -735,16 +1084,23 @@ pk_spawn_class_init (PkSpawnClass *klass)
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__INT,
 			      G_TYPE_NONE, 1, G_TYPE_INT);
+	/* the line points into the stdout buffer and is only valid in the handler */
 	signals [SIGNAL_STDOUT] =
 		g_signal_new ("stdout",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
-			      G_TYPE_NONE, 1, G_TYPE_STRING);
+			      G_TYPE_NONE, 1, G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE);
 	signals [SIGNAL_STDERR] =
 		g_signal_new ("stderr",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
 			      G_TYPE_NONE, 1, G_TYPE_STRING);
+	/* the payload points into the stdout buffer and is only valid in the handler */
+	signals [SIGNAL_FRAME] =
+		g_signal_new ("frame",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_generic,
+			      G_TYPE_NONE, 2, G_TYPE_POINTER, G_TYPE_UINT);
 
 	g_type_class_add_private (klass, sizeof (PkSpawnPrivate));
 }
@@ -766,6 +1122,7 @@ pk_spawn_init (PkSpawn *spawn)
 	spawn->priv->kill_id = 0;
 	spawn->priv->finished = FALSE;
 	spawn->priv->is_sending_exit = FALSE;
+	spawn->priv->is_exiting_async = FALSE;
 	spawn->priv->is_changing_dispatcher = FALSE;
 	spawn->priv->allow_sigkill = TRUE;
 	spawn->priv->last_argv0 = NULL;
@@ -773,7 +1130,8 @@ pk_spawn_init (PkSpawn *spawn)
 	spawn->priv->background = FALSE;
 	spawn->priv->exit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
 
-	spawn->priv->stdout_buf = g_string_new ("");
+	spawn->priv->stdout_buf.size = PK_SPAWN_STDOUT_BUF_SIZE;
+	spawn->priv->stdout_buf.data = g_malloc (PK_SPAWN_STDOUT_BUF_SIZE + 1);
 	spawn->priv->stderr_buf = g_string_new ("");
 }
 
@@ -814,8 +1172,12 @@ pk_spawn_finalize (GObject *object)
 			g_source_remove (spawn->priv->kill_id);
 	}
 
+	/* the helper exited but the output was never drained */
+	if (spawn->priv->stdout_drain_pending)
+		close (spawn->priv->stdout_fd);
+
 	/* free the buffers */
-	g_string_free (spawn->priv->stdout_buf, TRUE);
+	g_free (spawn->priv->stdout_buf.data);
 	g_string_free (spawn->priv->stderr_buf, TRUE);
 	g_free (spawn->priv->last_argv0);
 	g_strfreev (spawn->priv->last_envp);
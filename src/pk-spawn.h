@@ -83,8 +83,15 @@ gboolean	 pk_spawn_argv				(PkSpawn	*spawn,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 pk_spawn_is_running			(PkSpawn	*spawn);
+gboolean	 pk_spawn_can_reuse			(PkSpawn	*spawn,
+							 gchar		**argv,
+							 gchar		**envp);
+guint		 pk_spawn_get_job_count			(PkSpawn	*spawn);
 gboolean	 pk_spawn_kill				(PkSpawn	*spawn);
 gboolean	 pk_spawn_exit				(PkSpawn	*spawn);
+gboolean	 pk_spawn_exit_async			(PkSpawn	*spawn);
+void		 pk_spawn_set_framed			(PkSpawn	*spawn,
+							 gboolean	 framed);
 
 G_END_DECLS
 
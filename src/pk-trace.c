@@ -0,0 +1,354 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Transaction Tracing:
+ *
+ * Every transaction records a monotonic timestamp as it passes each
+ * PkTraceStage. When the Finished() signal has been flushed to the bus the
+ * timestamps are handed to PkTrace, which adds the time spent between each
+ * stage and the one before it into a per-role histogram. Stages that were
+ * never reached (e.g. no packages were emitted) are skipped, so the time is
+ * accounted to the next stage that was.
+ *
+ * If a trace file is set, each transaction is also written as a set of
+ * complete events in the Chrome trace-event JSON array format, which can be
+ * loaded into chrome://tracing or any compatible viewer.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include "pk-trace.h"
+
+#define PK_TRACE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_TRACE, PkTracePrivate))
+
+/* the extra row holds the complete transaction time */
+#define PK_TRACE_STAGE_TOTAL	PK_TRACE_STAGE_LAST
+
+typedef struct {
+	guint			 count;
+	guint			 samples[PK_TRACE_STAGE_LAST + 1];
+	guint			 buckets[PK_TRACE_STAGE_LAST + 1][PK_TRACE_HISTOGRAM_BUCKETS];
+} PkTraceRole;
+
+struct PkTracePrivate
+{
+	PkTraceRole		 roles[PK_ROLE_ENUM_LAST];
+	GOutputStream		*stream;
+	guint			 stream_events;
+	guint			 stream_rows;
+};
+
+G_DEFINE_TYPE (PkTrace, pk_trace, G_TYPE_OBJECT)
+
+/**
+ * pk_trace_stage_to_string:
+ **/
+const gchar *
+pk_trace_stage_to_string (PkTraceStage stage)
+{
+	if (stage == PK_TRACE_STAGE_CREATED)
+		return "created";
+	if (stage == PK_TRACE_STAGE_RECEIVED)
+		return "received";
+	if (stage == PK_TRACE_STAGE_AUTHORIZED)
+		return "authorized";
+	if (stage == PK_TRACE_STAGE_SCHEDULED)
+		return "scheduled";
+	if (stage == PK_TRACE_STAGE_BACKEND_STARTED)
+		return "backend-started";
+	if (stage == PK_TRACE_STAGE_FIRST_PACKAGE)
+		return "first-package";
+	if (stage == PK_TRACE_STAGE_LAST_PACKAGE)
+		return "last-package";
+	if (stage == PK_TRACE_STAGE_FINISHED)
+		return "finished";
+	if (stage == PK_TRACE_STAGE_FLUSHED)
+		return "flushed";
+	if (stage == PK_TRACE_STAGE_TOTAL)
+		return "total";
+	return NULL;
+}
+
+/**
+ * pk_trace_get_bucket:
+ **/
+static guint
+pk_trace_get_bucket (gint64 duration)
+{
+	gint64 ms = duration / 1000;
+	guint bucket = 0;
+
+	while (bucket < PK_TRACE_HISTOGRAM_BUCKETS - 1 &&
+	       ms >= ((gint64) 1 << bucket))
+		bucket++;
+	return bucket;
+}
+
+/**
+ * pk_trace_write_event:
+ **/
+static void
+pk_trace_write_event (PkTrace *trace,
+		      PkRoleEnum role,
+		      const gchar *tid,
+		      PkTraceStage stage,
+		      gint64 start,
+		      gint64 duration)
+{
+	PkTracePrivate *priv = trace->priv;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *event = NULL;
+
+	event = g_strdup_printf ("%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+				 "\"pid\":%i,\"tid\":%u,"
+				 "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+				 "\"args\":{\"transaction\":\"%s\"}}",
+				 priv->stream_events > 0 ? ",\n" : "",
+				 pk_trace_stage_to_string (stage),
+				 pk_role_enum_to_string (role),
+				 getpid (),
+				 priv->stream_rows,
+				 start, duration, tid);
+	if (!g_output_stream_write_all (priv->stream, event, strlen (event),
+					NULL, NULL, &error)) {
+		g_warning ("failed to write trace, disabling: %s", error->message);
+		g_clear_object (&priv->stream);
+		return;
+	}
+	priv->stream_events++;
+}
+
+/**
+ * pk_trace_add:
+ * @stages: an array of PK_TRACE_STAGE_LAST monotonic times, 0 if unset
+ *
+ * Adds a finished transaction to the histogram, and to the trace file if set.
+ **/
+void
+pk_trace_add (PkTrace *trace,
+	      PkRoleEnum role,
+	      const gchar *tid,
+	      const gint64 *stages)
+{
+	PkTracePrivate *priv = trace->priv;
+	PkTraceRole *item;
+	gint64 duration;
+	guint first = PK_TRACE_STAGE_LAST;
+	guint prev = PK_TRACE_STAGE_LAST;
+	guint i;
+
+	g_return_if_fail (PK_IS_TRACE (trace));
+	g_return_if_fail (stages != NULL);
+
+	if (role >= PK_ROLE_ENUM_LAST)
+		return;
+	item = &priv->roles[role];
+	item->count++;
+
+	for (i = 0; i < PK_TRACE_STAGE_LAST; i++) {
+		if (stages[i] == 0)
+			continue;
+		if (prev == PK_TRACE_STAGE_LAST) {
+			first = prev = i;
+			continue;
+		}
+		duration = MAX (stages[i] - stages[prev], 0);
+		item->samples[i]++;
+		item->buckets[i][pk_trace_get_bucket (duration)]++;
+		if (priv->stream != NULL) {
+			pk_trace_write_event (trace, role, tid, i,
+					      stages[prev], duration);
+		}
+		prev = i;
+	}
+
+	/* nothing was recorded at all */
+	if (first == PK_TRACE_STAGE_LAST)
+		return;
+	duration = stages[prev] - stages[first];
+	item->samples[PK_TRACE_STAGE_TOTAL]++;
+	item->buckets[PK_TRACE_STAGE_TOTAL][pk_trace_get_bucket (duration)]++;
+
+	/* each transaction gets its own row in the viewer */
+	if (priv->stream != NULL) {
+		if (!g_output_stream_flush (priv->stream, NULL, NULL))
+			g_clear_object (&priv->stream);
+		priv->stream_rows++;
+	}
+}
+
+/**
+ * pk_trace_get_count:
+ *
+ * Return value: the number of transactions of @role that have been traced
+ **/
+guint
+pk_trace_get_count (PkTrace *trace, PkRoleEnum role)
+{
+	g_return_val_if_fail (PK_IS_TRACE (trace), 0);
+	if (role >= PK_ROLE_ENUM_LAST)
+		return 0;
+	return trace->priv->roles[role].count;
+}
+
+/**
+ * pk_trace_get_histogram:
+ *
+ * Return value: (transfer floating): a "(aua(ssuau))" variant with the upper
+ * bound of each bucket in ms, then role, stage, sample count and buckets for
+ * every stage that has samples.
+ **/
+GVariant *
+pk_trace_get_histogram (PkTrace *trace)
+{
+	PkTraceRole *item;
+	GVariantBuilder bounds;
+	GVariantBuilder builder;
+	GVariantBuilder buckets;
+	guint i, j, k;
+
+	g_return_val_if_fail (PK_IS_TRACE (trace), NULL);
+
+	g_variant_builder_init (&bounds, G_VARIANT_TYPE ("au"));
+	for (k = 0; k < PK_TRACE_HISTOGRAM_BUCKETS - 1; k++)
+		g_variant_builder_add (&bounds, "u", 1u << k);
+	g_variant_builder_add (&bounds, "u", G_MAXUINT32);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssuau)"));
+	for (i = 0; i < PK_ROLE_ENUM_LAST; i++) {
+		item = &trace->priv->roles[i];
+		if (item->count == 0)
+			continue;
+		for (j = 0; j <= PK_TRACE_STAGE_TOTAL; j++) {
+			if (item->samples[j] == 0)
+				continue;
+			g_variant_builder_init (&buckets, G_VARIANT_TYPE ("au"));
+			for (k = 0; k < PK_TRACE_HISTOGRAM_BUCKETS; k++)
+				g_variant_builder_add (&buckets, "u", item->buckets[j][k]);
+			g_variant_builder_add (&builder, "(ssuau)",
+					       pk_role_enum_to_string (i),
+					       pk_trace_stage_to_string (j),
+					       item->samples[j],
+					       &buckets);
+		}
+	}
+	return g_variant_new ("(aua(ssuau))", &bounds, &builder);
+}
+
+/**
+ * pk_trace_reset:
+ *
+ * Clears the histogram; the trace file is not touched.
+ **/
+void
+pk_trace_reset (PkTrace *trace)
+{
+	g_return_if_fail (PK_IS_TRACE (trace));
+	memset (trace->priv->roles, 0, sizeof (trace->priv->roles));
+}
+
+/**
+ * pk_trace_set_filename:
+ *
+ * Starts writing trace events to @filename, replacing any existing file.
+ **/
+gboolean
+pk_trace_set_filename (PkTrace *trace, const gchar *filename, GError **error)
+{
+	PkTracePrivate *priv = trace->priv;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GFileOutputStream) stream = NULL;
+
+	g_return_val_if_fail (PK_IS_TRACE (trace), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	file = g_file_new_for_path (filename);
+	stream = g_file_replace (file, NULL, FALSE,
+				 G_FILE_CREATE_REPLACE_DESTINATION,
+				 NULL, error);
+	if (stream == NULL)
+		return FALSE;
+	if (!g_output_stream_write_all (G_OUTPUT_STREAM (stream), "[\n", 2,
+					NULL, NULL, error))
+		return FALSE;
+
+	g_clear_object (&priv->stream);
+	priv->stream = g_object_ref (stream);
+	priv->stream_events = 0;
+	priv->stream_rows = 0;
+	return TRUE;
+}
+
+/**
+ * pk_trace_finalize:
+ **/
+static void
+pk_trace_finalize (GObject *object)
+{
+	PkTrace *trace = PK_TRACE (object);
+	PkTracePrivate *priv = trace->priv;
+
+	/* the closing bracket is optional, but nice to have */
+	if (priv->stream != NULL) {
+		g_output_stream_write_all (priv->stream, "\n]\n", 3,
+					   NULL, NULL, NULL);
+		g_output_stream_close (priv->stream, NULL, NULL);
+		g_object_unref (priv->stream);
+	}
+
+	G_OBJECT_CLASS (pk_trace_parent_class)->finalize (object);
+}
+
+/**
+ * pk_trace_class_init:
+ **/
+static void
+pk_trace_class_init (PkTraceClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_trace_finalize;
+	g_type_class_add_private (klass, sizeof (PkTracePrivate));
+}
+
+/**
+ * pk_trace_init:
+ **/
+static void
+pk_trace_init (PkTrace *trace)
+{
+	trace->priv = PK_TRACE_GET_PRIVATE (trace);
+}
+
+/**
+ * pk_trace_new:
+ *
+ * Return value: a new PkTrace object.
+ **/
+PkTrace *
+pk_trace_new (void)
+{
+	return PK_TRACE (g_object_new (PK_TYPE_TRACE, NULL));
+}
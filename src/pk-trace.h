@@ -0,0 +1,88 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_TRACE_H
+#define __PK_TRACE_H
+
+#include <glib-object.h>
+#include <packagekit-glib2/pk-enum.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_TRACE		(pk_trace_get_type ())
+#define PK_TRACE(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_TRACE, PkTrace))
+#define PK_TRACE_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_TRACE, PkTraceClass))
+#define PK_IS_TRACE(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_TRACE))
+#define PK_IS_TRACE_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_TRACE))
+#define PK_TRACE_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_TRACE, PkTraceClass))
+
+/* bucket n holds durations shorter than 2^n ms, the last one everything else */
+#define PK_TRACE_HISTOGRAM_BUCKETS	18
+
+typedef struct PkTracePrivate PkTracePrivate;
+
+typedef struct
+{
+	 GObject		 parent;
+	 PkTracePrivate		*priv;
+} PkTrace;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} PkTraceClass;
+
+/* these have to be kept in the order they happen */
+typedef enum {
+	PK_TRACE_STAGE_CREATED,		/* CreateTransaction() */
+	PK_TRACE_STAGE_RECEIVED,	/* role method call */
+	PK_TRACE_STAGE_AUTHORIZED,	/* polkit done, queued */
+	PK_TRACE_STAGE_SCHEDULED,	/* left the scheduler queue */
+	PK_TRACE_STAGE_BACKEND_STARTED,
+	PK_TRACE_STAGE_FIRST_PACKAGE,
+	PK_TRACE_STAGE_LAST_PACKAGE,
+	PK_TRACE_STAGE_FINISHED,	/* Finished() emitted */
+	PK_TRACE_STAGE_FLUSHED,		/* Finished() written to the bus */
+	PK_TRACE_STAGE_LAST
+} PkTraceStage;
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkTrace, g_object_unref)
+#endif
+
+GType		 pk_trace_get_type		(void);
+PkTrace		*pk_trace_new			(void);
+const gchar	*pk_trace_stage_to_string	(PkTraceStage	 stage);
+gboolean	 pk_trace_set_filename		(PkTrace	*trace,
+						 const gchar	*filename,
+						 GError		**error);
+void		 pk_trace_add			(PkTrace	*trace,
+						 PkRoleEnum	 role,
+						 const gchar	*tid,
+						 const gint64	*stages);
+guint		 pk_trace_get_count		(PkTrace	*trace,
+						 PkRoleEnum	 role);
+GVariant	*pk_trace_get_histogram		(PkTrace	*trace);
+void		 pk_trace_reset			(PkTrace	*trace);
+
+G_END_DECLS
+
+#endif /* __PK_TRACE_H */
@@ -39,6 +39,7 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-results.h>
 #include <packagekit-glib2/pk-common.h>
+#include <packagekit-glib2/pk-package-id.h>
 
 #include "pk-shared.h"
 
@@ -48,15 +49,98 @@ static void     pk_transaction_db_finalize	(GObject        *object);
 
 #define PK_TRANSACTION_DB_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_TRANSACTION_DB, PkTransactionDbPrivate))
 
+/* statements that are run for every transaction, prepared once and cached */
+typedef enum {
+	PK_TRANSACTION_DB_STMT_ADD,
+	PK_TRANSACTION_DB_STMT_SET_ROLE,
+	PK_TRANSACTION_DB_STMT_SET_UID,
+	PK_TRANSACTION_DB_STMT_SET_CMDLINE,
+	PK_TRANSACTION_DB_STMT_SET_DATA,
+	PK_TRANSACTION_DB_STMT_SET_FINISHED,
+	PK_TRANSACTION_DB_STMT_ACTION_TIME_SINCE,
+	PK_TRANSACTION_DB_STMT_ACTION_TIME_RESET,
+	PK_TRANSACTION_DB_STMT_GET_TRANSACTION,
+	PK_TRANSACTION_DB_STMT_ADD_PACKAGE_HISTORY,
+	PK_TRANSACTION_DB_STMT_GET_PACKAGE_HISTORY,
+	PK_TRANSACTION_DB_STMT_GET_TRANSACTIONS,
+	PK_TRANSACTION_DB_STMT_GET_TRANSACTIONS_BEFORE,
+	PK_TRANSACTION_DB_STMT_LAST
+} PkTransactionDbStmt;
+
+static const gchar *pk_transaction_db_stmt_sql[PK_TRANSACTION_DB_STMT_LAST] = {
+	"INSERT INTO transactions (transaction_id, timespec) VALUES (?, ?)",
+	"UPDATE transactions SET role = ? WHERE transaction_id = ?",
+	"UPDATE transactions SET uid = ? WHERE transaction_id = ?",
+	"UPDATE transactions SET cmdline = ? WHERE transaction_id = ?",
+	"UPDATE transactions SET data = ? WHERE transaction_id = ?",
+	"UPDATE transactions SET succeeded = ?, duration = ? WHERE transaction_id = ?",
+	"SELECT timespec FROM last_action WHERE role = ?",
+	"INSERT OR REPLACE INTO last_action (role, timespec) VALUES (?, ?)",
+	"SELECT timespec, uid FROM transactions WHERE transaction_id = ?",
+	"INSERT OR IGNORE INTO package_history (name, package_id, info, tid, timestamp, uid) "
+	"VALUES (?, ?, ?, ?, ?, ?)",
+	/* the newest entries, returned oldest first; there is one entry per
+	 * timestamp as multiarch packages share a transaction, and with MIN()
+	 * SQLite takes the other columns from the row with the lowest package ID */
+	"SELECT package_id, info, timestamp, uid FROM ("
+	"SELECT MIN(package_history.package_id) AS package_id, package_history.info AS info, "
+	"package_history.timestamp AS timestamp, package_history.uid AS uid FROM package_history "
+	"JOIN transactions ON transactions.transaction_id = package_history.tid "
+	"WHERE package_history.name = ? AND package_history.timestamp != 0 "
+	"AND transactions.succeeded = 1 "
+	"GROUP BY package_history.timestamp "
+	"ORDER BY package_history.timestamp DESC LIMIT ?) "
+	"ORDER BY timestamp ASC",
+	/* the newest rows, returned oldest first */
+	"SELECT * FROM (SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
+	"FROM transactions WHERE timespec >= ?1 "
+	"ORDER BY timespec DESC, transaction_id DESC LIMIT ?2) "
+	"ORDER BY timespec, transaction_id",
+	/* as above, for the rows older than the cursor ?3, ?4 */
+	"SELECT * FROM (SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
+	"FROM transactions WHERE timespec >= ?1 "
+	"AND (timespec < ?3 OR (timespec = ?3 AND transaction_id < ?4)) "
+	"ORDER BY timespec DESC, transaction_id DESC LIMIT ?2) "
+	"ORDER BY timespec, transaction_id",
+};
+
+static gboolean pk_transaction_db_backfill_package_history (PkTransactionDb *tdb, GError **error);
+
+typedef struct {
+	const gchar	*sql;
+	gboolean	 (*func)	(PkTransactionDb *tdb, GError **error);
+} PkTransactionDbMigration;
+
+/* schema changes made after the tables were first created; the index of
+ * each entry plus one is the user_version the database has once applied */
+static const PkTransactionDbMigration pk_transaction_db_migrations[] = {
+	/* 1: GetOldTransactions sorts on this */
+	{ "CREATE INDEX IF NOT EXISTS transactions_timespec ON transactions (timespec);",
+	  NULL },
+	/* 2: GetPackageHistory without parsing every transaction */
+	{ "CREATE TABLE package_history (name TEXT NOT NULL, package_id TEXT NOT NULL, "
+	  "info TEXT, tid TEXT NOT NULL, timestamp INTEGER DEFAULT 0, uid INTEGER DEFAULT 0, "
+	  "UNIQUE (tid, package_id));"
+	  "CREATE INDEX package_history_name ON package_history (name, timestamp);",
+	  pk_transaction_db_backfill_package_history },
+	/* 3: paging through GetOldTransactions */
+	{ "DROP INDEX IF EXISTS transactions_timespec;"
+	  "CREATE INDEX transactions_timespec_tid ON transactions (timespec, transaction_id);",
+	  NULL },
+};
+
 struct PkTransactionDbPrivate
 {
 	gboolean		 loaded;
 	sqlite3			*db;
+	sqlite3_stmt		*stmt[PK_TRANSACTION_DB_STMT_LAST];
 	guint			 job_count;
 	guint			 database_save_id;
+	guint			 database_commit_id;
 };
 
 G_DEFINE_TYPE (PkTransactionDb, pk_transaction_db, G_TYPE_OBJECT)
+static gpointer pk_transaction_db_object = NULL;
 
 typedef struct {
 	gchar		*proxy_http;
@@ -68,67 +152,6 @@ typedef struct {
 	gboolean	set;
 } PkTransactionDbProxyItem;
 
-/**
- * pk_transaction_sqlite_transaction_cb:
- **/
-static gint
-pk_transaction_db_add_transaction_cb (void *data,
-				      gint argc,
-				      gchar **argv,
-				      gchar **col_name)
-{
-	PkTransactionPast *item;
-	GList **list = (GList **) data;
-	gint i;
-	gchar *col;
-	gchar *value;
-	guint temp;
-
-	item = pk_transaction_past_new ();
-	for (i = 0; i < argc; i++) {
-		col = col_name[i];
-		value = argv[i];
-		if (g_strcmp0 (col, "succeeded") == 0) {
-			if (!pk_strtouint (value, &temp)) {
-				g_warning ("failed to parse succeeded: %s", value);
-				continue;
-			}
-			if (temp == 1)
-				g_object_set (item, "succeeded", TRUE, NULL);
-			else
-				g_object_set (item, "succeeded", FALSE, NULL);
-		} else if (g_strcmp0 (col, "role") == 0) {
-			if (value != NULL)
-				g_object_set (item, "role", pk_role_enum_from_string (value), NULL);
-		} else if (g_strcmp0 (col, "transaction_id") == 0) {
-			if (value != NULL)
-				g_object_set (item, "tid", value, NULL);
-		} else if (g_strcmp0 (col, "timespec") == 0) {
-			if (value != NULL)
-				g_object_set (item, "timespec", value, NULL);
-		} else if (g_strcmp0 (col, "cmdline") == 0) {
-			if (value != NULL)
-				g_object_set (item, "cmdline", value, NULL);
-		} else if (g_strcmp0 (col, "data") == 0) {
-			if (value != NULL)
-				g_object_set (item, "data", value, NULL);
-		} else if (g_strcmp0 (col, "uid") == 0) {
-			if (pk_strtouint (value, &temp))
-				g_object_set (item, "uid", temp, NULL);
-		} else if (g_strcmp0 (col, "duration") == 0) {
-			if (pk_strtouint (value, &temp))
-				g_object_set (item, "duration", temp, NULL);
-		} else {
-			g_warning ("%s = %s", col, value);
-		}
-	}
-
-	/* add to start of the list */
-	*list = g_list_prepend (*list, item);
-
-	return 0;
-}
-
 /**
  * pk_transaction_db_sql_statement:
  **/
@@ -152,25 +175,221 @@ pk_transaction_db_sql_statement (PkTransactionDb *tdb, const gchar *sql)
 }
 
 /**
- * pk_time_action_sqlite_callback:
+ * pk_transaction_db_commit_cb:
  **/
-static gint
-pk_time_action_sqlite_callback (void *data, gint argc, gchar **argv, gchar **col_name)
+static gboolean
+pk_transaction_db_commit_cb (PkTransactionDb *tdb)
 {
-	gint i;
-	gchar *col;
-	gchar *value;
-	gchar **timespec = (gchar**) data;
+	pk_transaction_db_sql_statement (tdb, "COMMIT");
+	tdb->priv->database_commit_id = 0;
+	return FALSE;
+}
 
-	for (i = 0; i < argc; i++) {
-		col = col_name[i];
-		value = argv[i];
-		if (g_strcmp0 (col, "timespec") == 0)
-			*timespec = g_strdup (value);
-		else
-			g_warning ("%s = %s", col, value);
+/**
+ * pk_transaction_db_commit:
+ *
+ * Writes out any rows that are still waiting for the deferred commit.
+ **/
+static void
+pk_transaction_db_commit (PkTransactionDb *tdb)
+{
+	if (tdb->priv->database_commit_id == 0)
+		return;
+	g_source_remove (tdb->priv->database_commit_id);
+	pk_transaction_db_commit_cb (tdb);
+}
+
+/**
+ * pk_transaction_db_begin:
+ *
+ * Opens a write transaction, unless one is already open. All the rows
+ * written for a transaction in one pass of the main loop are then committed
+ * together when we are next idle, rather than each being its own journal
+ * write.
+ **/
+static void
+pk_transaction_db_begin (PkTransactionDb *tdb)
+{
+	if (tdb->priv->database_commit_id != 0)
+		return;
+	if (!pk_transaction_db_sql_statement (tdb, "BEGIN"))
+		return;
+	tdb->priv->database_commit_id =
+		g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc)
+				 pk_transaction_db_commit_cb, tdb, NULL);
+	g_source_set_name_by_id (tdb->priv->database_commit_id, "[PkTransactionDb] commit");
+}
+
+/**
+ * pk_transaction_db_get_stmt:
+ *
+ * Return value: the cached statement with no parameters bound, or %NULL
+ **/
+static sqlite3_stmt *
+pk_transaction_db_get_stmt (PkTransactionDb *tdb, PkTransactionDbStmt id)
+{
+	gint rc;
+
+	g_return_val_if_fail (tdb->priv->db != NULL, NULL);
+
+	if (tdb->priv->stmt[id] != NULL) {
+		sqlite3_clear_bindings (tdb->priv->stmt[id]);
+		return tdb->priv->stmt[id];
 	}
-	return 0;
+	rc = sqlite3_prepare_v2 (tdb->priv->db,
+				 pk_transaction_db_stmt_sql[id],
+				 -1, &tdb->priv->stmt[id], NULL);
+	if (rc != SQLITE_OK) {
+		g_warning ("failed to prepare statement: %s", sqlite3_errmsg (tdb->priv->db));
+		return NULL;
+	}
+	return tdb->priv->stmt[id];
+}
+
+/**
+ * pk_transaction_db_step:
+ *
+ * Executes a bound statement from pk_transaction_db_get_stmt() that
+ * returns no rows.
+ **/
+static gboolean
+pk_transaction_db_step (PkTransactionDb *tdb, sqlite3_stmt *stmt)
+{
+	gboolean ret = TRUE;
+	gint rc;
+
+	rc = sqlite3_step (stmt);
+	if (rc != SQLITE_DONE) {
+		g_warning ("failed to execute statement: %s", sqlite3_errmsg (tdb->priv->db));
+		ret = FALSE;
+	}
+	sqlite3_reset (stmt);
+	return ret;
+}
+
+/**
+ * pk_transaction_db_step_write:
+ *
+ * As pk_transaction_db_step(), but as part of the pending write transaction.
+ **/
+static gboolean
+pk_transaction_db_step_write (PkTransactionDb *tdb, sqlite3_stmt *stmt)
+{
+	pk_transaction_db_begin (tdb);
+	return pk_transaction_db_step (tdb, stmt);
+}
+
+/**
+ * pk_transaction_db_add_package_history:
+ * @data: the transaction data, one "info\tpackage-id\tsummary" per line
+ *
+ * Indexes the packages that were installed, removed or updated by a
+ * transaction.
+ **/
+static gboolean
+pk_transaction_db_add_package_history (PkTransactionDb *tdb,
+				       const gchar *tid,
+				       const gchar *timespec,
+				       guint uid,
+				       const gchar *data)
+{
+	gboolean ret = TRUE;
+	gint64 timestamp = 0;
+	guint i;
+	sqlite3_stmt *stmt;
+	GDateTime *datetime;
+	g_auto(GStrv) lines = NULL;
+
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_ADD_PACKAGE_HISTORY);
+	if (stmt == NULL)
+		return FALSE;
+
+	/* use the same resolution as PkTransactionPast */
+	datetime = pk_iso8601_to_datetime (timespec);
+	if (datetime != NULL) {
+		timestamp = g_date_time_to_unix (datetime);
+		g_date_time_unref (datetime);
+	}
+
+	lines = g_strsplit (data, "\n", -1);
+	for (i = 0; lines[i] != NULL; i++) {
+		PkInfoEnum info;
+		g_auto(GStrv) sections = NULL;
+		g_auto(GStrv) split = NULL;
+
+		sections = g_strsplit (lines[i], "\t", 3);
+		if (g_strv_length (sections) < 2) {
+			g_warning ("failed to parse package: '%s'", lines[i]);
+			continue;
+		}
+
+		/* not a state we care about */
+		info = pk_info_enum_from_string (sections[0]);
+		if (info != PK_INFO_ENUM_INSTALLING &&
+		    info != PK_INFO_ENUM_REMOVING &&
+		    info != PK_INFO_ENUM_UPDATING)
+			continue;
+
+		split = pk_package_id_split (sections[1]);
+		if (split == NULL) {
+			g_warning ("invalid package-id: '%s'", sections[1]);
+			continue;
+		}
+		sqlite3_bind_text (stmt, 1, split[PK_PACKAGE_ID_NAME], -1, SQLITE_STATIC);
+		sqlite3_bind_text (stmt, 2, sections[1], -1, SQLITE_STATIC);
+		sqlite3_bind_text (stmt, 3, sections[0], -1, SQLITE_STATIC);
+		sqlite3_bind_text (stmt, 4, tid, -1, SQLITE_STATIC);
+		sqlite3_bind_int64 (stmt, 5, timestamp);
+		sqlite3_bind_int64 (stmt, 6, uid);
+		if (!pk_transaction_db_step (tdb, stmt))
+			ret = FALSE;
+	}
+	return ret;
+}
+
+/**
+ * pk_transaction_db_backfill_package_history:
+ *
+ * Indexes the transactions saved before the package_history table existed.
+ **/
+static gboolean
+pk_transaction_db_backfill_package_history (PkTransactionDb *tdb, GError **error)
+{
+	gint rc;
+	sqlite3_stmt *statement = NULL;
+
+	rc = sqlite3_prepare_v2 (tdb->priv->db,
+				 "SELECT transaction_id, timespec, uid, data FROM transactions "
+				 "WHERE data IS NOT NULL AND timespec IS NOT NULL",
+				 -1, &statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+	while ((rc = sqlite3_step (statement)) == SQLITE_ROW) {
+		if (!pk_transaction_db_add_package_history (tdb,
+							    (const gchar *) sqlite3_column_text (statement, 0),
+							    (const gchar *) sqlite3_column_text (statement, 1),
+							    sqlite3_column_int64 (statement, 2),
+							    (const gchar *) sqlite3_column_text (statement, 3))) {
+			g_set_error (error, 1, 0,
+				     "failed to index transaction %s: %s",
+				     (const gchar *) sqlite3_column_text (statement, 0),
+				     sqlite3_errmsg (tdb->priv->db));
+			sqlite3_finalize (statement);
+			return FALSE;
+		}
+	}
+	sqlite3_finalize (statement);
+	if (rc != SQLITE_DONE) {
+		g_set_error (error, 1, 0,
+			     "failed to read transactions: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+	return TRUE;
 }
 
 /**
@@ -209,25 +428,23 @@ pk_transaction_db_iso8601_difference (const gchar *isodate)
 guint
 pk_transaction_db_action_time_since (PkTransactionDb *tdb, PkRoleEnum role)
 {
-	gchar *error_msg = NULL;
 	gint rc;
-	const gchar *role_text;
-	g_autofree gchar *statement = NULL;
+	sqlite3_stmt *stmt;
 	g_autofree gchar *timespec = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), 0);
 	g_return_val_if_fail (tdb->priv->db != NULL, 0);
 
-	role_text = pk_role_enum_to_string (role);
-
-	statement = g_strdup_printf ("SELECT timespec FROM last_action WHERE role = '%s'", role_text);
-	rc = sqlite3_exec (tdb->priv->db, statement,
-			   pk_time_action_sqlite_callback, &timespec, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_ACTION_TIME_SINCE);
+	if (stmt == NULL)
 		return G_MAXUINT;
-	}
+	sqlite3_bind_text (stmt, 1, pk_role_enum_to_string (role), -1, SQLITE_STATIC);
+	rc = sqlite3_step (stmt);
+	if (rc == SQLITE_ROW)
+		timespec = g_strdup ((const gchar *) sqlite3_column_text (stmt, 0));
+	else if (rc != SQLITE_DONE)
+		g_warning ("SQL error: %s", sqlite3_errmsg (tdb->priv->db));
+	sqlite3_reset (stmt);
 	if (timespec == NULL)
 		return G_MAXUINT;
 
@@ -241,69 +458,169 @@ pk_transaction_db_action_time_since (PkTransactionDb *tdb, PkRoleEnum role)
 gboolean
 pk_transaction_db_action_time_reset (PkTransactionDb *tdb, PkRoleEnum role)
 {
-	gchar *error_msg = NULL;
-	gint rc;
-	const gchar *role_text;
-	guint since;
-	g_autofree gchar *statement = NULL;
+	sqlite3_stmt *stmt;
 	g_autofree gchar *timespec = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
 
+	/* role is the primary key, so this updates or inserts the entry */
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_ACTION_TIME_RESET);
+	if (stmt == NULL)
+		return FALSE;
 	timespec = pk_iso8601_present ();
-	role_text = pk_role_enum_to_string (role);
+	sqlite3_bind_text (stmt, 1, pk_role_enum_to_string (role), -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 2, timespec, -1, SQLITE_STATIC);
+	return pk_transaction_db_step_write (tdb, stmt);
+}
 
-	/* get the previous entry */
-	since = pk_transaction_db_action_time_since (tdb, role);
-	if (since == G_MAXUINT) {
-		statement = g_strdup_printf ("INSERT INTO last_action (role, timespec) VALUES ('%s', '%s')", role_text, timespec);
+/**
+ * pk_transaction_db_foreach:
+ * @tdb: the #PkTransactionDb instance
+ * @before_tid: only return transactions older than this one, or %NULL
+ * @since: only return transactions started at or after this UNIX time, or 0
+ * @limit: the maximum number of transactions, or 0 for all
+ * @func: called for each transaction, oldest first
+ * @user_data: user data for @func
+ * @error: a #GError, or %NULL
+ *
+ * Steps through the newest @limit saved transactions without building
+ * objects for them. Passing the first transaction ID that @func was given
+ * as @before_tid gets the previous page.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+pk_transaction_db_foreach (PkTransactionDb *tdb,
+			   const gchar *before_tid,
+			   gint64 since,
+			   guint limit,
+			   PkTransactionDbForeachFunc func,
+			   gpointer user_data,
+			   GError **error)
+{
+	gint rc;
+	sqlite3_stmt *stmt;
+	g_autofree gchar *before_timespec = NULL;
+	g_autofree gchar *since_timespec = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+
+	/* find where the previous page stopped */
+	if (before_tid != NULL) {
+		stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_GET_TRANSACTION);
+		if (stmt == NULL) {
+			g_set_error (error, 1, 0,
+				     "failed to prepare statement: %s",
+				     sqlite3_errmsg (tdb->priv->db));
+			return FALSE;
+		}
+		sqlite3_bind_text (stmt, 1, before_tid, -1, SQLITE_STATIC);
+		if (sqlite3_step (stmt) == SQLITE_ROW)
+			before_timespec = g_strdup ((const gchar *) sqlite3_column_text (stmt, 0));
+		sqlite3_reset (stmt);
+		if (before_timespec == NULL) {
+			g_set_error (error, 1, 0,
+				     "no transaction %s", before_tid);
+			return FALSE;
+		}
+		stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_GET_TRANSACTIONS_BEFORE);
 	} else {
-		statement = g_strdup_printf ("UPDATE last_action SET timespec = '%s' WHERE role = '%s'", timespec, role_text);
+		stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_GET_TRANSACTIONS);
+	}
+	if (stmt == NULL) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
 	}
 
-	/* update or insert the entry */
-	rc = sqlite3_exec (tdb->priv->db, statement, NULL, NULL, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+	/* timespecs are all UTC, so compare as text; they are saved with
+	 * microseconds, and "12:00:00Z" would sort after "12:00:00.5Z" */
+	if (since > 0) {
+		g_autoptr(GDateTime) datetime = g_date_time_new_from_unix_utc (since);
+
+		/* too far in the future for anything to have started since */
+		if (datetime == NULL)
+			return TRUE;
+		since_timespec = g_date_time_format (datetime, "%Y-%m-%dT%H:%M:%S.000000Z");
+	}
+	sqlite3_bind_text (stmt, 1, since_timespec != NULL ? since_timespec : "", -1, SQLITE_STATIC);
+	sqlite3_bind_int64 (stmt, 2, limit > 0 ? (gint64) limit : -1);
+	if (before_timespec != NULL) {
+		sqlite3_bind_text (stmt, 3, before_timespec, -1, SQLITE_STATIC);
+		sqlite3_bind_text (stmt, 4, before_tid, -1, SQLITE_STATIC);
+	}
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+		const gchar *role = (const gchar *) sqlite3_column_text (stmt, 4);
+		func ((const gchar *) sqlite3_column_text (stmt, 0),
+		      (const gchar *) sqlite3_column_text (stmt, 1),
+		      sqlite3_column_int (stmt, 2) == 1,
+		      sqlite3_column_int64 (stmt, 3),
+		      role != NULL ? pk_role_enum_from_string (role) : PK_ROLE_ENUM_UNKNOWN,
+		      (const gchar *) sqlite3_column_text (stmt, 5),
+		      sqlite3_column_int64 (stmt, 6),
+		      (const gchar *) sqlite3_column_text (stmt, 7),
+		      user_data);
+	}
+	sqlite3_reset (stmt);
+	if (rc != SQLITE_DONE) {
+		g_set_error (error, 1, 0,
+			     "failed to get transactions: %s",
+			     sqlite3_errmsg (tdb->priv->db));
 		return FALSE;
 	}
 	return TRUE;
 }
 
+/**
+ * pk_transaction_db_get_list_cb:
+ **/
+static void
+pk_transaction_db_get_list_cb (const gchar *tid,
+			       const gchar *timespec,
+			       gboolean succeeded,
+			       guint duration,
+			       PkRoleEnum role,
+			       const gchar *data,
+			       guint uid,
+			       const gchar *cmdline,
+			       gpointer user_data)
+{
+	GList **list = (GList **) user_data;
+	PkTransactionPast *item;
+
+	item = pk_transaction_past_new ();
+	g_object_set (item,
+		      "tid", tid,
+		      "timespec", timespec,
+		      "succeeded", succeeded,
+		      "duration", duration,
+		      "role", role,
+		      "data", data,
+		      "uid", uid,
+		      "cmdline", cmdline,
+		      NULL);
+	*list = g_list_prepend (*list, item);
+}
+
 /**
  * pk_transaction_db_get_list:
  **/
 GList *
 pk_transaction_db_get_list (PkTransactionDb *tdb, guint limit)
 {
-	gchar *error_msg = NULL;
-	gint rc;
 	GList *list = NULL;
-	g_autofree gchar *statement = NULL;
+	g_autoptr(GError) error = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
 
-	if (limit == 0) {
-		statement = g_strdup ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
-				      "FROM transactions ORDER BY timespec DESC");
-	} else {
-		statement = g_strdup_printf ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
-					     "FROM transactions ORDER BY timespec DESC LIMIT %i", limit);
-	}
-	rc = sqlite3_exec (tdb->priv->db,
-			   statement,
-			   pk_transaction_db_add_transaction_cb,
-			   &list,
-			   &error_msg);
-	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
-		goto out;
-	}
-out:
-	return list;
+	if (!pk_transaction_db_foreach (tdb, NULL, 0, limit,
+					pk_transaction_db_get_list_cb,
+					&list, &error))
+		g_warning ("SQL error: %s", error->message);
+	return g_list_reverse (list);
 }
 
 /**
@@ -312,15 +629,18 @@ out:
 gboolean
 pk_transaction_db_add (PkTransactionDb *tdb, const gchar *tid)
 {
+	sqlite3_stmt *stmt;
 	g_autofree gchar *timespec = NULL;
-	g_autofree gchar *statement = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_ADD);
+	if (stmt == NULL)
+		return FALSE;
 	timespec = pk_iso8601_present ();
-	statement = g_strdup_printf ("INSERT INTO transactions (transaction_id, timespec) VALUES ('%s', '%s')", tid, timespec);
-	pk_transaction_db_sql_statement (tdb, statement);
-	return TRUE;
+	sqlite3_bind_text (stmt, 1, tid, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 2, timespec, -1, SQLITE_STATIC);
+	return pk_transaction_db_step_write (tdb, stmt);
 }
 
 /**
@@ -329,15 +649,16 @@ pk_transaction_db_add (PkTransactionDb *tdb, const gchar *tid)
 gboolean
 pk_transaction_db_set_role (PkTransactionDb *tdb, const gchar *tid, PkRoleEnum role)
 {
-	const gchar *role_text;
-	g_autofree gchar *statement = NULL;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	role_text = pk_role_enum_to_string (role);
-	statement = g_strdup_printf ("UPDATE transactions SET role = '%s' WHERE transaction_id = '%s'", role_text, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
-	return TRUE;
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_SET_ROLE);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, pk_role_enum_to_string (role), -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 2, tid, -1, SQLITE_STATIC);
+	return pk_transaction_db_step_write (tdb, stmt);
 }
 
 /**
@@ -346,13 +667,16 @@ pk_transaction_db_set_role (PkTransactionDb *tdb, const gchar *tid, PkRoleEnum r
 gboolean
 pk_transaction_db_set_uid (PkTransactionDb *tdb, const gchar *tid, guint uid)
 {
-	g_autofree gchar *statement = NULL;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	statement = g_strdup_printf ("UPDATE transactions SET uid = '%i' WHERE transaction_id = '%s'", uid, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
-	return TRUE;
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_SET_UID);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_int64 (stmt, 1, uid);
+	sqlite3_bind_text (stmt, 2, tid, -1, SQLITE_STATIC);
+	return pk_transaction_db_step_write (tdb, stmt);
 }
 
 /**
@@ -361,13 +685,16 @@ pk_transaction_db_set_uid (PkTransactionDb *tdb, const gchar *tid, guint uid)
 gboolean
 pk_transaction_db_set_cmdline (PkTransactionDb *tdb, const gchar *tid, const gchar *cmdline)
 {
-	g_autofree gchar *statement = NULL;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	statement = g_strdup_printf ("UPDATE transactions SET cmdline = '%s' WHERE transaction_id = '%s'", cmdline, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
-	return TRUE;
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_SET_CMDLINE);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, cmdline, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 2, tid, -1, SQLITE_STATIC);
+	return pk_transaction_db_step_write (tdb, stmt);
 }
 
 /**
@@ -376,14 +703,89 @@ pk_transaction_db_set_cmdline (PkTransactionDb *tdb, const gchar *tid, const gch
 gboolean
 pk_transaction_db_set_data (PkTransactionDb *tdb, const gchar *tid, const gchar *data)
 {
-	g_autofree gchar *statement = NULL;
+	guint uid = 0;
+	sqlite3_stmt *stmt;
+	g_autofree gchar *timespec = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	/* TODO: we have to be careful of SQL injection attacks */
-	statement = g_strdup_printf ("UPDATE transactions SET data = \"%s\" WHERE transaction_id = '%s'",
-				     data, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
+	/* bind data, so that package names cannot be used to inject SQL */
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_SET_DATA);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, data, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 2, tid, -1, SQLITE_STATIC);
+	if (!pk_transaction_db_step_write (tdb, stmt))
+		return FALSE;
+
+	/* index the packages for GetPackageHistory */
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_GET_TRANSACTION);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, tid, -1, SQLITE_STATIC);
+	if (sqlite3_step (stmt) == SQLITE_ROW) {
+		timespec = g_strdup ((const gchar *) sqlite3_column_text (stmt, 0));
+		uid = sqlite3_column_int64 (stmt, 1);
+	}
+	sqlite3_reset (stmt);
+	if (timespec == NULL) {
+		g_warning ("no transaction %s to add history for", tid);
+		return FALSE;
+	}
+	return pk_transaction_db_add_package_history (tdb, tid, timespec, uid, data);
+}
+
+/**
+ * pk_transaction_db_get_package_history:
+ * @tdb: the #PkTransactionDb instance
+ * @name: the package name
+ * @limit: the maximum number of entries, or 0 for all
+ * @func: called for each entry, oldest first
+ * @user_data: user data for @func
+ * @error: a #GError, or %NULL
+ *
+ * Gets the installs, removals and updates of a package by successful
+ * transactions. If @limit is set only the newest entries are returned.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+pk_transaction_db_get_package_history (PkTransactionDb *tdb,
+				       const gchar *name,
+				       guint limit,
+				       PkTransactionDbPackageHistoryFunc func,
+				       gpointer user_data,
+				       GError **error)
+{
+	gint rc;
+	sqlite3_stmt *stmt;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_GET_PACKAGE_HISTORY);
+	if (stmt == NULL) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+	sqlite3_bind_text (stmt, 1, name, -1, SQLITE_STATIC);
+	sqlite3_bind_int64 (stmt, 2, limit > 0 ? (gint64) limit : -1);
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+		func ((const gchar *) sqlite3_column_text (stmt, 0),
+		      pk_info_enum_from_string ((const gchar *) sqlite3_column_text (stmt, 1)),
+		      sqlite3_column_int64 (stmt, 2),
+		      sqlite3_column_int64 (stmt, 3),
+		      user_data);
+	}
+	sqlite3_reset (stmt);
+	if (rc != SQLITE_DONE) {
+		g_set_error (error, 1, 0,
+			     "failed to get history for %s: %s",
+			     name, sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
 	return TRUE;
 }
 
@@ -395,14 +797,17 @@ pk_transaction_db_set_data (PkTransactionDb *tdb, const gchar *tid, const gchar
 gboolean
 pk_transaction_db_set_finished (PkTransactionDb *tdb, const gchar *tid, gboolean success, guint runtime)
 {
-	g_autofree gchar *statement = NULL;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 
-	statement = g_strdup_printf ("UPDATE transactions SET succeeded = %i, duration = %i WHERE transaction_id = '%s'",
-				     success, runtime, tid);
-	pk_transaction_db_sql_statement (tdb, statement);
-	return TRUE;
+	stmt = pk_transaction_db_get_stmt (tdb, PK_TRANSACTION_DB_STMT_SET_FINISHED);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_int (stmt, 1, success ? 1 : 0);
+	sqlite3_bind_int64 (stmt, 2, runtime);
+	sqlite3_bind_text (stmt, 3, tid, -1, SQLITE_STATIC);
+	return pk_transaction_db_step_write (tdb, stmt);
 }
 
 /**
@@ -492,6 +897,9 @@ pk_transaction_db_defer_write_job_count_cb (PkTransactionDb *tdb)
 		goto out;
 	}
 
+	/* the pragma cannot be changed inside a transaction */
+	pk_transaction_db_commit (tdb);
+
 	/* force fsync as we don't want to repeat this number */
 	sqlite3_exec (tdb->priv->db, "PRAGMA synchronous=ON", NULL, NULL, NULL);
 
@@ -835,6 +1243,51 @@ pk_transaction_db_execute (PkTransactionDb *tdb,
 	return ret;
 }
 
+/**
+ * pk_transaction_db_migrate:
+ *
+ * Brings the schema up to date, applying each missing migration in its own
+ * transaction so that an interrupted upgrade is simply resumed next time.
+ **/
+static gboolean
+pk_transaction_db_migrate (PkTransactionDb *tdb, GError **error)
+{
+	gint rc;
+	guint i;
+	guint version = 0;
+	sqlite3_stmt *statement = NULL;
+
+	/* get the schema version */
+	rc = sqlite3_prepare_v2 (tdb->priv->db, "PRAGMA user_version", -1, &statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to get schema version: %s",
+			     sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+	if (sqlite3_step (statement) == SQLITE_ROW)
+		version = sqlite3_column_int (statement, 0);
+	sqlite3_finalize (statement);
+
+	for (i = version; i < G_N_ELEMENTS (pk_transaction_db_migrations); i++) {
+		const PkTransactionDbMigration *migration = &pk_transaction_db_migrations[i];
+		g_autofree gchar *text = NULL;
+		g_debug ("migrating transaction database to version %i", i + 1);
+		if (!pk_transaction_db_execute (tdb, "BEGIN", error))
+			return FALSE;
+		text = g_strdup_printf ("PRAGMA user_version = %i", i + 1);
+		if (!pk_transaction_db_execute (tdb, migration->sql, error) ||
+		    (migration->func != NULL && !migration->func (tdb, error)) ||
+		    !pk_transaction_db_execute (tdb, text, error)) {
+			pk_transaction_db_execute (tdb, "ROLLBACK", NULL);
+			return FALSE;
+		}
+		if (!pk_transaction_db_execute (tdb, "COMMIT", error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 /**
  * pk_transaction_db_load:
  **/
@@ -870,6 +1323,13 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 	if (!pk_transaction_db_execute (tdb, "PRAGMA synchronous=OFF", error))
 		return FALSE;
 
+	/* appending to a log is cheaper than rewriting a rollback journal,
+	 * and readers are not blocked by the pending write transaction */
+	if (!pk_transaction_db_execute (tdb, "PRAGMA journal_mode=WAL", &error_local)) {
+		g_warning ("failed to use write-ahead log: %s", error_local->message);
+		g_clear_error (&error_local);
+	}
+
 	/* check transactions */
 	if (!pk_transaction_db_execute (tdb, "SELECT * FROM transactions LIMIT 1", &error_local)) {
 		g_debug ("creating table to repair: %s", error_local->message);
@@ -933,6 +1393,10 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 			return FALSE;
 	}
 
+	/* apply any schema changes made since */
+	if (!pk_transaction_db_migrate (tdb, error))
+		return FALSE;
+
 	/* try to set correct permissions */
 	g_chmod (PK_DB_DIR "/transactions.db", 0644);
 
@@ -958,17 +1422,21 @@ static void
 pk_transaction_db_finalize (GObject *object)
 {
 	PkTransactionDb *tdb;
+	guint i;
 	g_return_if_fail (PK_IS_TRANSACTION_DB (object));
 	tdb = PK_TRANSACTION_DB (object);
 	g_return_if_fail (tdb->priv != NULL);
 
 	/* if we shutdown with a deferred database write, then enforce it here */
 	if (tdb->priv->database_save_id != 0) {
-		pk_transaction_db_defer_write_job_count_cb (tdb);
 		g_source_remove (tdb->priv->database_save_id);
+		pk_transaction_db_defer_write_job_count_cb (tdb);
 	}
+	pk_transaction_db_commit (tdb);
 
 	/* close the database */
+	for (i = 0; i < PK_TRANSACTION_DB_STMT_LAST; i++)
+		sqlite3_finalize (tdb->priv->stmt[i]);
 	sqlite3_close (tdb->priv->db);
 
 	G_OBJECT_CLASS (pk_transaction_db_parent_class)->finalize (object);
@@ -977,13 +1445,20 @@ pk_transaction_db_finalize (GObject *object)
 /**
  * pk_transaction_db_new:
  *
+ * The database connection, and the statements cached on it, are shared by
+ * the engine and every transaction.
+ *
  * Return value: a new PkTransactionDb object.
  **/
 PkTransactionDb *
 pk_transaction_db_new (void)
 {
-	PkTransactionDb *tdb;
-	tdb = g_object_new (PK_TYPE_TRANSACTION_DB, NULL);
-	return PK_TRANSACTION_DB (tdb);
+	if (pk_transaction_db_object != NULL) {
+		g_object_ref (pk_transaction_db_object);
+	} else {
+		pk_transaction_db_object = g_object_new (PK_TYPE_TRANSACTION_DB, NULL);
+		g_object_add_weak_pointer (pk_transaction_db_object, &pk_transaction_db_object);
+	}
+	return PK_TRANSACTION_DB (pk_transaction_db_object);
 }
 
@@ -47,6 +47,21 @@ typedef struct
 	GObjectClass	parent_class;
 } PkTransactionDbClass;
 
+typedef void	(*PkTransactionDbPackageHistoryFunc)	(const gchar		*package_id,
+							 PkInfoEnum		 info,
+							 gint64			 timestamp,
+							 guint			 uid,
+							 gpointer		 user_data);
+typedef void	(*PkTransactionDbForeachFunc)		(const gchar		*tid,
+							 const gchar		*timespec,
+							 gboolean		 succeeded,
+							 guint			 duration,
+							 PkRoleEnum		 role,
+							 const gchar		*data,
+							 guint			 uid,
+							 const gchar		*cmdline,
+							 gpointer		 user_data);
+
 #ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkTransactionDb, g_object_unref)
 #endif
@@ -77,6 +92,19 @@ gboolean	 pk_transaction_db_set_data		(PkTransactionDb	*tdb,
 							 const gchar		*data);
 GList		*pk_transaction_db_get_list		(PkTransactionDb	*tdb,
 							 guint			 limit);
+gboolean	 pk_transaction_db_foreach		(PkTransactionDb	*tdb,
+							 const gchar		*before_tid,
+							 gint64			 since,
+							 guint			 limit,
+							 PkTransactionDbForeachFunc func,
+							 gpointer		 user_data,
+							 GError			**error);
+gboolean	 pk_transaction_db_get_package_history	(PkTransactionDb	*tdb,
+							 const gchar		*name,
+							 guint			 limit,
+							 PkTransactionDbPackageHistoryFunc func,
+							 gpointer		 user_data,
+							 GError			**error);
 gboolean	 pk_transaction_db_action_time_reset	(PkTransactionDb	*tdb,
 							 PkRoleEnum		 role);
 guint		 pk_transaction_db_action_time_since	(PkTransactionDb	*tdb,
@@ -52,6 +52,7 @@
 #include "pk-backend.h"
 #include "pk-dbus.h"
 #include "pk-shared.h"
+#include "pk-trace.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
 #include "pk-transaction-private.h"
@@ -138,6 +139,9 @@ struct PkTransactionPrivate
 	guint			 registration_id;
 	GDBusConnection		*connection;
 	GDBusNodeInfo		*introspection;
+	GError			**start_error;
+	PkTrace			*trace;
+	gint64			 trace_stages[PK_TRACE_STAGE_LAST];
 };
 
 typedef enum {
@@ -415,6 +419,53 @@ pk_transaction_status_changed_emit (PkTransaction *transaction, PkStatusEnum sta
 					      g_variant_new_uint32 (status));
 }
 
+/**
+ * pk_transaction_trace_mark:
+ *
+ * Records when @stage was first reached.
+ **/
+static void
+pk_transaction_trace_mark (PkTransaction *transaction, PkTraceStage stage)
+{
+	if (transaction->priv->trace_stages[stage] == 0)
+		transaction->priv->trace_stages[stage] = g_get_monotonic_time ();
+}
+
+/**
+ * pk_transaction_trace_flush_cb:
+ **/
+static void
+pk_transaction_trace_flush_cb (GObject *source_object,
+			       GAsyncResult *res,
+			       gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+	PkTransactionPrivate *priv = transaction->priv;
+	g_autoptr(GError) error = NULL;
+
+	if (!g_dbus_connection_flush_finish (G_DBUS_CONNECTION (source_object),
+					     res, &error))
+		g_debug ("failed to flush for trace: %s", error->message);
+	pk_transaction_trace_mark (transaction, PK_TRACE_STAGE_FLUSHED);
+	pk_trace_add (priv->trace, priv->role, priv->tid, priv->trace_stages);
+	g_object_unref (transaction);
+}
+
+/**
+ * pk_transaction_set_trace:
+ *
+ * Reports the stage timings to @trace when the transaction has finished.
+ **/
+void
+pk_transaction_set_trace (PkTransaction *transaction, PkTrace *trace)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+
+	g_clear_object (&transaction->priv->trace);
+	if (trace != NULL)
+		transaction->priv->trace = g_object_ref (trace);
+}
+
 /**
  * pk_transaction_finished_emit:
  **/
@@ -436,6 +487,15 @@ pk_transaction_finished_emit (PkTransaction *transaction,
 						      time_ms),
 				       NULL);
 
+	/* time until the client can actually see the result */
+	if (transaction->priv->trace != NULL &&
+	    transaction->priv->trace_stages[PK_TRACE_STAGE_FINISHED] == 0) {
+		pk_transaction_trace_mark (transaction, PK_TRACE_STAGE_FINISHED);
+		g_dbus_connection_flush (transaction->priv->connection, NULL,
+					 pk_transaction_trace_flush_cb,
+					 g_object_ref (transaction));
+	}
+
 	/* For the transaction list */
 	g_signal_emit (transaction, signals[SIGNAL_FINISHED], 0);
 }
@@ -828,6 +888,12 @@ pk_transaction_set_state (PkTransaction *transaction, PkTransactionState state)
 
 	g_debug ("transaction now %s", pk_transaction_state_to_string (state));
 	priv->state = state;
+	if (state == PK_TRANSACTION_STATE_NEW)
+		pk_transaction_trace_mark (transaction, PK_TRACE_STAGE_CREATED);
+	else if (state == PK_TRANSACTION_STATE_READY)
+		pk_transaction_trace_mark (transaction, PK_TRACE_STAGE_AUTHORIZED);
+	else if (state == PK_TRANSACTION_STATE_RUNNING)
+		pk_transaction_trace_mark (transaction, PK_TRACE_STAGE_SCHEDULED);
 	g_signal_emit (transaction, signals[SIGNAL_STATE_CHANGED], 0, state);
 
 	/* only save into the database for useful stuff */
@@ -1286,6 +1352,8 @@ pk_transaction_package_cb (PkBackend *backend,
 		pk_results_add_package (transaction->priv->results, item);
 
 	/* emit */
+	pk_transaction_trace_mark (transaction, PK_TRACE_STAGE_FIRST_PACKAGE);
+	transaction->priv->trace_stages[PK_TRACE_STAGE_LAST_PACKAGE] = g_get_monotonic_time ();
 	package_id = pk_package_get_id (item);
 	g_free (transaction->priv->last_package_id);
 	transaction->priv->last_package_id = g_strdup (package_id);
@@ -1777,6 +1845,7 @@ pk_transaction_run (PkTransaction *transaction)
 	}
 
 	/* run the job */
+	pk_transaction_trace_mark (transaction, PK_TRACE_STAGE_BACKEND_STARTED);
 	pk_backend_start_job (priv->backend, priv->job);
 
 	/* is an error code set? */
@@ -2074,6 +2143,148 @@ pk_transaction_run (PkTransaction *transaction)
 	return TRUE;
 }
 
+/**
+ * pk_transaction_get_results:
+ *
+ * Return value: the results so far, do not unref.
+ **/
+PkResults *
+pk_transaction_get_results (PkTransaction *transaction)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+	return transaction->priv->results;
+}
+
+/**
+ * pk_transaction_get_coalesce_key:
+ *
+ * Transactions with the same key would return the same results, so only
+ * one of them has to be run on the backend.
+ *
+ * Return value: the key, or %NULL if the role cannot be shared
+ **/
+gchar *
+pk_transaction_get_coalesce_key (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	GString *key;
+	const gchar *locale;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+
+	/* only roles without side effects that do not read local files */
+	switch (priv->role) {
+	case PK_ROLE_ENUM_DEPENDS_ON:
+	case PK_ROLE_ENUM_GET_CATEGORIES:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_DISTRO_UPGRADES:
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_REPO_LIST:
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+	case PK_ROLE_ENUM_GET_UPDATES:
+	case PK_ROLE_ENUM_REQUIRED_BY:
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		break;
+	default:
+		return NULL;
+	}
+
+	locale = pk_backend_job_get_locale (priv->job);
+	key = g_string_new (pk_role_enum_to_string (priv->role));
+	g_string_append_printf (key, "\n%u\n%" G_GUINT64_FORMAT "\n%i\n%u\n%s",
+				pk_backend_get_generation (priv->backend),
+				priv->cached_filters,
+				priv->cached_force,
+				pk_backend_job_get_cache_age (priv->job),
+				locale != NULL ? locale : "");
+	for (i = 0; priv->cached_package_ids != NULL && priv->cached_package_ids[i] != NULL; i++)
+		g_string_append_printf (key, "\nid:%s", priv->cached_package_ids[i]);
+	for (i = 0; priv->cached_values != NULL && priv->cached_values[i] != NULL; i++)
+		g_string_append_printf (key, "\nvalue:%s", priv->cached_values[i]);
+	return g_string_free (key, FALSE);
+}
+
+/**
+ * pk_transaction_replay_results:
+ * @transaction: a committed transaction that has not been run
+ * @results: the results of an identical transaction
+ *
+ * Finishes the transaction by emitting a copy of the results of another
+ * transaction instead of running anything on the backend.
+ **/
+void
+pk_transaction_replay_results (PkTransaction *transaction, PkResults *results)
+{
+	PkExitEnum exit_enum;
+	PkTransactionPrivate *priv = transaction->priv;
+	guint i;
+	guint time_ms;
+	g_autoptr(GPtrArray) categories = NULL;
+	g_autoptr(GPtrArray) details = NULL;
+	g_autoptr(GPtrArray) distro_upgrades = NULL;
+	g_autoptr(GPtrArray) files = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GPtrArray) repo_details = NULL;
+	g_autoptr(GPtrArray) update_details = NULL;
+	g_autoptr(PkError) error_code = NULL;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_RESULTS (results));
+
+	/* have we already been marked as finished? */
+	if (priv->finished) {
+		g_warning ("Already finished");
+		return;
+	}
+
+	/* emit each result as if the backend had just sent it */
+	packages = pk_results_get_package_array (results);
+	for (i = 0; i < packages->len; i++)
+		pk_transaction_package_cb (NULL, g_ptr_array_index (packages, i), transaction);
+	details = pk_results_get_details_array (results);
+	for (i = 0; i < details->len; i++)
+		pk_transaction_details_cb (NULL, g_ptr_array_index (details, i), transaction);
+	files = pk_results_get_files_array (results);
+	for (i = 0; i < files->len; i++)
+		pk_transaction_files_cb (NULL, g_ptr_array_index (files, i), transaction);
+	update_details = pk_results_get_update_detail_array (results);
+	for (i = 0; i < update_details->len; i++)
+		pk_transaction_update_detail_cb (NULL, g_ptr_array_index (update_details, i), transaction);
+	repo_details = pk_results_get_repo_detail_array (results);
+	for (i = 0; i < repo_details->len; i++)
+		pk_transaction_repo_detail_cb (NULL, g_ptr_array_index (repo_details, i), transaction);
+	categories = pk_results_get_category_array (results);
+	for (i = 0; i < categories->len; i++)
+		pk_transaction_category_cb (NULL, g_ptr_array_index (categories, i), transaction);
+	distro_upgrades = pk_results_get_distro_upgrade_array (results);
+	for (i = 0; i < distro_upgrades->len; i++)
+		pk_transaction_distro_upgrade_cb (NULL, g_ptr_array_index (distro_upgrades, i), transaction);
+	error_code = pk_results_get_error_code (results);
+	if (error_code != NULL)
+		pk_transaction_error_code_cb (NULL, error_code, transaction);
+
+	/* we should get no more with this tid */
+	exit_enum = pk_results_get_exit_code (results);
+	pk_results_set_exit_code (priv->results, exit_enum);
+	priv->finished = TRUE;
+
+	time_ms = pk_transaction_get_runtime (transaction);
+	syslog (LOG_DAEMON | LOG_INFO,
+		"%s transaction %s shared the results of an identical transaction, finished with %s after %ims",
+		pk_role_enum_to_string (priv->role),
+		priv->tid,
+		pk_exit_enum_to_string (exit_enum),
+		time_ms);
+	pk_transaction_finished_emit (transaction, exit_enum, time_ms);
+}
+
 /**
  * pk_transaction_get_tid:
  */
@@ -2693,8 +2904,18 @@ pk_transaction_set_role (PkTransaction *transaction, PkRoleEnum role)
  * pk_transaction_dbus_return:
  **/
 static void
-pk_transaction_dbus_return (GDBusMethodInvocation *context, const GError *error)
+pk_transaction_dbus_return (PkTransaction *transaction,
+			    GDBusMethodInvocation *context,
+			    const GError *error)
 {
+	/* called by pk_transaction_start() rather than over D-Bus */
+	if (context == NULL && transaction->priv->start_error != NULL) {
+		if (error != NULL)
+			g_propagate_error (transaction->priv->start_error,
+					   g_error_copy (error));
+		return;
+	}
+
 	/* not set inside the test suite */
 	if (context == NULL) {
 		if (error != NULL)
@@ -2753,7 +2974,7 @@ pk_transaction_accept_eula (PkTransaction *transaction,
 	idle_id = g_idle_add ((GSourceFunc) pk_transaction_finished_idle_cb, transaction);
 	g_source_set_name_by_id (idle_id, "[PkTransaction] finished from accept");
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -2836,7 +3057,7 @@ pk_transaction_cancel (PkTransaction *transaction,
 		g_debug ("No point trying to cancel a finished transaction, ignoring");
 
 		/* return from async with success */
-		pk_transaction_dbus_return (context, NULL);
+		pk_transaction_dbus_return (transaction, context, NULL);
 		goto out;
 	}
 
@@ -2910,7 +3131,7 @@ skip_uid:
 	/* actually run the method */
 	pk_backend_cancel (transaction->priv->backend, transaction->priv->job);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -2994,7 +3215,7 @@ pk_transaction_download_packages (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_DOWNLOAD_PACKAGES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3026,7 +3247,7 @@ pk_transaction_get_categories (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_CATEGORIES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3097,7 +3318,7 @@ pk_transaction_depends_on (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_DEPENDS_ON);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3163,7 +3384,7 @@ pk_transaction_get_details (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_DETAILS);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3267,7 +3488,7 @@ pk_transaction_get_details_local (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_DETAILS_LOCAL);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3371,7 +3592,7 @@ pk_transaction_get_files_local (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_FILES_LOCAL);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3404,7 +3625,7 @@ pk_transaction_get_distro_upgrades (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_DISTRO_UPGRADES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3469,7 +3690,7 @@ pk_transaction_get_files (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_FILES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3507,7 +3728,82 @@ pk_transaction_get_packages (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_PACKAGES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
+}
+
+/**
+ * pk_transaction_get_old_transactions_cb:
+ **/
+static void
+pk_transaction_get_old_transactions_cb (const gchar *tid,
+					const gchar *modified,
+					gboolean succeeded,
+					guint duration,
+					PkRoleEnum role,
+					const gchar *data,
+					guint uid,
+					const gchar *cmdline,
+					gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+
+	/* emit each row as it is read, without building a list */
+	g_debug ("adding transaction %s, %s, %i, %s, %i, %s, %i, %s",
+		 tid, modified, succeeded,
+		 pk_role_enum_to_string (role),
+		 duration, data, uid, cmdline);
+	g_dbus_connection_emit_signal (transaction->priv->connection,
+				       NULL,
+				       transaction->priv->tid,
+				       PK_DBUS_INTERFACE_TRANSACTION,
+				       "Transaction",
+				       g_variant_new ("(osbuusus)",
+						      tid,
+						      modified != NULL ? modified : "",
+						      succeeded,
+						      role,
+						      duration,
+						      data != NULL ? data : "",
+						      uid,
+						      cmdline != NULL ? cmdline : ""),
+				       NULL);
+}
+
+/**
+ * pk_transaction_emit_old_transactions:
+ **/
+static void
+pk_transaction_emit_old_transactions (PkTransaction *transaction,
+				      const gchar *before_tid,
+				      guint64 since,
+				      guint number,
+				      GDBusMethodInvocation *context)
+{
+	guint idle_id;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GError) error_local = NULL;
+
+	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_OLD_TRANSACTIONS);
+	if (!pk_transaction_db_foreach (transaction->priv->transaction_db,
+					before_tid,
+					(gint64) MIN (since, G_MAXINT64),
+					number,
+					pk_transaction_get_old_transactions_cb,
+					transaction,
+					&error_local)) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NO_SUCH_TRANSACTION,
+			     "failed to get old transactions: %s",
+			     error_local->message);
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+
+	idle_id = g_idle_add ((GSourceFunc) pk_transaction_finished_idle_cb, transaction);
+	g_source_set_name_by_id (idle_id, "[PkTransaction] finished from get-old-transactions");
+out:
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3518,19 +3814,7 @@ pk_transaction_get_old_transactions (PkTransaction *transaction,
 				     GVariant *params,
 				     GDBusMethodInvocation *context)
 {
-	const gchar *cmdline;
-	const gchar *data;
-	const gchar *modified;
-	const gchar *tid;
-	gboolean succeeded;
-	GList *l;
-	GList *transactions = NULL;
-	guint duration;
-	guint idle_id;
 	guint number;
-	guint uid;
-	PkRoleEnum role;
-	PkTransactionPast *item;
 
 	g_return_if_fail (PK_IS_TRANSACTION (transaction));
 	g_return_if_fail (transaction->priv->tid != NULL);
@@ -3539,52 +3823,34 @@ pk_transaction_get_old_transactions (PkTransaction *transaction,
 		       &number);
 
 	g_debug ("GetOldTransactions method called");
+	pk_transaction_emit_old_transactions (transaction, NULL, 0, number, context);
+}
 
-	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_OLD_TRANSACTIONS);
-	transactions = pk_transaction_db_get_list (transaction->priv->transaction_db, number);
-	for (l = transactions; l != NULL; l = l->next) {
-		item = PK_TRANSACTION_PAST (l->data);
-
-		/* add to results */
-		pk_results_add_transaction (transaction->priv->results, item);
-
-		/* get data */
-		role = pk_transaction_past_get_role (item);
-		tid = pk_transaction_past_get_id (item);
-		modified = pk_transaction_past_get_timespec (item);
-		succeeded = pk_transaction_past_get_succeeded (item);
-		duration = pk_transaction_past_get_duration (item);
-		data = pk_transaction_past_get_data (item);
-		uid = pk_transaction_past_get_uid (item);
-		cmdline = pk_transaction_past_get_cmdline (item);
-
-		/* emit */
-		g_debug ("adding transaction %s, %s, %i, %s, %i, %s, %i, %s",
-			 tid, modified, succeeded,
-			 pk_role_enum_to_string (role),
-			 duration, data, uid, cmdline);
-		g_dbus_connection_emit_signal (transaction->priv->connection,
-					       NULL,
-					       transaction->priv->tid,
-					       PK_DBUS_INTERFACE_TRANSACTION,
-					       "Transaction",
-					       g_variant_new ("(osbuusus)",
-							      tid,
-							      modified,
-							      succeeded,
-							      role,
-							      duration,
-							      data != NULL ? data : "",
-							      uid,
-							      cmdline != NULL ? cmdline : ""),
-					       NULL);
-	}
-	g_list_free_full (transactions, (GDestroyNotify) g_object_unref);
+/**
+ * pk_transaction_get_old_transactions_page:
+ **/
+static void
+pk_transaction_get_old_transactions_page (PkTransaction *transaction,
+					  GVariant *params,
+					  GDBusMethodInvocation *context)
+{
+	const gchar *before_tid;
+	guint number;
+	guint64 since;
 
-	idle_id = g_idle_add ((GSourceFunc) pk_transaction_finished_idle_cb, transaction);
-	g_source_set_name_by_id (idle_id, "[PkTransaction] finished from get-old-transactions");
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (transaction->priv->tid != NULL);
 
-	pk_transaction_dbus_return (context, NULL);
+	g_variant_get (params, "(u&st)",
+		       &number,
+		       &before_tid,
+		       &since);
+
+	g_debug ("GetOldTransactionsPage method called: %i, %s, %" G_GUINT64_FORMAT,
+		 number, before_tid, since);
+	pk_transaction_emit_old_transactions (transaction,
+					      before_tid[0] != '\0' ? before_tid : NULL,
+					      since, number, context);
 }
 
 /**
@@ -3622,7 +3888,7 @@ pk_transaction_get_repo_list (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_REPO_LIST);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3693,7 +3959,7 @@ pk_transaction_required_by (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_REQUIRED_BY);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3759,7 +4025,7 @@ pk_transaction_get_update_detail (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_UPDATE_DETAIL);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3797,7 +4063,7 @@ pk_transaction_get_updates (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_UPDATES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -3953,7 +4219,7 @@ pk_transaction_install_files (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4037,7 +4303,7 @@ pk_transaction_install_packages (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4110,7 +4376,7 @@ pk_transaction_install_signature (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4157,7 +4423,7 @@ pk_transaction_refresh_cache (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4247,7 +4513,7 @@ pk_transaction_remove_packages (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4304,7 +4570,7 @@ pk_transaction_repo_enable (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4365,7 +4631,7 @@ pk_transaction_repo_set_data (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4428,7 +4694,7 @@ pk_transaction_repo_remove (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4504,7 +4770,7 @@ pk_transaction_resolve (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_RESOLVE);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4554,7 +4820,7 @@ pk_transaction_search_details (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_SEARCH_DETAILS);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4617,7 +4883,7 @@ pk_transaction_search_files (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_SEARCH_FILE);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4680,7 +4946,7 @@ pk_transaction_search_groups (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_SEARCH_GROUP);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4730,7 +4996,7 @@ pk_transaction_search_names (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_SEARCH_NAME);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4846,6 +5112,34 @@ pk_transaction_set_hint (PkTransaction *transaction,
 	return TRUE;
 }
 
+/**
+ * pk_transaction_set_hints_strv:
+ */
+static gboolean
+pk_transaction_set_hints_strv (PkTransaction *transaction,
+			       gchar **hints,
+			       GError **error)
+{
+	guint i;
+
+	for (i = 0; hints[i] != NULL; i++) {
+		g_auto(GStrv) sections = NULL;
+		sections = g_strsplit (hints[i], "=", 2);
+		if (g_strv_length (sections) != 2) {
+			g_set_error (error, PK_TRANSACTION_ERROR,
+					    PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+					    "Could not parse hint '%s'", hints[i]);
+			return FALSE;
+		}
+		if (!pk_transaction_set_hint (transaction,
+					      sections[0],
+					      sections[1],
+					      error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 /**
  * pk_transaction_set_hints:
  */
@@ -4854,8 +5148,6 @@ pk_transaction_set_hints (PkTransaction *transaction,
 			  GVariant *params,
 			  GDBusMethodInvocation *context)
 {
-	gboolean ret;
-	guint i;
 	g_autofree gchar **hints = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *dbg = NULL;
@@ -4868,25 +5160,8 @@ pk_transaction_set_hints (PkTransaction *transaction,
 	g_debug ("SetHints method called: %s", dbg);
 
 	/* parse */
-	for (i = 0; hints[i] != NULL; i++) {
-		g_auto(GStrv) sections = NULL;
-		sections = g_strsplit (hints[i], "=", 2);
-		if (g_strv_length (sections) == 2) {
-			ret = pk_transaction_set_hint (transaction,
-						       sections[0],
-						       sections[1],
-						       &error);
-			if (!ret)
-				goto out;
-		} else {
-			g_set_error (&error, PK_TRANSACTION_ERROR,
-					     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
-					     "Could not parse hint '%s'", hints[i]);
-			goto out;
-		}
-	}
-out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_set_hints_strv (transaction, hints, &error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -4971,7 +5246,7 @@ pk_transaction_update_packages (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -5021,7 +5296,7 @@ pk_transaction_what_provides (PkTransaction *transaction,
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_WHAT_PROVIDES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -5084,7 +5359,7 @@ pk_transaction_upgrade_system (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -5138,7 +5413,7 @@ pk_transaction_repair_system (PkTransaction *transaction,
 		goto out;
 	}
 out:
-	pk_transaction_dbus_return (context, error);
+	pk_transaction_dbus_return (transaction, context, error);
 }
 
 /**
@@ -5190,164 +5465,188 @@ pk_transaction_get_property (GDBusConnection *connection_, const gchar *sender,
 }
 
 /**
- * pk_transaction_method_call:
+ * pk_transaction_dispatch:
+ *
+ * Runs a method that sets the transaction role, returning %FALSE if
+ * @method_name is not one of them.
  **/
-static void
-pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
-			    const gchar *object_path, const gchar *interface_name,
-			    const gchar *method_name, GVariant *parameters,
-			    GDBusMethodInvocation *invocation, gpointer user_data)
+static gboolean
+pk_transaction_dispatch (PkTransaction *transaction,
+			 const gchar *method_name,
+			 GVariant *parameters,
+			 GDBusMethodInvocation *context)
 {
-	PkTransaction *transaction = PK_TRANSACTION (user_data);
-
-	g_return_if_fail (transaction->priv->sender != NULL);
-
-	/* check is the same as the sender that did CreateTransaction */
-	if (g_strcmp0 (transaction->priv->sender, sender) != 0) {
-		g_dbus_method_invocation_return_error (invocation,
-						       PK_TRANSACTION_ERROR,
-						       PK_TRANSACTION_ERROR_REFUSED_BY_POLICY,
-						       "sender does not match (%s vs %s)",
-						       sender,
-						       transaction->priv->sender);
-		return;
-	}
-	if (g_strcmp0 (method_name, "SetHints") == 0) {
-		pk_transaction_set_hints (transaction, parameters, invocation);
-		return;
-	}
+	pk_transaction_trace_mark (transaction, PK_TRACE_STAGE_RECEIVED);
 	if (g_strcmp0 (method_name, "AcceptEula") == 0) {
-		pk_transaction_accept_eula (transaction, parameters, invocation);
-		return;
-	}
-	if (g_strcmp0 (method_name, "Cancel") == 0) {
-		pk_transaction_cancel (transaction, parameters, invocation);
-		return;
+		pk_transaction_accept_eula (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "DownloadPackages") == 0) {
-		pk_transaction_download_packages (transaction, parameters, invocation);
-		return;
+		pk_transaction_download_packages (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetCategories") == 0) {
-		pk_transaction_get_categories (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_categories (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "DependsOn") == 0) {
-		pk_transaction_depends_on (transaction, parameters, invocation);
-		return;
+		pk_transaction_depends_on (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetDetails") == 0) {
-		pk_transaction_get_details (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_details (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetDetailsLocal") == 0) {
-		pk_transaction_get_details_local (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_details_local (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetFilesLocal") == 0) {
-		pk_transaction_get_files_local (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_files_local (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetFiles") == 0) {
-		pk_transaction_get_files (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_files (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetOldTransactions") == 0) {
-		pk_transaction_get_old_transactions (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_old_transactions (transaction, parameters, context);
+		return TRUE;
+	}
+	if (g_strcmp0 (method_name, "GetOldTransactionsPage") == 0) {
+		pk_transaction_get_old_transactions_page (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetPackages") == 0) {
-		pk_transaction_get_packages (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_packages (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetRepoList") == 0) {
-		pk_transaction_get_repo_list (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_repo_list (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RequiredBy") == 0) {
-		pk_transaction_required_by (transaction, parameters, invocation);
-		return;
+		pk_transaction_required_by (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetUpdateDetail") == 0) {
-		pk_transaction_get_update_detail (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_update_detail (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetUpdates") == 0) {
-		pk_transaction_get_updates (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_updates (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetDistroUpgrades") == 0) {
-		pk_transaction_get_distro_upgrades (transaction, parameters, invocation);
-		return;
+		pk_transaction_get_distro_upgrades (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "InstallFiles") == 0) {
-		pk_transaction_install_files (transaction, parameters, invocation);
-		return;
+		pk_transaction_install_files (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "InstallPackages") == 0) {
-		pk_transaction_install_packages (transaction, parameters, invocation);
-		return;
+		pk_transaction_install_packages (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "InstallSignature") == 0) {
-		pk_transaction_install_signature (transaction, parameters, invocation);
-		return;
+		pk_transaction_install_signature (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RefreshCache") == 0) {
-		pk_transaction_refresh_cache (transaction, parameters, invocation);
-		return;
+		pk_transaction_refresh_cache (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RemovePackages") == 0) {
-		pk_transaction_remove_packages (transaction, parameters, invocation);
-		return;
+		pk_transaction_remove_packages (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RepoEnable") == 0) {
-		pk_transaction_repo_enable (transaction, parameters, invocation);
-		return;
+		pk_transaction_repo_enable (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RepoSetData") == 0) {
-		pk_transaction_repo_set_data (transaction, parameters, invocation);
-		return;
+		pk_transaction_repo_set_data (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RepoRemove") == 0) {
-		pk_transaction_repo_remove (transaction, parameters, invocation);
-		return;
+		pk_transaction_repo_remove (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "Resolve") == 0) {
-		pk_transaction_resolve (transaction, parameters, invocation);
-		return;
+		pk_transaction_resolve (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "SearchDetails") == 0) {
-		pk_transaction_search_details (transaction, parameters, invocation);
-		return;
+		pk_transaction_search_details (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "SearchFiles") == 0) {
-		pk_transaction_search_files (transaction, parameters, invocation);
-		return;
+		pk_transaction_search_files (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "SearchGroups") == 0) {
-		pk_transaction_search_groups (transaction, parameters, invocation);
-		return;
+		pk_transaction_search_groups (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "SearchNames") == 0) {
-		pk_transaction_search_names (transaction, parameters, invocation);
-		return;
+		pk_transaction_search_names (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "UpdatePackages") == 0) {
-		pk_transaction_update_packages (transaction, parameters, invocation);
-		return;
+		pk_transaction_update_packages (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "WhatProvides") == 0) {
-		pk_transaction_what_provides (transaction, parameters, invocation);
-		return;
+		pk_transaction_what_provides (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "UpgradeSystem") == 0) {
-		pk_transaction_upgrade_system (transaction, parameters, invocation);
-		return;
+		pk_transaction_upgrade_system (transaction, parameters, context);
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RepairSystem") == 0) {
-		pk_transaction_repair_system (transaction, parameters, invocation);
+		pk_transaction_repair_system (transaction, parameters, context);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * pk_transaction_method_call:
+ **/
+static void
+pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
+			    const gchar *object_path, const gchar *interface_name,
+			    const gchar *method_name, GVariant *parameters,
+			    GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+
+	g_return_if_fail (transaction->priv->sender != NULL);
+
+	/* check is the same as the sender that did CreateTransaction */
+	if (g_strcmp0 (transaction->priv->sender, sender) != 0) {
+		g_dbus_method_invocation_return_error (invocation,
+						       PK_TRANSACTION_ERROR,
+						       PK_TRANSACTION_ERROR_REFUSED_BY_POLICY,
+						       "sender does not match (%s vs %s)",
+						       sender,
+						       transaction->priv->sender);
+		return;
+	}
+	if (g_strcmp0 (method_name, "SetHints") == 0) {
+		pk_transaction_set_hints (transaction, parameters, invocation);
+		return;
+	}
+	if (g_strcmp0 (method_name, "Cancel") == 0) {
+		pk_transaction_cancel (transaction, parameters, invocation);
 		return;
 	}
+	if (pk_transaction_dispatch (transaction, method_name,
+				     parameters, invocation))
+		return;
 
 	/* nothing matched */
 	g_dbus_method_invocation_return_error (invocation,
@@ -5357,6 +5656,92 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 					       sender);
 }
 
+/**
+ * pk_transaction_get_in_args_signature:
+ **/
+static gchar *
+pk_transaction_get_in_args_signature (GDBusMethodInfo *method_info)
+{
+	guint i;
+	GString *str = g_string_new ("(");
+
+	for (i = 0; method_info->in_args != NULL &&
+		    method_info->in_args[i] != NULL; i++)
+		g_string_append (str, method_info->in_args[i]->signature);
+	g_string_append_c (str, ')');
+	return g_string_free (str, FALSE);
+}
+
+/**
+ * pk_transaction_start:
+ * @transaction: a #PkTransaction
+ * @hints: the hints, as passed to SetHints()
+ * @method_name: a method that sets the role, e.g. "Resolve"
+ * @parameters: the arguments for @method_name
+ * @error: a #GError, or %NULL
+ *
+ * Does SetHints() and then @method_name as if the sender had called
+ * them both, so a client can start a transaction in one round-trip.
+ *
+ * Return value: %FALSE if the hints or method were rejected
+ **/
+gboolean
+pk_transaction_start (PkTransaction *transaction,
+		      gchar **hints,
+		      const gchar *method_name,
+		      GVariant *parameters,
+		      GError **error)
+{
+	GDBusMethodInfo *method_info;
+	GError *error_local = NULL;
+	g_autofree gchar *signature = NULL;
+	g_autoptr(PkTransaction) transaction_ref = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
+	g_return_val_if_fail (transaction->priv->tid != NULL, FALSE);
+
+	/* only methods that set the role */
+	method_info = g_dbus_interface_info_lookup_method (transaction->priv->introspection->interfaces[0],
+							   method_name);
+	if (method_info == NULL ||
+	    g_strcmp0 (method_name, "SetHints") == 0 ||
+	    g_strcmp0 (method_name, "Cancel") == 0) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+			     "Cannot start a transaction with %s",
+			     method_name);
+		return FALSE;
+	}
+
+	/* GDBus only checks the outer variant */
+	signature = pk_transaction_get_in_args_signature (method_info);
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE (signature))) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "%s takes %s, not %s",
+			     method_name,
+			     signature,
+			     g_variant_get_type_string (parameters));
+		return FALSE;
+	}
+
+	if (!pk_transaction_set_hints_strv (transaction, hints, error))
+		return FALSE;
+
+	/* the scheduler drops the transaction if the method fails */
+	transaction_ref = g_object_ref (transaction);
+	transaction->priv->start_error = &error_local;
+	pk_transaction_dispatch (transaction, method_name, parameters, NULL);
+	transaction->priv->start_error = NULL;
+	if (error_local != NULL) {
+		g_propagate_error (error, error_local);
+		return FALSE;
+	}
+	return TRUE;
+}
+
 /**
  * pk_transaction_set_tid:
  */
@@ -5545,6 +5930,8 @@ pk_transaction_finalize (GObject *object)
 	g_free (transaction->priv->sender);
 	g_free (transaction->priv->cmdline);
 	g_ptr_array_unref (transaction->priv->supported_content_types);
+	if (transaction->priv->trace != NULL)
+		g_object_unref (transaction->priv->trace);
 
 	if (transaction->priv->connection != NULL)
 		g_object_unref (transaction->priv->connection);
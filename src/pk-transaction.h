@@ -27,6 +27,7 @@
 #include <packagekit-glib2/pk-results.h>
 
 #include "pk-backend.h"
+#include "pk-trace.h"
 
 G_BEGIN_DECLS
 
@@ -71,6 +72,11 @@ PkTransaction	*pk_transaction_new				(GKeyFile		*conf,
 /* go go go! */
 gboolean	 pk_transaction_run				(PkTransaction	*transaction)
 								 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 pk_transaction_start				(PkTransaction	*transaction,
+								 gchar		**hints,
+								 const gchar	*method_name,
+								 GVariant	*parameters,
+								 GError		**error);
 /* internal status */
 void		 pk_transaction_cancel_bg			(PkTransaction	*transaction);
 gboolean	 pk_transaction_get_background			(PkTransaction	*transaction);
@@ -78,6 +84,8 @@ PkRoleEnum	 pk_transaction_get_role			(PkTransaction	*transaction);
 guint		 pk_transaction_get_uid				(PkTransaction	*transaction);
 void		 pk_transaction_set_backend			(PkTransaction	*transaction,
 								 PkBackend	*backend);
+void		 pk_transaction_set_trace			(PkTransaction	*transaction,
+								 PkTrace	*trace);
 PkBackendJob	*pk_transaction_get_backend_job 		(PkTransaction	*transaction);
 PkTransactionState pk_transaction_get_state			(PkTransaction	*transaction);
 void		 pk_transaction_set_state			(PkTransaction	*transaction,
@@ -92,6 +100,11 @@ void		 pk_transaction_reset_after_lock_error		(PkTransaction *transaction);
 void		 pk_transaction_make_exclusive			(PkTransaction *transaction);
 void		 pk_transaction_skip_auth_checks		(PkTransaction *transaction,
 								 gboolean skip_checks);
+PkResults	*pk_transaction_get_results			(PkTransaction	*transaction);
+gchar		*pk_transaction_get_coalesce_key		(PkTransaction	*transaction)
+								 G_GNUC_WARN_UNUSED_RESULT;
+void		 pk_transaction_replay_results			(PkTransaction	*transaction,
+								 PkResults	*results);
 
 G_END_DECLS
 